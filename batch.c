@@ -0,0 +1,600 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "fft.h"
+#include "compression.h"
+#include "workspace.h"
+
+// --- Offline batch compressor ---
+// Compresses many raw 8-bit grayscale images of one size, given either as
+// one file of back-to-back images or as a directory of one image per file
+// (in name order), into a single archive. The input is mmapped, never
+// copied. Every worker thread takes the next image and runs it through
+// the whole pipeline (page-in and widening, FFT, quantization and coding,
+// write), so the stages of different images overlap; each FFT runs on its
+// own worker's thread, which beats splitting one small FFT across cores
+// when there are many images. Streams are written where they land: a
+// worker reserves the next range of the file and pwrites outside the lock.
+//
+// Archive format (little-endian):
+//   offset  size  field
+//        0     4  magic "FFTA"
+//        4     4  format version (ARCHIVE_VERSION)
+//        8     4  image count n
+//       12     4  reserved, 0
+//       16  20*n  index, one entry per image in input order:
+//                   u64 stream offset, u32 stream size, u32 width, u32 height
+//   16 + 20*n     the FFTC streams (see compression.h), in completion order
+//
+// The index sits at the front, so reading image i costs one read of the
+// header, one of entry i and one of the stream itself.
+
+#define ARCHIVE_MAGIC "FFTA"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_ENTRY_SIZE 20
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+} archive_entry;
+
+// One image of the input: a slice of the concatenated file, or a file of
+// the directory (mapped by the worker that takes it).
+typedef struct {
+    const unsigned char *pixels; // NULL for a directory entry
+    char *path;
+} input_image;
+
+typedef struct {
+    int width;
+    int height;
+    int tile_size; // 0 for whole-image FFTs
+    float quantization;
+    input_image *images;
+    int count;
+    int out_fd;
+    archive_entry *index;
+
+    pthread_mutex_t lock; // Guards the fields below
+    int next_image;
+    uint64_t next_offset;
+    int failed;
+    size_t output_bytes;
+} batch_job;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -s WIDTHxHEIGHT [-j jobs] [-t tile_size] [-q factor] -o archive input\n"
+            "       %s -l archive\n"
+            "       %s -x index [-o output] archive\n"
+            "  input is a file of back-to-back raw 8-bit grayscale images, or a\n"
+            "  directory of one such image per file (taken in name order)\n"
+            "  -s  image size, the same for every image\n"
+            "  -j  worker threads (default: online CPUs)\n"
+            "  -t  tile size (8, 16 or 32) for tiled streams; default whole-image\n"
+            "  -q  quantization factor; larger is smaller and coarser (default %g)\n"
+            "  -o  archive to create, or the raw image to extract (default stdout)\n"
+            "  -l  list the archive index\n"
+            "  -x  extract image `index` (from 0) as raw 8-bit grayscale\n",
+            prog, prog, prog, COMPRESSION_DEFAULT_QUANTIZATION);
+}
+
+static int pwrite_all(int fd, const void *data, size_t len, uint64_t offset) {
+    const unsigned char *p = (const unsigned char*)data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+// Returns 0 on success, -1 on an error or a short file.
+static int pread_all(int fd, void *data, size_t len, uint64_t offset) {
+    unsigned char *p = (unsigned char*)data;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+// Maps a whole file read-only. Returns NULL (after a message) on failure;
+// *size is the file size.
+static const unsigned char *map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    if (*size == 0) {
+        close(fd);
+        fprintf(stderr, "%s: empty file\n", path);
+        return NULL;
+    }
+    void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (data == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+    return (const unsigned char*)data;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(((const input_image*)a)->path, ((const input_image*)b)->path);
+}
+
+// Lists the regular files of a directory, each of which must hold exactly
+// one image. Returns the count, -1 on failure.
+static int list_directory(const char *dir, size_t image_bytes, input_image **images) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return -1;
+    }
+    int count = 0, cap = 0;
+    *images = NULL;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        size_t len = strlen(dir) + strlen(e->d_name) + 2;
+        char *path = (char*)malloc(len);
+        if (!path) {
+            perror("malloc");
+            goto fail;
+        }
+        snprintf(path, len, "%s/%s", dir, e->d_name);
+        struct stat st;
+        if (stat(path, &st) == -1 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+        if ((size_t)st.st_size != image_bytes) {
+            fprintf(stderr, "%s: %lld bytes, expected %zu\n", path, (long long)st.st_size, image_bytes);
+            free(path);
+            goto fail;
+        }
+        if (count == cap) {
+            cap = cap ? 2 * cap : 64;
+            input_image *grown = (input_image*)realloc(*images, cap * sizeof(input_image));
+            if (!grown) {
+                perror("realloc");
+                free(path);
+                goto fail;
+            }
+            *images = grown;
+        }
+        (*images)[count].pixels = NULL;
+        (*images)[count].path = path;
+        count++;
+    }
+    closedir(d);
+    qsort(*images, count, sizeof(input_image), compare_names);
+    return count;
+
+fail:
+    closedir(d);
+    for (int i = 0; i < count; ++i) {
+        free((*images)[i].path);
+    }
+    free(*images);
+    *images = NULL;
+    return -1;
+}
+
+// Compresses one image into the worker's workspace. Returns the stream and
+// its size, or NULL on failure.
+static unsigned char *compress_image(const batch_job *job, const unsigned char *pixels, workspace *ws,
+                                     size_t *size) {
+    int width = job->width, height = job->height;
+    size_t count = (size_t)width * height;
+    if (job->tile_size != 0) {
+        size_t bound = simple_compress_tiled_bound(width, height, job->tile_size);
+        size_t scratch_bytes = simple_compress_tiled_scratch_size(width, height, job->tile_size);
+        if (workspace_begin(ws, workspace_block_size(bound) + workspace_block_size(scratch_bytes)) != 0) {
+            return NULL;
+        }
+        unsigned char *out = (unsigned char*)workspace_alloc(ws, bound);
+        void *scratch = workspace_alloc(ws, scratch_bytes);
+        *size = simple_compress_tiled(pixels, width, height, job->tile_size, job->quantization, out, scratch, NULL);
+        return *size ? out : NULL;
+    }
+
+    // As in the server, the input plane is dead after the FFT and doubles
+    // as the coder's scratch.
+    size_t spectrum_bytes = (size_t)(width / 2 + 1) * height * sizeof(float);
+    size_t plane_bytes = count * sizeof(float);
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    if (plane_bytes < scratch_bytes) plane_bytes = scratch_bytes;
+    size_t bound = simple_compress_bound(width, height);
+    size_t needed = workspace_block_size(plane_bytes) + 2 * workspace_block_size(spectrum_bytes) +
+                    workspace_block_size(bound);
+    if (workspace_begin(ws, needed) != 0) return NULL;
+    float *plane = (float*)workspace_alloc(ws, plane_bytes);
+    float *real = (float*)workspace_alloc(ws, spectrum_bytes);
+    float *imag = (float*)workspace_alloc(ws, spectrum_bytes);
+    unsigned char *out = (unsigned char*)workspace_alloc(ws, bound);
+
+    for (size_t i = 0; i < count; ++i) {
+        plane[i] = (float)pixels[i];
+    }
+    if (two_d_fft_r2c(plane, real, imag, width, height) != 0) return NULL;
+    *size = simple_compress(real, imag, width, height, job->quantization, out, plane, NULL);
+    return *size ? out : NULL;
+}
+
+static void *worker_main(void *arg) {
+    batch_job *job = (batch_job*)arg;
+    workspace ws;
+    workspace_init(&ws);
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int i = job->failed ? job->count : job->next_image++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->count) break;
+
+        const unsigned char *pixels = job->images[i].pixels;
+        size_t mapped = 0;
+        if (!pixels) {
+            pixels = map_file(job->images[i].path, &mapped);
+            if (!pixels) goto fail;
+        }
+        size_t size = 0;
+        unsigned char *stream = compress_image(job, pixels, &ws, &size);
+        if (mapped) munmap((void*)pixels, mapped);
+        if (!stream) {
+            fprintf(stderr, "image %d: compression failed\n", i);
+            goto fail;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        uint64_t offset = job->next_offset;
+        job->next_offset += size;
+        job->output_bytes += size;
+        pthread_mutex_unlock(&job->lock);
+        if (pwrite_all(job->out_fd, stream, size, offset) != 0) {
+            perror("write");
+            goto fail;
+        }
+        job->index[i] = (archive_entry){ offset, (uint32_t)size, (uint32_t)job->width, (uint32_t)job->height };
+        continue;
+
+    fail:
+        pthread_mutex_lock(&job->lock);
+        job->failed = 1;
+        pthread_mutex_unlock(&job->lock);
+        break;
+    }
+    workspace_free(&ws);
+    return NULL;
+}
+
+static int create_archive(const char *input, const char *output, int width, int height, int tile_size,
+                          float quantization, int jobs) {
+    size_t image_bytes = (size_t)width * height;
+    batch_job job = { .width = width, .height = height, .tile_size = tile_size, .quantization = quantization };
+    pthread_mutex_init(&job.lock, NULL);
+
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
+    struct stat st;
+    if (stat(input, &st) == -1) {
+        perror(input);
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        job.count = list_directory(input, image_bytes, &job.images);
+        if (job.count < 0) return -1;
+    } else {
+        data = map_file(input, &data_size);
+        if (!data) return -1;
+        if (data_size % image_bytes != 0) {
+            fprintf(stderr, "%s: %zu bytes is not a whole number of %dx%d images\n", input, data_size, width,
+                    height);
+            munmap((void*)data, data_size);
+            return -1;
+        }
+        // Workers walk the file front to back, near enough.
+        madvise((void*)data, data_size, MADV_SEQUENTIAL);
+        job.count = (int)(data_size / image_bytes);
+        job.images = (input_image*)calloc(job.count, sizeof(input_image));
+        if (!job.images) {
+            perror("calloc");
+            munmap((void*)data, data_size);
+            return -1;
+        }
+        for (int i = 0; i < job.count; ++i) {
+            job.images[i].pixels = data + (size_t)i * image_bytes;
+        }
+    }
+    if (job.count == 0) {
+        fprintf(stderr, "%s: no images\n", input);
+        free(job.images);
+        return -1;
+    }
+
+    int status = -1;
+    job.index = (archive_entry*)calloc(job.count, sizeof(archive_entry));
+    pthread_t *threads = (pthread_t*)calloc(jobs, sizeof(pthread_t));
+    job.out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (!job.index || !threads || job.out_fd == -1) {
+        perror(job.out_fd == -1 ? output : "calloc");
+        goto done;
+    }
+    job.next_offset = ARCHIVE_HEADER_SIZE + (uint64_t)ARCHIVE_ENTRY_SIZE * job.count;
+
+    double start = now_seconds();
+    int started = 0;
+    for (; started < jobs; ++started) {
+        if (pthread_create(&threads[started], NULL, worker_main, &job) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    if (started == 0) goto done;
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    if (job.failed) goto done;
+
+    // Header and index last, so an interrupted run leaves no valid archive.
+    size_t index_bytes = ARCHIVE_HEADER_SIZE + (size_t)ARCHIVE_ENTRY_SIZE * job.count;
+    unsigned char *head = (unsigned char*)calloc(1, index_bytes);
+    if (!head) {
+        perror("calloc");
+        goto done;
+    }
+    memcpy(head, ARCHIVE_MAGIC, 4);
+    put_u32(head + 4, ARCHIVE_VERSION);
+    put_u32(head + 8, (uint32_t)job.count);
+    for (int i = 0; i < job.count; ++i) {
+        unsigned char *e = head + ARCHIVE_HEADER_SIZE + (size_t)ARCHIVE_ENTRY_SIZE * i;
+        put_u32(e, (uint32_t)job.index[i].offset);
+        put_u32(e + 4, (uint32_t)(job.index[i].offset >> 32));
+        put_u32(e + 8, job.index[i].size);
+        put_u32(e + 12, job.index[i].width);
+        put_u32(e + 16, job.index[i].height);
+    }
+    int written = pwrite_all(job.out_fd, head, index_bytes, 0);
+    free(head);
+    if (written != 0) {
+        perror(output);
+        goto done;
+    }
+    double seconds = now_seconds() - start;
+    double input_mb = (double)image_bytes * job.count / 1e6;
+    printf("%d images (%dx%d, %d threads) in %.3f s: %.1f images/s, %.1f MB/s in; %.1f -> %.1f MB (ratio %.2f)\n",
+           job.count, width, height, started, seconds, job.count / seconds, input_mb / seconds, input_mb,
+           (index_bytes + job.output_bytes) / 1e6, input_mb * 1e6 / (index_bytes + job.output_bytes));
+    status = 0;
+
+done:
+    if (job.out_fd != -1) {
+        if (close(job.out_fd) != 0 && status == 0) {
+            perror(output);
+            status = -1;
+        }
+        if (status != 0) unlink(output);
+    }
+    if (data) munmap((void*)data, data_size);
+    for (int i = 0; i < job.count; ++i) {
+        free(job.images[i].path);
+    }
+    free(job.images);
+    free(job.index);
+    free(threads);
+    pthread_mutex_destroy(&job.lock);
+    return status;
+}
+
+// Reads the archive header; returns the image count, -1 if invalid.
+static int read_archive_header(int fd, const char *path) {
+    unsigned char head[ARCHIVE_HEADER_SIZE];
+    if (pread_all(fd, head, sizeof(head), 0) != 0 || memcmp(head, ARCHIVE_MAGIC, 4) != 0 ||
+        get_u32(head + 4) != ARCHIVE_VERSION || get_u32(head + 8) > 0x7FFFFFFF) {
+        fprintf(stderr, "%s: not an image archive\n", path);
+        return -1;
+    }
+    return (int)get_u32(head + 8);
+}
+
+static int read_archive_entry(int fd, int i, archive_entry *entry) {
+    unsigned char e[ARCHIVE_ENTRY_SIZE];
+    if (pread_all(fd, e, sizeof(e), ARCHIVE_HEADER_SIZE + (uint64_t)ARCHIVE_ENTRY_SIZE * i) != 0) return -1;
+    entry->offset = get_u32(e) | (uint64_t)get_u32(e + 4) << 32;
+    entry->size = get_u32(e + 8);
+    entry->width = get_u32(e + 12);
+    entry->height = get_u32(e + 16);
+    return 0;
+}
+
+static int list_archive(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    int count = read_archive_header(fd, path);
+    for (int i = 0; i < count; ++i) {
+        archive_entry entry;
+        if (read_archive_entry(fd, i, &entry) != 0) {
+            fprintf(stderr, "%s: truncated index\n", path);
+            close(fd);
+            return -1;
+        }
+        printf("%d\t%ux%u\toffset %llu\t%u bytes\n", i, entry.width, entry.height,
+               (unsigned long long)entry.offset, entry.size);
+    }
+    close(fd);
+    return count < 0 ? -1 : 0;
+}
+
+// Decodes image i alone: the header, its index entry and its stream are
+// the only parts of the archive read.
+static int extract_image(const char *path, int i, const char *output) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    int status = -1;
+    unsigned char *stream = NULL, *pixels = NULL;
+    float *real = NULL, *imag = NULL, *plane = NULL;
+    archive_entry entry;
+    compression_info info;
+    int count = read_archive_header(fd, path);
+    if (count < 0) goto done;
+    if (i < 0 || i >= count) {
+        fprintf(stderr, "%s: no image %d (%d images)\n", path, i, count);
+        goto done;
+    }
+    if (read_archive_entry(fd, i, &entry) != 0 || entry.size < COMPRESSION_HEADER_SIZE ||
+        !(stream = (unsigned char*)malloc(entry.size)) || pread_all(fd, stream, entry.size, entry.offset) != 0 ||
+        simple_decompress_info(stream, entry.size, &info) != 0 || info.width > MAX_IMAGE_DIM ||
+        info.height > MAX_IMAGE_DIM || info.color != COMPRESSION_COLOR_GRAY) {
+        fprintf(stderr, "%s: image %d is unreadable\n", path, i);
+        goto done;
+    }
+    size_t count_pixels = (size_t)info.width * info.height;
+    pixels = (unsigned char*)malloc(count_pixels);
+    if (!pixels) {
+        perror("malloc");
+        goto done;
+    }
+    if (info.mode == COMPRESSION_MODE_TILED) {
+        if (simple_decompress_region(stream, entry.size, 0, 0, info.width, info.height, pixels, NULL) != 0) {
+            fprintf(stderr, "%s: image %d is corrupt\n", path, i);
+            goto done;
+        }
+    } else {
+        size_t spectrum = (size_t)(info.width / 2 + 1) * info.height;
+        real = (float*)malloc(spectrum * sizeof(float));
+        imag = (float*)malloc(spectrum * sizeof(float));
+        plane = (float*)malloc(count_pixels * sizeof(float));
+        if (!real || !imag || !plane) {
+            perror("malloc");
+            goto done;
+        }
+        if (simple_decompress(stream, entry.size, real, imag, NULL) != 0) {
+            fprintf(stderr, "%s: image %d is corrupt\n", path, i);
+            goto done;
+        }
+        if (two_d_ifft_c2r(real, imag, plane, info.width, info.height) != 0) {
+            fprintf(stderr, "%s: inverse transform failed\n", path);
+            goto done;
+        }
+        simple_decompress_pixels(plane, pixels, count_pixels);
+    }
+
+    int out = output ? open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+    if (out == -1) {
+        perror(output);
+        goto done;
+    }
+    size_t done_bytes = 0;
+    while (done_bytes < count_pixels) {
+        ssize_t n = write(out, pixels + done_bytes, count_pixels - done_bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done_bytes += (size_t)n;
+    }
+    if (done_bytes != count_pixels || (output && close(out) != 0)) {
+        perror(output ? output : "stdout");
+        goto done;
+    }
+    fprintf(stderr, "Image %d: %dx%d, %u -> %zu bytes\n", i, info.width, info.height, entry.size, count_pixels);
+    status = 0;
+
+done:
+    free(stream);
+    free(pixels);
+    free(real);
+    free(imag);
+    free(plane);
+    close(fd);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    int width = 0, height = 0, tile_size = 0, jobs = 0, extract = -1, list = 0;
+    float quantization = COMPRESSION_DEFAULT_QUANTIZATION;
+    const char *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:j:t:q:o:x:lh")) != -1) {
+        switch (opt) {
+        case 's':
+            if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'j': jobs = atoi(optarg); break;
+        case 't': tile_size = atoi(optarg); break;
+        case 'q': quantization = strtof(optarg, NULL); break;
+        case 'o': output = optarg; break;
+        case 'x': extract = atoi(optarg); break;
+        case 'l': list = 1; break;
+        default:
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *path = argv[optind];
+
+    if (list) return list_archive(path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (extract >= 0) return extract_image(path, extract, output) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (!output || width < 1 || height < 1 || width > MAX_IMAGE_DIM || height > MAX_IMAGE_DIM ||
+        (tile_size != 0 && simple_compress_tiled_bound(width, height, tile_size) == 0) ||
+        !(quantization > 0.0f) || !isfinite(quantization)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (jobs < 1) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    // Parallelism comes from running images side by side; every FFT stays
+    // on its worker's thread.
+    fft_set_threads(1);
+    int status = create_archive(path, output, width, height, tile_size, quantization, jobs);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
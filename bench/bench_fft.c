@@ -0,0 +1,370 @@
+// FFT and compression kernel benchmark.
+//
+// Times, over a sweep of sizes from 16 to 4096:
+//   fft_1d           version-2 complex 1D FFT (cplx_double), N <= FFT_1D_MAX_N
+//   fft_1d.ct        the same with the power-of-two engine forced to
+//   fft_1d.stockham  Cooley-Tukey or Stockham, power-of-two N only
+//   fft_2d           version-2 complex 2D FFT, both dimensions <= 16
+//   two_d_fft        real-pixel 2D FFT of the server, square and non-square
+//   two_d_fft_pruned real-input two_d_fft_r2c_pruned with an elliptic
+//                    low-pass mask of cutoff PRUNE_CUTOFF (GFLOP/s still
+//                    counts a full complex FFT)
+//   simple_compress  quantization + entropy coding of a two_d_fft_r2c
+//                    spectrum (the FFT itself is not included)
+// Sizes a kernel does not support are left out of its sweep.
+//
+// Each measurement warms up first, then takes samples until it has at
+// least MIN_SAMPLES and TARGET_SECONDS of them (or MAX_SAMPLES, or fewer
+// samples for very slow sizes once MAX_SECONDS is spent). A sample times
+// enough back-to-back calls to last MIN_SAMPLE_SECONDS, so the clock does
+// not dominate tiny sizes. fft_1d and fft_2d alternate forward and inverse
+// calls so values stay bounded. Reported per call:
+//   median, p99     over the samples
+//   GFLOP/s         5 N log2(N) / median, N the number of points, the
+//                   usual FFT convention (also for the real-input two_d_fft)
+//   MPixel/s        points / median
+//
+// The table goes to stdout; with -o FILE the same results are written as
+// JSON, for comparing runs between releases. -q caps the sweep at 1024,
+// for slow targets such as qemu-user.
+//
+// Usage: bench_fft [-q] [-o results.json]
+// Build: make -C bench bench_fft   (CROSS=riscv64-unknown-linux- for RVV)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "fft.h"
+#include "compression.h"
+#include "fft_1d.h"
+#include "fft_2d.h"
+
+#define MIN_SAMPLES 15
+#define MAX_SAMPLES 1000
+#define TARGET_SECONDS 0.25
+#define MAX_SECONDS 3.0
+#define WARMUP_SECONDS 0.02
+#define MIN_SAMPLE_SECONDS 20e-6
+#define MAX_RESULTS 128
+#define V2_MAX_FFT_DIM 16 // MAX_FFT_DIM in version-2/fft_2d.c
+
+typedef struct {
+    const char *kernel;
+    int width, height; // height 1 for 1D
+    int samples;
+    long calls_per_sample;
+    double median_ns, p99_ns;
+    double gflops; // < 0 when not meaningful
+    double mpixels;
+} bench_result;
+
+static bench_result results[MAX_RESULTS];
+static int num_results;
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef void (*bench_fn)(void *ctx);
+
+static void measure(const char *kernel, int width, int height, int flops, bench_fn fn, void *ctx) {
+    static double times[MAX_SAMPLES];
+
+    double start = now_seconds(), elapsed;
+    long calls = 0;
+    do {
+        fn(ctx);
+        calls++;
+        elapsed = now_seconds() - start;
+    } while (calls < 2 || elapsed < WARMUP_SECONDS);
+
+    long per_sample = (long)ceil(MIN_SAMPLE_SECONDS / (elapsed / calls));
+    if (per_sample < 1) per_sample = 1;
+
+    int samples = 0;
+    double total = 0.0;
+    while (samples < MAX_SAMPLES) {
+        double t0 = now_seconds();
+        for (long c = 0; c < per_sample; ++c) {
+            fn(ctx);
+        }
+        double t = now_seconds() - t0;
+        times[samples++] = t / per_sample;
+        total += t;
+        if (samples >= MIN_SAMPLES && total >= TARGET_SECONDS) break;
+        if (samples >= 5 && total >= MAX_SECONDS) break;
+    }
+    qsort(times, samples, sizeof(double), compare_double);
+
+    if (num_results == MAX_RESULTS) {
+        fprintf(stderr, "Too many results\n");
+        exit(1);
+    }
+    bench_result *r = &results[num_results++];
+    double points = (double)width * height;
+    r->kernel = kernel;
+    r->width = width;
+    r->height = height;
+    r->samples = samples;
+    r->calls_per_sample = per_sample;
+    r->median_ns = times[samples / 2] * 1e9;
+    r->p99_ns = times[(int)ceil(0.99 * samples) - 1] * 1e9;
+    r->gflops = flops ? 5.0 * points * log2(points) / r->median_ns : -1.0;
+    r->mpixels = points / r->median_ns * 1e3;
+
+    char size_str[32], gflops_str[16];
+    if (height == 1) {
+        snprintf(size_str, sizeof(size_str), "%d", width);
+    } else {
+        snprintf(size_str, sizeof(size_str), "%dx%d", width, height);
+    }
+    if (flops) {
+        snprintf(gflops_str, sizeof(gflops_str), "%.3f", r->gflops);
+    } else {
+        snprintf(gflops_str, sizeof(gflops_str), "-");
+    }
+    printf("%-16s %-10s %8d %14.0f %14.0f %10s %12.2f\n", kernel, size_str, samples, r->median_ns, r->p99_ns,
+           gflops_str, r->mpixels);
+    fflush(stdout);
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        perror("malloc");
+        exit(1);
+    }
+    return p;
+}
+
+static void fill_random(float *x, size_t count, unsigned int seed) {
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        x[i] = (float)((seed >> 16) & 0xff);
+    }
+}
+
+// --- Kernels ---
+
+typedef struct {
+    int rows, cols;
+    cplx_double *data;
+    int inverse;
+} v2_ctx;
+
+static void run_fft_1d(void *p) {
+    v2_ctx *c = (v2_ctx*)p;
+    fft_1d(c->cols, c->data, c->inverse);
+    c->inverse ^= 1;
+}
+
+static void run_fft_2d(void *p) {
+    v2_ctx *c = (v2_ctx*)p;
+    fft_2d(c->rows, c->cols, c->data, c->inverse);
+    c->inverse ^= 1;
+}
+
+static void bench_v2(const char *kernel, int rows, int cols) {
+    v2_ctx c = { rows, cols, (cplx_double*)xmalloc((size_t)rows * cols * sizeof(cplx_double)), 0 };
+    unsigned int seed = 777;
+    for (int i = 0; i < rows * cols; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        c.data[i] = (double)((seed >> 16) & 0xff);
+    }
+    if (rows == 1) {
+        measure(kernel, cols, 1, 1, run_fft_1d, &c);
+    } else {
+        measure(kernel, cols, rows, 1, run_fft_2d, &c);
+    }
+    free(c.data);
+}
+
+#define PRUNE_CUTOFF 0.125f
+
+typedef struct {
+    int width, height;
+    float *pixels, *re, *im, *scratch;
+    unsigned char *stream;
+    int *mask;
+} image_ctx;
+
+static void run_two_d_fft(void *p) {
+    image_ctx *c = (image_ctx*)p;
+    if (two_d_fft(c->pixels, c->re, c->im, c->width, c->height) != 0) {
+        fprintf(stderr, "two_d_fft failed\n");
+        exit(1);
+    }
+}
+
+static void run_two_d_fft_pruned(void *p) {
+    image_ctx *c = (image_ctx*)p;
+    if (two_d_fft_r2c_pruned(c->pixels, c->re, c->im, c->width, c->height, c->mask) != 0) {
+        fprintf(stderr, "two_d_fft_r2c_pruned failed\n");
+        exit(1);
+    }
+}
+
+static void run_simple_compress(void *p) {
+    image_ctx *c = (image_ctx*)p;
+    if (simple_compress(c->re, c->im, c->width, c->height, COMPRESSION_DEFAULT_QUANTIZATION, c->stream, c->scratch,
+                        NULL) == 0) {
+        fprintf(stderr, "simple_compress failed\n");
+        exit(1);
+    }
+}
+
+static void bench_image(int width, int height) {
+    size_t pixels = (size_t)width * height;
+    image_ctx c = { width, height, (float*)xmalloc(pixels * sizeof(float)), (float*)xmalloc(pixels * sizeof(float)),
+                    (float*)xmalloc(pixels * sizeof(float)), NULL, NULL, NULL };
+    fill_random(c.pixels, pixels, (unsigned int)(width * 31 + height));
+    measure("two_d_fft", width, height, 1, run_two_d_fft, &c);
+    c.mask = (int*)xmalloc(height * sizeof(int));
+    fft_mask_lowpass(c.mask, width, height, FFT_MASK_ELLIPSE, PRUNE_CUTOFF);
+    measure("two_d_fft_pruned", width, height, 1, run_two_d_fft_pruned, &c);
+
+    // Smooth content compresses like a photo; random bytes would not.
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            c.pixels[(size_t)y * width + x] = (float)(128.0 + 60.0 * sin(0.05 * x) * cos(0.03 * y)) +
+                                              0.05f * c.pixels[(size_t)y * width + x];
+        }
+    }
+    two_d_fft_r2c(c.pixels, c.re, c.im, width, height);
+    c.scratch = (float*)xmalloc(simple_compress_scratch_size(width, height));
+    c.stream = (unsigned char*)xmalloc(simple_compress_bound(width, height));
+    measure("simple_compress", width, height, 0, run_simple_compress, &c);
+
+    free(c.pixels);
+    free(c.re);
+    free(c.im);
+    free(c.scratch);
+    free(c.stream);
+    free(c.mask);
+}
+
+// --- JSON ---
+
+// Writes s as a JSON string literal: quotes, backslashes and control
+// characters are escaped, everything else is copied as is.
+static void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static int write_json(const char *path, int max_size) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(f, "{\n");
+    fprintf(f, "  \"host\": ");
+    write_json_string(f, host);
+    fprintf(f, ",\n");
+#if defined(__riscv_vector)
+    fprintf(f, "  \"arch\": \"rvv\",\n");
+#else
+    fprintf(f, "  \"arch\": \"scalar\",\n");
+#endif
+    fprintf(f, "  \"compiler\": ");
+    write_json_string(f, __VERSION__);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(f, "  \"threads\": %d,\n", fft_get_threads());
+    fprintf(f, "  \"max_size\": %d,\n", max_size);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < num_results; ++i) {
+        const bench_result *r = &results[i];
+        fprintf(f, "    {\"kernel\": ");
+        write_json_string(f, r->kernel);
+        fprintf(f, ", \"width\": %d, \"height\": %d, \"samples\": %d, "
+                   "\"calls_per_sample\": %ld, \"median_ns\": %.1f, \"p99_ns\": %.1f, ",
+                r->width, r->height, r->samples, r->calls_per_sample, r->median_ns, r->p99_ns);
+        if (r->gflops >= 0.0) {
+            fprintf(f, "\"gflops\": %.4f, ", r->gflops);
+        } else {
+            fprintf(f, "\"gflops\": null, ");
+        }
+        fprintf(f, "\"mpixels_per_s\": %.3f}%s\n", r->mpixels, i + 1 < num_results ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *json_path = NULL;
+    int max_size = 4096;
+    int opt;
+    while ((opt = getopt(argc, argv, "qo:")) != -1) {
+        switch (opt) {
+        case 'q':
+            max_size = 1024;
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-q] [-o results.json]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Width x height; 1D kernels use the widths of the square entries.
+    static const int sizes[][2] = {
+        { 16, 16 }, { 32, 32 }, { 64, 64 }, { 128, 128 }, { 256, 256 }, { 512, 512 }, { 1024, 1024 },
+        { 2048, 2048 }, { 4096, 4096 }, { 64, 16 }, { 256, 64 }, { 640, 480 }, { 1000, 750 }, { 1920, 1080 },
+        { 4096, 16 }, { 16, 4096 },
+    };
+    static const int sizes_1d[] = { 16, 32, 64, 128, 256, 512, 1000, 1024, 2048, 4096 };
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%d FFT threads, sizes up to %d\n", fft_get_threads(), max_size);
+    printf("%-16s %-10s %8s %14s %14s %10s %12s\n", "kernel", "size", "samples", "median_ns", "p99_ns", "GFLOP/s",
+           "MPixel/s");
+    for (size_t i = 0; i < sizeof(sizes_1d) / sizeof(sizes_1d[0]); ++i) {
+        if (sizes_1d[i] <= FFT_1D_MAX_N && sizes_1d[i] <= max_size) bench_v2("fft_1d", 1, sizes_1d[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes_1d) / sizeof(sizes_1d[0]); ++i) {
+        int n = sizes_1d[i];
+        if (n > FFT_1D_MAX_N || n > max_size || (n & (n - 1)) != 0) continue;
+        fft_1d_set_algorithm(FFT_1D_ALGORITHM_COOLEY_TUKEY);
+        bench_v2("fft_1d.ct", 1, n);
+        fft_1d_set_algorithm(FFT_1D_ALGORITHM_STOCKHAM);
+        bench_v2("fft_1d.stockham", 1, n);
+    }
+    fft_1d_set_algorithm(FFT_1D_ALGORITHM_AUTO);
+    for (int i = 0; i < num_sizes; ++i) {
+        int width = sizes[i][0], height = sizes[i][1];
+        if (width <= V2_MAX_FFT_DIM && height <= V2_MAX_FFT_DIM) bench_v2("fft_2d", height, width);
+    }
+    for (int i = 0; i < num_sizes; ++i) {
+        int width = sizes[i][0], height = sizes[i][1];
+        if (width <= max_size && height <= max_size) bench_image(width, height);
+    }
+
+    if (json_path && write_json(json_path, max_size) != 0) return 1;
+    return 0;
+}
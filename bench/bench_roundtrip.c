@@ -0,0 +1,188 @@
+// Compression round-trip benchmark.
+//
+// For each image size and mode, compresses a synthetic 8-bit grayscale
+// image the way POST /compress does, then decompresses it the way POST
+// /decompress does, and reports:
+//   ratio       raw image bytes / compressed bytes
+//   PSNR        of the reconstruction against the original, in dB
+//   encode      raw image MB/s through the whole compressor
+//   entropy     raw image MB/s through simple_decompress alone (full mode)
+//   decode      raw image MB/s through the whole decompressor
+//   region      microseconds to decode one 64x64 region (tiled modes)
+// Modes: "full" is one real 2D FFT over the image; "tileN" codes N x N
+// tiles independently. Times are medians over REPETITIONS runs after a
+// warm-up.
+//
+// Usage: bench_roundtrip [quantization_factor]   (default COMPRESSION_DEFAULT_QUANTIZATION)
+//
+// Build (host):  gcc -O2 -pthread -I. bench/bench_roundtrip.c fft.c fft_mixed.c fft_threads.c
+//                    fft_tile.c compression.c -o bench_roundtrip -lm
+// Build (RVV):   riscv64-unknown-linux-gcc -march=rv64gcv -mabi=lp64d -O3 -pthread -I.
+//                    bench/bench_roundtrip.c fft.c fft_mixed.c fft_threads.c fft_tile.c compression.c
+//                    -o bench_roundtrip -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "common.h"
+#include "fft.h"
+#include "compression.h"
+
+#define REPETITIONS 7
+#define REGION_DIM 64
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *times) {
+    qsort(times, REPETITIONS, sizeof(double), compare_double);
+    return times[REPETITIONS / 2];
+}
+
+// Smooth shading, a few hard edges and mild sensor-like noise, so the
+// spectrum has both a compact low-frequency part and a noisy tail.
+static void make_image(unsigned char *pixels, int width, int height) {
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double u = (double)x / width, v = (double)y / height;
+            double value = 90.0 + 60.0 * u + 40.0 * sin(6.0 * v + 3.0 * u);
+            if ((x / 64 + y / 48) % 5 == 0) value += 50.0;
+            if ((u - 0.6) * (u - 0.6) + (v - 0.4) * (v - 0.4) < 0.02) value -= 70.0;
+            seed = seed * 1103515245u + 12345u;
+            value += (double)((seed >> 16) % 9) - 4.0;
+            pixels[(size_t)y * width + x] = (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+    }
+}
+
+static double psnr(const unsigned char *a, const unsigned char *b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double d = (double)a[i] - (double)b[i];
+        sum += d * d;
+    }
+    if (sum == 0.0) return INFINITY;
+    return 10.0 * log10(255.0 * 255.0 / (sum / n));
+}
+
+// One row of the table: tile_size 0 is the full mode.
+static void run_mode(const unsigned char *image, int width, int height, int tile_size, float qf) {
+    size_t pixels = (size_t)width * height;
+    size_t bins = (size_t)(width / 2 + 1) * height;
+    size_t bound, scratch_bytes;
+    if (tile_size) {
+        bound = simple_compress_tiled_bound(width, height, tile_size);
+        scratch_bytes = simple_compress_tiled_scratch_size(width, height, tile_size);
+    } else {
+        bound = simple_compress_bound(width, height);
+        scratch_bytes = simple_compress_scratch_size(width, height);
+    }
+    size_t plane_bytes = pixels * sizeof(float);
+    if (plane_bytes < scratch_bytes) plane_bytes = scratch_bytes;
+    unsigned char *decoded = (unsigned char*)malloc(pixels);
+    float *plane = (float*)malloc(plane_bytes);
+    float *re = (float*)malloc(bins * sizeof(float));
+    float *im = (float*)malloc(bins * sizeof(float));
+    unsigned char *stream = (unsigned char*)malloc(bound);
+    if (!decoded || !plane || !re || !im || !stream) {
+        perror("malloc");
+        exit(1);
+    }
+
+    double encode[REPETITIONS], entropy[REPETITIONS], decode[REPETITIONS], region[REPETITIONS];
+    size_t size = 0;
+    for (int rep = -1; rep < REPETITIONS; ++rep) { // rep -1 is the warm-up
+        double t0 = now_seconds(), t1, t2, t3, t4 = 0.0;
+        int failed;
+        if (tile_size) {
+            size = simple_compress_tiled(image, width, height, tile_size, qf, stream, plane, NULL);
+            t1 = t2 = now_seconds();
+            failed = size == 0 || simple_decompress_region(stream, size, 0, 0, width, height, decoded, NULL) != 0;
+            t3 = now_seconds();
+            int rw = width < REGION_DIM ? width : REGION_DIM, rh = height < REGION_DIM ? height : REGION_DIM;
+            failed |= simple_decompress_region(stream, size, (width - rw) / 2, (height - rh) / 2, rw, rh,
+                                               (unsigned char*)re, NULL) != 0;
+            t4 = now_seconds() - t3;
+        } else {
+            for (size_t i = 0; i < pixels; ++i) {
+                plane[i] = (float)image[i];
+            }
+            failed = two_d_fft_r2c(plane, re, im, width, height) != 0;
+            size = simple_compress(re, im, width, height, qf, stream, plane, NULL);
+            t1 = now_seconds();
+            failed |= size == 0 || simple_decompress(stream, size, re, im, NULL) != 0;
+            t2 = now_seconds();
+            failed |= two_d_ifft_c2r(re, im, plane, width, height) != 0;
+            simple_decompress_pixels(plane, decoded, pixels);
+            t3 = now_seconds();
+        }
+        if (failed) {
+            fprintf(stderr, "%dx%d: round trip failed\n", width, height);
+            exit(1);
+        }
+        if (rep >= 0) {
+            encode[rep] = t1 - t0;
+            entropy[rep] = t2 - t1;
+            decode[rep] = t3 - t1;
+            region[rep] = t4;
+        }
+    }
+
+    char size_str[32], mode_str[16], entropy_str[16], region_str[16];
+    double mb = (double)pixels / 1e6;
+    snprintf(size_str, sizeof(size_str), "%dx%d", width, height);
+    if (tile_size) {
+        snprintf(mode_str, sizeof(mode_str), "tile%d", tile_size);
+        snprintf(entropy_str, sizeof(entropy_str), "-");
+        snprintf(region_str, sizeof(region_str), "%.1f", median(region) * 1e6);
+    } else {
+        snprintf(mode_str, sizeof(mode_str), "full");
+        snprintf(entropy_str, sizeof(entropy_str), "%.1f", mb / median(entropy));
+        snprintf(region_str, sizeof(region_str), "-");
+    }
+    printf("%-10s %-7s %12zu %8.2f %8.2f %12.1f %12s %12.1f %10s\n", size_str, mode_str, size,
+           (double)pixels / size, psnr(image, decoded, pixels), mb / median(encode), entropy_str,
+           mb / median(decode), region_str);
+
+    free(decoded);
+    free(plane);
+    free(re);
+    free(im);
+    free(stream);
+}
+
+int main(int argc, char **argv) {
+    static const int sizes[][2] = {
+        { 256, 256 }, { 512, 512 }, { 640, 480 }, { 1024, 1024 }, { 1920, 1080 }, { 2048, 2048 },
+    };
+    static const int tile_sizes[] = { 0, 8, 16, 32 };
+    float qf = argc > 1 ? (float)atof(argv[1]) : COMPRESSION_DEFAULT_QUANTIZATION;
+    if (!(qf > 0.0f)) {
+        fprintf(stderr, "Usage: %s [quantization_factor]\n", argv[0]);
+        return 1;
+    }
+
+    printf("quantization %.1f, %d FFT threads\n", qf, fft_get_threads());
+    printf("%-10s %-7s %12s %8s %8s %12s %12s %12s %10s\n", "size", "mode", "bytes", "ratio", "PSNR_dB",
+           "encode_MB/s", "entropy_MB/s", "decode_MB/s", "region_us");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int width = sizes[s][0], height = sizes[s][1];
+        unsigned char *image = (unsigned char*)malloc((size_t)width * height);
+        if (!image) {
+            perror("malloc");
+            return 1;
+        }
+        make_image(image, width, height);
+        for (size_t m = 0; m < sizeof(tile_sizes) / sizeof(tile_sizes[0]); ++m) {
+            run_mode(image, width, height, tile_sizes[m], qf);
+        }
+        free(image);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Column-pass data movement benchmark.
+//
+// Times the ways the 2D FFT has brought one float plane into column-contiguous
+// order and back again (the FFT work itself is left out):
+//   gather      per-column strided gather/scatter (old fft.c column pass)
+//   copy-back   naive transpose + copy-back, twice (old version-2 fft_2d)
+//   tiled       tiled out-of-place transpose there and back (non-square path)
+//   inplace     tiled in-place square transpose, twice (square path)
+//
+// "traffic" is the nominal number of bytes each method loads and stores; GB/s
+// is that traffic divided by the median time.
+//
+// Build (host):  gcc -O2 -I. bench/bench_transpose.c transpose.c -o bench_transpose
+// Build (RVV):   riscv64-unknown-linux-gcc -march=rv64gcv -mabi=lp64d -O3 -I.
+//                    bench/bench_transpose.c transpose.c -o bench_transpose
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "transpose.h"
+
+#define REPETITIONS 7
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void method_gather(float *plane, float *temp, float *column, int rows, int cols) {
+    (void)temp;
+    for (int c = 0; c < cols; ++c) {
+        for (int r = 0; r < rows; ++r) {
+            column[r] = plane[(size_t)r * cols + c];
+        }
+        for (int r = 0; r < rows; ++r) {
+            plane[(size_t)r * cols + c] = column[r];
+        }
+    }
+}
+
+static void method_copy_back(float *plane, float *temp, float *column, int rows, int cols) {
+    (void)column;
+    size_t n = (size_t)rows * cols;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            temp[(size_t)c * rows + r] = plane[(size_t)r * cols + c];
+        }
+    }
+    memcpy(plane, temp, n * sizeof(float));
+    for (int r = 0; r < cols; ++r) {
+        for (int c = 0; c < rows; ++c) {
+            temp[(size_t)c * cols + r] = plane[(size_t)r * rows + c];
+        }
+    }
+    memcpy(plane, temp, n * sizeof(float));
+}
+
+static void method_tiled(float *plane, float *temp, float *column, int rows, int cols) {
+    (void)column;
+    transpose_tiled(plane, temp, rows, cols);
+    transpose_tiled(temp, plane, cols, rows);
+}
+
+static void method_inplace(float *plane, float *temp, float *column, int rows, int cols) {
+    (void)temp; (void)column; (void)cols;
+    transpose_square_inplace(plane, rows);
+    transpose_square_inplace(plane, rows);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(float *plane, float *temp, float *column, int rows, int cols);
+    int passes; // full-plane read+write sweeps
+    int square_only;
+} method;
+
+static const method methods[] = {
+    { "gather",    method_gather,    2, 0 },
+    { "copy-back", method_copy_back, 4, 0 },
+    { "tiled",     method_tiled,     2, 0 },
+    { "inplace",   method_inplace,   2, 1 },
+};
+
+int main(void) {
+    static const int sizes[][2] = {
+        { 256, 256 }, { 512, 512 }, { 1024, 1024 }, { 2048, 2048 },
+        { 1080, 1920 }, { 2048, 1025 },
+    };
+
+    printf("%-10s %-10s %12s %12s %10s\n", "size", "method", "traffic_MB", "median_ms", "GB/s");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int rows = sizes[s][0], cols = sizes[s][1];
+        size_t n = (size_t)rows * cols;
+        float *plane = (float*)malloc(n * sizeof(float));
+        float *temp = (float*)malloc(n * sizeof(float));
+        float *column = (float*)malloc(rows * sizeof(float));
+        if (!plane || !temp || !column) {
+            perror("malloc");
+            return 1;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            plane[i] = (float)(i % 251);
+        }
+
+        for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); ++m) {
+            if (methods[m].square_only && rows != cols) continue;
+
+            double times[REPETITIONS];
+            methods[m].run(plane, temp, column, rows, cols); // warm-up
+            for (int rep = 0; rep < REPETITIONS; ++rep) {
+                double t0 = now_seconds();
+                methods[m].run(plane, temp, column, rows, cols);
+                times[rep] = now_seconds() - t0;
+            }
+            qsort(times, REPETITIONS, sizeof(double), compare_double);
+            double median = times[REPETITIONS / 2];
+            double traffic = 2.0 * methods[m].passes * (double)n * sizeof(float);
+
+            char size_str[32];
+            snprintf(size_str, sizeof(size_str), "%dx%d", cols, rows);
+            printf("%-10s %-10s %12.1f %12.3f %10.2f\n", size_str, methods[m].name,
+                   traffic / 1e6, median * 1e3, traffic / median / 1e9);
+        }
+
+        free(plane);
+        free(temp);
+        free(column);
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+// Accuracy-vs-speed table for version-2's precision-specialized FFTs.
+//
+// For each size and element type (fp64, fp32, fp16, Q15), runs the 1D or
+// 2D transform of the same random complex signal (|re|, |im| < 0.5) and
+// reports:
+//   ns          median time of one transform (a forward/inverse pair,
+//               halved, so values stay in range across repetitions)
+//   MFLOP/s     5 N log2(N) / ns, the usual FFT convention
+//   SNR_dB      10 log10(sum |X|^2 / sum |X - ref|^2) of the forward
+//               output against a long double DFT; Q15 output is scaled
+//               back up by N (its per-stage halving) before comparing
+//   bits        SNR_dB / 6.02, the effective precision of the result
+//
+// fp16 only runs when the compiler has _Float16; without Zvfh it is
+// emulated and its speed is not meaningful.
+//
+// Build (host):  gcc -O2 -Iversion-2 bench/bench_typed.c version-2/fft_typed.c bench/uart_host.c
+//                    -o bench_typed -lm
+// Build (RVV):   riscv64-unknown-linux-gcc -march=rv64gcv_zvfh -mabi=lp64d -O3 -Iversion-2
+//                    bench/bench_typed.c version-2/fft_typed.c bench/uart_host.c -o bench_typed -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "common.h"
+#include "fft_typed.h"
+
+#define REPETITIONS 7
+// Transforms per timed repetition scale with 1 / (N log2 N), so every
+// repetition does about this many butterflies.
+#define BUTTERFLIES_PER_REP (1 << 20)
+
+static const char *type_names[FFT_TYPE_COUNT] = { "fp64", "fp32", "fp16", "q15" };
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int log2i(int n) {
+    int log2n = 0;
+    while ((1 << log2n) < n) log2n++;
+    return log2n;
+}
+
+// Forward DFT of count transforms of length n, elements stride apart and
+// transforms dist apart, in long double.
+static void reference_dft(long double *re, long double *im, int n, int stride, int dist, int count) {
+    long double *cos_table = (long double*)malloc(n * sizeof(long double));
+    long double *sin_table = (long double*)malloc(n * sizeof(long double));
+    long double *out_re = (long double*)malloc(n * sizeof(long double));
+    long double *out_im = (long double*)malloc(n * sizeof(long double));
+    if (!cos_table || !sin_table || !out_re || !out_im) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int k = 0; k < n; ++k) {
+        cos_table[k] = cosl(-2.0L * M_PI * k / n);
+        sin_table[k] = sinl(-2.0L * M_PI * k / n);
+    }
+    for (int t = 0; t < count; ++t) {
+        long double *x_re = re + (size_t)t * dist, *x_im = im + (size_t)t * dist;
+        for (int k = 0; k < n; ++k) {
+            long double sum_re = 0.0L, sum_im = 0.0L;
+            for (int j = 0; j < n; ++j) {
+                int w = (int)(((long)j * k) % n);
+                long double a = x_re[j * stride], b = x_im[j * stride];
+                sum_re += a * cos_table[w] - b * sin_table[w];
+                sum_im += a * sin_table[w] + b * cos_table[w];
+            }
+            out_re[k] = sum_re;
+            out_im[k] = sum_im;
+        }
+        for (int k = 0; k < n; ++k) {
+            x_re[k * stride] = out_re[k];
+            x_im[k * stride] = out_im[k];
+        }
+    }
+    free(cos_table);
+    free(sin_table);
+    free(out_re);
+    free(out_im);
+}
+
+static void to_type(int type, const double *x, void *out, int count) {
+    for (int i = 0; i < count; ++i) {
+        switch (type) {
+        case FFT_TYPE_F64:
+            ((double*)out)[i] = x[i];
+            break;
+        case FFT_TYPE_F32:
+            ((float*)out)[i] = (float)x[i];
+            break;
+#if FFT_TYPED_HAVE_F16
+        case FFT_TYPE_F16:
+            ((fft_f16*)out)[i] = (fft_f16)x[i];
+            break;
+#endif
+        case FFT_TYPE_Q15:
+            ((int16_t*)out)[i] = (int16_t)lrint(x[i] * 32768.0);
+            break;
+        }
+    }
+}
+
+static double from_type(int type, const void *x, int i) {
+    switch (type) {
+    case FFT_TYPE_F64:
+        return ((const double*)x)[i];
+    case FFT_TYPE_F32:
+        return ((const float*)x)[i];
+#if FFT_TYPED_HAVE_F16
+    case FFT_TYPE_F16:
+        return (double)((const fft_f16*)x)[i];
+#endif
+    case FFT_TYPE_Q15:
+        return ((const int16_t*)x)[i] / 32768.0;
+    }
+    return 0.0;
+}
+
+// One transform: rows == 1 is a 1D FFT of length cols.
+static void transform(int type, int rows, int cols, void *re, void *im, const fft_typed_plan *plan, int inverse) {
+    if (rows == 1) {
+        fft_typed_execute(plan, re, im);
+    } else {
+        fft_typed_2d(rows, cols, type, re, im, inverse);
+    }
+}
+
+static void run_size(int rows, int cols) {
+    int count = rows * cols;
+    double *signal_re = (double*)malloc(count * sizeof(double));
+    double *signal_im = (double*)malloc(count * sizeof(double));
+    long double *ref_re = (long double*)malloc(count * sizeof(long double));
+    long double *ref_im = (long double*)malloc(count * sizeof(long double));
+    void *re = malloc(count * sizeof(double));
+    void *im = malloc(count * sizeof(double));
+    if (!signal_re || !signal_im || !ref_re || !ref_im || !re || !im) {
+        perror("malloc");
+        exit(1);
+    }
+
+    unsigned int seed = 12345;
+    for (int i = 0; i < count; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        signal_re[i] = ((seed >> 8) & 0xffff) / 65536.0 - 0.5;
+        seed = seed * 1103515245u + 12345u;
+        signal_im[i] = ((seed >> 8) & 0xffff) / 65536.0 - 0.5;
+        ref_re[i] = signal_re[i];
+        ref_im[i] = signal_im[i];
+    }
+    reference_dft(ref_re, ref_im, cols, 1, cols, rows);
+    if (rows > 1) reference_dft(ref_re, ref_im, rows, cols, 1, cols);
+
+    double flops = 5.0 * count * log2i(count);
+    int pairs = BUTTERFLIES_PER_REP / (count / 2 * (log2i(count) > 0 ? log2i(count) : 1));
+    if (pairs < 1) pairs = 1;
+
+    char size_str[32];
+    if (rows == 1) {
+        snprintf(size_str, sizeof(size_str), "%d", cols);
+    } else {
+        snprintf(size_str, sizeof(size_str), "%dx%d", rows, cols);
+    }
+
+    for (int type = 0; type < FFT_TYPE_COUNT; ++type) {
+        if (!fft_typed_supported(type)) continue;
+        fft_typed_plan *forward = 0, *inverse = 0;
+        if (rows == 1) {
+            forward = fft_typed_plan_create(cols, 0, type);
+            inverse = fft_typed_plan_create(cols, 1, type);
+            if (!forward || !inverse) {
+                fprintf(stderr, "%s: plan creation failed\n", size_str);
+                exit(1);
+            }
+        }
+
+        // Accuracy: one forward transform.
+        to_type(type, signal_re, re, count);
+        to_type(type, signal_im, im, count);
+        transform(type, rows, cols, re, im, forward, 0);
+        double scale = type == FFT_TYPE_Q15 ? (double)count : 1.0;
+        long double signal = 0.0L, noise = 0.0L;
+        for (int i = 0; i < count; ++i) {
+            long double dr = from_type(type, re, i) * scale - ref_re[i];
+            long double di = from_type(type, im, i) * scale - ref_im[i];
+            signal += ref_re[i] * ref_re[i] + ref_im[i] * ref_im[i];
+            noise += dr * dr + di * di;
+        }
+        double snr = noise > 0.0L ? (double)(10.0L * log10l(signal / noise)) : INFINITY;
+
+        // Speed: forward/inverse pairs; rep -1 is the warm-up.
+        double times[REPETITIONS];
+        for (int rep = -1; rep < REPETITIONS; ++rep) {
+            to_type(type, signal_re, re, count);
+            to_type(type, signal_im, im, count);
+            double t0 = now_seconds();
+            for (int p = 0; p < pairs; ++p) {
+                transform(type, rows, cols, re, im, forward, 0);
+                transform(type, rows, cols, re, im, inverse, 1);
+            }
+            if (rep >= 0) times[rep] = (now_seconds() - t0) / (2.0 * pairs);
+        }
+        qsort(times, REPETITIONS, sizeof(double), compare_double);
+        double ns = times[REPETITIONS / 2] * 1e9;
+
+        printf("%-10s %-5s %5d %12.0f %10.1f %8.1f %6.1f\n", size_str, type_names[type],
+               fft_typed_element_size(type), ns, flops / ns * 1e3, snr, snr / 6.02);
+        fft_typed_plan_destroy(forward);
+        fft_typed_plan_destroy(inverse);
+    }
+
+    free(signal_re);
+    free(signal_im);
+    free(ref_re);
+    free(ref_im);
+    free(re);
+    free(im);
+}
+
+int main(void) {
+    static const int sizes[][2] = {
+        { 1, 64 }, { 1, 256 }, { 1, 1024 }, { 32, 32 }, { 64, 64 }, { 128, 128 }, { 64, 256 },
+    };
+
+    printf("%-10s %-5s %5s %12s %10s %8s %6s\n", "size", "type", "bytes", "ns", "MFLOP/s", "SNR_dB", "bits");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        run_size(sizes[s][0], sizes[s][1]);
+    }
+    return 0;
+}
@@ -0,0 +1,375 @@
+// Load generator for the compression server.
+//
+// Drives POST /compress over -c concurrent connections, one thread each,
+// with synthetic 8-bit grayscale images, and reports throughput and the
+// latency distribution. Each connection cycles through the -s sizes.
+//   closed loop (default)  every connection sends its next request as
+//                          soon as the previous response arrives
+//   open loop (-r rate)    requests are due at a fixed total rate, spread
+//                          evenly over the connections; latency counts
+//                          from when a request was due, not when it went
+//                          out, so a server that falls behind shows the
+//                          queueing delay instead of hiding it
+//                          (coordinated omission)
+// Connections are kept alive unless -n is given, in which case every
+// request opens a new connection and asks the server to close it.
+//
+// Latencies go into an HDR-style histogram: exact below 2^HIST_SUB_BITS
+// ns, then 2^(HIST_SUB_BITS - 1) linear sub-buckets per power of two, so
+// every percentile is within 1/128 of the true value.
+//
+// Usage: loadgen [-h host] [-p port] [-c connections] [-d seconds]
+//                [-s WxH[,WxH...]] [-r requests_per_second] [-n]
+//
+// Build (host):  make -C bench loadgen
+// Run:           ./image_compress_server & bench/loadgen -c 8 -d 10 -s 256x256,512x512
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define MAX_SIZES 16
+#define MAX_CONNECTIONS 1024
+#define HIST_SUB_BITS 8
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((1 << HIST_SUB_BITS) + (64 - HIST_SUB_BITS) * HIST_HALF)
+#define RESPONSE_HEADER_MAX 4096
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+    double sum;
+} histogram;
+
+typedef struct {
+    unsigned char *request; // Headers and body, ready to send
+    size_t request_len;
+} image_request;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    histogram hist;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t sent_bytes;
+    uint64_t received_bytes;
+} connection_stats;
+
+static struct sockaddr_in server_addr;
+static image_request sizes[MAX_SIZES];
+static int size_count;
+static int connections = 4;
+static double duration = 10.0;
+static double rate; // Requests per second over all connections; 0 for closed loop
+static int keep_alive = 1;
+static uint64_t start_ns, end_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static int hist_index(uint64_t value) {
+    if (value < (1u << HIST_SUB_BITS)) return (int)value;
+    int shift = 63 - __builtin_clzll(value) - (HIST_SUB_BITS - 1);
+    return (1 << HIST_SUB_BITS) + (shift - 1) * HIST_HALF + (int)(value >> shift) - HIST_HALF;
+}
+
+// Largest value that lands in bucket index.
+static uint64_t hist_value(int index) {
+    if (index < (1 << HIST_SUB_BITS)) return (uint64_t)index;
+    int shift = (index - (1 << HIST_SUB_BITS)) / HIST_HALF + 1;
+    uint64_t sub = (uint64_t)((index - (1 << HIST_SUB_BITS)) % HIST_HALF + HIST_HALF);
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hist_record(histogram *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value > h->max) h->max = value;
+}
+
+static void hist_merge(histogram *into, const histogram *h) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        into->counts[i] += h->counts[i];
+    }
+    into->total += h->total;
+    into->sum += h->sum;
+    if (h->max > into->max) into->max = h->max;
+}
+
+static uint64_t hist_percentile(const histogram *h, double percentile) {
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * h->total);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+// Same synthetic content as bench_roundtrip: smooth shading, hard edges
+// and mild noise.
+static void make_image(unsigned char *pixels, int width, int height) {
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double u = (double)x / width, v = (double)y / height;
+            double value = 90.0 + 60.0 * u + 40.0 * sin(6.0 * v + 3.0 * u);
+            if ((x / 64 + y / 48) % 5 == 0) value += 50.0;
+            seed = seed * 1103515245u + 12345u;
+            value += (double)((seed >> 16) % 9) - 4.0;
+            pixels[(size_t)y * width + x] = value < 0 ? 0 : value > 255 ? 255 : (unsigned char)value;
+        }
+    }
+}
+
+static int add_size(int width, int height) {
+    if (size_count == MAX_SIZES || width < 1 || height < 1) return -1;
+    image_request *r = &sizes[size_count];
+    size_t pixels = (size_t)width * height;
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "POST /compress HTTP/1.1\r\nHost: loadgen\r\n"
+                              "Content-Type: application/octet-stream\r\nContent-Length: %zu\r\n"
+                              "X-Image-Width: %d\r\nX-Image-Height: %d\r\n%s\r\n",
+                              pixels, width, height, keep_alive ? "" : "Connection: close\r\n");
+    r->request = (unsigned char*)malloc(header_len + pixels);
+    if (!r->request) {
+        perror("malloc");
+        return -1;
+    }
+    memcpy(r->request, header, header_len);
+    make_image(r->request + header_len, width, height);
+    r->request_len = header_len + pixels;
+    size_count++;
+    return 0;
+}
+
+static int open_connection(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_all(int fd, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads one response, discarding the body. Returns the bytes read, or -1
+// if the connection failed or the status was not 200. *close_after is set
+// when the server will close the connection.
+static ssize_t read_response(int fd, int *close_after) {
+    char header[RESPONSE_HEADER_MAX + 1];
+    size_t len = 0;
+    char *end = NULL;
+    while (!end) {
+        if (len == RESPONSE_HEADER_MAX) return -1;
+        ssize_t n = recv(fd, header + len, RESPONSE_HEADER_MAX - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        len += (size_t)n;
+        header[len] = '\0';
+        end = strstr(header, "\r\n\r\n");
+    }
+    size_t header_len = (size_t)(end - header) + 4;
+    long content_length = -1;
+    *close_after = strncmp(header, "HTTP/1.1", 8) != 0;
+    for (char *line = strstr(header, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = atol(line + 17);
+        } else if (strncasecmp(line + 2, "Connection: close", 17) == 0) {
+            *close_after = 1;
+        }
+    }
+    if (content_length < 0) return -1;
+    // Whatever followed the headers is body; pipelining is not used, so
+    // nothing past this response is in flight.
+    size_t have = len - header_len;
+    size_t remaining = have < (size_t)content_length ? (size_t)content_length - have : 0;
+    char discard[65536];
+    while (remaining > 0) {
+        ssize_t n = recv(fd, discard, remaining < sizeof(discard) ? remaining : sizeof(discard), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        remaining -= (size_t)n;
+    }
+    if (strncmp(header + 9, "200", 3) != 0) return -1;
+    return (ssize_t)(header_len + content_length);
+}
+
+static void *connection_main(void *arg) {
+    connection_stats *stats = (connection_stats*)arg;
+    // Open loop: this connection's share of the rate, phase-shifted so
+    // the connections do not fire together.
+    uint64_t interval = rate > 0 ? (uint64_t)(1e9 * connections / rate) : 0;
+    uint64_t due = start_ns + interval * stats->id / connections;
+    int fd = -1;
+    for (uint64_t k = 0;; ++k) {
+        if (interval) {
+            if (due >= end_ns) break;
+            sleep_until(due);
+        } else if (now_ns() >= end_ns) {
+            break;
+        }
+        const image_request *r = &sizes[(stats->id + k) % size_count];
+        uint64_t sent = now_ns();
+        uint64_t begin = interval ? due : sent;
+        int close_after = 1;
+        ssize_t received = -1;
+        if (fd == -1) fd = open_connection();
+        if (fd != -1 && send_all(fd, r->request, r->request_len) == 0) {
+            received = read_response(fd, &close_after);
+        }
+        if (received < 0) {
+            stats->errors++;
+        } else {
+            hist_record(&stats->hist, now_ns() - begin);
+            stats->requests++;
+            stats->sent_bytes += r->request_len;
+            stats->received_bytes += (uint64_t)received;
+        }
+        if (fd != -1 && (received < 0 || close_after || !keep_alive)) {
+            close(fd);
+            fd = -1;
+        }
+        due += interval;
+    }
+    if (fd != -1) close(fd);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-h host] [-p port] [-c connections] [-d seconds] [-s WxH[,WxH...]]\n"
+            "          [-r requests_per_second] [-n]\n"
+            "  -h  server address (default 127.0.0.1)\n"
+            "  -p  server port (default 8080)\n"
+            "  -c  concurrent connections (default 4)\n"
+            "  -d  test duration in seconds (default 10)\n"
+            "  -s  image sizes, cycled per request (default 256x256)\n"
+            "  -r  open loop at this total rate; default closed loop\n"
+            "  -n  no keep-alive: one connection per request\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1", *size_list = "256x256";
+    int port = 8080;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:d:s:r:n")) != -1) {
+        switch (opt) {
+        case 'h': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'c': connections = atoi(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 's': size_list = optarg; break;
+        case 'r': rate = atof(optarg); break;
+        case 'n': keep_alive = 0; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (connections < 1 || connections > MAX_CONNECTIONS || !(duration > 0) || rate < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Bad address: %s\n", host);
+        return EXIT_FAILURE;
+    }
+    for (const char *p = size_list; *p;) {
+        int width, height, n;
+        if (sscanf(p, "%dx%d%n", &width, &height, &n) != 2 || add_size(width, height) != 0) {
+            fprintf(stderr, "Bad image size list: %s\n", size_list);
+            return EXIT_FAILURE;
+        }
+        p += n;
+        if (*p == ',') p++;
+    }
+
+    connection_stats *stats = (connection_stats*)calloc(connections, sizeof(connection_stats));
+    if (!stats) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    start_ns = now_ns();
+    end_ns = start_ns + (uint64_t)(duration * 1e9);
+    int started = 0;
+    for (; started < connections; ++started) {
+        stats[started].id = started;
+        if (pthread_create(&stats[started].thread, NULL, connection_main, &stats[started]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    histogram *total = (histogram*)calloc(1, sizeof(histogram));
+    uint64_t requests = 0, errors = 0, sent = 0, received = 0;
+    for (int i = 0; i < started; ++i) {
+        pthread_join(stats[i].thread, NULL);
+        hist_merge(total, &stats[i].hist);
+        requests += stats[i].requests;
+        errors += stats[i].errors;
+        sent += stats[i].sent_bytes;
+        received += stats[i].received_bytes;
+    }
+    double elapsed = (now_ns() - start_ns) * 1e-9;
+
+    printf("%s loop, %d connections%s, %.1f s, sizes %s\n", rate > 0 ? "open" : "closed", started,
+           keep_alive ? "" : " (no keep-alive)", elapsed, size_list);
+    if (rate > 0) printf("target rate   %.1f req/s\n", rate);
+    printf("requests      %llu ok, %llu failed\n", (unsigned long long)requests, (unsigned long long)errors);
+    printf("throughput    %.1f req/s, %.2f MB/s up, %.2f MB/s down\n", requests / elapsed, sent / 1e6 / elapsed,
+           received / 1e6 / elapsed);
+    if (requests > 0) {
+        printf("latency (ms)  mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p999 %.3f  max %.3f\n",
+               total->sum / total->total * 1e-6, hist_percentile(total, 50.0) * 1e-6,
+               hist_percentile(total, 90.0) * 1e-6, hist_percentile(total, 99.0) * 1e-6,
+               hist_percentile(total, 99.9) * 1e-6, total->max * 1e-6);
+    }
+    free(total);
+    free(stats);
+    for (int i = 0; i < size_count; ++i) {
+        free(sizes[i].request);
+    }
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,495 @@
+// Compression round-trip tests.
+//
+// Compresses synthetic 8-bit images the way the server does, decodes them
+// back and checks the reconstruction:
+//   full mode and tiles  PSNR above a floor and a real size reduction at
+//                        the default quantization factor
+//   size independence    the same content at 256x256 and 1024x1024 comes
+//                        back at about the same PSNR (the step is scaled
+//                        by the transform size)
+//   quantization factor  a larger factor never makes the stream bigger
+//   full and tiles       the same factor gives about the same PSNR in
+//                        both modes
+//   format version       a stream with another version byte is refused
+//   regions              any region of a tiled stream decodes to the same
+//                        pixels as that part of the whole image
+//   streaming            simple_compress_stream hands the sink exactly
+//                        the bytes of simple_compress, in full chunks,
+//                        and stops at the first sink failure
+//   color                RGB through YCbCr 4:4:4 and 4:2:0 planes comes
+//                        back above a PSNR floor, 4:2:0 in fewer bytes
+//   frame factor         a frame sequence starts a key frame when the
+//                        quantization factor changes, every frame decodes
+//                        to what simple_compress gives at its factor, and
+//                        a delta against another factor is refused
+//
+// Prints one line per failure and a summary; exits 1 if anything failed.
+//
+// Usage: test_compression
+// Build: make -C bench test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fft.h"
+#include "image.h"
+#include "compression.h"
+
+#define MIN_PSNR 35.0     // dB at the default factor
+#define MIN_RATIO 6.0     // Raw bytes / stream bytes at the default factor
+#define MAX_PSNR_SPREAD 3.0 // dB between sizes, same content and factor
+#define MIN_COLOR_PSNR 30.0 // dB over the RGB values; chroma is coarser
+
+static int checks;
+static int failures;
+
+static void check(const char *test, int width, int height, int ok, const char *detail) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("FAIL %-24s %dx%d %s\n", test, width, height, detail);
+    }
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        perror("malloc");
+        exit(1);
+    }
+    return p;
+}
+
+// The content of bench_roundtrip, scaled to the image: smooth shading,
+// hard edges and mild noise.
+static void make_image(unsigned char *pixels, int width, int height) {
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double u = (double)x / width, v = (double)y / height;
+            double value = 90.0 + 60.0 * u + 40.0 * sin(6.0 * v + 3.0 * u);
+            if (((int)(u * 16) + (int)(v * 16)) % 5 == 0) value += 50.0;
+            if ((u - 0.6) * (u - 0.6) + (v - 0.4) * (v - 0.4) < 0.02) value -= 70.0;
+            seed = seed * 1103515245u + 12345u;
+            value += (double)((seed >> 16) % 9) - 4.0;
+            pixels[(size_t)y * width + x] = (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+    }
+}
+
+static double psnr(const unsigned char *a, const unsigned char *b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double d = (double)a[i] - (double)b[i];
+        sum += d * d;
+    }
+    return sum == 0.0 ? INFINITY : 10.0 * log10(255.0 * 255.0 / (sum / n));
+}
+
+// Compresses image in the given mode (tile_size 0 for full) and decodes it
+// into decoded. Returns the stream size, 0 if either step failed; the
+// stream is left in *stream (free it).
+static size_t round_trip(const unsigned char *image, int width, int height, int tile_size, float qf,
+                         unsigned char *decoded, unsigned char **stream) {
+    size_t pixels = (size_t)width * height;
+    size_t bins = (size_t)(width / 2 + 1) * height;
+    size_t bound = tile_size ? simple_compress_tiled_bound(width, height, tile_size)
+                             : simple_compress_bound(width, height);
+    size_t scratch_bytes = tile_size ? simple_compress_tiled_scratch_size(width, height, tile_size)
+                                     : simple_compress_scratch_size(width, height);
+    size_t plane_bytes = pixels * sizeof(float);
+    if (plane_bytes < scratch_bytes) plane_bytes = scratch_bytes;
+    float *plane = (float*)xmalloc(plane_bytes);
+    float *re = (float*)xmalloc(bins * sizeof(float)), *im = (float*)xmalloc(bins * sizeof(float));
+    *stream = (unsigned char*)xmalloc(bound);
+
+    size_t size;
+    int failed;
+    if (tile_size) {
+        size = simple_compress_tiled(image, width, height, tile_size, qf, *stream, plane, NULL);
+        failed = size == 0 || simple_decompress_region(*stream, size, 0, 0, width, height, decoded, NULL) != 0;
+    } else {
+        for (size_t i = 0; i < pixels; ++i) {
+            plane[i] = (float)image[i];
+        }
+        failed = two_d_fft_r2c(plane, re, im, width, height) != 0;
+        size = simple_compress(re, im, width, height, qf, *stream, plane, NULL);
+        failed |= size == 0 || simple_decompress(*stream, size, re, im, NULL) != 0;
+        failed |= two_d_ifft_c2r(re, im, plane, width, height) != 0;
+        simple_decompress_pixels(plane, decoded, pixels);
+    }
+    free(plane);
+    free(re);
+    free(im);
+    return failed ? 0 : size;
+}
+
+// Returns the PSNR, or 0 if the round trip failed.
+static double test_mode(const char *test, int width, int height, int tile_size) {
+    size_t pixels = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    unsigned char *decoded = (unsigned char*)xmalloc(pixels);
+    unsigned char *stream;
+    make_image(image, width, height);
+    size_t size = round_trip(image, width, height, tile_size, COMPRESSION_DEFAULT_QUANTIZATION, decoded, &stream);
+    double quality = size ? psnr(image, decoded, pixels) : 0.0;
+    double ratio = size ? (double)pixels / size : 0.0;
+    char detail[128];
+    snprintf(detail, sizeof(detail), "PSNR %.2f dB, ratio %.2f", quality, ratio);
+    check(test, width, height, size != 0 && quality >= MIN_PSNR && ratio >= MIN_RATIO, detail);
+    free(image);
+    free(decoded);
+    free(stream);
+    return quality;
+}
+
+// A larger factor must not grow the stream; tile_size 0 for full mode.
+static void test_monotonic(int width, int height, int tile_size) {
+    static const float factors[] = { 2.0f, 6.0f, 12.5f, 25.0f, 50.0f };
+    size_t pixels = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    unsigned char *decoded = (unsigned char*)xmalloc(pixels);
+    make_image(image, width, height);
+    size_t previous = 0;
+    for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); ++i) {
+        unsigned char *stream;
+        size_t size = round_trip(image, width, height, tile_size, factors[i], decoded, &stream);
+        char detail[128];
+        snprintf(detail, sizeof(detail), "tile %d, factor %.1f: %zu bytes after %zu", tile_size, factors[i], size,
+                 previous);
+        check("larger factor, smaller", width, height, size != 0 && (i == 0 || size <= previous), detail);
+        previous = size;
+        free(stream);
+    }
+    free(image);
+    free(decoded);
+}
+
+static void test_version(void) {
+    int width = 64, height = 64;
+    size_t pixels = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    unsigned char *decoded = (unsigned char*)xmalloc(pixels);
+    unsigned char *stream;
+    make_image(image, width, height);
+    size_t size = round_trip(image, width, height, 0, COMPRESSION_DEFAULT_QUANTIZATION, decoded, &stream);
+    compression_info info;
+    int ok = size != 0 && simple_decompress_info(stream, size, &info) == 0 &&
+             info.quantization_factor == COMPRESSION_DEFAULT_QUANTIZATION;
+    stream[4] = COMPRESSION_VERSION - 1;
+    float *re = (float*)xmalloc((size_t)(width / 2 + 1) * height * sizeof(float));
+    float *im = (float*)xmalloc((size_t)(width / 2 + 1) * height * sizeof(float));
+    ok = ok && simple_decompress_info(stream, size, &info) != 0 && simple_decompress(stream, size, re, im, NULL) != 0;
+    check("older version refused", width, height, ok, "");
+    free(image);
+    free(decoded);
+    free(stream);
+    free(re);
+    free(im);
+}
+
+// Regions of every alignment, including single pixels, the last partial
+// tiles and the whole image.
+static void test_regions(int width, int height, int tile_size) {
+    size_t pixels = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    unsigned char *whole = (unsigned char*)xmalloc(pixels);
+    unsigned char *region = (unsigned char*)xmalloc(pixels);
+    unsigned char *stream;
+    make_image(image, width, height);
+    size_t size = round_trip(image, width, height, tile_size, COMPRESSION_DEFAULT_QUANTIZATION, whole, &stream);
+    const int boxes[][4] = {
+        { 0, 0, 1, 1 },
+        { width - 1, height - 1, 1, 1 },
+        { tile_size - 1, tile_size - 1, 2, 2 },
+        { 3, 5, tile_size * 3 + 1, tile_size + 7 },
+        { width / 2, height / 3, width - width / 2, height / 2 },
+        { 0, height - tile_size / 2, width, tile_size / 2 },
+        { 0, 0, width, height },
+    };
+    for (size_t b = 0; b < sizeof(boxes) / sizeof(boxes[0]); ++b) {
+        int x = boxes[b][0], y = boxes[b][1], w = boxes[b][2], h = boxes[b][3];
+        int ok = size != 0 && simple_decompress_region(stream, size, x, y, w, h, region, NULL) == 0;
+        for (int r = 0; r < h && ok; ++r) {
+            ok = memcmp(region + (size_t)r * w, whole + (size_t)(y + r) * width + x, (size_t)w) == 0;
+        }
+        char detail[128];
+        snprintf(detail, sizeof(detail), "tile %d, region %dx%d at (%d, %d)", tile_size, w, h, x, y);
+        check("region matches whole", width, height, ok, detail);
+    }
+    // Out of bounds
+    int ok = simple_decompress_region(stream, size, width - 4, 0, 5, 1, region, NULL) != 0 &&
+             simple_decompress_region(stream, size, 0, 0, 0, 1, region, NULL) != 0;
+    check("region out of bounds", width, height, ok, "");
+    free(image);
+    free(whole);
+    free(region);
+    free(stream);
+}
+
+// Collects what simple_compress_stream hands over, and checks the pieces
+// as they come: full chunks except the last, one stream size throughout.
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t chunk_size;
+    size_t stream_size;
+    int pieces;
+    int fail_at;   // Piece number whose sink call fails, 0 for none
+    int bad_piece; // A short piece before the end, or a changing size
+} stream_sink;
+
+static int collect_piece(void *ctx, const unsigned char *data, size_t size, size_t stream_size) {
+    stream_sink *sink = (stream_sink*)ctx;
+    sink->pieces++;
+    if (sink->pieces == 1) sink->stream_size = stream_size;
+    if (stream_size != sink->stream_size || sink->len + size > stream_size ||
+        (size != sink->chunk_size && sink->len + size != stream_size)) {
+        sink->bad_piece = 1;
+        return -1;
+    }
+    memcpy(sink->data + sink->len, data, size);
+    sink->len += size;
+    return sink->pieces == sink->fail_at ? -1 : 0;
+}
+
+static void test_stream(int width, int height) {
+    size_t pixels = (size_t)width * height;
+    size_t bins = (size_t)(width / 2 + 1) * height;
+    size_t bound = simple_compress_bound(width, height);
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    float *plane = (float*)xmalloc(pixels * sizeof(float));
+    float *re = (float*)xmalloc(bins * sizeof(float)), *im = (float*)xmalloc(bins * sizeof(float));
+    void *scratch = xmalloc(scratch_bytes);
+    unsigned char *expected = (unsigned char*)xmalloc(bound);
+    stream_sink sink = { .data = (unsigned char*)xmalloc(bound) };
+    unsigned char *chunk = (unsigned char*)xmalloc(bound);
+    make_image(image, width, height);
+    for (size_t i = 0; i < pixels; ++i) {
+        plane[i] = (float)image[i];
+    }
+    int ok = two_d_fft_r2c(plane, re, im, width, height) == 0;
+    size_t size = simple_compress(re, im, width, height, COMPRESSION_DEFAULT_QUANTIZATION, expected, scratch, NULL);
+    ok = ok && size != 0;
+    check("stream reference", width, height, ok, "simple_compress failed");
+
+    // The smallest chunk, an odd one, and one that holds the whole stream
+    const size_t chunks[] = { COMPRESSION_STREAM_CHUNK_MIN, 1000, bound };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]) && ok; ++c) {
+        sink.len = 0;
+        sink.pieces = sink.fail_at = sink.bad_piece = 0;
+        sink.chunk_size = chunks[c];
+        size_t streamed = simple_compress_stream(re, im, width, height, COMPRESSION_DEFAULT_QUANTIZATION, chunk,
+                                                 chunks[c], scratch, collect_piece, &sink, NULL);
+        char detail[128];
+        snprintf(detail, sizeof(detail), "chunk %zu: %zu bytes in %d pieces, %zu expected", chunks[c], streamed,
+                 sink.pieces, size);
+        check("stream matches", width, height,
+              streamed == size && sink.len == size && !sink.bad_piece && memcmp(sink.data, expected, size) == 0,
+              detail);
+    }
+
+    // A failing sink fails the call and is not called again.
+    sink.len = 0;
+    sink.pieces = sink.bad_piece = 0;
+    sink.fail_at = 2;
+    sink.chunk_size = COMPRESSION_STREAM_CHUNK_MIN;
+    size_t streamed = simple_compress_stream(re, im, width, height, COMPRESSION_DEFAULT_QUANTIZATION, chunk,
+                                             COMPRESSION_STREAM_CHUNK_MIN, scratch, collect_piece, &sink, NULL);
+    char detail[128];
+    snprintf(detail, sizeof(detail), "returned %zu after %d pieces", streamed, sink.pieces);
+    check("stream sink failure", width, height, !ok || (streamed == 0 && sink.pieces == 2), detail);
+    // So is a chunk below the minimum.
+    streamed = simple_compress_stream(re, im, width, height, COMPRESSION_DEFAULT_QUANTIZATION, chunk,
+                                      COMPRESSION_STREAM_CHUNK_MIN - 1, scratch, collect_piece, &sink, NULL);
+    check("stream chunk too small", width, height, streamed == 0, "");
+
+    free(image);
+    free(plane);
+    free(re);
+    free(im);
+    free(scratch);
+    free(expected);
+    free(sink.data);
+    free(chunk);
+}
+
+// The gray test image in green, a ramp in red and its mirror in blue, so
+// that every channel and both chroma planes carry detail.
+static void make_rgb(unsigned char *rgb, int width, int height) {
+    unsigned char *gray = (unsigned char*)xmalloc((size_t)width * height);
+    make_image(gray, width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t)y * width + x;
+            rgb[3 * i] = (unsigned char)(40 + 160 * x / width);
+            rgb[3 * i + 1] = gray[i];
+            rgb[3 * i + 2] = (unsigned char)(200 - 160 * x / width + 30 * y / height);
+        }
+    }
+    free(gray);
+}
+
+// Compresses rgb as the server does (YCbCr planes, batched FFTs, one color
+// stream), decodes it back and returns the stream size, 0 on failure.
+static size_t color_round_trip(const unsigned char *rgb, int width, int height, int color, unsigned char *decoded) {
+    fft_plane planes[COMPRESSION_MAX_PLANES];
+    float *fft_real[COMPRESSION_MAX_PLANES], *fft_imag[COMPRESSION_MAX_PLANES];
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        compression_plane_size(color, p, width, height, &planes[p].width, &planes[p].height);
+        size_t spectrum = (size_t)(planes[p].width / 2 + 1) * planes[p].height;
+        planes[p].pixels = (float*)xmalloc((size_t)planes[p].width * planes[p].height * sizeof(float));
+        planes[p].real = fft_real[p] = (float*)xmalloc(spectrum * sizeof(float));
+        planes[p].imag = fft_imag[p] = (float*)xmalloc(spectrum * sizeof(float));
+    }
+    void *scratch = xmalloc(simple_compress_scratch_size(width, height));
+    unsigned char *stream = (unsigned char*)xmalloc(simple_compress_color_bound(width, height, color));
+
+    image_rgb_to_ycbcr(rgb, width, height, color, planes[0].pixels, planes[1].pixels, planes[2].pixels);
+    int failed = two_d_fft_r2c_planes(planes, COMPRESSION_MAX_PLANES) != 0;
+    size_t size = simple_compress_color((const float *const *)fft_real, (const float *const *)fft_imag, width,
+                                        height, color, COMPRESSION_DEFAULT_QUANTIZATION, stream, scratch, NULL);
+    compression_info info;
+    failed |= size == 0 || simple_decompress_info(stream, size, &info) != 0 || info.color != color ||
+              simple_decompress_color(stream, size, fft_real, fft_imag, NULL) != 0;
+    failed |= two_d_ifft_c2r_planes(planes, COMPRESSION_MAX_PLANES) != 0;
+    image_ycbcr_to_rgb(planes[0].pixels, planes[1].pixels, planes[2].pixels, width, height, color, decoded);
+
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        free(planes[p].pixels);
+        free(fft_real[p]);
+        free(fft_imag[p]);
+    }
+    free(scratch);
+    free(stream);
+    return failed ? 0 : size;
+}
+
+static void test_color(int width, int height) {
+    size_t bytes = (size_t)width * height * IMAGE_CHANNELS_RGB;
+    unsigned char *rgb = (unsigned char*)xmalloc(bytes);
+    unsigned char *decoded = (unsigned char*)xmalloc(bytes);
+    make_rgb(rgb, width, height);
+    size_t sizes[2];
+    static const int colors[2] = { IMAGE_COLOR_YCBCR444, IMAGE_COLOR_YCBCR420 };
+    for (int c = 0; c < 2; ++c) {
+        sizes[c] = color_round_trip(rgb, width, height, colors[c], decoded);
+        double quality = sizes[c] ? psnr(rgb, decoded, bytes) : 0.0;
+        char detail[128];
+        snprintf(detail, sizeof(detail), "%s: PSNR %.2f dB, %zu bytes",
+                 colors[c] == IMAGE_COLOR_YCBCR444 ? "4:4:4" : "4:2:0", quality, sizes[c]);
+        check("color round trip", width, height, sizes[c] != 0 && quality >= MIN_COLOR_PSNR, detail);
+    }
+    char detail[128];
+    snprintf(detail, sizeof(detail), "4:4:4 %zu bytes, 4:2:0 %zu bytes", sizes[0], sizes[1]);
+    check("4:2:0 smaller", width, height, sizes[1] != 0 && sizes[1] < sizes[0], detail);
+    free(rgb);
+    free(decoded);
+}
+
+// Four frames, a few pixels apart, at factors A, A, B, B: key, delta,
+// key, delta.
+static void test_frame_factor(int width, int height) {
+    static const float factors[] = { 25.0f, 25.0f, 50.0f, 50.0f };
+    size_t pixels = (size_t)width * height, bins = (size_t)(width / 2 + 1) * height;
+    size_t bound = simple_compress_bound(width, height), scratch_bytes = simple_compress_scratch_size(width, height);
+    unsigned char *image = (unsigned char*)xmalloc(pixels);
+    float *plane = (float*)xmalloc(pixels * sizeof(float));
+    float *re = (float*)xmalloc(bins * sizeof(float)), *im = (float*)xmalloc(bins * sizeof(float));
+    float *frame_re = (float*)xmalloc(bins * sizeof(float)), *frame_im = (float*)xmalloc(bins * sizeof(float));
+    int32_t *encoder = (int32_t*)xmalloc(simple_compress_reference_size(width, height));
+    int32_t *decoder = (int32_t*)xmalloc(simple_compress_reference_size(width, height));
+    void *scratch = xmalloc(scratch_bytes);
+    unsigned char *streams[4], *single = (unsigned char*)xmalloc(bound);
+    size_t sizes[4];
+    char detail[160];
+    make_image(image, width, height);
+
+    for (int f = 0; f < 4; ++f) {
+        image[(size_t)f * 97 % pixels] ^= 0x40;
+        for (size_t i = 0; i < pixels; ++i) {
+            plane[i] = (float)image[i];
+        }
+        int key = f == 0;
+        streams[f] = (unsigned char*)xmalloc(bound);
+        int ok = two_d_fft_r2c(plane, re, im, width, height) == 0;
+        sizes[f] = simple_compress_frame(re, im, width, height, factors[f], encoder, &key, streams[f], scratch, NULL);
+        ok = ok && sizes[f] != 0 &&
+             simple_decompress_frame(streams[f], sizes[f], width, height, decoder, frame_re, frame_im, NULL) == 0;
+        // The same frame on its own, at the same factor
+        size_t size = simple_compress(re, im, width, height, factors[f], single, scratch, NULL);
+        ok = ok && size != 0 && simple_decompress(single, size, re, im, NULL) == 0;
+        int same = ok && memcmp(re, frame_re, bins * sizeof(float)) == 0 &&
+                   memcmp(im, frame_im, bins * sizeof(float)) == 0;
+        int expected_key = f == 0 || factors[f] != factors[f - 1];
+        snprintf(detail, sizeof(detail), "frame %d at factor %.0f: %s frame, %s", f, factors[f], key ? "key" : "delta",
+                 same ? "same spectrum" : "different spectrum");
+        check("frame factor", width, height, same && key == expected_key, detail);
+    }
+
+    // A decoder holding the first key frame (factor A) gets the last delta
+    // (factor B).
+    int refused = simple_decompress_frame(streams[0], sizes[0], width, height, decoder, frame_re, frame_im,
+                                          NULL) == 0 &&
+                  simple_decompress_frame(streams[3], sizes[3], width, height, decoder, frame_re, frame_im,
+                                          NULL) != 0;
+    check("delta of another factor", width, height, refused, "decoded against a key frame of another factor");
+
+    for (int f = 0; f < 4; ++f) {
+        free(streams[f]);
+    }
+    free(single);
+    free(image);
+    free(plane);
+    free(re);
+    free(im);
+    free(frame_re);
+    free(frame_im);
+    free(encoder);
+    free(decoder);
+    free(scratch);
+}
+
+int main(void) {
+    double small = test_mode("full", 256, 256, 0);
+    double large = test_mode("full", 1024, 1024, 0);
+    char detail[128];
+    snprintf(detail, sizeof(detail), "PSNR %.2f dB at 256x256, %.2f dB at 1024x1024", small, large);
+    check("full, size independent", 1024, 1024, fabs(small - large) <= MAX_PSNR_SPREAD, detail);
+    test_mode("full", 333, 199, 0);
+    test_mode("full", 640, 480, 0);
+
+    static const int tiles[] = { 8, 16, 32 };
+    for (size_t t = 0; t < sizeof(tiles) / sizeof(tiles[0]); ++t) {
+        char name[32];
+        snprintf(name, sizeof(name), "tile%d", tiles[t]);
+        small = test_mode(name, 256, 256, tiles[t]);
+        large = test_mode(name, 1024, 1024, tiles[t]);
+        snprintf(detail, sizeof(detail), "PSNR %.2f dB at 256x256, %.2f dB at 1024x1024", small, large);
+        check("tiles, size independent", 1024, 1024, fabs(small - large) <= MAX_PSNR_SPREAD, detail);
+        test_mode(name, 333, 199, tiles[t]);
+    }
+    // Full mode and tiles at the same factor land close together.
+    double full = test_mode("full", 512, 512, 0), tiled = test_mode("tile8", 512, 512, 8);
+    snprintf(detail, sizeof(detail), "full %.2f dB, tile8 %.2f dB", full, tiled);
+    check("full and tiles agree", 512, 512, fabs(full - tiled) <= MAX_PSNR_SPREAD, detail);
+
+    test_monotonic(256, 256, 0);
+    test_monotonic(256, 256, 8);
+    test_version();
+    for (size_t t = 0; t < sizeof(tiles) / sizeof(tiles[0]); ++t) {
+        test_regions(333, 199, tiles[t]);
+    }
+    test_stream(256, 256);
+    test_stream(333, 199);
+    test_color(256, 192);
+    test_color(333, 199);
+    test_frame_factor(256, 256);
+    test_frame_factor(333, 199);
+
+    printf("test_compression: %d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,661 @@
+// FFT correctness tests.
+//
+// The server's float transforms are checked against version-2's fft_1d,
+// which is itself checked against a direct O(N^2) DFT in long double, so a
+// bug shared by both engines still shows up. Sizes cover every plan kind:
+// powers of two (radix-2), 2^a 3^b 5^c 7^d (mixed radix) and others
+// (Bluestein). Errors are relative to the largest output magnitude.
+//
+// The 2D transforms are checked against a direct separable DFT, on one
+// thread and on several, and must report success; so are the unrolled
+// tile kernels. Pruned transforms must match it on every bin the mask
+// keeps and give exactly 0 everywhere else. Frame sessions must match
+// two_d_fft_r2c of every frame of a sequence, through unchanged frames,
+// the direct update of a few rows, the column pass over many and the
+// periodic refresh, and report how many rows changed.
+//
+// version-2's precision-specialized FFTs (fft_typed) are checked against
+// the direct DFT for every supported element type, 1D and 2D, forward and
+// inverse: the SNR of the output must reach a floor set per type.
+//
+// Prints one line per failure and a summary; exits 1 if anything failed.
+//
+// Usage: test_fft
+// Build: make -C bench test   (CROSS=riscv64-unknown-linux- for RVV)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft.h"
+#include "fft_1d.h"
+#include "fft_typed.h"
+
+#define FLOAT_TOLERANCE 2e-6  // Per log2(N); float engines against fft_1d
+#define DOUBLE_TOLERANCE 1e-12 // fft_1d against the direct DFT
+
+static int checks;
+static int failures;
+
+static void check(const char *test, int n, double error, double tolerance) {
+    checks++;
+    if (!(error <= tolerance)) {
+        failures++;
+        printf("FAIL %-24s N=%-5d error %.3g > %.3g\n", test, n, error, tolerance);
+    }
+}
+
+static void check_2d(const char *test, int width, int height, int threads, int status, double error,
+                     double tolerance) {
+    checks++;
+    if (status != 0 || !(error <= tolerance)) {
+        failures++;
+        printf("FAIL %-24s %dx%d threads=%d status %d error %.3g > %.3g\n", test, width, height, threads, status,
+               error, tolerance);
+    }
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        perror("malloc");
+        exit(1);
+    }
+    return p;
+}
+
+static double float_tolerance(int n) {
+    return FLOAT_TOLERANCE * (log2((double)n) + 1.0);
+}
+
+// Pseudo-random values in [-1, 1), the same for every run.
+static void fill_signal(cplx_double *x, int n, unsigned int seed) {
+    for (int i = 0; i < n; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double re = (double)((seed >> 8) & 0xFFFF) / 32768.0 - 1.0;
+        seed = seed * 1103515245u + 12345u;
+        double im = (double)((seed >> 8) & 0xFFFF) / 32768.0 - 1.0;
+        x[i] = re + im * I;
+    }
+}
+
+// Direct DFT, normalized by 1/N when inverse, like fft_1d.
+static void direct_dft(const cplx_double *x, cplx_double *y, int n, int inverse) {
+    long double sign = inverse ? 1.0L : -1.0L;
+    for (int k = 0; k < n; ++k) {
+        long double re = 0.0L, im = 0.0L;
+        for (int j = 0; j < n; ++j) {
+            // k * j mod n keeps the angle small and exact
+            long double angle = sign * 2.0L * 3.14159265358979323846264338327950288L *
+                                (long double)(((long)k * j) % n) / n;
+            long double c = cosl(angle), s = sinl(angle);
+            long double xr = creal(x[j]), xi = cimag(x[j]);
+            re += xr * c - xi * s;
+            im += xr * s + xi * c;
+        }
+        if (inverse) {
+            re /= n;
+            im /= n;
+        }
+        y[k] = (double)re + (double)im * I;
+    }
+}
+
+static double max_error(const cplx_double *expected, const float *re, const float *im, const cplx_double *actual,
+                        int n) {
+    double peak = 0.0, error = 0.0;
+    for (int k = 0; k < n; ++k) {
+        double magnitude = cabs(expected[k]);
+        if (magnitude > peak) peak = magnitude;
+        cplx_double got = actual ? actual[k] : (double)re[k] + (double)im[k] * I;
+        double e = cabs(got - expected[k]);
+        if (e > error) error = e;
+    }
+    return peak > 0.0 ? error / peak : error;
+}
+
+// fft_1d, with each power-of-two engine, against the direct DFT.
+static void test_reference(int n) {
+    cplx_double *x = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    cplx_double *expected = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    cplx_double *y = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    static const int algorithms[] = { FFT_1D_ALGORITHM_COOLEY_TUKEY, FFT_1D_ALGORITHM_STOCKHAM };
+    int engines = (n & (n - 1)) == 0 ? 2 : 1;
+    fill_signal(x, n, (unsigned int)n * 7u + 1u);
+    for (int inverse = 0; inverse <= 1; ++inverse) {
+        direct_dft(x, expected, n, inverse);
+        for (int a = 0; a < engines; ++a) {
+            fft_1d_set_algorithm(algorithms[a]);
+            for (int i = 0; i < n; ++i) y[i] = x[i];
+            fft_1d(n, y, inverse);
+            check(inverse ? "fft_1d inverse" : "fft_1d forward", n, max_error(expected, NULL, NULL, y, n),
+                  DOUBLE_TOLERANCE * n);
+        }
+    }
+    fft_1d_set_algorithm(FFT_1D_ALGORITHM_AUTO);
+    free(x);
+    free(expected);
+    free(y);
+}
+
+// _1d_fft_rvv and inverse plans, in and out of place, against fft_1d.
+static void test_plans(int n) {
+    cplx_double *x = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    cplx_double *expected = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    float *in_re = (float*)xmalloc(n * sizeof(float)), *in_im = (float*)xmalloc(n * sizeof(float));
+    float *out_re = (float*)xmalloc(n * sizeof(float)), *out_im = (float*)xmalloc(n * sizeof(float));
+    fill_signal(x, n, (unsigned int)n * 13u + 5u);
+    // The float input, widened back, is what the reference transforms.
+    for (int i = 0; i < n; ++i) {
+        in_re[i] = (float)creal(x[i]);
+        in_im[i] = (float)cimag(x[i]);
+        x[i] = (double)in_re[i] + (double)in_im[i] * I;
+    }
+
+    for (int inverse = 0; inverse <= 1; ++inverse) {
+        for (int i = 0; i < n; ++i) expected[i] = x[i];
+        fft_1d(n, expected, inverse);
+        if (!inverse) {
+            _1d_fft_rvv(in_re, in_im, out_re, out_im, n);
+            check("_1d_fft_rvv", n, max_error(expected, out_re, out_im, NULL, n), float_tolerance(n));
+        }
+        const fft_plan *plan = fft_plan_get(n, inverse ? FFT_INVERSE : FFT_FORWARD);
+        if (!plan) {
+            check("fft_plan_get", n, INFINITY, 0.0);
+            continue;
+        }
+        fft_plan_execute(plan, in_re, in_im, out_re, out_im);
+        check(inverse ? "plan inverse" : "plan forward", n, max_error(expected, out_re, out_im, NULL, n),
+              float_tolerance(n));
+        for (int i = 0; i < n; ++i) {
+            out_re[i] = in_re[i];
+            out_im[i] = in_im[i];
+        }
+        fft_plan_execute(plan, out_re, out_im, out_re, out_im);
+        check(inverse ? "plan inverse in place" : "plan forward in place", n,
+              max_error(expected, out_re, out_im, NULL, n), float_tolerance(n));
+    }
+    free(x);
+    free(expected);
+    free(in_re);
+    free(in_im);
+    free(out_re);
+    free(out_im);
+}
+
+// Direct 2D DFT of a real width x height image, forward and unnormalized:
+// each row, then each column, in double.
+static void direct_dft_2d(const float *pixels, cplx_double *spectrum, int width, int height) {
+    int n = width > height ? width : height;
+    cplx_double *twiddle = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    cplx_double *column = (cplx_double*)xmalloc(height * sizeof(cplx_double));
+    for (int i = 0; i < width; ++i) {
+        twiddle[i] = cexp(-2.0 * M_PI * I * i / width);
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int k = 0; k < width; ++k) {
+            cplx_double sum = 0.0;
+            for (int x = 0; x < width; ++x) {
+                sum += pixels[(size_t)y * width + x] * twiddle[((long)k * x) % width];
+            }
+            spectrum[(size_t)y * width + k] = sum;
+        }
+    }
+    for (int i = 0; i < height; ++i) {
+        twiddle[i] = cexp(-2.0 * M_PI * I * i / height);
+    }
+    for (int k = 0; k < width; ++k) {
+        for (int ky = 0; ky < height; ++ky) {
+            cplx_double sum = 0.0;
+            for (int y = 0; y < height; ++y) {
+                sum += spectrum[(size_t)y * width + k] * twiddle[((long)ky * y) % height];
+            }
+            column[ky] = sum;
+        }
+        for (int ky = 0; ky < height; ++ky) {
+            spectrum[(size_t)ky * width + k] = column[ky];
+        }
+    }
+    free(twiddle);
+    free(column);
+}
+
+// Error of a height x out_width spectrum against the first out_width
+// columns of the full one, relative to its peak.
+static double spectrum_error(const cplx_double *expected, const float *re, const float *im, int width, int height,
+                             int out_width) {
+    double peak = 0.0, error = 0.0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < out_width; ++x) {
+            cplx_double e = expected[(size_t)y * width + x];
+            size_t i = (size_t)y * out_width + x;
+            double d = cabs((double)re[i] + (double)im[i] * I - e);
+            if (cabs(e) > peak) peak = cabs(e);
+            if (d > error) error = d;
+        }
+    }
+    return peak > 0.0 ? error / peak : error;
+}
+
+static double pixel_error(const float *expected, const float *actual, size_t n) {
+    double error = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double d = fabs((double)actual[i] - expected[i]);
+        if (d > error) error = d;
+    }
+    return error / 255.0;
+}
+
+// Error of a pruned half spectrum (width/2 + 1 wide) against the full one
+// on the bins the mask keeps, relative to its peak; INFINITY if a dropped
+// bin is not exactly 0.
+static double masked_error(const cplx_double *expected, const float *re, const float *im, int width, int height,
+                           const int *mask) {
+    int sw = width / 2 + 1;
+    double peak = 0.0, error = 0.0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < sw; ++x) {
+            size_t i = (size_t)y * sw + x;
+            if (x >= mask[y]) {
+                if (re[i] != 0.0f || im[i] != 0.0f) return INFINITY;
+                continue;
+            }
+            cplx_double e = expected[(size_t)y * width + x];
+            double d = cabs((double)re[i] + (double)im[i] * I - e);
+            if (cabs(e) > peak) peak = cabs(e);
+            if (d > error) error = d;
+        }
+    }
+    return peak > 0.0 ? error / peak : error;
+}
+
+// two_d_fft_r2c_pruned and its rows/columns split, for both mask shapes
+// at several cutoffs, and with no mask. The outputs start out as NaN so
+// that a bin left unwritten shows up.
+static void test_pruned(const float *image, const cplx_double *expected, int width, int height, int threads,
+                        double tolerance) {
+    static const float cutoffs[] = { 0.1f, 0.5f, 1.0f };
+    size_t half = (size_t)(width / 2 + 1) * height;
+    float *re = (float*)xmalloc(half * sizeof(float)), *im = (float*)xmalloc(half * sizeof(float));
+    int *mask = (int*)xmalloc(height * sizeof(int));
+    for (int shape = FFT_MASK_RECTANGLE; shape <= FFT_MASK_ELLIPSE; ++shape) {
+        for (size_t c = 0; c < sizeof(cutoffs) / sizeof(cutoffs[0]); ++c) {
+            int status = fft_mask_lowpass(mask, width, height, shape, cutoffs[c]);
+            for (size_t i = 0; i < half; ++i) re[i] = im[i] = NAN;
+            status |= two_d_fft_r2c_pruned(image, re, im, width, height, mask);
+            check_2d(shape == FFT_MASK_RECTANGLE ? "pruned rectangle" : "pruned ellipse", width, height, threads,
+                     status, masked_error(expected, re, im, width, height, mask), tolerance);
+
+            for (size_t i = 0; i < half; ++i) re[i] = im[i] = NAN;
+            status = two_d_fft_r2c_rows_pruned(image, re, im, width, height, height / 2, height, mask);
+            status |= two_d_fft_r2c_rows_pruned(image, re, im, width, height, 0, height / 2, mask);
+            status |= two_d_fft_r2c_columns_pruned(re, im, width, height, mask);
+            check_2d("pruned rows/columns", width, height, threads, status,
+                     masked_error(expected, re, im, width, height, mask), tolerance);
+        }
+    }
+    for (int y = 0; y < height; ++y) mask[y] = width / 2 + 1;
+    int status = two_d_fft_r2c_pruned(image, re, im, width, height, NULL);
+    check_2d("pruned, no mask", width, height, threads, status,
+             masked_error(expected, re, im, width, height, mask), tolerance);
+    free(re);
+    free(im);
+    free(mask);
+}
+
+// Complex and real-input 2D transforms, the split row/column form, the
+// inverse, and two planes of different sizes in one batched call.
+static void test_2d(int width, int height, int threads) {
+    size_t pixels = (size_t)width * height;
+    int sw = width / 2 + 1;
+    size_t half = (size_t)sw * height;
+    float *image = (float*)xmalloc(pixels * sizeof(float));
+    float *re = (float*)xmalloc(pixels * sizeof(float)), *im = (float*)xmalloc(pixels * sizeof(float));
+    float *back = (float*)xmalloc(pixels * sizeof(float));
+    cplx_double *expected = (cplx_double*)xmalloc(pixels * sizeof(cplx_double));
+    unsigned int seed = (unsigned int)(width * 131 + height);
+    for (size_t i = 0; i < pixels; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        image[i] = (float)((seed >> 16) & 0xFF);
+    }
+    direct_dft_2d(image, expected, width, height);
+    double tolerance = float_tolerance(width > height ? width : height) * 2.0;
+    fft_set_threads(threads);
+
+    int status = two_d_fft(image, re, im, width, height);
+    check_2d("two_d_fft", width, height, threads, status, spectrum_error(expected, re, im, width, height, width),
+             tolerance);
+
+    status = two_d_fft_r2c(image, re, im, width, height);
+    check_2d("two_d_fft_r2c", width, height, threads, status, spectrum_error(expected, re, im, width, height, sw),
+             tolerance);
+
+    test_pruned(image, expected, width, height, threads, tolerance);
+
+    status = two_d_ifft_c2r(re, im, back, width, height);
+    check_2d("two_d_ifft_c2r", width, height, threads, status, pixel_error(image, back, pixels), tolerance);
+
+    for (size_t i = 0; i < half; ++i) re[i] = im[i] = NAN;
+    status = two_d_fft_r2c_rows(image, re, im, width, height, height / 2, height);
+    status |= two_d_fft_r2c_rows(image, re, im, width, height, 0, height / 2);
+    status |= two_d_fft_r2c_columns(re, im, width, height);
+    check_2d("two_d_fft_r2c_rows", width, height, threads, status,
+             spectrum_error(expected, re, im, width, height, sw), tolerance);
+
+    // The second plane is the top-left quarter of the image.
+    int qw = (width + 1) / 2, qh = (height + 1) / 2;
+    float *quarter = (float*)xmalloc((size_t)qw * qh * sizeof(float));
+    float *quarter_back = (float*)xmalloc((size_t)qw * qh * sizeof(float));
+    float *quarter_re = (float*)xmalloc((size_t)(qw / 2 + 1) * qh * sizeof(float));
+    float *quarter_im = (float*)xmalloc((size_t)(qw / 2 + 1) * qh * sizeof(float));
+    cplx_double *quarter_expected = (cplx_double*)xmalloc((size_t)qw * qh * sizeof(cplx_double));
+    for (int y = 0; y < qh; ++y) {
+        for (int x = 0; x < qw; ++x) {
+            quarter[(size_t)y * qw + x] = image[(size_t)y * width + x];
+        }
+    }
+    direct_dft_2d(quarter, quarter_expected, qw, qh);
+    fft_plane planes[2] = {
+        { width, height, image, re, im },
+        { qw, qh, quarter, quarter_re, quarter_im },
+    };
+    status = two_d_fft_r2c_planes(planes, 2);
+    double error = spectrum_error(expected, re, im, width, height, sw);
+    double quarter_error = spectrum_error(quarter_expected, quarter_re, quarter_im, qw, qh, qw / 2 + 1);
+    check_2d("two_d_fft_r2c_planes", width, height, threads, status,
+             error > quarter_error ? error : quarter_error, tolerance);
+    planes[0].pixels = back;
+    planes[1].pixels = quarter_back;
+    status = two_d_ifft_c2r_planes(planes, 2);
+    error = pixel_error(image, back, pixels);
+    quarter_error = pixel_error(quarter, quarter_back, (size_t)qw * qh);
+    check_2d("two_d_ifft_c2r_planes", width, height, threads, status,
+             error > quarter_error ? error : quarter_error, tolerance);
+
+    free(image);
+    free(re);
+    free(im);
+    free(back);
+    free(expected);
+    free(quarter);
+    free(quarter_back);
+    free(quarter_re);
+    free(quarter_im);
+    free(quarter_expected);
+}
+
+// fft_tile_2d, forward and inverse, on a complex tile against the direct
+// DFT (the inverse is normalized by 1/size^2).
+static void test_tile(int size) {
+    size_t n = (size_t)size * size;
+    float re[FFT_TILE_MAX * FFT_TILE_MAX], im[FFT_TILE_MAX * FFT_TILE_MAX];
+    float real_part[FFT_TILE_MAX * FFT_TILE_MAX] = { 0 }, imag_part[FFT_TILE_MAX * FFT_TILE_MAX] = { 0 };
+    cplx_double *spectrum = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    cplx_double *part = (cplx_double*)xmalloc(n * sizeof(cplx_double));
+    unsigned int seed = (unsigned int)size * 977u;
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        real_part[i] = re[i] = (float)((seed >> 16) & 0xFF);
+        seed = seed * 1103515245u + 12345u;
+        imag_part[i] = im[i] = (float)((seed >> 16) & 0xFF);
+    }
+    // The DFT is linear: transform the real and imaginary parts apart.
+    direct_dft_2d(real_part, spectrum, size, size);
+    direct_dft_2d(imag_part, part, size, size);
+    for (size_t i = 0; i < n; ++i) {
+        spectrum[i] += I * part[i];
+    }
+    int status = fft_tile_2d(re, im, size, FFT_FORWARD);
+    check_2d("fft_tile_2d forward", size, size, 1, status, spectrum_error(spectrum, re, im, size, size, size),
+             float_tolerance(size) * 2.0);
+    status = fft_tile_2d(re, im, size, FFT_INVERSE);
+    double error = pixel_error(real_part, re, n);
+    double imag_error = pixel_error(imag_part, im, n);
+    check_2d("fft_tile_2d inverse", size, size, 1, status, error > imag_error ? error : imag_error,
+             float_tolerance(size) * 2.0);
+    check_2d("fft_tile_2d bad size", 12, 12, 1, fft_tile_2d(re, im, 12, FFT_FORWARD) == -1 ? 0 : -1, 0.0, 0.0);
+    free(spectrum);
+    free(part);
+}
+
+// Error of the session's spectrum against two_d_fft_r2c of the frame,
+// relative to its peak.
+static double session_error(const unsigned char *frame, const float *re, const float *im, float *image,
+                            float *expected_re, float *expected_im, int width, int height) {
+    size_t pixels = (size_t)width * height, half = (size_t)(width / 2 + 1) * height;
+    for (size_t i = 0; i < pixels; ++i) image[i] = frame[i];
+    if (two_d_fft_r2c(image, expected_re, expected_im, width, height) != 0) return INFINITY;
+    double peak = 0.0, error = 0.0;
+    for (size_t i = 0; i < half; ++i) {
+        double magnitude = hypot(expected_re[i], expected_im[i]);
+        double d = hypot((double)re[i] - expected_re[i], (double)im[i] - expected_im[i]);
+        if (magnitude > peak) peak = magnitude;
+        if (!(d <= error)) error = d; // NaN sticks
+    }
+    return peak > 0.0 ? error / peak : error;
+}
+
+// Changes count rows of frame starting at first, wrapping around; every
+// byte of those rows differs afterwards.
+static void change_rows(unsigned char *frame, int width, int height, int first, int count, int step) {
+    for (int r = 0; r < count; ++r) {
+        unsigned char *row = frame + (size_t)((first + r) % height) * width;
+        for (int x = 0; x < width; ++x) row[x] = (unsigned char)(row[x] + 1 + (x + step) % 200);
+    }
+}
+
+static void test_session(int width, int height, int threads) {
+    size_t pixels = (size_t)width * height, half = (size_t)(width / 2 + 1) * height;
+    unsigned char *frame = (unsigned char*)xmalloc(pixels);
+    float *image = (float*)xmalloc(pixels * sizeof(float));
+    float *expected_re = (float*)xmalloc(half * sizeof(float)), *expected_im = (float*)xmalloc(half * sizeof(float));
+    unsigned int seed = (unsigned int)(width * 31 + height);
+    for (size_t i = 0; i < pixels; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        frame[i] = (unsigned char)(seed >> 16);
+    }
+    double tolerance = float_tolerance(width > height ? width : height) * 2.0;
+    fft_set_threads(threads);
+    fft_session *session = fft_session_create(width, height);
+    if (!session) {
+        check_2d("fft_session_create", width, height, threads, -1, 0.0, 0.0);
+        free(frame);
+        free(image);
+        free(expected_re);
+        free(expected_im);
+        return;
+    }
+
+    // Each step: the rows to change, and how many the session must report.
+    const float *re, *im;
+    static const char *const names[] = { "fft_session first", "fft_session same", "fft_session one pixel",
+                                         "fft_session few rows", "fft_session many rows" };
+    // height / 2 + 1 is past the direct-update limit, log2(height), for every size tested.
+    int counts[] = { height, 0, 1, 3 < height ? 3 : height, height / 2 + 1 };
+    for (int step = 0; step < 5; ++step) {
+        if (step == 2) {
+            frame[pixels / 2] ^= 1;
+        } else if (step >= 3) {
+            change_rows(frame, width, height, step * 7, counts[step], step);
+        }
+        int changed = fft_session_frame(session, frame, &re, &im);
+        double error = changed >= 0 ? session_error(frame, re, im, image, expected_re, expected_im, width, height)
+                                    : INFINITY;
+        check_2d(names[step], width, height, threads, changed == counts[step] ? 0 : -1, error, tolerance);
+    }
+
+    // One changed row per frame, past FFT_SESSION_REFRESH frames.
+    int status = 0;
+    double worst = 0.0;
+    for (int step = 0; step < 80; ++step) {
+        change_rows(frame, width, height, step * 5, 1, step);
+        int changed = fft_session_frame(session, frame, &re, &im);
+        double error = changed >= 0 ? session_error(frame, re, im, image, expected_re, expected_im, width, height)
+                                    : INFINITY;
+        if (changed != 1) status = -1;
+        if (!(error <= worst)) worst = error;
+    }
+    check_2d("fft_session sequence", width, height, threads, status, worst, tolerance);
+
+    fft_session_destroy(session);
+    free(frame);
+    free(image);
+    free(expected_re);
+    free(expected_im);
+}
+
+// Lowest SNR, in dB, each fft_typed element type must reach at every size
+// tested, a few dB under the worst case measured (N = 1024): 308, 139, 61
+// and 52. Q15 loses about 3 dB per stage to the halving, from 80 at N = 2.
+static const double typed_snr_floor[FFT_TYPE_COUNT] = { 295.0, 130.0, 55.0, 46.0 };
+static const char *typed_names[FFT_TYPE_COUNT] = { "f64", "f32", "f16", "q15" };
+
+static void to_typed(int type, const cplx_double *x, void *re, void *im, int count) {
+    for (int i = 0; i < count; ++i) {
+        switch (type) {
+        case FFT_TYPE_F64:
+            ((double*)re)[i] = creal(x[i]);
+            ((double*)im)[i] = cimag(x[i]);
+            break;
+        case FFT_TYPE_F32:
+            ((float*)re)[i] = (float)creal(x[i]);
+            ((float*)im)[i] = (float)cimag(x[i]);
+            break;
+#if FFT_TYPED_HAVE_F16
+        case FFT_TYPE_F16:
+            ((fft_f16*)re)[i] = (fft_f16)creal(x[i]);
+            ((fft_f16*)im)[i] = (fft_f16)cimag(x[i]);
+            break;
+#endif
+        case FFT_TYPE_Q15:
+            ((int16_t*)re)[i] = (int16_t)lrint(creal(x[i]) * 32768.0);
+            ((int16_t*)im)[i] = (int16_t)lrint(cimag(x[i]) * 32768.0);
+            break;
+        }
+    }
+}
+
+static cplx_double from_typed(int type, const void *re, const void *im, int i) {
+    switch (type) {
+    case FFT_TYPE_F64:
+        return ((const double*)re)[i] + ((const double*)im)[i] * I;
+    case FFT_TYPE_F32:
+        return ((const float*)re)[i] + ((const float*)im)[i] * I;
+#if FFT_TYPED_HAVE_F16
+    case FFT_TYPE_F16:
+        return (double)((const fft_f16*)re)[i] + (double)((const fft_f16*)im)[i] * I;
+#endif
+    case FFT_TYPE_Q15:
+        return ((const int16_t*)re)[i] / 32768.0 + ((const int16_t*)im)[i] / 32768.0 * I;
+    }
+    return 0.0;
+}
+
+// Direct rows x cols DFT of complex x: each row, then each column.
+static void direct_dft_rows_cols(const cplx_double *x, cplx_double *y, int rows, int cols, int inverse) {
+    cplx_double *line = (cplx_double*)xmalloc((rows > cols ? rows : cols) * sizeof(cplx_double));
+    cplx_double *out = (cplx_double*)xmalloc((rows > cols ? rows : cols) * sizeof(cplx_double));
+    for (int r = 0; r < rows; ++r) {
+        direct_dft(x + (size_t)r * cols, y + (size_t)r * cols, cols, inverse);
+    }
+    for (int c = 0; rows > 1 && c < cols; ++c) {
+        for (int r = 0; r < rows; ++r) line[r] = y[(size_t)r * cols + c];
+        direct_dft(line, out, rows, inverse);
+        for (int r = 0; r < rows; ++r) y[(size_t)r * cols + c] = out[r];
+    }
+    free(line);
+    free(out);
+}
+
+// fft_typed against the direct DFT; rows == 1 runs the 1D transform of
+// length cols through a plan, anything else fft_typed_2d. Inputs have
+// |re|, |im| < 0.5, which keeps Q15 in range.
+static void test_typed(int rows, int cols) {
+    int count = rows * cols;
+    cplx_double *x = (cplx_double*)xmalloc(count * sizeof(cplx_double));
+    cplx_double *expected = (cplx_double*)xmalloc(count * sizeof(cplx_double));
+    void *re = xmalloc(count * sizeof(double)), *im = xmalloc(count * sizeof(double));
+    char test[48];
+    fill_signal(x, count, (unsigned int)count * 5u + (unsigned int)rows);
+    for (int i = 0; i < count; ++i) x[i] *= 0.5;
+
+    for (int inverse = 0; inverse <= 1; ++inverse) {
+        direct_dft_rows_cols(x, expected, rows, cols, inverse);
+        for (int type = 0; type < FFT_TYPE_COUNT; ++type) {
+            if (!fft_typed_supported(type)) continue;
+            snprintf(test, sizeof(test), "fft_typed %s %s %s", typed_names[type], rows == 1 ? "1D" : "2D",
+                     inverse ? "inverse" : "forward");
+            to_typed(type, x, re, im, count);
+            if (rows == 1) {
+                fft_typed_plan *plan = fft_typed_plan_create(cols, inverse, type);
+                if (!plan) {
+                    check(test, cols, INFINITY, 0.0);
+                    continue;
+                }
+                fft_typed_execute(plan, re, im);
+                fft_typed_plan_destroy(plan);
+            } else {
+                fft_typed_2d(rows, cols, type, re, im, inverse);
+            }
+            // Q15 is scaled by 1/N both ways; the others like fft_1d.
+            double scale = type == FFT_TYPE_Q15 && !inverse ? (double)count : 1.0;
+            long double signal = 0.0L, noise = 0.0L;
+            for (int i = 0; i < count; ++i) {
+                cplx_double d = from_typed(type, re, im, i) * scale - expected[i];
+                signal += (long double)creal(expected[i]) * creal(expected[i]) +
+                          (long double)cimag(expected[i]) * cimag(expected[i]);
+                noise += (long double)creal(d) * creal(d) + (long double)cimag(d) * cimag(d);
+            }
+            double snr = noise > 0.0L ? (double)(10.0L * log10l(signal / noise)) : INFINITY;
+            // check() compares an error with a tolerance: the SNR shortfall
+            check(test, count, typed_snr_floor[type] - snr, 0.0);
+        }
+    }
+    free(x);
+    free(expected);
+    free(re);
+    free(im);
+}
+
+int main(void) {
+    // Radix-2, mixed radix and Bluestein (fft_1d takes those up to
+    // FFT_1D_MAX_N / 2).
+    static const int sizes[] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024,
+        3, 5, 6, 7, 12, 15, 60, 100, 360, 480, 1000,
+        11, 13, 17, 97, 127, 251, 509,
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        test_reference(sizes[i]);
+        test_plans(sizes[i]);
+    }
+
+    // Radix-2, mixed radix, Bluestein and odd widths, below and above the
+    // size at which the worker pool takes over.
+    static const int sizes_2d[][2] = {
+        { 16, 16 }, { 12, 10 }, { 17, 9 }, { 64, 48 }, { 160, 120 }, { 135, 129 }, { 256, 128 },
+    };
+    static const int threads[] = { 1, 4 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        for (size_t i = 0; i < sizeof(sizes_2d) / sizeof(sizes_2d[0]); ++i) {
+            test_2d(sizes_2d[i][0], sizes_2d[i][1], threads[t]);
+            test_session(sizes_2d[i][0], sizes_2d[i][1], threads[t]);
+        }
+    }
+
+    for (int size = 8; size <= FFT_TILE_MAX; size *= 2) {
+        test_tile(size);
+    }
+
+    // fft_typed sizes are powers of two up to FFT_TYPED_MAX_N per axis.
+    static const int sizes_typed[][2] = {
+        { 1, 2 }, { 1, 8 }, { 1, 64 }, { 1, 256 }, { 1, FFT_TYPED_MAX_N },
+        { 2, 4 }, { 16, 16 }, { 8, 64 }, { 64, 8 }, { 32, 32 },
+    };
+    for (size_t i = 0; i < sizeof(sizes_typed) / sizeof(sizes_typed[0]); ++i) {
+        test_typed(sizes_typed[i][0], sizes_typed[i][1]);
+    }
+
+    printf("test_fft: %d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
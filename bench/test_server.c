@@ -0,0 +1,721 @@
+// Behavior tests for the compression server.
+//
+// Starts the server binary on a local port with one compute worker, runs
+// requests against it over real sockets and checks the answers:
+//   round trip     /compress then /decompress of a gray and a color image,
+//                  within a PSNR bound
+//   slow upload    a client that stalls mid-body does not hold up the
+//                  others, and its request still completes
+//   streaming      the row FFTs of a gray upload run while the rest of it
+//                  is still to come, and the answer matches a one-piece
+//                  upload
+//   body budget    bodies past the server's -r budget get 503, and the
+//                  memory comes back when their connections go
+//   stall          a request that stops sending is dropped after -s
+//   pipelining     requests sent back to back on one connection are all
+//                  answered, in order
+//   errors         400/404 answers leave the connection usable
+//   counters       /stats moves by exactly one compress and decompress,
+//                  and /metrics exports the same totals
+//   frames         /frame streams decode through /decompress-frame; a
+//                  delta frame with nothing to apply it to gets 409
+//   frame budget   frame state past the server's -m budget evicts the
+//                  least recently used connection's, which then starts
+//                  over from a key frame; state that cannot fit gets 503
+//
+// Prints one line per failure and a summary; exits 1 if anything failed.
+//
+// Usage: test_server [-p port] [server_binary]
+// Build: make -C bench test   (runs ./image_compress_server)
+
+#define _GNU_SOURCE // memmem, strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "common.h"
+
+#define DEFAULT_PORT 18089
+#define RESPONSE_HEADER_MAX 4096
+#define MIN_PSNR 30.0           // dB, for the smooth test images
+#define SLOW_UPLOAD_STALL_MS 3000 // Longer than any request here takes
+#define FRAME_BUDGET_MB "8"     // Room for two 512x384 frame encoders, about 3.4 MB each
+#define BODY_BUDGET_MB "16"     // One 2048x1536 RGB upload, not two, nor a 2048x2048 gray plane
+#define STALL_SECONDS "1"
+
+static struct sockaddr_in server_addr;
+static int checks;
+static int failures;
+
+static void check(const char *test, int ok, const char *detail) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("FAIL %-24s %s\n", test, detail);
+    }
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        perror("malloc");
+        exit(1);
+    }
+    return p;
+}
+
+// Smooth shading with an edge, so the spectrum is compressible.
+static void make_image(unsigned char *pixels, int width, int height, int channels) {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < channels; ++c) {
+                double u = (double)x / width, v = (double)y / height;
+                double value = 80.0 + 60.0 * u + 40.0 * sin(5.0 * v + 2.0 * u + c) + (x > width / 2 ? 30.0 : 0.0);
+                pixels[((size_t)y * width + x) * channels + c] = (unsigned char)value;
+            }
+        }
+    }
+}
+
+static double psnr(const unsigned char *a, const unsigned char *b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double d = (double)a[i] - b[i];
+        sum += d * d;
+    }
+    return sum == 0.0 ? INFINITY : 10.0 * log10(255.0 * 255.0 / (sum / n));
+}
+
+static int open_connection(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = { 10, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_all(int fd, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// One server response. Bytes past it stay in the connection's buffer for
+// the next read_response (pipelining).
+typedef struct {
+    int status;
+    char headers[RESPONSE_HEADER_MAX + 1];
+    unsigned char *body;
+    size_t body_len;
+} response;
+
+typedef struct {
+    int fd;
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+} client;
+
+static int client_fill(client *c) {
+    if (c->cap - c->len < 65536) {
+        c->cap = c->cap ? c->cap * 2 : 65536;
+        while (c->cap - c->len < 65536) c->cap *= 2;
+        c->buf = (unsigned char*)realloc(c->buf, c->cap);
+        if (!c->buf) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    ssize_t n;
+    do {
+        n = recv(c->fd, c->buf + c->len, c->cap - c->len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    c->len += (size_t)n;
+    return 0;
+}
+
+// Returns 0 with *r filled (free r->body), -1 if the connection failed.
+static int read_response(client *c, response *r) {
+    unsigned char *end = NULL;
+    while (!(end = memmem(c->buf, c->len, "\r\n\r\n", 4))) {
+        if (c->len > RESPONSE_HEADER_MAX || client_fill(c) != 0) return -1;
+    }
+    size_t header_len = (size_t)(end - c->buf) + 4;
+    memcpy(r->headers, c->buf, header_len);
+    r->headers[header_len] = '\0';
+    r->status = atoi(r->headers + 9);
+    const char *length = strcasestr(r->headers, "\r\nContent-Length:");
+    if (!length) return -1;
+    r->body_len = (size_t)atol(length + 17);
+    while (c->len < header_len + r->body_len) {
+        if (client_fill(c) != 0) return -1;
+    }
+    r->body = (unsigned char*)xmalloc(r->body_len + 1);
+    memcpy(r->body, c->buf + header_len, r->body_len);
+    r->body[r->body_len] = '\0'; // Text bodies can be searched as strings
+    memmove(c->buf, c->buf + header_len + r->body_len, c->len - header_len - r->body_len);
+    c->len -= header_len + r->body_len;
+    return 0;
+}
+
+static void client_close(client *c) {
+    if (c->fd != -1) close(c->fd);
+    free(c->buf);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+// Headers and body of one request, ready to send.
+static unsigned char *make_request(const char *method, const char *uri, const char *extra_headers, const void *body,
+                                   size_t body_len, size_t *len) {
+    char header[512];
+    int header_len = snprintf(header, sizeof(header), "%s %s HTTP/1.1\r\nHost: test\r\nContent-Length: %zu\r\n%s\r\n",
+                              method, uri, body_len, extra_headers ? extra_headers : "");
+    unsigned char *request = (unsigned char*)xmalloc(header_len + body_len);
+    memcpy(request, header, header_len);
+    if (body_len) memcpy(request + header_len, body, body_len);
+    *len = header_len + body_len;
+    return request;
+}
+
+// Sends one request on c and reads its response. Returns 0 or -1.
+static int exchange(client *c, const char *method, const char *uri, const char *extra_headers, const void *body,
+                    size_t body_len, response *r) {
+    size_t len;
+    unsigned char *request = make_request(method, uri, extra_headers, body, body_len, &len);
+    int status = send_all(c->fd, request, len) == 0 ? read_response(c, r) : -1;
+    free(request);
+    return status;
+}
+
+static int connect_client(client *c) {
+    memset(c, 0, sizeof(*c));
+    c->fd = open_connection();
+    return c->fd == -1 ? -1 : 0;
+}
+
+static void test_round_trip(int width, int height, int rgb) {
+    const char *name = rgb ? "round trip rgb" : "round trip gray";
+    int channels = rgb ? 3 : 1;
+    size_t bytes = (size_t)width * height * channels;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, channels);
+    char headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n%s", width, height,
+             rgb ? "X-Image-Format: rgb\r\n" : "");
+
+    client c;
+    response compressed = { 0 }, decompressed = { 0 };
+    int ok = connect_client(&c) == 0 &&
+             exchange(&c, "POST", "/compress", headers, image, bytes, &compressed) == 0 && compressed.status == 200 &&
+             exchange(&c, "POST", "/decompress", NULL, compressed.body, compressed.body_len, &decompressed) == 0 &&
+             decompressed.status == 200 && decompressed.body_len == bytes;
+    double quality = ok ? psnr(image, decompressed.body, bytes) : 0.0;
+    snprintf(detail, sizeof(detail), "%dx%d: status %d/%d, %zu bytes, PSNR %.1f dB", width, height,
+             compressed.status, decompressed.status, compressed.body_len, quality);
+    check(name, ok && quality >= MIN_PSNR, detail);
+    free(compressed.body);
+    free(decompressed.body);
+    client_close(&c);
+    free(image);
+}
+
+// With one compute worker, a client that stalls mid-body must not delay a
+// second client, whose request arrives complete.
+static void test_slow_upload(void) {
+    int width = 256, height = 256;
+    size_t bytes = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, 1);
+    char headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+    size_t len;
+    unsigned char *request = make_request("POST", "/compress", headers, image, bytes, &len);
+
+    client slow, fast;
+    response r = { 0 }, slow_r = { 0 };
+    int ok = connect_client(&slow) == 0 && send_all(slow.fd, request, len / 2) == 0;
+    usleep(100000); // Let the server see the first half
+    double start = now_seconds();
+    ok = ok && connect_client(&fast) == 0 && send_all(fast.fd, request, len) == 0 && read_response(&fast, &r) == 0;
+    double elapsed = now_seconds() - start;
+    snprintf(detail, sizeof(detail), "second client answered %d after %.2f s", r.status, elapsed);
+    check("slow upload", ok && r.status == 200 && elapsed * 1000.0 < SLOW_UPLOAD_STALL_MS, detail);
+
+    ok = send_all(slow.fd, request + len / 2, len - len / 2) == 0 && read_response(&slow, &slow_r) == 0;
+    snprintf(detail, sizeof(detail), "stalled client answered %d", slow_r.status);
+    check("slow upload completes", ok && slow_r.status == 200, detail);
+    free(r.body);
+    free(slow_r.body);
+    client_close(&slow);
+    client_close(&fast);
+    free(request);
+    free(image);
+}
+
+static void test_pipelining(void) {
+    int width = 64, height = 48;
+    size_t bytes = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, 1);
+    char headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+    size_t one_len, stats_len;
+    unsigned char *one = make_request("POST", "/compress", headers, image, bytes, &one_len);
+    unsigned char *stats = make_request("GET", "/stats", NULL, NULL, 0, &stats_len);
+    // compress, compress, stats in one send
+    unsigned char *all = (unsigned char*)xmalloc(2 * one_len + stats_len);
+    memcpy(all, one, one_len);
+    memcpy(all + one_len, one, one_len);
+    memcpy(all + 2 * one_len, stats, stats_len);
+
+    client c;
+    response r[3] = { { 0 } };
+    int ok = connect_client(&c) == 0 && send_all(c.fd, all, 2 * one_len + stats_len) == 0;
+    for (int i = 0; i < 3 && ok; ++i) {
+        ok = read_response(&c, &r[i]) == 0;
+    }
+    ok = ok && r[0].status == 200 && r[1].status == 200 && r[2].status == 200 && r[0].body_len == r[1].body_len &&
+         memcmp(r[0].body, r[1].body, r[0].body_len) == 0 && memmem(r[2].body, r[2].body_len, "requests ", 9);
+    snprintf(detail, sizeof(detail), "statuses %d %d %d", r[0].status, r[1].status, r[2].status);
+    check("pipelining", ok, detail);
+    for (int i = 0; i < 3; ++i) free(r[i].body);
+    client_close(&c);
+    free(one);
+    free(stats);
+    free(all);
+    free(image);
+}
+
+// 1 once the server has closed c: no more bytes, and end of file.
+static int closed_by_server(client *c) {
+    unsigned char byte;
+    ssize_t n;
+    do {
+        n = recv(c->fd, &byte, 1, 0);
+    } while (n < 0 && errno == EINTR);
+    return n == 0;
+}
+
+static void test_errors(void) {
+    client c;
+    response r = { 0 };
+    char detail[160];
+    unsigned char junk[100] = { 0 };
+    int ok = connect_client(&c) == 0;
+
+    ok = ok && exchange(&c, "GET", "/nowhere", NULL, NULL, 0, &r) == 0 && r.status == 404;
+    snprintf(detail, sizeof(detail), "status %d", r.status);
+    check("404", ok, detail);
+    free(r.body);
+    r.body = NULL;
+
+    ok = ok && exchange(&c, "POST", "/compress", "X-Image-Width: 10\r\nX-Image-Height: 11\r\n", junk, sizeof(junk),
+                        &r) == 0 && r.status == 400;
+    snprintf(detail, sizeof(detail), "status %d", r.status);
+    check("400 bad dimensions", ok, detail);
+    free(r.body);
+    r.body = NULL;
+
+    ok = ok && exchange(&c, "POST", "/decompress", NULL, junk, sizeof(junk), &r) == 0 && r.status == 400;
+    snprintf(detail, sizeof(detail), "status %d", r.status);
+    check("400 bad stream", ok, detail);
+    free(r.body);
+    r.body = NULL;
+
+    // Still usable after all that
+    ok = ok && exchange(&c, "GET", "/stats", NULL, NULL, 0, &r) == 0 && r.status == 200;
+    snprintf(detail, sizeof(detail), "status %d", r.status);
+    check("keep-alive after errors", ok, detail);
+    free(r.body);
+    client_close(&c);
+
+    // A Content-Length that is not all digits, or too long for the server,
+    // is malformed: 400 and the connection closes.
+    const char *lengths[] = { "12abc", "-5", "+7", "99999999999999999999", "4294967296" };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        char request[160];
+        response bad = { 0 };
+        int len = snprintf(request, sizeof(request), "POST /decompress HTTP/1.1\r\nContent-Length: %s\r\n\r\n",
+                           lengths[i]);
+        ok = connect_client(&c) == 0 && send_all(c.fd, request, (size_t)len) == 0 && read_response(&c, &bad) == 0 &&
+             bad.status == 400 && closed_by_server(&c);
+        snprintf(detail, sizeof(detail), "Content-Length: %s answered %d", lengths[i], bad.status);
+        check("400 bad Content-Length", ok, detail);
+        free(bad.body);
+        client_close(&c);
+    }
+}
+
+// Value of the line "name <value>" in a /stats or /metrics body, -1 if
+// there is no such line.
+static long long counter_value(const response *r, const char *name) {
+    size_t name_len = strlen(name);
+    const char *line = (const char*)r->body;
+    while (line && *line) {
+        if (strncmp(line, name, name_len) == 0 && line[name_len] == ' ') return atoll(line + name_len + 1);
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return -1;
+}
+
+static void test_counters(void) {
+    int width = 80, height = 64;
+    size_t bytes = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, 1);
+    char headers[128], detail[256];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+
+    client c;
+    response before = { 0 }, compressed = { 0 }, decompressed = { 0 }, after = { 0 }, metrics = { 0 };
+    int ok = connect_client(&c) == 0 && exchange(&c, "GET", "/stats", NULL, NULL, 0, &before) == 0 &&
+             exchange(&c, "POST", "/compress", headers, image, bytes, &compressed) == 0 && compressed.status == 200 &&
+             exchange(&c, "POST", "/decompress", NULL, compressed.body, compressed.body_len, &decompressed) == 0 &&
+             exchange(&c, "GET", "/stats", NULL, NULL, 0, &after) == 0 &&
+             exchange(&c, "GET", "/metrics", NULL, NULL, 0, &metrics) == 0 && metrics.status == 200;
+    // Each /stats already counts itself, so requests moves by the compress,
+    // the decompress and the second /stats.
+    static const char *const names[] = { "requests", "compress_input_bytes", "compress_output_bytes",
+                                         "decompress_input_bytes", "decompress_output_bytes" };
+    long long expected[] = { 3, (long long)bytes, (long long)compressed.body_len, (long long)compressed.body_len,
+                             (long long)bytes };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && ok; ++i) {
+        long long delta = counter_value(&after, names[i]) - counter_value(&before, names[i]);
+        snprintf(detail, sizeof(detail), "%s moved by %lld, expected %lld", names[i], delta, expected[i]);
+        check("stats counters", delta == expected[i], detail);
+    }
+    // Nothing else runs meanwhile, so /metrics shows the totals of /stats,
+    // and the workspace series appear exactly once.
+    long long stats_bytes = counter_value(&after, "compress_input_bytes");
+    long long metrics_bytes = ok ? counter_value(&metrics, "image_compress_compress_input_bytes_total") : -1;
+    const char *grows = ok ? strstr((const char*)metrics.body, "\nimage_compress_workspace_grows_total ") : NULL;
+    int once = grows && !strstr(grows + 1, "\nimage_compress_workspace_grows_total ");
+    snprintf(detail, sizeof(detail), "compress_input_bytes %lld in /stats, %lld in /metrics, workspace grows %s",
+             stats_bytes, metrics_bytes, once ? "once" : "missing or repeated");
+    check("metrics counters", ok && metrics_bytes == stats_bytes && once, detail);
+    free(before.body);
+    free(compressed.body);
+    free(decompressed.body);
+    free(after.body);
+    free(metrics.body);
+    client_close(&c);
+    free(image);
+}
+
+// A counter of GET /stats on a new connection, -1 on failure.
+static long long stats_value(const char *name) {
+    client c;
+    response r = { 0 };
+    long long value = -1;
+    if (connect_client(&c) == 0 && exchange(&c, "GET", "/stats", NULL, NULL, 0, &r) == 0 && r.status == 200) {
+        value = counter_value(&r, name);
+    }
+    free(r.body);
+    client_close(&c);
+    return value;
+}
+
+// A gray upload sent in two halves with a pause between: the row jobs
+// must transform the first half during the pause, and the answer must be
+// the bytes a one-piece upload gets.
+static void test_streaming(const char *extra_headers) {
+    int width = 512, height = 256;
+    size_t bytes = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, 1);
+    char headers[160], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n%s", width, height,
+             extra_headers ? extra_headers : "");
+    size_t len;
+    unsigned char *request = make_request("POST", "/compress", headers, image, bytes, &len);
+    size_t first = len - bytes / 2; // Headers and the first height/2 rows
+
+    client whole, halves;
+    response expected = { 0 }, r = { 0 };
+    long long before = stats_value("streamed_rows");
+    int ok = connect_client(&whole) == 0 && exchange(&whole, "POST", "/compress", headers, image, bytes,
+                                                     &expected) == 0 && expected.status == 200 &&
+             connect_client(&halves) == 0 && send_all(halves.fd, request, first) == 0;
+    usleep(300000); // Time for the row job
+    long long streamed = stats_value("streamed_rows") - before;
+    ok = ok && send_all(halves.fd, request + first, len - first) == 0 && read_response(&halves, &r) == 0 &&
+         r.status == 200;
+    int same = ok && r.body_len == expected.body_len && memcmp(r.body, expected.body, r.body_len) == 0;
+    snprintf(detail, sizeof(detail), "%s: status %d, %lld rows done before the second half, %s",
+             extra_headers ? "low-pass" : "full", r.status, streamed, same ? "same bytes" : "different bytes");
+    check("streaming", ok && same && streamed >= height / 2, detail);
+    free(expected.body);
+    free(r.body);
+    client_close(&whole);
+    client_close(&halves);
+    free(request);
+    free(image);
+}
+
+static void test_body_budget(void) {
+    char detail[160];
+    unsigned char part[1000] = { 0 };
+    // A streamed gray body reserves its float plane and spectrum, 33 MB here.
+    client c;
+    response r = { 0 };
+    const char *gray = "POST /compress HTTP/1.1\r\nContent-Length: 4194304\r\nX-Image-Width: 2048\r\n"
+                       "X-Image-Height: 2048\r\n\r\n";
+    int ok = connect_client(&c) == 0 && send_all(c.fd, gray, strlen(gray)) == 0 && read_response(&c, &r) == 0;
+    snprintf(detail, sizeof(detail), "2048x2048 gray answered %d", r.status);
+    check("503 streamed body", ok && r.status == 503 && closed_by_server(&c), detail);
+    free(r.body);
+    client_close(&c);
+
+    // Buffered RGB bodies reserve their size: 9.4 MB, one at a time.
+    const char *rgb = "POST /compress HTTP/1.1\r\nContent-Length: 9437184\r\nX-Image-Width: 2048\r\n"
+                      "X-Image-Height: 1536\r\nX-Image-Format: rgb\r\n\r\n";
+    client first, second;
+    response refused = { 0 };
+    ok = connect_client(&first) == 0 && send_all(first.fd, rgb, strlen(rgb)) == 0 &&
+         send_all(first.fd, part, sizeof(part)) == 0;
+    usleep(100000);
+    long long held = stats_value("body_bytes");
+    ok = ok && connect_client(&second) == 0 && send_all(second.fd, rgb, strlen(rgb)) == 0 &&
+         read_response(&second, &refused) == 0;
+    client_close(&first);
+    long long left = -1;
+    for (int i = 0; i < 50 && left != 0; ++i) {
+        usleep(20000);
+        left = stats_value("body_bytes");
+    }
+    snprintf(detail, sizeof(detail), "%lld bytes held, second upload answered %d, %lld bytes left after", held,
+             refused.status, left);
+    check("503 buffered body", ok && held == 9437184 && refused.status == 503 && left == 0, detail);
+    free(refused.body);
+    client_close(&second);
+}
+
+// A client that sends half a request and stops is disconnected within a
+// sweep of the stall timeout.
+static void test_stall(void) {
+    int width = 64, height = 64;
+    size_t bytes = (size_t)width * height;
+    unsigned char *image = (unsigned char*)xmalloc(bytes);
+    make_image(image, width, height, 1);
+    char headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+    size_t len;
+    unsigned char *request = make_request("POST", "/compress", headers, image, bytes, &len);
+
+    client c;
+    long long before = stats_value("stalled_requests");
+    double start = now_seconds();
+    int ok = connect_client(&c) == 0 && send_all(c.fd, request, len / 2) == 0 && closed_by_server(&c);
+    double elapsed = now_seconds() - start;
+    long long stalled = stats_value("stalled_requests") - before;
+    double timeout = atof(STALL_SECONDS);
+    snprintf(detail, sizeof(detail), "%s after %.2f s, %lld stalled", ok ? "closed" : "not closed", elapsed,
+             stalled);
+    check("stall timeout", ok && elapsed >= timeout && elapsed < timeout + 2.5 && stalled == 1, detail);
+    client_close(&c);
+    free(request);
+    free(image);
+}
+
+// A frame of the test sequence: make_image with rows [first, first + count)
+// brightened, as if something moved there.
+static void make_frame(unsigned char *pixels, int width, int height, int first, int count) {
+    make_image(pixels, width, height, 1);
+    for (int y = first; y < first + count && y < height; ++y) {
+        for (int x = 0; x < width; ++x) pixels[(size_t)y * width + x] += 20;
+    }
+}
+
+static int is_key_frame(const response *r) {
+    return strcasestr(r->headers, "\r\nX-Frame: key\r\n") != NULL;
+}
+
+static void test_frames(void) {
+    int width = 512, height = 384;
+    size_t bytes = (size_t)width * height;
+    unsigned char *first = (unsigned char*)xmalloc(bytes);
+    unsigned char *second = (unsigned char*)xmalloc(bytes);
+    make_frame(first, width, height, 0, 0);
+    make_frame(second, width, height, 100, 16);
+    char headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+
+    client encoder, decoder, late;
+    response key = { 0 }, delta = { 0 }, key_pixels = { 0 }, delta_pixels = { 0 }, orphan = { 0 }, restart = { 0 };
+    int ok = connect_client(&encoder) == 0 && connect_client(&decoder) == 0 && connect_client(&late) == 0 &&
+             exchange(&encoder, "POST", "/frame", headers, first, bytes, &key) == 0 && key.status == 200 &&
+             exchange(&encoder, "POST", "/frame", headers, second, bytes, &delta) == 0 && delta.status == 200;
+    const char *rows = ok ? strcasestr(delta.headers, "\r\nX-Changed-Rows:") : NULL;
+    int changed_rows = rows ? atoi(rows + 17) : -1;
+    snprintf(detail, sizeof(detail), "statuses %d %d, %s then %s, %d changed rows, %zu then %zu bytes", key.status,
+             delta.status, is_key_frame(&key) ? "key" : "delta", is_key_frame(&delta) ? "key" : "delta",
+             changed_rows, key.body_len, delta.body_len);
+    check("frame encode", ok && is_key_frame(&key) && !is_key_frame(&delta) && changed_rows == 16 &&
+                              delta.body_len < key.body_len, detail);
+
+    ok = ok && exchange(&decoder, "POST", "/decompress-frame", NULL, key.body, key.body_len, &key_pixels) == 0 &&
+         key_pixels.status == 200 && key_pixels.body_len == bytes &&
+         exchange(&decoder, "POST", "/decompress-frame", NULL, delta.body, delta.body_len, &delta_pixels) == 0 &&
+         delta_pixels.status == 200 && delta_pixels.body_len == bytes;
+    double key_quality = ok ? psnr(first, key_pixels.body, bytes) : 0.0;
+    double delta_quality = ok ? psnr(second, delta_pixels.body, bytes) : 0.0;
+    snprintf(detail, sizeof(detail), "statuses %d %d, PSNR %.1f then %.1f dB", key_pixels.status,
+             delta_pixels.status, key_quality, delta_quality);
+    check("frame decode", ok && key_quality >= MIN_PSNR && delta_quality >= MIN_PSNR, detail);
+
+    // A delta frame first has nothing to apply to; a key frame restarts.
+    ok = ok && exchange(&late, "POST", "/decompress-frame", NULL, delta.body, delta.body_len, &orphan) == 0 &&
+         orphan.status == 409 &&
+         exchange(&late, "POST", "/decompress-frame", NULL, key.body, key.body_len, &restart) == 0 &&
+         restart.status == 200;
+    snprintf(detail, sizeof(detail), "delta first %d, then key %d", orphan.status, restart.status);
+    check("409 delta without key", ok, detail);
+
+    free(key.body);
+    free(delta.body);
+    free(key_pixels.body);
+    free(delta_pixels.body);
+    free(orphan.body);
+    free(restart.body);
+    client_close(&encoder);
+    client_close(&decoder);
+    client_close(&late);
+    free(first);
+    free(second);
+}
+
+// Three 512x384 encoders do not fit in FRAME_BUDGET_MB: the third evicts
+// the least recently used one, whose next frame comes back as a key
+// frame. A frame too large for the whole budget gets 503.
+static void test_frame_budget(void) {
+    int width = 512, height = 384, big = 1024;
+    size_t bytes = (size_t)width * height, big_bytes = (size_t)big * big;
+    unsigned char *frame = (unsigned char*)xmalloc(big_bytes);
+    make_frame(frame, width, height, 0, 0);
+    char headers[128], big_headers[128], detail[160];
+    snprintf(headers, sizeof(headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", width, height);
+    snprintf(big_headers, sizeof(big_headers), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n", big, big);
+
+    client c[3];
+    response before = { 0 }, r[5] = { { 0 } }, refused = { 0 }, after = { 0 };
+    int ok = connect_client(&c[0]) == 0 && connect_client(&c[1]) == 0 && connect_client(&c[2]) == 0 &&
+             exchange(&c[0], "GET", "/stats", NULL, NULL, 0, &before) == 0 &&
+             exchange(&c[0], "POST", "/frame", headers, frame, bytes, &r[0]) == 0 &&
+             exchange(&c[0], "POST", "/frame", headers, frame, bytes, &r[1]) == 0 &&
+             exchange(&c[1], "POST", "/frame", headers, frame, bytes, &r[2]) == 0 &&
+             exchange(&c[2], "POST", "/frame", headers, frame, bytes, &r[3]) == 0 &&
+             exchange(&c[0], "POST", "/frame", headers, frame, bytes, &r[4]) == 0;
+    for (int i = 0; i < 5 && ok; ++i) ok = r[i].status == 200;
+    snprintf(detail, sizeof(detail), "first connection sent %s, %s, then %s after eviction",
+             is_key_frame(&r[0]) ? "key" : "delta", is_key_frame(&r[1]) ? "key" : "delta",
+             is_key_frame(&r[4]) ? "key" : "delta");
+    check("frame eviction", ok && is_key_frame(&r[0]) && !is_key_frame(&r[1]) && is_key_frame(&r[4]), detail);
+
+    ok = ok && exchange(&c[1], "POST", "/frame", big_headers, frame, big_bytes, &refused) == 0 &&
+         refused.status == 503 && exchange(&c[1], "GET", "/stats", NULL, NULL, 0, &after) == 0 &&
+         after.status == 200;
+    long long evictions = ok ? counter_value(&after, "frame_evictions") - counter_value(&before, "frame_evictions")
+                             : -1;
+    snprintf(detail, sizeof(detail), "%dx%d answered %d, then /stats %d; %lld evictions", big, big, refused.status,
+             after.status, evictions);
+    check("503 over frame budget", ok && evictions >= 2, detail);
+
+    free(before.body);
+    for (int i = 0; i < 5; ++i) free(r[i].body);
+    free(refused.body);
+    free(after.body);
+    for (int i = 0; i < 3; ++i) client_close(&c[i]);
+    free(frame);
+}
+
+int main(int argc, char **argv) {
+    int port = DEFAULT_PORT;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        if (opt != 'p') {
+            fprintf(stderr, "Usage: %s [-p port] [server_binary]\n", argv[0]);
+            return 1;
+        }
+        port = atoi(optarg);
+    }
+    const char *server = optind < argc ? argv[optind] : "./image_compress_server";
+
+    char port_arg[16];
+    snprintf(port_arg, sizeof(port_arg), "%d", port);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null != -1) dup2(null, STDOUT_FILENO);
+        execl(server, server, "-p", port_arg, "-w", "1", "-t", "1", "-m", FRAME_BUDGET_MB, "-r", BODY_BUDGET_MB, "-s",
+              STALL_SECONDS, (char*)NULL);
+        perror(server);
+        _exit(1);
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // Wait for the server to listen
+    int fd = -1;
+    for (int i = 0; i < 100 && fd == -1; ++i) {
+        fd = open_connection();
+        if (fd == -1) usleep(20000);
+    }
+    if (fd == -1) {
+        fprintf(stderr, "%s did not start on port %d\n", server, port);
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return 1;
+    }
+    close(fd);
+
+    test_round_trip(256, 192, 0);
+    test_round_trip(96, 80, 1);
+    test_slow_upload();
+    test_streaming(NULL);
+    test_streaming("X-Low-Pass: 0.5\r\n");
+    test_body_budget();
+    test_stall();
+    test_pipelining();
+    test_errors();
+    test_counters();
+    test_frames();
+    test_frame_budget();
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    printf("test_server: %d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+// Host stand-in for version-2/uart.c, so the bare-metal FFT sources can be
+// linked into the host benchmarks. UART output goes to stderr.
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "uart.h"
+
+void uart_init(void) {
+}
+
+void uart_putc(char c) {
+    fputc(c, stderr);
+}
+
+void uart_puts(const char* s) {
+    fputs(s, stderr);
+}
+
+void uart_puthex(uint64_t val) {
+    fprintf(stderr, "0x%" PRIx64, val);
+}
+
+void uart_putdouble(double val) {
+    fprintf(stderr, "%.6f", val);
+}
@@ -13,20 +13,28 @@ img_data = np.arange(width * height, dtype=np.uint8).reshape((height, width)) %
 # Flatten the image data to send as raw bytes
 raw_image_bytes = img_data.tobytes()
 
-server_url = "http://<RISCV_TARGET_IP>:8080/compress"
+server_url = "http://<RISCV_TARGET_IP>:8080"
 
 try:
-    response = requests.post(server_url, data=raw_image_bytes, 
-                             headers={'Content-Type': 'application/octet-stream'})
+    response = requests.post(server_url + "/compress", data=raw_image_bytes,
+                             headers={'Content-Type': 'application/octet-stream',
+                                      'X-Image-Width': str(width), 'X-Image-Height': str(height)})
 
     if response.status_code == 200:
         print(f"Compression successful. Received {len(response.content)} bytes of compressed data.")
-        # You would then need a decompression client to reverse the process
-        # For this simplified example, the client would need to know the
-        # quantization factor and the very basic encoding.
-        # Example: If you just sent raw quantized shorts:
-        # received_shorts = np.frombuffer(response.content, dtype=np.int16)
-        # print(f"Decompressed shorts shape: {received_shorts.shape}")
+        # The stream is self-describing, so the server can reverse it
+        # without being told the image size.
+        restored = requests.post(server_url + "/decompress", data=response.content,
+                                 headers={'Content-Type': 'application/octet-stream'})
+        if restored.status_code == 200:
+            w = int(restored.headers['X-Image-Width'])
+            h = int(restored.headers['X-Image-Height'])
+            restored_data = np.frombuffer(restored.content, dtype=np.uint8).reshape((h, w))
+            mse = np.mean((restored_data.astype(np.float64) - img_data) ** 2)
+            psnr = 10 * np.log10(255.0 ** 2 / mse) if mse > 0 else float('inf')
+            print(f"Decompressed {w}x{h} image, PSNR {psnr:.2f} dB.")
+        else:
+            print(f"Decompression error: {restored.status_code} - {restored.text}")
     else:
         print(f"Error: {response.status_code} - {response.text}")
 except requests.exceptions.ConnectionError as e:
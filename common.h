@@ -0,0 +1,35 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+#include <time.h>
+
+// --- Shared helpers ---
+// Limits and byte-order helpers shared by the server, the codec, the batch
+// compressor and the benchmarks. Everything here is inline: no
+// translation unit to link.
+
+// Largest width or height of an image accepted for compression, by the
+// server and by the batch compressor alike.
+#define MAX_IMAGE_DIM 8192
+
+// Little-endian 32-bit fields, as in compressed streams and archives.
+static inline void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Monotonic clock in seconds.
+static inline double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+#endif // COMMON_H
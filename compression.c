@@ -1,59 +1,1116 @@
 #include "compression.h"
+#include "common.h"
+#include "fft.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h> // For fabs
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__riscv_vector)
+#include <riscv_vector.h>
+#endif
+
+#define HUFFMAN_MAX_LEN 16
+#define SYMBOL_ZRL 0xF0 // 16 zeros
+#define SYMBOL_EOB 0x00 // Only zeros remain
+#define SIZE_ESCAPE 15   // Size nibble: the real size - 15 follows in 4 bits
+#define SIZE_MAX_BITS 30
+#define QUANT_MAX ((1 << SIZE_MAX_BITS) - 1)
+
+// Canonical Huffman table over the 256 (run, size) symbols
+typedef struct {
+    uint8_t counts[HUFFMAN_MAX_LEN]; // Codes of length 1..16
+    uint8_t symbols[256];            // In code order
+    int num_symbols;
+    uint16_t code[256];
+    uint8_t length[256];             // 0 if the symbol is unused
+} huffman_table;
+
+// MSB-first bit writer with a 64-bit accumulator. A streaming writer hands
+// out to its sink whenever pos reaches cap and starts over; otherwise cap
+// is SIZE_MAX and out holds the whole stream.
+typedef struct {
+    unsigned char *out;
+    size_t pos;
+    uint64_t acc;
+    int bits; // Pending bits in acc
+    size_t cap;
+    compression_sink sink; // NULL once it has failed
+    void *ctx;
+    size_t stream_size;
+    int failed;
+} bit_writer;
+
+static void drain_bits(bit_writer *bw) {
+    if (bw->sink && bw->sink(bw->ctx, bw->out, bw->pos, bw->stream_size) != 0) {
+        bw->sink = NULL;
+        bw->failed = 1;
+    }
+    bw->pos = 0;
+}
+
+static void put_bits(bit_writer *bw, uint32_t value, int count) {
+    bw->acc = (bw->acc << count) | (value & ((1u << count) - 1));
+    bw->bits += count;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        bw->out[bw->pos++] = (unsigned char)(bw->acc >> bw->bits);
+        if (bw->pos == bw->cap) drain_bits(bw);
+    }
+}
+
+static void flush_bits(bit_writer *bw) {
+    if (bw->bits > 0) {
+        put_bits(bw, 0xFF, 8 - bw->bits); // Pad with 1 bits
+    }
+}
+
+// MSB-first bit reader. acc is left-aligned: its top bit is the next one
+// in the stream. Reading past the end yields 1 bits, like the padding;
+// bits_consumed() tells whether real data ran out.
+typedef struct {
+    const unsigned char *in;
+    size_t pos;
+    size_t size;
+    uint64_t acc;
+    int bits; // Valid bits in acc
+} bit_reader;
+
+static inline void refill_bits(bit_reader *br) {
+    while (br->bits <= 56) {
+        uint64_t byte = br->pos < br->size ? br->in[br->pos] : 0xFF;
+        br->pos++;
+        br->acc |= byte << (56 - br->bits);
+        br->bits += 8;
+    }
+}
+
+// Takes count (1..32) bits; at most 57 bits may be taken between calls to
+// refill_bits.
+static inline uint32_t get_bits(bit_reader *br, int count) {
+    uint32_t v = (uint32_t)(br->acc >> (64 - count));
+    br->acc <<= count;
+    br->bits -= count;
+    return v;
+}
+
+static size_t bits_consumed(const bit_reader *br) {
+    return br->pos * 8 - (size_t)br->bits;
+}
+
+// Bit length of |v|, v != 0
+static int magnitude_size(int v) {
+    unsigned int a = (unsigned int)(v < 0 ? -v : v);
+    return 32 - __builtin_clz(a);
+}
+
+static int valid_tile_size(int tile_size) {
+    return tile_size == 8 || tile_size == 16 || tile_size == 32;
+}
+
+// --- Quantization ---
+// One value; the tiled mode quantizes tile by tile with this.
+static inline int32_t quantize_one(float x) {
+    // 2^30 is exact in float; clamp after rounding
+    x = fminf(fmaxf(x, -1073741824.0f), 1073741824.0f);
+    long v = lrintf(x);
+    return (int32_t)(v > QUANT_MAX ? QUANT_MAX : v < -QUANT_MAX ? -QUANT_MAX : v);
+}
+
+// The FFT is unnormalized: its coefficients grow with sqrt(width * height)
+// for the same content. Dividing by the factor times that (T for T x T
+// tiles) quantizes the orthonormal transform instead, so one factor gives
+// about the same quality at every image size and in every mode.
+static float quantization_step(float quantization_factor, int width, int height) {
+    return quantization_factor * sqrtf((float)width * (float)height);
+}
+
+// Whole planes:
+// q[2i] = round(re[i] / step), q[2i+1] = round(im[i] / step), saturated to
+// +-QUANT_MAX. Rounds to nearest even, like the vector conversion.
+
+#if defined(__riscv_vector)
+
+static void quantize(const float *re, const float *im, int32_t *q, size_t bins, float inv_q) {
+    ptrdiff_t pair = 2 * (ptrdiff_t)sizeof(int32_t);
+    size_t vl;
+    for (size_t i = 0; i < bins; i += vl) {
+        vl = __riscv_vsetvl_e32m4(bins - i);
+        // The conversion itself saturates to the int32 range.
+        vint32m4_t r = __riscv_vfcvt_x_f_v_i32m4(__riscv_vfmul_vf_f32m4(__riscv_vle32_v_f32m4(re + i, vl), inv_q, vl), vl);
+        vint32m4_t m = __riscv_vfcvt_x_f_v_i32m4(__riscv_vfmul_vf_f32m4(__riscv_vle32_v_f32m4(im + i, vl), inv_q, vl), vl);
+        r = __riscv_vmax_vx_i32m4(__riscv_vmin_vx_i32m4(r, QUANT_MAX, vl), -QUANT_MAX, vl);
+        m = __riscv_vmax_vx_i32m4(__riscv_vmin_vx_i32m4(m, QUANT_MAX, vl), -QUANT_MAX, vl);
+        __riscv_vsse32_v_i32m4(q + 2 * i, pair, r, vl);
+        __riscv_vsse32_v_i32m4(q + 2 * i + 1, pair, m, vl);
+    }
+}
+
+#else
+
+static void quantize(const float *re, const float *im, int32_t *q, size_t bins, float inv_q) {
+    for (size_t i = 0; i < bins; ++i) {
+        q[2 * i] = quantize_one(re[i] * inv_q);
+        q[2 * i + 1] = quantize_one(im[i] * inv_q);
+    }
+}
+
+#endif
+
+// --- Symbol stream ---
+// One walk over the coefficients. With bw NULL it only counts symbol
+// frequencies into freq and, if raw_bits is not NULL, adds the bits that
+// follow the codes (size escapes and values) to it; otherwise it writes
+// codes and raw bits.
+static size_t code_coefficients(const int32_t *q, size_t count, const huffman_table *t, bit_writer *bw,
+                                uint32_t *freq, uint64_t *raw_bits) {
+    size_t zeros = 0, run = 0;
+    uint64_t raw = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int v = q[i];
+        if (v == 0) {
+            run++;
+            zeros++;
+            continue;
+        }
+        while (run >= 16) {
+            if (bw) put_bits(bw, t->code[SYMBOL_ZRL], t->length[SYMBOL_ZRL]);
+            else freq[SYMBOL_ZRL]++;
+            run -= 16;
+        }
+        int size = magnitude_size(v);
+        int symbol = (int)(run << 4) | (size < SIZE_ESCAPE ? size : SIZE_ESCAPE);
+        if (bw) {
+            put_bits(bw, t->code[symbol], t->length[symbol]);
+            if (size >= SIZE_ESCAPE) put_bits(bw, (uint32_t)(size - SIZE_ESCAPE), 4);
+            put_bits(bw, (uint32_t)(v > 0 ? v : v + (1 << size) - 1), size);
+        } else {
+            freq[symbol]++;
+            raw += (uint64_t)size + (size >= SIZE_ESCAPE ? 4 : 0);
+        }
+        run = 0;
+    }
+    if (run > 0) {
+        if (bw) put_bits(bw, t->code[SYMBOL_EOB], t->length[SYMBOL_EOB]);
+        else freq[SYMBOL_EOB]++;
+    }
+    if (raw_bits) *raw_bits += raw;
+    return zeros;
+}
+
+// --- Huffman table construction ---
+// Code lengths from symbol frequencies, limited to 16 bits and made
+// canonical, following JPEG (ITU T.81) Annex K.2.
+static void build_huffman(const uint32_t *freq_in, huffman_table *t) {
+    uint64_t freq[256];
+    int codesize[256], others[256];
+    for (int i = 0; i < 256; ++i) {
+        freq[i] = freq_in[i];
+        codesize[i] = 0;
+        others[i] = -1;
+    }
+
+    for (;;) {
+        // The two least frequent live nodes; v1 the smaller
+        int v1 = -1, v2 = -1;
+        for (int i = 0; i < 256; ++i) {
+            if (freq[i] == 0) continue;
+            if (v1 < 0 || freq[i] <= freq[v1]) {
+                v2 = v1;
+                v1 = i;
+            } else if (v2 < 0 || freq[i] <= freq[v2]) {
+                v2 = i;
+            }
+        }
+        if (v2 < 0) {
+            // A lone symbol still needs a 1-bit code
+            if (v1 >= 0 && codesize[v1] == 0) codesize[v1] = 1;
+            break;
+        }
+        freq[v1] += freq[v2];
+        freq[v2] = 0;
+        codesize[v1]++;
+        while (others[v1] >= 0) {
+            v1 = others[v1];
+            codesize[v1]++;
+        }
+        others[v1] = v2;
+        codesize[v2]++;
+        while (others[v2] >= 0) {
+            v2 = others[v2];
+            codesize[v2]++;
+        }
+    }
+
+    // Count codes per length, then move overlong codes up the tree
+    int bits[257] = {0};
+    for (int i = 0; i < 256; ++i) {
+        if (codesize[i] > 0) bits[codesize[i]]++;
+    }
+    for (int i = 256; i > HUFFMAN_MAX_LEN; --i) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) j--;
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+
+    // Symbols in order of their original length, then symbol value, take
+    // the (possibly adjusted) lengths in order.
+    t->num_symbols = 0;
+    for (int len = 1; len <= 256; ++len) {
+        for (int i = 0; i < 256; ++i) {
+            if (codesize[i] == len) t->symbols[t->num_symbols++] = (uint8_t)i;
+        }
+    }
+    memset(t->length, 0, sizeof(t->length));
+    int k = 0;
+    uint32_t code = 0;
+    for (int len = 1; len <= HUFFMAN_MAX_LEN; ++len) {
+        t->counts[len - 1] = (uint8_t)bits[len];
+        for (int n = 0; n < bits[len]; ++n, ++k) {
+            t->length[t->symbols[k]] = (uint8_t)len;
+            t->code[t->symbols[k]] = (uint16_t)code++;
+        }
+        code <<= 1;
+    }
+}
+
+// --- Huffman decoding ---
+// Codes up to HUFFMAN_LOOKUP_BITS long resolve with one table lookup on
+// the next bits of the stream; longer ones walk the canonical code ranges
+// per length (JPEG F.2.2.3).
+#define HUFFMAN_LOOKUP_BITS 9
+
+typedef struct {
+    uint16_t lookup[1 << HUFFMAN_LOOKUP_BITS]; // (length << 8) | symbol, 0 if longer
+    int32_t max_code[HUFFMAN_MAX_LEN + 1];     // Largest code of each length, -1 if none
+    int32_t first_code[HUFFMAN_MAX_LEN + 1];
+    int first_index[HUFFMAN_MAX_LEN + 1];      // Into symbols
+    const uint8_t *symbols;
+} huffman_decoder;
+
+// Returns 0, or -1 if the counts do not describe a prefix code.
+static int build_decoder(const uint8_t *counts, const uint8_t *symbols, huffman_decoder *d) {
+    memset(d->lookup, 0, sizeof(d->lookup));
+    d->symbols = symbols;
+    uint32_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= HUFFMAN_MAX_LEN; ++len) {
+        int n = counts[len - 1];
+        d->first_code[len] = (int32_t)code;
+        d->first_index[len] = k;
+        d->max_code[len] = n ? (int32_t)(code + n - 1) : -1;
+        if (code + n > (1u << len)) return -1;
+        for (int i = 0; i < n; ++i, ++k, ++code) {
+            if (len <= HUFFMAN_LOOKUP_BITS) {
+                int shift = HUFFMAN_LOOKUP_BITS - len;
+                uint16_t entry = (uint16_t)(len << 8 | symbols[k]);
+                for (uint32_t j = code << shift; j < (code + 1) << shift; ++j) {
+                    d->lookup[j] = entry;
+                }
+            }
+        }
+        code <<= 1;
+    }
+    return 0;
+}
+
+// Next symbol, or -1 if the bits match no code. Needs 16 buffered bits.
+static inline int decode_symbol(const huffman_decoder *d, bit_reader *br) {
+    uint16_t entry = d->lookup[br->acc >> (64 - HUFFMAN_LOOKUP_BITS)];
+    if (entry) {
+        get_bits(br, entry >> 8);
+        return entry & 0xFF;
+    }
+    for (int len = HUFFMAN_LOOKUP_BITS + 1; len <= HUFFMAN_MAX_LEN; ++len) {
+        int32_t code = (int32_t)(br->acc >> (64 - len));
+        if (code <= d->max_code[len]) {
+            get_bits(br, len);
+            return d->symbols[d->first_index[len] + code - d->first_code[len]];
+        }
+    }
+    return -1;
+}
+
+size_t simple_compress_bound(int width, int height) {
+    size_t count = 2 * (size_t)(width / 2 + 1) * height;
+    // Each value costs at most a 16-bit code, a 4-bit size escape and 30
+    // raw bits (under 7 bytes); each ZRL covers 16 zeros; then one EOB and
+    // padding.
+    return COMPRESSION_HEADER_SIZE + 256 + 7 * count + 8;
+}
+
+size_t simple_compress_scratch_size(int width, int height) {
+    return 2 * (size_t)(width / 2 + 1) * height * sizeof(int32_t);
+}
+
+size_t simple_compress_reference_size(int width, int height) {
+    return simple_compress_scratch_size(width, height) + sizeof(int32_t);
+}
+
+// Turns q into its difference from reference and makes q the new
+// reference. Returns -1, changing nothing, if a difference is too large
+// to code.
+static int delta_against(int32_t *q, int32_t *reference, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int64_t d = (int64_t)q[i] - reference[i];
+        if (d > QUANT_MAX || d < -QUANT_MAX) return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int32_t v = q[i];
+        q[i] = v - reference[i];
+        reference[i] = v;
+    }
+    return 0;
+}
+
+// simple_compress with the header's color byte set to color. With a sink,
+// compressed_data is a chunk of chunk_size bytes handed to it as it
+// fills (simple_compress_stream); otherwise it holds the whole stream.
+// With a reference (simple_compress_frame), *key selects a key frame and
+// reports whether one was written. The reference's factor follows its
+// count values; values quantized with another step are no base for a
+// delta, so a new factor makes a key frame.
+static size_t compress_plane(const float *fft_real, const float *fft_imag, int width, int height, int color,
+                             float quantization_factor, unsigned char *compressed_data, size_t chunk_size,
+                             void *scratch, int32_t *reference, int *key, compression_sink sink, void *ctx,
+                             compression_stats *stats) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-// This is a VERY simplistic compression.
-// A real image compression scheme (like JPEG) is much more sophisticated.
-void simple_compress(float *fft_real, float *fft_imag, int width, int height, unsigned char **compressed_data, size_t *compressed_size) {
     // Quantization:
     // Scale FFT coefficients and round to integers.
     // Larger quantization_factor means more compression (more data loss).
-    float quantization_factor = 100.0f; // Example: Adjust this value
-
-    // For simplicity, we'll store quantized real and imaginary parts as short integers.
-    // This is still very large, but shows the principle.
-    short *quantized_coeffs = (short*)malloc(2 * width * height * sizeof(short)); // real and imag
-    if (!quantized_coeffs) {
-        perror("malloc for quantized_coeffs");
-        *compressed_data = NULL;
-        *compressed_size = 0;
-        return;
-    }
-
-    int zero_count = 0;
-    for (int i = 0; i < width * height; ++i) {
-        quantized_coeffs[2 * i] = (short)roundf(fft_real[i] / quantization_factor);
-        quantized_coeffs[2 * i + 1] = (short)roundf(fft_imag[i] / quantization_factor);
-
-        if (quantized_coeffs[2 * i] == 0 && quantized_coeffs[2 * i + 1] == 0) {
-            zero_count++;
-        }
-    }
-
-    // Very basic "encoding":
-    // For demonstration, we'll just copy the quantized data.
-    // In a real scenario, you'd apply run-length encoding (RLE), Huffman coding,
-    // or arithmetic coding to exploit the zeroes and distribution of coefficients.
-
-    // A slightly better "encoding" for demonstration: simple run-length encoding for zeros.
-    // This is still not robust or efficient for all cases.
-    // Format: [value, count] or [0, zero_count]
-    
-    // For simplicity, let's just dump the quantized shorts.
-    // This won't be very compressed unless many coefficients become 0.
-    *compressed_size = 2 * width * height * sizeof(short);
-    *compressed_data = (unsigned char*)malloc(*compressed_size);
-    if (!*compressed_data) {
-        perror("malloc for compressed_data");
-        free(quantized_coeffs);
-        *compressed_size = 0;
-        return;
-    }
-    memcpy(*compressed_data, quantized_coeffs, *compressed_size);
-
-    printf("Quantized coefficients: %d real, %d imag. Zero count: %d\n", width*height, width*height, zero_count);
-    printf("Compressed size (raw shorts): %zu bytes\n", *compressed_size);
-
-    free(quantized_coeffs);
-}
\ No newline at end of file
+    size_t bins = (size_t)(width / 2 + 1) * height;
+    size_t count = 2 * bins;
+    int32_t *q = (int32_t*)scratch;
+    quantize(fft_real, fft_imag, q, bins, 1.0f / quantization_step(quantization_factor, width, height));
+    uint32_t qbits;
+    memcpy(&qbits, &quantization_factor, sizeof(qbits));
+    int mode = COMPRESSION_MODE_FULL;
+    if (reference) {
+        if (!*key && (uint32_t)reference[count] == qbits && delta_against(q, reference, count) == 0) {
+            mode = COMPRESSION_MODE_DELTA;
+        } else {
+            memcpy(reference, q, count * sizeof(int32_t));
+            reference[count] = (int32_t)qbits;
+        }
+        *key = mode == COMPRESSION_MODE_FULL;
+    }
+    struct timespec quantized;
+    clock_gettime(CLOCK_MONOTONIC, &quantized);
+
+    // Entropy coding: size the Huffman table on a counting pass, then code.
+    // The counting pass also gives the exact payload size, so the header
+    // is final before the first payload byte.
+    uint32_t freq[256] = {0};
+    uint64_t payload_bits = 0;
+    huffman_table table;
+    size_t zero_count = code_coefficients(q, count, NULL, NULL, freq, &payload_bits);
+    build_huffman(freq, &table);
+    for (int i = 0; i < 256; ++i) {
+        payload_bits += (uint64_t)freq[i] * table.length[i];
+    }
+    size_t payload_size = (size_t)((payload_bits + 7) / 8);
+    size_t payload_offset = COMPRESSION_HEADER_SIZE + table.num_symbols;
+    size_t compressed_size = payload_offset + payload_size;
+
+    unsigned char *p = compressed_data;
+    memcpy(p, COMPRESSION_MAGIC, 4);
+    p[4] = COMPRESSION_VERSION;
+    p[5] = (unsigned char)mode;
+    p[6] = 0;
+    p[7] = (unsigned char)color;
+    put_u32(p + 8, (uint32_t)width);
+    put_u32(p + 12, (uint32_t)height);
+    put_u32(p + 16, qbits);
+    put_u32(p + 20, (uint32_t)payload_size);
+    memcpy(p + 24, table.counts, HUFFMAN_MAX_LEN);
+    memcpy(p + COMPRESSION_HEADER_SIZE, table.symbols, table.num_symbols);
+
+    // The payload follows the symbols in the same buffer; a streaming
+    // writer wraps to the start of the chunk each time it fills.
+    bit_writer bw = { compressed_data, payload_offset, 0, 0, sink ? chunk_size : SIZE_MAX, sink, ctx,
+                      compressed_size, 0 };
+    code_coefficients(q, count, &table, &bw, NULL, NULL);
+    flush_bits(&bw);
+    if (sink && bw.pos > 0) drain_bits(&bw);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (bw.failed) return 0;
+    if (stats) {
+        stats->coefficients = count;
+        stats->zero_coefficients = zero_count;
+        stats->output_bytes = compressed_size;
+        stats->encode_seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+        stats->quantize_seconds =
+            (double)(quantized.tv_sec - start.tv_sec) + 1e-9 * (double)(quantized.tv_nsec - start.tv_nsec);
+        stats->decode_seconds = 0.0;
+    }
+    return compressed_size;
+}
+
+size_t simple_compress(const float *fft_real, const float *fft_imag, int width, int height,
+                       float quantization_factor, unsigned char *compressed_data, void *scratch,
+                       compression_stats *stats) {
+    if (width < 1 || height < 1 || !(quantization_factor > 0.0f)) {
+        return 0;
+    }
+    return compress_plane(fft_real, fft_imag, width, height, COMPRESSION_COLOR_GRAY, quantization_factor,
+                          compressed_data, 0, scratch, NULL, NULL, NULL, NULL, stats);
+}
+
+size_t simple_compress_stream(const float *fft_real, const float *fft_imag, int width, int height,
+                              float quantization_factor, unsigned char *chunk, size_t chunk_size, void *scratch,
+                              compression_sink sink, void *ctx, compression_stats *stats) {
+    if (width < 1 || height < 1 || !(quantization_factor > 0.0f) || chunk_size < COMPRESSION_STREAM_CHUNK_MIN ||
+        !sink) {
+        return 0;
+    }
+    return compress_plane(fft_real, fft_imag, width, height, COMPRESSION_COLOR_GRAY, quantization_factor, chunk,
+                          chunk_size, scratch, NULL, NULL, sink, ctx, stats);
+}
+
+size_t simple_compress_frame(const float *fft_real, const float *fft_imag, int width, int height,
+                             float quantization_factor, int32_t *reference, int *key, unsigned char *compressed_data,
+                             void *scratch, compression_stats *stats) {
+    if (width < 1 || height < 1 || !(quantization_factor > 0.0f)) {
+        return 0;
+    }
+    return compress_plane(fft_real, fft_imag, width, height, COMPRESSION_COLOR_GRAY, quantization_factor,
+                          compressed_data, 0, scratch, reference, key, NULL, NULL, stats);
+}
+
+// --- Color ---
+
+int compression_color_planes(int color) {
+    switch (color) {
+    case COMPRESSION_COLOR_GRAY:
+        return 1;
+    case COMPRESSION_COLOR_YCBCR444:
+    case COMPRESSION_COLOR_YCBCR420:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+void compression_plane_size(int color, int plane, int width, int height, int *plane_width, int *plane_height) {
+    if (color == COMPRESSION_COLOR_YCBCR420 && plane > 0) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    *plane_width = width;
+    *plane_height = height;
+}
+
+size_t simple_compress_color_bound(int width, int height, int color) {
+    size_t bound = 0;
+    for (int p = 0; p < compression_color_planes(color); ++p) {
+        int plane_width, plane_height;
+        compression_plane_size(color, p, width, height, &plane_width, &plane_height);
+        bound += simple_compress_bound(plane_width, plane_height);
+    }
+    return bound;
+}
+
+size_t simple_compress_color(const float *const *fft_real, const float *const *fft_imag, int width, int height,
+                             int color, float quantization_factor, unsigned char *compressed_data, void *scratch,
+                             compression_stats *stats) {
+    if (width < 1 || height < 1 || !(quantization_factor > 0.0f) || compression_color_planes(color) == 0) {
+        return 0;
+    }
+    compression_stats total = {0};
+    size_t offset = 0;
+    for (int p = 0; p < compression_color_planes(color); ++p) {
+        int plane_width, plane_height;
+        compression_plane_size(color, p, width, height, &plane_width, &plane_height);
+        compression_stats plane;
+        size_t size = compress_plane(fft_real[p], fft_imag[p], plane_width, plane_height, color, quantization_factor,
+                                     compressed_data + offset, 0, scratch, NULL, NULL, NULL, NULL, &plane);
+        if (size == 0) return 0;
+        offset += size;
+        total.coefficients += plane.coefficients;
+        total.zero_coefficients += plane.zero_coefficients;
+        total.encode_seconds += plane.encode_seconds;
+        total.quantize_seconds += plane.quantize_seconds;
+    }
+    total.output_bytes = offset;
+    if (stats) *stats = total;
+    return offset;
+}
+
+int simple_decompress_info(const unsigned char *compressed_data, size_t size, compression_info *info) {
+    if (size < COMPRESSION_HEADER_SIZE || memcmp(compressed_data, COMPRESSION_MAGIC, 4) != 0 ||
+        compressed_data[4] != COMPRESSION_VERSION) {
+        return -1;
+    }
+    int mode = compressed_data[5];
+    int tile_size = compressed_data[6];
+    int color = compressed_data[7];
+    if (!((mode == COMPRESSION_MODE_FULL || mode == COMPRESSION_MODE_DELTA) && tile_size == 0) &&
+        !(mode == COMPRESSION_MODE_TILED && valid_tile_size(tile_size))) {
+        return -1;
+    }
+    if (compression_color_planes(color) == 0 || (mode != COMPRESSION_MODE_FULL && color != COMPRESSION_COLOR_GRAY)) {
+        return -1;
+    }
+    uint32_t w = get_u32(compressed_data + 8);
+    uint32_t h = get_u32(compressed_data + 12);
+    uint32_t qbits = get_u32(compressed_data + 16);
+    float qf;
+    memcpy(&qf, &qbits, sizeof(qf));
+    // Bounded so that every size derived from them fits an int
+    if (w < 1 || h < 1 || w > 65536 || h > 65536 || (uint64_t)w * h > 0x3FFFFFFF ||
+        !(qf > 0.0f) || !isfinite(qf)) {
+        return -1;
+    }
+    info->width = (int)w;
+    info->height = (int)h;
+    info->mode = mode;
+    info->tile_size = tile_size;
+    info->color = color;
+    info->quantization_factor = qf;
+    return 0;
+}
+
+// Checks the Huffman tables that follow the header and builds their
+// decoder. Returns the offset just past the symbol list, 0 if invalid.
+static size_t read_huffman_tables(const unsigned char *compressed_data, size_t size, huffman_decoder *decoder) {
+    const uint8_t *counts = compressed_data + 24;
+    size_t num_symbols = 0;
+    for (int i = 0; i < HUFFMAN_MAX_LEN; ++i) {
+        num_symbols += counts[i];
+    }
+    if (num_symbols == 0 || num_symbols > 256 || COMPRESSION_HEADER_SIZE + num_symbols > size) {
+        return 0;
+    }
+    // Only (run, size) symbols with 1 <= size <= 15, ZRL and EOB occur.
+    const uint8_t *symbols = compressed_data + COMPRESSION_HEADER_SIZE;
+    for (size_t i = 0; i < num_symbols; ++i) {
+        if ((symbols[i] & 0x0F) == 0 && symbols[i] != SYMBOL_EOB && symbols[i] != SYMBOL_ZRL) return 0;
+    }
+    if (build_decoder(counts, symbols, decoder) != 0) {
+        return 0;
+    }
+    return COMPRESSION_HEADER_SIZE + num_symbols;
+}
+
+// Decodes the next run of zeros and the value after it (value 0 for a
+// ZRL, which stands for 16 zeros alone). Returns 0, 1 at an EOB, or -1 if
+// the bits are corrupt.
+static inline int decode_value(const huffman_decoder *decoder, bit_reader *br, int *run, int *value) {
+    refill_bits(br);
+    int symbol = decode_symbol(decoder, br);
+    if (symbol < 0) return -1;
+    if (symbol == SYMBOL_EOB) return 1;
+    if (symbol == SYMBOL_ZRL) {
+        *run = 16;
+        *value = 0;
+        return 0;
+    }
+    int size_bits = symbol & 0x0F;
+    if (size_bits == SIZE_ESCAPE) {
+        size_bits += (int)get_bits(br, 4);
+        if (size_bits > SIZE_MAX_BITS) return -1;
+    }
+    int v = (int)get_bits(br, size_bits);
+    if (v < (1 << (size_bits - 1))) v -= (1 << size_bits) - 1;
+    *run = symbol >> 4;
+    *value = v;
+    return 0;
+}
+
+// Decodes the full- or delta-mode plane stream at the start of compressed_data,
+// whose header is info. Returns the plane stream's size, 0 on failure.
+// With a reference (simple_decompress_frame), the decoded values are
+// added to it, after clearing it for a full-mode stream, and the spectrum
+// is the updated reference. A delta-mode stream must have the reference's
+// factor.
+static size_t decompress_plane(const unsigned char *compressed_data, size_t size, const compression_info *info,
+                               int32_t *reference, float *fft_real, float *fft_imag, compression_stats *stats) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    huffman_decoder decoder;
+    size_t payload_offset = read_huffman_tables(compressed_data, size, &decoder);
+    size_t payload_size = get_u32(compressed_data + 20);
+    if (payload_offset == 0 || payload_size > size - payload_offset) {
+        return 0;
+    }
+
+    // Zeros are implied by the runs, so clear everything first and only
+    // store the nonzero values, already multiplied back by the step.
+    float step = quantization_step(info->quantization_factor, info->width, info->height);
+    size_t bins = (size_t)(info->width / 2 + 1) * info->height;
+    size_t count = 2 * bins;
+    memset(fft_real, 0, bins * sizeof(float));
+    memset(fft_imag, 0, bins * sizeof(float));
+    float *planes[2] = { fft_real, fft_imag };
+    if (reference) {
+        uint32_t qbits;
+        memcpy(&qbits, &info->quantization_factor, sizeof(qbits));
+        if (info->mode == COMPRESSION_MODE_FULL) {
+            memset(reference, 0, count * sizeof(int32_t));
+            reference[count] = (int32_t)qbits;
+        } else if ((uint32_t)reference[count] != qbits) {
+            return 0;
+        }
+    }
+
+    bit_reader br = { compressed_data + payload_offset, 0, payload_size, 0, 0 };
+    size_t i = 0, nonzero = 0;
+    while (i < count) {
+        int run, v;
+        int status = decode_value(&decoder, &br, &run, &v);
+        if (status < 0) return 0;
+        if (status > 0) break;
+        i += (size_t)run;
+        if (v == 0) continue;
+        if (i >= count) return 0;
+        if (reference) {
+            int64_t sum = (int64_t)reference[i] + v;
+            if (sum > QUANT_MAX || sum < -QUANT_MAX) return 0;
+            reference[i] = (int32_t)sum;
+        } else {
+            planes[i & 1][i >> 1] = (float)v * step;
+        }
+        i++;
+        nonzero++;
+    }
+    if (i > count || bits_consumed(&br) > payload_size * 8) {
+        return 0;
+    }
+    if (reference) {
+        for (size_t j = 0; j < bins; ++j) {
+            fft_real[j] = (float)reference[2 * j] * step;
+            fft_imag[j] = (float)reference[2 * j + 1] * step;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats) {
+        stats->coefficients = count;
+        stats->zero_coefficients = count - nonzero;
+        stats->output_bytes = payload_offset + payload_size;
+        stats->encode_seconds = 0.0;
+        stats->quantize_seconds = 0.0;
+        stats->decode_seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+    }
+    return payload_offset + payload_size;
+}
+
+int simple_decompress(const unsigned char *compressed_data, size_t size, float *fft_real, float *fft_imag,
+                      compression_stats *stats) {
+    compression_info info;
+    if (simple_decompress_info(compressed_data, size, &info) != 0 || info.mode != COMPRESSION_MODE_FULL ||
+        info.color != COMPRESSION_COLOR_GRAY) {
+        return -1;
+    }
+    return decompress_plane(compressed_data, size, &info, NULL, fft_real, fft_imag, stats) == 0 ? -1 : 0;
+}
+
+int simple_decompress_frame(const unsigned char *compressed_data, size_t size, int width, int height,
+                            int32_t *reference, float *fft_real, float *fft_imag, compression_stats *stats) {
+    compression_info info;
+    if (simple_decompress_info(compressed_data, size, &info) != 0 || info.color != COMPRESSION_COLOR_GRAY ||
+        (info.mode != COMPRESSION_MODE_FULL && info.mode != COMPRESSION_MODE_DELTA) || info.width != width ||
+        info.height != height) {
+        return -1;
+    }
+    return decompress_plane(compressed_data, size, &info, reference, fft_real, fft_imag, stats) == 0 ? -1 : 0;
+}
+
+int simple_decompress_color(const unsigned char *compressed_data, size_t size, float *const *fft_real,
+                            float *const *fft_imag, compression_stats *stats) {
+    compression_info image;
+    if (simple_decompress_info(compressed_data, size, &image) != 0 || image.mode != COMPRESSION_MODE_FULL ||
+        image.color == COMPRESSION_COLOR_GRAY) {
+        return -1;
+    }
+    compression_stats total = {0};
+    size_t offset = 0;
+    for (int p = 0; p < compression_color_planes(image.color); ++p) {
+        // Every plane header must agree with the image header.
+        compression_info info;
+        int plane_width, plane_height;
+        compression_plane_size(image.color, p, image.width, image.height, &plane_width, &plane_height);
+        if (simple_decompress_info(compressed_data + offset, size - offset, &info) != 0 ||
+            info.mode != COMPRESSION_MODE_FULL || info.color != image.color || info.width != plane_width ||
+            info.height != plane_height) {
+            return -1;
+        }
+        compression_stats plane;
+        size_t plane_size = decompress_plane(compressed_data + offset, size - offset, &info, NULL, fft_real[p],
+                                             fft_imag[p], &plane);
+        if (plane_size == 0) return -1;
+        offset += plane_size;
+        total.coefficients += plane.coefficients;
+        total.zero_coefficients += plane.zero_coefficients;
+        total.decode_seconds += plane.decode_seconds;
+    }
+    total.output_bytes = offset;
+    if (stats) *stats = total;
+    return 0;
+}
+
+// --- Tiled mode ---
+// A real size x size tile has exactly size^2 independent spectrum values:
+// bins in columns 0 and size/2 mirror onto the same columns, and the four
+// self-conjugate bins have no imaginary part. tile_layout lists them from
+// low to high spatial frequency, so that a tile's quantized tail is mostly
+// zeros and an early EOB cuts it off.
+typedef struct {
+    int size;
+    int count;                                         // size^2
+    uint16_t bin[FFT_TILE_MAX * FFT_TILE_MAX];         // Index into the full size x size spectrum
+    uint16_t mirror[FFT_TILE_MAX * FFT_TILE_MAX];      // Index of its conjugate bin
+    uint8_t imag[FFT_TILE_MAX * FFT_TILE_MAX];         // 1 for the imaginary part
+} tile_layout;
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void build_tile_layout(int size, tile_layout *layout) {
+    // Sort key: squared radius with the vertical frequency folded, then
+    // the position, so the order is total and fixed.
+    uint32_t keys[FFT_TILE_MAX * FFT_TILE_MAX];
+    int n = 0, half = size / 2;
+    for (int ky = 0; ky < size; ++ky) {
+        int fy = ky <= half ? ky : size - ky;
+        for (int kx = 0; kx <= half; ++kx) {
+            int edge = kx == 0 || kx == half;
+            if (edge && ky > half) continue; // Mirror of row size - ky
+            uint32_t key = (uint32_t)(fy * fy + kx * kx) << 20 | (uint32_t)fy << 14 | (uint32_t)kx << 8 |
+                           (uint32_t)ky << 1;
+            keys[n++] = key;
+            if (!(edge && (ky == 0 || ky == half))) keys[n++] = key | 1;
+        }
+    }
+    qsort(keys, n, sizeof(keys[0]), compare_u32);
+    layout->size = size;
+    layout->count = n;
+    for (int i = 0; i < n; ++i) {
+        int kx = (keys[i] >> 8) & 0x3F, ky = (keys[i] >> 1) & 0x7F;
+        layout->bin[i] = (uint16_t)(ky * size + kx);
+        layout->mirror[i] = (uint16_t)(((size - ky) % size) * size + (size - kx) % size);
+        layout->imag[i] = (uint8_t)(keys[i] & 1);
+    }
+}
+
+// Copies the tile whose top-left pixel is (x0, y0), repeating the last
+// row and column of the image past its edges.
+static void load_tile(const unsigned char *pixels, int width, int height, int x0, int y0, int size, float *tile) {
+    for (int r = 0; r < size; ++r) {
+        int y = y0 + r < height ? y0 + r : height - 1;
+        const unsigned char *row = pixels + (size_t)y * width;
+        int inside = width - x0 < size ? width - x0 : size;
+        for (int c = 0; c < inside; ++c) {
+            tile[r * size + c] = (float)row[x0 + c];
+        }
+        for (int c = inside; c < size; ++c) {
+            tile[r * size + c] = (float)row[width - 1];
+        }
+    }
+}
+
+// Two real tiles go through one complex FFT as z = a + i b. Their spectra
+// separate as A[k] = (Z[k] + conj Z[-k]) / 2 and B[k] = (Z[k] - conj Z[-k]) / 2i.
+static void quantize_tile_pair(const float *zr, const float *zi, const tile_layout *layout, float inv_q,
+                               int32_t *qa, int32_t *qb) {
+    float h = 0.5f * inv_q;
+    for (int e = 0; e < layout->count; ++e) {
+        int k = layout->bin[e], m = layout->mirror[e];
+        if (layout->imag[e]) {
+            qa[e] = quantize_one((zi[k] - zi[m]) * h);
+            if (qb) qb[e] = quantize_one((zr[m] - zr[k]) * h);
+        } else {
+            qa[e] = quantize_one((zr[k] + zr[m]) * h);
+            if (qb) qb[e] = quantize_one((zi[k] + zi[m]) * h);
+        }
+    }
+}
+
+// The reverse: rebuilds Z = A + i B over the full tile from the values
+// of a and (if not NULL) b.
+static void dequantize_tile_pair(const int32_t *qa, const int32_t *qb, const tile_layout *layout, float step,
+                                 float *zr, float *zi) {
+    int size = layout->size;
+    memset(zr, 0, (size_t)size * size * sizeof(float));
+    memset(zi, 0, (size_t)size * size * sizeof(float));
+    for (int e = 0; e < layout->count; ++e) {
+        int k = layout->bin[e], m = layout->mirror[e];
+        if (qa[e]) {
+            float v = (float)qa[e] * step;
+            if (layout->imag[e]) {
+                zi[k] += v;
+                zi[m] -= v;
+            } else {
+                zr[k] += v;
+                if (m != k) zr[m] += v;
+            }
+        }
+        if (qb && qb[e]) {
+            float v = (float)qb[e] * step;
+            if (layout->imag[e]) {
+                zr[k] -= v;
+                zr[m] += v;
+            } else {
+                zi[k] += v;
+                if (m != k) zi[m] += v;
+            }
+        }
+    }
+}
+
+size_t simple_compress_tiled_bound(int width, int height, int tile_size) {
+    if (width < 1 || height < 1 || !valid_tile_size(tile_size)) return 0;
+    size_t tiles_x = (size_t)(width + tile_size - 1) / tile_size;
+    size_t tiles_y = (size_t)(height + tile_size - 1) / tile_size;
+    size_t count = tiles_x * tiles_y * tile_size * tile_size;
+    // As for the full mode, plus the row index and one byte of padding
+    // per tile row.
+    return COMPRESSION_HEADER_SIZE + 256 + 5 * tiles_y + 7 * count + 8;
+}
+
+size_t simple_compress_tiled_scratch_size(int width, int height, int tile_size) {
+    if (width < 1 || height < 1 || !valid_tile_size(tile_size)) return 0;
+    size_t tiles_x = (size_t)(width + tile_size - 1) / tile_size;
+    size_t tiles_y = (size_t)(height + tile_size - 1) / tile_size;
+    return tiles_x * tiles_y * tile_size * tile_size * sizeof(int32_t);
+}
+
+size_t simple_compress_tiled(const unsigned char *pixels, int width, int height, int tile_size,
+                             float quantization_factor, unsigned char *compressed_data, void *scratch,
+                             compression_stats *stats) {
+    if (width < 1 || height < 1 || !valid_tile_size(tile_size) || !(quantization_factor > 0.0f)) {
+        return 0;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    tile_layout layout;
+    build_tile_layout(tile_size, &layout);
+    int tiles_x = (width + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+    size_t per_tile = (size_t)layout.count;
+    float inv_q = 1.0f / quantization_step(quantization_factor, tile_size, tile_size);
+
+    // Transform and quantize every tile, two at a time, counting symbol
+    // frequencies as we go.
+    int32_t *q = (int32_t*)scratch;
+    float zr[FFT_TILE_MAX * FFT_TILE_MAX], zi[FFT_TILE_MAX * FFT_TILE_MAX];
+    uint32_t freq[256] = {0};
+    size_t zero_count = 0;
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        for (int tx = 0; tx < tiles_x; tx += 2) {
+            int pair = tx + 1 < tiles_x;
+            int32_t *qa = q + ((size_t)ty * tiles_x + tx) * per_tile;
+            load_tile(pixels, width, height, tx * tile_size, ty * tile_size, tile_size, zr);
+            if (pair) {
+                load_tile(pixels, width, height, (tx + 1) * tile_size, ty * tile_size, tile_size, zi);
+            } else {
+                memset(zi, 0, per_tile * sizeof(float));
+            }
+            fft_tile_2d(zr, zi, tile_size, FFT_FORWARD);
+            quantize_tile_pair(zr, zi, &layout, inv_q, qa, pair ? qa + per_tile : NULL);
+            for (int t = 0; t <= pair; ++t) {
+                zero_count += code_coefficients(qa + t * per_tile, per_tile, NULL, NULL, freq, NULL);
+            }
+        }
+    }
+    huffman_table table;
+    build_huffman(freq, &table);
+
+    unsigned char *p = compressed_data;
+    memcpy(p, COMPRESSION_MAGIC, 4);
+    p[4] = COMPRESSION_VERSION;
+    p[5] = COMPRESSION_MODE_TILED;
+    p[6] = (unsigned char)tile_size;
+    p[7] = 0;
+    put_u32(p + 8, (uint32_t)width);
+    put_u32(p + 12, (uint32_t)height);
+    uint32_t qbits;
+    memcpy(&qbits, &quantization_factor, sizeof(qbits));
+    put_u32(p + 16, qbits);
+    memcpy(p + 24, table.counts, HUFFMAN_MAX_LEN);
+    memcpy(p + COMPRESSION_HEADER_SIZE, table.symbols, table.num_symbols);
+
+    // Each tile row starts on a byte boundary at an indexed offset.
+    unsigned char *index = p + COMPRESSION_HEADER_SIZE + table.num_symbols;
+    size_t payload_offset = (size_t)(index - p) + 4 * (size_t)tiles_y;
+    bit_writer bw = { compressed_data + payload_offset, 0, 0, 0, SIZE_MAX, NULL, NULL, 0, 0 };
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        put_u32(index + 4 * ty, (uint32_t)bw.pos);
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            code_coefficients(q + ((size_t)ty * tiles_x + tx) * per_tile, per_tile, &table, &bw, NULL, NULL);
+        }
+        flush_bits(&bw);
+    }
+    put_u32(p + 20, (uint32_t)bw.pos);
+
+    size_t compressed_size = payload_offset + bw.pos;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats) {
+        stats->coefficients = (size_t)tiles_x * tiles_y * per_tile;
+        stats->zero_coefficients = zero_count;
+        stats->output_bytes = compressed_size;
+        stats->encode_seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+        stats->quantize_seconds = 0.0;
+        stats->decode_seconds = 0.0;
+    }
+    return compressed_size;
+}
+
+// Decodes one tile's values into q (zeroed first), or skips them if q is
+// NULL. Returns the number of nonzero values, -1 if corrupt.
+static int decode_tile(const huffman_decoder *decoder, bit_reader *br, int32_t *q, int count) {
+    if (q) memset(q, 0, (size_t)count * sizeof(int32_t));
+    int i = 0, nonzero = 0;
+    while (i < count) {
+        int run, v;
+        int status = decode_value(decoder, br, &run, &v);
+        if (status < 0) return -1;
+        if (status > 0) break;
+        i += run;
+        if (v == 0) continue;
+        if (i >= count) return -1;
+        if (q) q[i] = v;
+        i++;
+        nonzero++;
+    }
+    return i > count ? -1 : nonzero;
+}
+
+// Inverse-transforms a decoded pair (tile tx and, if qb, tile tx + 1 of
+// row ty) and writes the part inside the region to out.
+static void store_tile_pair(const int32_t *qa, const int32_t *qb, const tile_layout *layout, float step, int tx,
+                            int ty, int x, int y, int region_width, int region_height, unsigned char *out) {
+    int size = layout->size;
+    float zr[FFT_TILE_MAX * FFT_TILE_MAX], zi[FFT_TILE_MAX * FFT_TILE_MAX];
+    dequantize_tile_pair(qa, qb, layout, step, zr, zi);
+    fft_tile_2d(zr, zi, size, FFT_INVERSE);
+
+    for (int t = 0; t <= (qb != NULL); ++t) {
+        const float *tile = t ? zi : zr;
+        int x0 = (tx + t) * size, y0 = ty * size;
+        int c0 = x > x0 ? x - x0 : 0, c1 = x + region_width - x0 < size ? x + region_width - x0 : size;
+        int r0 = y > y0 ? y - y0 : 0, r1 = y + region_height - y0 < size ? y + region_height - y0 : size;
+        if (c1 <= c0) continue; // A partner outside the region
+        for (int r = r0; r < r1; ++r) {
+            simple_decompress_pixels(tile + r * size + c0, out + (size_t)(y0 + r - y) * region_width + (x0 + c0 - x),
+                                     (size_t)(c1 - c0));
+        }
+    }
+}
+
+int simple_decompress_region(const unsigned char *compressed_data, size_t size, int x, int y, int region_width,
+                             int region_height, unsigned char *pixels, compression_stats *stats) {
+    compression_info info;
+    if (simple_decompress_info(compressed_data, size, &info) != 0 || info.mode != COMPRESSION_MODE_TILED ||
+        x < 0 || y < 0 || region_width < 1 || region_height < 1 || x > info.width - region_width ||
+        y > info.height - region_height) {
+        return -1;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int tile_size = info.tile_size;
+    int tiles_x = (info.width + tile_size - 1) / tile_size;
+    int tiles_y = (info.height + tile_size - 1) / tile_size;
+    huffman_decoder decoder;
+    size_t index_offset = read_huffman_tables(compressed_data, size, &decoder);
+    size_t payload_offset = index_offset + 4 * (size_t)tiles_y;
+    if (index_offset == 0 || payload_offset > size) {
+        return -1;
+    }
+    const unsigned char *index = compressed_data + index_offset;
+    const unsigned char *payload = compressed_data + payload_offset;
+    size_t payload_size = get_u32(compressed_data + 20);
+    if (payload_size > size - payload_offset) {
+        return -1;
+    }
+
+    tile_layout layout;
+    build_tile_layout(tile_size, &layout);
+    float step = quantization_step(info.quantization_factor, tile_size, tile_size);
+    int32_t q[2][FFT_TILE_MAX * FFT_TILE_MAX];
+    // Tiles are transformed in the encoder's pairs, (even, odd), so a
+    // region decodes to exactly the same pixels as the whole image. The
+    // partner of an edge tile costs no extra FFT.
+    int tx_first = (x / tile_size) & ~1, tx_last = (x + region_width - 1) / tile_size | 1;
+    if (tx_last >= tiles_x) tx_last = tiles_x - 1;
+    int ty_first = y / tile_size, ty_last = (y + region_height - 1) / tile_size;
+    size_t tiles = 0, nonzero = 0;
+
+    // Only the tile rows the region touches are read; within a row, the
+    // tiles left of it are decoded but not transformed.
+    for (int ty = ty_first; ty <= ty_last; ++ty) {
+        size_t row_begin = get_u32(index + 4 * ty);
+        size_t row_end = ty + 1 < tiles_y ? get_u32(index + 4 * (ty + 1)) : payload_size;
+        if (row_begin > row_end || row_end > payload_size) {
+            return -1;
+        }
+        bit_reader br = { payload + row_begin, 0, row_end - row_begin, 0, 0 };
+        int pending = 0;
+        for (int tx = 0; tx <= tx_last; ++tx) {
+            int wanted = tx >= tx_first;
+            int n = decode_tile(&decoder, &br, wanted ? q[pending] : NULL, layout.count);
+            if (n < 0) return -1;
+            if (!wanted) continue;
+            nonzero += (size_t)n;
+            tiles++;
+            if (++pending == 2 || tx == tx_last) {
+                store_tile_pair(q[0], pending == 2 ? q[1] : NULL, &layout, step, tx - pending + 1, ty, x, y,
+                                region_width, region_height, pixels);
+                pending = 0;
+            }
+        }
+        if (bits_consumed(&br) > (row_end - row_begin) * 8) {
+            return -1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats) {
+        stats->coefficients = tiles * layout.count;
+        stats->zero_coefficients = stats->coefficients - nonzero;
+        stats->output_bytes = payload_offset + payload_size;
+        stats->encode_seconds = 0.0;
+        stats->quantize_seconds = 0.0;
+        stats->decode_seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+    }
+    return 0;
+}
+
+#if defined(__riscv_vector)
+
+void simple_decompress_pixels(const float *in, unsigned char *out, size_t count) {
+    size_t vl;
+    for (size_t i = 0; i < count; i += vl) {
+        vl = __riscv_vsetvl_e32m4(count - i);
+        vint32m4_t v = __riscv_vfcvt_x_f_v_i32m4(__riscv_vle32_v_f32m4(in + i, vl), vl);
+        vuint32m4_t u = __riscv_vreinterpret_v_i32m4_u32m4(__riscv_vmax_vx_i32m4(v, 0, vl));
+        // Two saturating narrows: 32 -> 16 -> 8 bits
+        vuint16m2_t u16 = __riscv_vnclipu_wx_u16m2(u, 0, __RISCV_VXRM_RNU, vl);
+        __riscv_vse8_v_u8m1(out + i, __riscv_vnclipu_wx_u8m1(u16, 0, __RISCV_VXRM_RNU, vl), vl);
+    }
+}
+
+#else
+
+void simple_decompress_pixels(const float *in, unsigned char *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float x = fminf(fmaxf(in[i], 0.0f), 255.0f);
+        out[i] = (unsigned char)lrintf(x);
+    }
+}
+
+#endif
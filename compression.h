@@ -2,8 +2,206 @@
 #define COMPRESSION_H
 
 #include <stddef.h> // For size_t
+#include <stdint.h>
 
-// Simple compression: quantize FFT coefficients and a very basic run-length encoding.
-void simple_compress(float *fft_real, float *fft_imag, int width, int height, unsigned char **compressed_data, size_t *compressed_size);
+#include "image.h" // For IMAGE_COLOR_*
 
-#endif // COMPRESSION_H
\ No newline at end of file
+// --- Compressed stream format ---
+// All multi-byte fields are little-endian.
+//   offset  size  field
+//        0     4  magic "FFTC"
+//        4     1  format version (COMPRESSION_VERSION)
+//        5     1  mode (COMPRESSION_MODE_*)
+//        6     1  tile size (mode TILED), else 0
+//        7     1  color (COMPRESSION_COLOR_*), 0 for grayscale
+//        8     4  image width in pixels
+//       12     4  image height in pixels
+//       16     4  quantization factor (IEEE float)
+//       20     4  payload size in bytes
+//       24    16  Huffman code counts: codes of length 1..16
+//       40     n  Huffman symbols in code order (n = sum of the counts)
+//   40 + n        payload: the Huffman-coded coefficient stream
+//
+// The coefficients are the height x (width/2 + 1) half spectrum of the
+// real-input 2D FFT, row-major, real and imaginary parts interleaved, each
+// divided by the quantization step and rounded to +-(2^30 - 1). The step is
+// the quantization factor times sqrt(width * height), which makes it a
+// step on the orthonormal transform: a factor means the same quality at
+// every image size.
+// As in JPEG, every nonzero value is coded as a symbol (run << 4) | size,
+// where run < 16 is the number of zeros before it and size the bit length
+// of |value|, followed by size raw bits: value itself if positive, else
+// value + 2^size - 1. Sizes of 15 and more, which the low frequencies of
+// large images need, are coded as 15 followed by 4 bits of size - 15.
+// Symbol 0xF0 stands for 16 zeros, and symbol 0x00 ends the stream early
+// when only zeros remain. Codes are canonical and written MSB first; the
+// payload is padded to a byte with 1 bits.
+//
+// Mode TILED cuts the image into T x T tiles (T = 8, 16 or 32), padding
+// the last row and column of tiles by repeating the image edge, and codes
+// every tile on its own with the shared Huffman table. A tile's 2D FFT has
+// exactly T*T independent values (the rest follow by Hermitian symmetry);
+// they are quantized as above, with a step of the factor times T, and
+// coded in order of increasing spatial frequency, each tile ending with
+// symbol 0x00 unless its last value is nonzero. The symbol list is
+// followed by one u32 per row of tiles: the byte offset of that row in the
+// payload. Rows start on a byte boundary and tiles follow left to right,
+// so any region can be decoded by reading only the rows it covers.
+//
+// A color stream holds one full-mode stream per plane, back to back: Y,
+// Cb, then Cr, each with its own header (the plane's width and height)
+// and Huffman table, and the color byte set in every header. Y has the
+// size of the image; Cb and Cr have it too (4:4:4) or are halved in both
+// directions, rounding up (4:2:0). See image.h for the conversion.
+//
+// Mode DELTA is laid out like mode FULL (gray only), but its values are
+// the differences from the quantized values of the previous frame of a
+// sequence, which starts with a full-mode key frame. Decoding one takes
+// the previous frame's values (simple_decompress_frame).
+#define COMPRESSION_MAGIC "FFTC"
+#define COMPRESSION_VERSION 3
+#define COMPRESSION_MODE_FULL 0  // One 2D FFT over the whole image
+#define COMPRESSION_MODE_TILED 1 // Independent tiles, see above
+#define COMPRESSION_MODE_DELTA 2 // Difference from the previous frame
+#define COMPRESSION_COLOR_GRAY IMAGE_COLOR_GRAY         // One plane
+#define COMPRESSION_COLOR_YCBCR444 IMAGE_COLOR_YCBCR444 // Y, Cb, Cr at full resolution
+#define COMPRESSION_COLOR_YCBCR420 IMAGE_COLOR_YCBCR420 // Cb, Cr at half resolution both ways
+#define COMPRESSION_MAX_PLANES 3
+#define COMPRESSION_HEADER_SIZE 40
+#define COMPRESSION_DEFAULT_QUANTIZATION 12.5f
+
+// Optional per-call figures for logging and benchmarks, filled in by
+// both simple_compress and simple_decompress (summed over the planes of
+// color streams)
+typedef struct {
+    size_t coefficients;      // Quantized values (2 per spectrum bin)
+    size_t zero_coefficients; // Of which quantized to 0
+    size_t output_bytes;      // Size of the compressed stream
+    double encode_seconds;    // Quantization and entropy coding
+    double quantize_seconds;  // Of which quantization (full mode only, else 0)
+    double decode_seconds;    // Entropy decoding and dequantization
+} compression_stats;
+
+// Largest stream simple_compress can produce for a width x height image.
+size_t simple_compress_bound(int width, int height);
+// Scratch bytes simple_compress needs for a width x height image.
+size_t simple_compress_scratch_size(int width, int height);
+
+// Quantizes and entropy-codes the height x (width/2 + 1) spectrum of a
+// width x height image (see two_d_fft_r2c). Writes into compressed_data,
+// which must hold simple_compress_bound(width, height) bytes, using the
+// caller's scratch, and returns the compressed size (0 on failure). Does
+// not allocate. stats may be NULL.
+size_t simple_compress(const float *fft_real, const float *fft_imag, int width, int height,
+                       float quantization_factor, unsigned char *compressed_data, void *scratch,
+                       compression_stats *stats);
+
+// --- Streaming ---
+// simple_compress without a stream-sized output buffer. The stream is
+// staged in the caller's chunk of chunk_size bytes (at least
+// COMPRESSION_STREAM_CHUNK_MIN) and handed to sink each time the chunk
+// fills, then once more for the rest, so whatever the sink does (e.g.
+// sending) overlaps the coding of the next chunk. The exact stream size
+// is worked out before the first byte is coded and passed with every
+// piece. The sink returns 0 to go on or -1 to fail the call; pieces after
+// a failure are dropped. Returns the stream size, 0 on failure.
+// encode_seconds includes the time spent in the sink.
+#define COMPRESSION_STREAM_CHUNK_MIN 512
+typedef int (*compression_sink)(void *ctx, const unsigned char *data, size_t size, size_t stream_size);
+size_t simple_compress_stream(const float *fft_real, const float *fft_imag, int width, int height,
+                              float quantization_factor, unsigned char *chunk, size_t chunk_size, void *scratch,
+                              compression_sink sink, void *ctx, compression_stats *stats);
+
+// --- Frame sequences ---
+// Bytes of a frame reference: the quantized values of a width x height
+// frame, then the quantization factor they were quantized with.
+size_t simple_compress_reference_size(int width, int height);
+
+// simple_compress for one frame of a sequence of same-sized frames.
+// reference holds simple_compress_reference_size(width, height) bytes,
+// the previous frame's, and is updated to this frame's. If *key is
+// nonzero, the quantization factor is not the reference's, or a value
+// moved further than the coder can code, the frame is coded as a
+// full-mode key frame; otherwise as a delta-mode frame. *key is set to 1
+// for a key frame, 0 for a delta. Unchanged frames code to a short run of
+// zeros. Returns the stream size, 0 on failure, and then the reference is
+// unchanged.
+size_t simple_compress_frame(const float *fft_real, const float *fft_imag, int width, int height,
+                             float quantization_factor, int32_t *reference, int *key, unsigned char *compressed_data,
+                             void *scratch, compression_stats *stats);
+
+// Tiled mode: like simple_compress, but straight from 8-bit pixels, with no
+// image-sized transform. tile_size is 8, 16 or 32; the bound and scratch
+// size are 0 for any other. Tiles are transformed with fft_tile_2d, two at
+// a time, and never leave the cache.
+size_t simple_compress_tiled_bound(int width, int height, int tile_size);
+size_t simple_compress_tiled_scratch_size(int width, int height, int tile_size);
+size_t simple_compress_tiled(const unsigned char *pixels, int width, int height, int tile_size,
+                             float quantization_factor, unsigned char *compressed_data, void *scratch,
+                             compression_stats *stats);
+
+// --- Color ---
+// Number of planes of a COMPRESSION_COLOR_* format (1 or 3), 0 if unknown.
+int compression_color_planes(int color);
+// Size of plane `plane` of a width x height image in that format.
+void compression_plane_size(int color, int plane, int width, int height, int *plane_width, int *plane_height);
+
+// simple_compress over every plane of a color format, into one color
+// stream. The spectra are those of two_d_fft_r2c on each plane. Scratch
+// is simple_compress_scratch_size(width, height), enough for the largest
+// plane. Returns the stream size, 0 on failure. stats may be NULL.
+size_t simple_compress_color_bound(int width, int height, int color);
+size_t simple_compress_color(const float *const *fft_real, const float *const *fft_imag, int width, int height,
+                             int color, float quantization_factor, unsigned char *compressed_data, void *scratch,
+                             compression_stats *stats);
+
+// --- Decoding ---
+typedef struct {
+    int width;
+    int height;
+    int mode;      // COMPRESSION_MODE_*
+    int tile_size; // 0 unless mode is COMPRESSION_MODE_TILED
+    int color;     // COMPRESSION_COLOR_*; always gray for tiled streams
+    float quantization_factor;
+} compression_info;
+
+// Reads the header at the start of a stream; only the first
+// COMPRESSION_HEADER_SIZE bytes are needed. Returns 0 and fills in info if
+// the header is valid, -1 otherwise.
+int simple_decompress_info(const unsigned char *compressed_data, size_t size, compression_info *info);
+
+// Inverse of simple_compress, up to quantization: decodes a whole
+// full-mode stream into the height x (width/2 + 1) spectrum planes,
+// multiplied back by the quantization step and ready for
+// two_d_ifft_c2r. Returns 0 on success, -1 if the stream is truncated,
+// corrupt, tiled or color. Does not allocate. stats may be NULL.
+int simple_decompress(const unsigned char *compressed_data, size_t size, float *fft_real, float *fft_imag,
+                      compression_stats *stats);
+// simple_decompress for every plane of a color stream, each into the
+// spectrum buffers of its plane (see compression_plane_size). Returns 0
+// on success, -1 if the stream is truncated, corrupt or not color.
+int simple_decompress_color(const unsigned char *compressed_data, size_t size, float *const *fft_real,
+                            float *const *fft_imag, compression_stats *stats);
+// simple_decompress for one frame of a sequence: a key frame or a delta
+// frame of a width x height image, decoded against and into reference
+// (as in simple_compress_frame). Returns 0 on success, -1 if the stream is
+// truncated, corrupt, of another size, neither mode, or a delta frame with
+// another quantization factor than the reference's; the reference is then
+// undefined until the next key frame.
+int simple_decompress_frame(const unsigned char *compressed_data, size_t size, int width, int height,
+                            int32_t *reference, float *fft_real, float *fft_imag, compression_stats *stats);
+
+// Decodes the region_width x region_height pixels at (x, y) of a tiled
+// stream into pixels (row stride region_width). Only the rows of tiles the
+// region covers are read, and only its tiles are transformed. Returns 0 on
+// success, -1 if the region is out of bounds or the stream is not tiled,
+// truncated or corrupt. Does not allocate. stats may be NULL.
+int simple_decompress_region(const unsigned char *compressed_data, size_t size, int x, int y, int region_width,
+                             int region_height, unsigned char *pixels, compression_stats *stats);
+
+// Rounds reconstructed pixels (two_d_ifft_c2r output) to the nearest
+// 8-bit value, clamped to [0, 255]. out may alias in: byte i never
+// overwrites a float past i.
+void simple_decompress_pixels(const float *in, unsigned char *out, size_t count);
+
+#endif // COMPRESSION_H
@@ -1,118 +1,1447 @@
 #include "fft.h"
+#include "fft_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <pthread.h>
 
 // Include RISC-V Vector intrinsics header (specific to your toolchain)
-// This path might vary. You may need to install appropriate RVV development headers.
+// Only available when compiling with the V extension (e.g. -march=rv64gcv).
+// Without it we fall back to the portable scalar kernels below.
+#if defined(__riscv_vector)
 #include <riscv_vector.h>
+#endif
 
-// --- Helper for 1D FFT (conceptual, not a full implementation) ---
-// A real 1D FFT involves complex numbers and butterfly operations.
-// This is a HIGHLY simplified placeholder to demonstrate RVV usage.
-void _1d_fft_rvv(float *input_real, float *input_imag, float *output_real, float *output_imag, int N) {
-    // In a real FFT, you'd have stages of butterfly operations.
-    // Each stage would involve loading, multiplying (complex), adding/subtracting.
+static fft_plan *plan_cache = NULL;
+static fft_real_plan *real_plan_cache = NULL;
+// Guards both caches. Plans are built outside the lock, since building one
+// can fetch other cached plans (Bluestein, real plans).
+static pthread_mutex_t plan_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    // Example of using RVV intrinsics for a simple vector operation:
-    // Let's say we want to scale real part by 0.5.
-    // This is NOT FFT, just demonstrating syntax.
-    size_t vl = vsetvl_e32m1(N); // Set vector length for 32-bit floats, m1 (ratio of 1 vector register to 1 element)
-    
-    // Create a vector of 0.5
-    vfloat32m1_t scale_factor = vfmv_v_f_f32m1(0.5f, vl);
+static _Thread_local float *thread_scratch[FFT_SCRATCH_SLOTS];
+static _Thread_local size_t thread_scratch_size[FFT_SCRATCH_SLOTS];
 
-    for (size_t i = 0; i < N; i += vl) {
-        vl = vsetvl_e32m1(N - i); // Adjust vector length for remaining elements
+// Allocation counters (fft_get_alloc_stats), updated atomically.
+static unsigned long stat_plans_created;
+static unsigned long stat_scratch_allocations;
+static unsigned long stat_scratch_bytes;
 
-        vfloat32m1_t vec_real = vle32_v_f32m1(input_real + i, vl);
-        vfloat32m1_t vec_imag = vle32_v_f32m1(input_imag + i, vl);
+float *fft_thread_scratch(int slot, size_t floats) {
+    if (thread_scratch_size[slot] < floats) {
+        float *grown = (float*)realloc(thread_scratch[slot], floats * sizeof(float));
+        if (!grown) {
+            perror("realloc for FFT scratch");
+            return NULL;
+        }
+        __atomic_add_fetch(&stat_scratch_allocations, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stat_scratch_bytes, (floats - thread_scratch_size[slot]) * sizeof(float),
+                           __ATOMIC_RELAXED);
+        thread_scratch[slot] = grown;
+        thread_scratch_size[slot] = floats;
+    }
+    return thread_scratch[slot];
+}
 
-        // Example: Scale real part
-        vfloat32m1_t scaled_real = vfmul_vv_f32m1(vec_real, scale_factor, vl); // rv.v_fmul.v.f32m1
+void fft_thread_scratch_release(void) {
+    for (int slot = 0; slot < FFT_SCRATCH_SLOTS; ++slot) {
+        __atomic_sub_fetch(&stat_scratch_bytes, thread_scratch_size[slot] * sizeof(float), __ATOMIC_RELAXED);
+        free(thread_scratch[slot]);
+        thread_scratch[slot] = NULL;
+        thread_scratch_size[slot] = 0;
+    }
+}
 
-        // In a real FFT, you'd do complex multiplications (a+bi)*(c+di) = (ac-bd) + (ad+bc)i
-        // This involves multiple vector instructions: vfmul, vfadd, vfsub.
+void fft_get_alloc_stats(fft_alloc_stats *stats) {
+    stats->plans_created = __atomic_load_n(&stat_plans_created, __ATOMIC_RELAXED);
+    stats->scratch_allocations = __atomic_load_n(&stat_scratch_allocations, __ATOMIC_RELAXED);
+    stats->scratch_bytes = __atomic_load_n(&stat_scratch_bytes, __ATOMIC_RELAXED);
+}
 
-        vse32_v_f32m1(output_real + i, scaled_real, vl); // Store
-        vse32_v_f32m1(output_imag + i, vec_imag, vl); // Store original imag for demo
+static int is_power_of_two(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static int ilog2(int n) {
+    int log2n = 0;
+    while ((1 << log2n) < n) {
+        log2n++;
     }
+    return log2n;
+}
 
-    // A real 1D FFT would involve bit-reversal permutation and multiple passes (log2(N) passes)
-    // with butterfly operations. This would be hundreds of lines of RVV code.
-    // Example: For a single butterfly (complex `a` and `b`, twiddle `w`):
-    // a' = a + w*b
-    // b' = a - w*b
-    // This involves complex multiplication and addition/subtraction, all vectorized.
+// Each twiddle is computed directly from its angle (no w *= wlen
+// recurrence), so the error does not grow with N.
+static void compute_twiddles(fft_plan *plan) {
+    double sign = plan->direction == FFT_INVERSE ? 1.0 : -1.0;
+    for (int half = 1; half < plan->n; half <<= 1) {
+        float *wr = plan->tw_real + half - 1;
+        float *wi = plan->tw_imag + half - 1;
+        for (int j = 0; j < half; ++j) {
+            double angle = sign * M_PI * (double)j / (double)half;
+            wr[j] = (float)cos(angle);
+            wi[j] = (float)sin(angle);
+        }
+    }
 }
 
-// --- 2D FFT (conceptual) ---
-void two_d_fft(float *input_pixels, float *output_real, float *output_imag, int width, int height) {
-    // Allocate temporary buffers for row-wise FFTs and column-wise FFTs
-    float *temp_real_rows = (float*)malloc(width * height * sizeof(float));
-    float *temp_imag_rows = (float*)malloc(width * height * sizeof(float));
-    if (!temp_real_rows || !temp_imag_rows) {
-        perror("malloc for FFT temp");
-        return; // Handle error appropriately
+static void compute_bit_reverse(fft_plan *plan) {
+#if defined(__riscv_vector)
+    const uint32_t unit = (uint32_t)sizeof(float);
+#else
+    const uint32_t unit = 1;
+#endif
+    plan->swap_count = 0;
+    for (int i = 0; i < plan->n; ++i) {
+        uint32_t r = 0;
+        for (int b = 0; b < plan->log2n; ++b) {
+            r |= (uint32_t)((i >> b) & 1) << (plan->log2n - 1 - b);
+        }
+        plan->bitrev[i] = r * unit;
+        if ((uint32_t)i < r) {
+            plan->swap_a[plan->swap_count] = (uint32_t)i * unit;
+            plan->swap_b[plan->swap_count] = r * unit;
+            plan->swap_count++;
+        }
     }
+}
 
-    // Perform 1D FFT on each row
-    for (int r = 0; r < height; ++r) {
-        // Extract row data for 1D FFT
-        float *row_input_real = (float*)malloc(width * sizeof(float));
-        float *row_input_imag = (float*)calloc(width, sizeof(float)); // Imaginary part is 0 for initial real image
-        
-        if (!row_input_real || !row_input_imag) {
-            perror("malloc for row FFT");
-            // Free previously allocated memory and return
-            free(temp_real_rows); free(temp_imag_rows);
-            return;
+#if defined(__riscv_vector)
+
+// --- RVV kernels ---
+
+// out[i] = in[rev[i]], strip-mined with an indexed gather.
+static void bit_reverse_copy(const float *in_real, const float *in_imag, float *out_real, float *out_imag,
+                             const uint32_t *rev, int N) {
+    size_t vl;
+    for (size_t i = 0; i < (size_t)N; i += vl) {
+        vl = __riscv_vsetvl_e32m1(N - i);
+        vuint32m1_t idx = __riscv_vle32_v_u32m1(rev + i, vl);
+        vfloat32m1_t vr = __riscv_vluxei32_v_f32m1(in_real, idx, vl);
+        vfloat32m1_t vi = __riscv_vluxei32_v_f32m1(in_imag, idx, vl);
+        __riscv_vse32_v_f32m1(out_real + i, vr, vl);
+        __riscv_vse32_v_f32m1(out_imag + i, vi, vl);
+    }
+}
+
+// In-place bit reversal: the swap pairs are disjoint, so one chunk can be
+// gathered and scattered back crosswise without conflicts.
+static void bit_reverse_inplace(float *re, float *im, const uint32_t *swap_a, const uint32_t *swap_b, int count) {
+    size_t vl;
+    for (size_t i = 0; i < (size_t)count; i += vl) {
+        vl = __riscv_vsetvl_e32m1(count - i);
+        vuint32m1_t ia = __riscv_vle32_v_u32m1(swap_a + i, vl);
+        vuint32m1_t ib = __riscv_vle32_v_u32m1(swap_b + i, vl);
+        vfloat32m1_t ar = __riscv_vluxei32_v_f32m1(re, ia, vl);
+        vfloat32m1_t br = __riscv_vluxei32_v_f32m1(re, ib, vl);
+        vfloat32m1_t ai = __riscv_vluxei32_v_f32m1(im, ia, vl);
+        vfloat32m1_t bi = __riscv_vluxei32_v_f32m1(im, ib, vl);
+        __riscv_vsuxei32_v_f32m1(re, ia, br, vl);
+        __riscv_vsuxei32_v_f32m1(re, ib, ar, vl);
+        __riscv_vsuxei32_v_f32m1(im, ia, bi, vl);
+        __riscv_vsuxei32_v_f32m1(im, ib, ai, vl);
+    }
+}
+
+// Butterflies [j0, j1) of every block of one radix-2 DIT stage with span
+// `half`; tw_real/tw_imag point at that stage's twiddles. Long runs
+// vectorize along the butterflies of one block (unit stride); short ones
+// vectorize across blocks (constant stride 2*half) so short early stages
+// still fill the vector register.
+static void butterfly_stage(float *re, float *im, const float *tw_real, const float *tw_imag, int N, int half,
+                            int j0, int j1) {
+    int len = half << 1;
+    size_t vlmax = __riscv_vsetvlmax_e32m1();
+    size_t vl;
+
+    if ((size_t)(j1 - j0) >= vlmax) {
+        for (int i = 0; i < N; i += len) {
+            for (size_t j = j0; j < (size_t)j1; j += vl) {
+                vl = __riscv_vsetvl_e32m1(j1 - j);
+                vfloat32m1_t wr = __riscv_vle32_v_f32m1(tw_real + j, vl);
+                vfloat32m1_t wi = __riscv_vle32_v_f32m1(tw_imag + j, vl);
+
+                float *a_re = re + i + j, *a_im = im + i + j;
+                float *b_re = a_re + half, *b_im = a_im + half;
+                vfloat32m1_t ar = __riscv_vle32_v_f32m1(a_re, vl);
+                vfloat32m1_t ai = __riscv_vle32_v_f32m1(a_im, vl);
+                vfloat32m1_t br = __riscv_vle32_v_f32m1(b_re, vl);
+                vfloat32m1_t bi = __riscv_vle32_v_f32m1(b_im, vl);
+
+                // t = w * b = (br*wr - bi*wi) + i(br*wi + bi*wr)
+                vfloat32m1_t tr = __riscv_vfmul_vv_f32m1(br, wr, vl);
+                tr = __riscv_vfnmsac_vv_f32m1(tr, bi, wi, vl);
+                vfloat32m1_t ti = __riscv_vfmul_vv_f32m1(br, wi, vl);
+                ti = __riscv_vfmacc_vv_f32m1(ti, bi, wr, vl);
+
+                __riscv_vse32_v_f32m1(a_re, __riscv_vfadd_vv_f32m1(ar, tr, vl), vl);
+                __riscv_vse32_v_f32m1(a_im, __riscv_vfadd_vv_f32m1(ai, ti, vl), vl);
+                __riscv_vse32_v_f32m1(b_re, __riscv_vfsub_vv_f32m1(ar, tr, vl), vl);
+                __riscv_vse32_v_f32m1(b_im, __riscv_vfsub_vv_f32m1(ai, ti, vl), vl);
+            }
+        }
+    } else {
+        int blocks = N / len;
+        ptrdiff_t stride = (ptrdiff_t)len * (ptrdiff_t)sizeof(float);
+        for (int j = j0; j < j1; ++j) {
+            float wr = tw_real[j];
+            float wi = tw_imag[j];
+            for (size_t b = 0; b < (size_t)blocks; b += vl) {
+                vl = __riscv_vsetvl_e32m1(blocks - b);
+                float *a_re = re + b * len + j, *a_im = im + b * len + j;
+                float *b_re = a_re + half, *b_im = a_im + half;
+                vfloat32m1_t ar = __riscv_vlse32_v_f32m1(a_re, stride, vl);
+                vfloat32m1_t ai = __riscv_vlse32_v_f32m1(a_im, stride, vl);
+                vfloat32m1_t br = __riscv_vlse32_v_f32m1(b_re, stride, vl);
+                vfloat32m1_t bi = __riscv_vlse32_v_f32m1(b_im, stride, vl);
+
+                vfloat32m1_t tr = __riscv_vfmul_vf_f32m1(br, wr, vl);
+                tr = __riscv_vfnmsac_vf_f32m1(tr, wi, bi, vl);
+                vfloat32m1_t ti = __riscv_vfmul_vf_f32m1(br, wi, vl);
+                ti = __riscv_vfmacc_vf_f32m1(ti, wr, bi, vl);
+
+                __riscv_vsse32_v_f32m1(a_re, stride, __riscv_vfadd_vv_f32m1(ar, tr, vl), vl);
+                __riscv_vsse32_v_f32m1(a_im, stride, __riscv_vfadd_vv_f32m1(ai, ti, vl), vl);
+                __riscv_vsse32_v_f32m1(b_re, stride, __riscv_vfsub_vv_f32m1(ar, tr, vl), vl);
+                __riscv_vsse32_v_f32m1(b_im, stride, __riscv_vfsub_vv_f32m1(ai, ti, vl), vl);
+            }
+        }
+    }
+}
+
+static void scale(float *re, float *im, int N, float factor) {
+    size_t vl;
+    for (size_t i = 0; i < (size_t)N; i += vl) {
+        vl = __riscv_vsetvl_e32m1(N - i);
+        vfloat32m1_t vr = __riscv_vle32_v_f32m1(re + i, vl);
+        vfloat32m1_t vi = __riscv_vle32_v_f32m1(im + i, vl);
+        __riscv_vse32_v_f32m1(re + i, __riscv_vfmul_vf_f32m1(vr, factor, vl), vl);
+        __riscv_vse32_v_f32m1(im + i, __riscv_vfmul_vf_f32m1(vi, factor, vl), vl);
+    }
+}
+
+#else
+
+// --- Portable scalar kernels ---
+
+static void bit_reverse_copy(const float *in_real, const float *in_imag, float *out_real, float *out_imag,
+                             const uint32_t *rev, int N) {
+    for (int i = 0; i < N; ++i) {
+        out_real[i] = in_real[rev[i]];
+        out_imag[i] = in_imag[rev[i]];
+    }
+}
+
+static void bit_reverse_inplace(float *re, float *im, const uint32_t *swap_a, const uint32_t *swap_b, int count) {
+    for (int i = 0; i < count; ++i) {
+        uint32_t a = swap_a[i], b = swap_b[i];
+        float tr = re[a], ti = im[a];
+        re[a] = re[b];
+        im[a] = im[b];
+        re[b] = tr;
+        im[b] = ti;
+    }
+}
+
+static void butterfly_stage(float *re, float *im, const float *tw_real, const float *tw_imag, int N, int half,
+                            int j0, int j1) {
+    int len = half << 1;
+    for (int i = 0; i < N; i += len) {
+        for (int j = j0; j < j1; ++j) {
+            float wr = tw_real[j];
+            float wi = tw_imag[j];
+            int a = i + j, b = i + j + half;
+            float tr = re[b] * wr - im[b] * wi;
+            float ti = re[b] * wi + im[b] * wr;
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
         }
+    }
+}
+
+static void scale(float *re, float *im, int N, float factor) {
+    for (int i = 0; i < N; ++i) {
+        re[i] *= factor;
+        im[i] *= factor;
+    }
+}
+
+#endif
+
+// --- Plan API ---
 
-        for (int c = 0; c < width; ++c) {
-            row_input_real[c] = input_pixels[r * width + c];
+fft_plan *fft_plan_create(int n, int direction) {
+    if (n < 1) {
+        fprintf(stderr, "fft_plan_create: invalid size N=%d\n", n);
+        return NULL;
+    }
+
+    fft_plan *plan = (fft_plan*)calloc(1, sizeof(fft_plan));
+    if (!plan) {
+        perror("calloc for FFT plan");
+        return NULL;
+    }
+    __atomic_add_fetch(&stat_plans_created, 1, __ATOMIC_RELAXED);
+    plan->n = n;
+    plan->direction = direction;
+    plan->log2n = ilog2(n);
+    if (is_power_of_two(n)) {
+        plan->kind = FFT_KIND_RADIX2;
+    } else if (fft_mixed_supported(n)) {
+        plan->kind = FFT_KIND_MIXED;
+    } else {
+        plan->kind = FFT_KIND_BLUESTEIN;
+    }
+
+    int ok = 1;
+    if (plan->kind != FFT_KIND_BLUESTEIN) {
+        // n - 1 twiddles cover every stage; allocate at least one so
+        // n == 1 plans still hold valid pointers.
+        size_t tw_count = n > 1 ? (size_t)(n - 1) : 1;
+        plan->tw_real = (float*)malloc(tw_count * sizeof(float));
+        plan->tw_imag = (float*)malloc(tw_count * sizeof(float));
+        ok = plan->tw_real && plan->tw_imag;
+    }
+    if (ok && plan->kind == FFT_KIND_RADIX2) {
+        plan->bitrev = (uint32_t*)malloc(n * sizeof(uint32_t));
+        plan->swap_a = (uint32_t*)malloc((n / 2 + 1) * sizeof(uint32_t));
+        plan->swap_b = (uint32_t*)malloc((n / 2 + 1) * sizeof(uint32_t));
+        ok = plan->bitrev && plan->swap_a && plan->swap_b;
+        if (ok) {
+            compute_twiddles(plan);
+            compute_bit_reverse(plan);
         }
+    } else if (ok && plan->kind == FFT_KIND_MIXED) {
+        ok = fft_mixed_init(plan);
+    } else if (ok) {
+        ok = fft_bluestein_init(plan);
+    }
+    if (!ok) {
+        perror("malloc for FFT tables");
+        fft_plan_destroy(plan);
+        return NULL;
+    }
+    return plan;
+}
+
+// Output pruning: when only the outputs k <= window and k >= N - window
+// are wanted, a DIT stage of span `half` only needs the butterflies whose
+// outputs are congruent to one of them mod 2*half, j <= window and
+// j >= half - window. Once 2*window + 1 >= half that is every butterfly,
+// so only the last few stages shrink. window >= N/2 keeps everything.
+static void pruned_range(int half, int window, int *j0, int *j1, int *j2) {
+    if (2 * window + 1 < half) {
+        *j0 = window + 1;
+        *j1 = half - window;
+    } else {
+        *j0 = *j1 = half;
+    }
+    *j2 = half;
+}
+
+static void radix2_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                           float *output_real, float *output_imag, int window) {
+    int N = plan->n;
 
-        // Call the 1D FFT (using RVV for acceleration)
-        _1d_fft_rvv(row_input_real, row_input_imag, temp_real_rows + r * width, temp_imag_rows + r * width, width);
-        
-        free(row_input_real);
-        free(row_input_imag);
+    // Out of place, bit reversal doubles as the copy into the output
+    // buffer; the butterflies then run in place on the output.
+    if (input_real == output_real && input_imag == output_imag) {
+        bit_reverse_inplace(output_real, output_imag, plan->swap_a, plan->swap_b, plan->swap_count);
+    } else {
+        bit_reverse_copy(input_real, input_imag, output_real, output_imag, plan->bitrev, N);
+    }
+    for (int half = 1; half < N; half <<= 1) {
+        const float *tw_real = plan->tw_real + half - 1;
+        const float *tw_imag = plan->tw_imag + half - 1;
+        int j0, j1, j2;
+        pruned_range(half, window, &j0, &j1, &j2);
+        butterfly_stage(output_real, output_imag, tw_real, tw_imag, N, half, 0, j0);
+        if (j1 < j2) butterfly_stage(output_real, output_imag, tw_real, tw_imag, N, half, j1, j2);
     }
 
-    // Perform 1D FFT on each column of the row-wise FFT results
-    for (int c = 0; c < width; ++c) {
-        // Extract column data for 1D FFT
-        float *col_input_real = (float*)malloc(height * sizeof(float));
-        float *col_input_imag = (float*)malloc(height * sizeof(float));
+    if (plan->direction == FFT_INVERSE) {
+        scale(output_real, output_imag, N, 1.0f / (float)N);
+    }
+}
+
+// fft_plan_execute with only the outputs k <= window and k >= n - window
+// guaranteed; the rest may hold partial results. Only radix-2 plans prune.
+static int execute_pruned(const fft_plan *plan, const float *input_real, const float *input_imag,
+                          float *output_real, float *output_imag, int window) {
+    switch (plan->kind) {
+    case FFT_KIND_RADIX2:
+        radix2_execute(plan, input_real, input_imag, output_real, output_imag, window);
+        return 0;
+    case FFT_KIND_MIXED:
+        return fft_mixed_execute(plan, input_real, input_imag, output_real, output_imag, 1, 1, 1);
+    default:
+        return fft_bluestein_execute(plan, input_real, input_imag, output_real, output_imag);
+    }
+}
+
+int fft_plan_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                     float *output_real, float *output_imag) {
+    return execute_pruned(plan, input_real, input_imag, output_real, output_imag, plan->n);
+}
+
+void fft_plan_destroy(fft_plan *plan) {
+    if (!plan) return;
+    free(plan->tw_real);
+    free(plan->tw_imag);
+    free(plan->bitrev);
+    free(plan->swap_a);
+    free(plan->swap_b);
+    free(plan->chirp_real);
+    free(plan->chirp_imag);
+    free(plan->kernel_real);
+    free(plan->kernel_imag);
+    free(plan);
+}
+
+static const fft_plan *plan_cache_find(int n, int direction) {
+    for (fft_plan *p = plan_cache; p; p = p->next) {
+        if (p->n == n && p->direction == direction) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+const fft_plan *fft_plan_get(int n, int direction) {
+    pthread_mutex_lock(&plan_cache_lock);
+    const fft_plan *found = plan_cache_find(n, direction);
+    pthread_mutex_unlock(&plan_cache_lock);
+    if (found) return found;
+
+    fft_plan *plan = fft_plan_create(n, direction);
+    if (!plan) return NULL;
+
+    // Another thread may have built the same plan meanwhile; keep theirs.
+    pthread_mutex_lock(&plan_cache_lock);
+    found = plan_cache_find(n, direction);
+    if (!found) {
+        plan->next = plan_cache;
+        plan_cache = plan;
+        found = plan;
+        plan = NULL;
+    }
+    pthread_mutex_unlock(&plan_cache_lock);
+    fft_plan_destroy(plan);
+    return found;
+}
+
+void fft_plan_cache_clear(void) {
+    pthread_mutex_lock(&plan_cache_lock);
+    // Real plans borrow cached complex plans, so they go first.
+    while (real_plan_cache) {
+        fft_real_plan *next = real_plan_cache->next;
+        fft_real_plan_destroy(real_plan_cache);
+        real_plan_cache = next;
+    }
+    while (plan_cache) {
+        fft_plan *next = plan_cache->next;
+        fft_plan_destroy(plan_cache);
+        plan_cache = next;
+    }
+    pthread_mutex_unlock(&plan_cache_lock);
+}
+
+// --- 1D FFT (forward), using the cached plan for N ---
+int _1d_fft_rvv(const float *input_real, const float *input_imag, float *output_real, float *output_imag, int N) {
+    const fft_plan *plan = fft_plan_get(N, FFT_FORWARD);
+    if (!plan) return -1;
+    return fft_plan_execute(plan, input_real, input_imag, output_real, output_imag);
+}
+
+// --- Batched column FFT ---
+// Transforms `cols` adjacent columns of a row-major matrix at once. Each
+// vector lane holds one column, so every load and store is a unit-stride
+// row segment, and the vector fills up even when the columns are short.
+// Columns are processed in strips so a strip stays cache-resident across
+// all log2(height) stages.
+
+#define COLUMN_STRIP 64
+
+// Plan tables hold byte offsets on RVV and element indices otherwise.
+static inline uint32_t table_index(uint32_t entry) {
+#if defined(__riscv_vector)
+    return entry / (uint32_t)sizeof(float);
+#else
+    return entry;
+#endif
+}
+
+#if defined(__riscv_vector)
+
+static void row_copy(const float *src, float *dst, int cols) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)cols; c += vl) {
+        vl = __riscv_vsetvl_e32m1(cols - c);
+        __riscv_vse32_v_f32m1(dst + c, __riscv_vle32_v_f32m1(src + c, vl), vl);
+    }
+}
+
+static void row_swap(float *a, float *b, int cols) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)cols; c += vl) {
+        vl = __riscv_vsetvl_e32m1(cols - c);
+        vfloat32m1_t va = __riscv_vle32_v_f32m1(a + c, vl);
+        vfloat32m1_t vb = __riscv_vle32_v_f32m1(b + c, vl);
+        __riscv_vse32_v_f32m1(a + c, vb, vl);
+        __riscv_vse32_v_f32m1(b + c, va, vl);
+    }
+}
+
+// (a, b) <- (a + w*b, a - w*b) across `cols` lanes with a scalar twiddle.
+static void row_butterfly(float *a_re, float *a_im, float *b_re, float *b_im, float wr, float wi, int cols) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)cols; c += vl) {
+        vl = __riscv_vsetvl_e32m1(cols - c);
+        vfloat32m1_t ar = __riscv_vle32_v_f32m1(a_re + c, vl);
+        vfloat32m1_t ai = __riscv_vle32_v_f32m1(a_im + c, vl);
+        vfloat32m1_t br = __riscv_vle32_v_f32m1(b_re + c, vl);
+        vfloat32m1_t bi = __riscv_vle32_v_f32m1(b_im + c, vl);
+
+        vfloat32m1_t tr = __riscv_vfmul_vf_f32m1(br, wr, vl);
+        tr = __riscv_vfnmsac_vf_f32m1(tr, wi, bi, vl);
+        vfloat32m1_t ti = __riscv_vfmul_vf_f32m1(br, wi, vl);
+        ti = __riscv_vfmacc_vf_f32m1(ti, wr, bi, vl);
+
+        __riscv_vse32_v_f32m1(a_re + c, __riscv_vfadd_vv_f32m1(ar, tr, vl), vl);
+        __riscv_vse32_v_f32m1(a_im + c, __riscv_vfadd_vv_f32m1(ai, ti, vl), vl);
+        __riscv_vse32_v_f32m1(b_re + c, __riscv_vfsub_vv_f32m1(ar, tr, vl), vl);
+        __riscv_vse32_v_f32m1(b_im + c, __riscv_vfsub_vv_f32m1(ai, ti, vl), vl);
+    }
+}
+
+#else
+
+static void row_copy(const float *src, float *dst, int cols) {
+    memcpy(dst, src, cols * sizeof(float));
+}
+
+static void row_swap(float *a, float *b, int cols) {
+    for (int c = 0; c < cols; ++c) {
+        float t = a[c];
+        a[c] = b[c];
+        b[c] = t;
+    }
+}
+
+static void row_butterfly(float *a_re, float *a_im, float *b_re, float *b_im, float wr, float wi, int cols) {
+    for (int c = 0; c < cols; ++c) {
+        float tr = b_re[c] * wr - b_im[c] * wi;
+        float ti = b_re[c] * wi + b_im[c] * wr;
+        b_re[c] = a_re[c] - tr;
+        b_im[c] = a_im[c] - ti;
+        a_re[c] += tr;
+        a_im[c] += ti;
+    }
+}
+
+#endif
+
+static void columns_strip(const fft_plan *plan, const float *in_real, const float *in_imag,
+                          float *out_real, float *out_imag, size_t stride, int cols, int window) {
+    int N = plan->n;
+
+    // Bit reversal permutes whole row segments.
+    if (in_real == out_real && in_imag == out_imag) {
+        for (int i = 0; i < plan->swap_count; ++i) {
+            size_t a = table_index(plan->swap_a[i]) * stride;
+            size_t b = table_index(plan->swap_b[i]) * stride;
+            row_swap(out_real + a, out_real + b, cols);
+            row_swap(out_imag + a, out_imag + b, cols);
+        }
+    } else {
+        for (int i = 0; i < N; ++i) {
+            size_t src = table_index(plan->bitrev[i]) * stride;
+            row_copy(in_real + src, out_real + i * stride, cols);
+            row_copy(in_imag + src, out_imag + i * stride, cols);
+        }
+    }
+
+    for (int half = 1; half < N; half <<= 1) {
+        const float *tw_real = plan->tw_real + half - 1;
+        const float *tw_imag = plan->tw_imag + half - 1;
+        int j0, j1, j2;
+        pruned_range(half, window, &j0, &j1, &j2);
+        for (int i = 0; i < N; i += 2 * half) {
+            for (int j = 0; j < j2; j = j + 1 == j0 ? j1 : j + 1) { // Skips [j0, j1)
+                size_t a = (size_t)(i + j) * stride;
+                size_t b = a + (size_t)half * stride;
+                row_butterfly(out_real + a, out_imag + a, out_real + b, out_imag + b, tw_real[j], tw_imag[j], cols);
+            }
+        }
+    }
+
+    if (plan->direction == FFT_INVERSE) {
+        for (int i = 0; i < N; ++i) {
+            scale(out_real + i * stride, out_imag + i * stride, cols, 1.0f / (float)N);
+        }
+    }
+}
+
+// fft_plan_execute_columns, pruned like execute_pruned.
+static int execute_columns(const fft_plan *plan, const float *input_real, const float *input_imag,
+                           float *output_real, float *output_imag, int stride, int cols, int window) {
+    if (plan->kind == FFT_KIND_BLUESTEIN) {
+        // No batched Bluestein: gather each column, transform it, scatter.
+        int n = plan->n;
+        float *column = fft_thread_scratch(FFT_SCRATCH_COLUMN, 2 * (size_t)n);
+        if (!column) return -1;
+        for (int c = 0; c < cols; ++c) {
+            for (int r = 0; r < n; ++r) {
+                column[r] = input_real[(size_t)r * stride + c];
+                column[n + r] = input_imag[(size_t)r * stride + c];
+            }
+            if (fft_bluestein_execute(plan, column, column + n, column, column + n) != 0) return -1;
+            for (int r = 0; r < n; ++r) {
+                output_real[(size_t)r * stride + c] = column[r];
+                output_imag[(size_t)r * stride + c] = column[n + r];
+            }
+        }
+        return 0;
+    }
+
+    for (int c0 = 0; c0 < cols; c0 += COLUMN_STRIP) {
+        int width = cols - c0 < COLUMN_STRIP ? cols - c0 : COLUMN_STRIP;
+        if (plan->kind == FFT_KIND_MIXED) {
+            if (fft_mixed_execute(plan, input_real + c0, input_imag + c0, output_real + c0, output_imag + c0,
+                                  (size_t)stride, (size_t)stride, width) != 0) {
+                return -1;
+            }
+        } else {
+            columns_strip(plan, input_real + c0, input_imag + c0, output_real + c0, output_imag + c0,
+                          (size_t)stride, width, window);
+        }
+    }
+    return 0;
+}
+
+int fft_plan_execute_columns(const fft_plan *plan, const float *input_real, const float *input_imag,
+                             float *output_real, float *output_imag, int stride, int cols) {
+    return execute_columns(plan, input_real, input_imag, output_real, output_imag, stride, cols, plan->n);
+}
+
+// --- Real-input transforms ---
+// An n-point real FFT runs as an n/2-point complex FFT on z[k] = x[2k] + i*x[2k+1]
+// followed by a split step that separates the even/odd spectra and applies
+// W_n^k. This halves the flops of a complex FFT with a zero imaginary part.
+
+#if defined(__riscv_vector)
+
+static void deinterleave(const float *x, float *even, float *odd, int m) {
+    ptrdiff_t stride = 2 * (ptrdiff_t)sizeof(float);
+    size_t vl;
+    for (size_t k = 0; k < (size_t)m; k += vl) {
+        vl = __riscv_vsetvl_e32m1(m - k);
+        __riscv_vse32_v_f32m1(even + k, __riscv_vlse32_v_f32m1(x + 2 * k, stride, vl), vl);
+        __riscv_vse32_v_f32m1(odd + k, __riscv_vlse32_v_f32m1(x + 2 * k + 1, stride, vl), vl);
+    }
+}
+
+static void interleave(const float *even, const float *odd, float *x, int m) {
+    ptrdiff_t stride = 2 * (ptrdiff_t)sizeof(float);
+    size_t vl;
+    for (size_t k = 0; k < (size_t)m; k += vl) {
+        vl = __riscv_vsetvl_e32m1(m - k);
+        __riscv_vsse32_v_f32m1(x + 2 * k, stride, __riscv_vle32_v_f32m1(even + k, vl), vl);
+        __riscv_vsse32_v_f32m1(x + 2 * k + 1, stride, __riscv_vle32_v_f32m1(odd + k, vl), vl);
+    }
+}
+
+// Z[0..m) -> X[0..m], in place. Bins k and m-k are produced together; the
+// mirrored operands are read with a negative-stride load.
+static void r2c_split(float *re, float *im, const float *tw_real, const float *tw_imag, int m) {
+    ptrdiff_t back = -(ptrdiff_t)sizeof(float);
+    size_t vl;
+    for (size_t k = 1; k <= (size_t)m / 2; k += vl) {
+        vl = __riscv_vsetvl_e32m1(m / 2 + 1 - k);
+        vfloat32m1_t ar = __riscv_vle32_v_f32m1(re + k, vl);
+        vfloat32m1_t ai = __riscv_vle32_v_f32m1(im + k, vl);
+        vfloat32m1_t br = __riscv_vlse32_v_f32m1(re + m - k, back, vl);
+        vfloat32m1_t bi = __riscv_vlse32_v_f32m1(im + m - k, back, vl);
+        vfloat32m1_t wr = __riscv_vle32_v_f32m1(tw_real + k, vl);
+        vfloat32m1_t wi = __riscv_vle32_v_f32m1(tw_imag + k, vl);
+
+        // E = (a + conj b) / 2, O = (a - conj b) / 2i
+        vfloat32m1_t er = __riscv_vfmul_vf_f32m1(__riscv_vfadd_vv_f32m1(ar, br, vl), 0.5f, vl);
+        vfloat32m1_t ei = __riscv_vfmul_vf_f32m1(__riscv_vfsub_vv_f32m1(ai, bi, vl), 0.5f, vl);
+        vfloat32m1_t or_ = __riscv_vfmul_vf_f32m1(__riscv_vfadd_vv_f32m1(ai, bi, vl), 0.5f, vl);
+        vfloat32m1_t oi = __riscv_vfmul_vf_f32m1(__riscv_vfsub_vv_f32m1(br, ar, vl), 0.5f, vl);
+
+        // t = W * O
+        vfloat32m1_t tr = __riscv_vfmul_vv_f32m1(or_, wr, vl);
+        tr = __riscv_vfnmsac_vv_f32m1(tr, oi, wi, vl);
+        vfloat32m1_t ti = __riscv_vfmul_vv_f32m1(or_, wi, vl);
+        ti = __riscv_vfmacc_vv_f32m1(ti, oi, wr, vl);
+
+        // X[k] = E + t, X[m-k] = conj(E - t)
+        __riscv_vse32_v_f32m1(re + k, __riscv_vfadd_vv_f32m1(er, tr, vl), vl);
+        __riscv_vse32_v_f32m1(im + k, __riscv_vfadd_vv_f32m1(ei, ti, vl), vl);
+        __riscv_vsse32_v_f32m1(re + m - k, back, __riscv_vfsub_vv_f32m1(er, tr, vl), vl);
+        __riscv_vsse32_v_f32m1(im + m - k, back, __riscv_vfsub_vv_f32m1(ti, ei, vl), vl);
+    }
+}
+
+// X[0..m] -> Z[0..m) (the inverse of r2c_split, without the 1/n scale
+// that the inverse half plan applies).
+static void c2r_merge(const float *in_re, const float *in_im, float *z_re, float *z_im,
+                      const float *tw_real, const float *tw_imag, int m) {
+    ptrdiff_t back = -(ptrdiff_t)sizeof(float);
+    size_t vl;
+    for (size_t k = 1; k <= (size_t)m / 2; k += vl) {
+        vl = __riscv_vsetvl_e32m1(m / 2 + 1 - k);
+        vfloat32m1_t ar = __riscv_vle32_v_f32m1(in_re + k, vl);
+        vfloat32m1_t ai = __riscv_vle32_v_f32m1(in_im + k, vl);
+        vfloat32m1_t br = __riscv_vlse32_v_f32m1(in_re + m - k, back, vl);
+        vfloat32m1_t bi = __riscv_vlse32_v_f32m1(in_im + m - k, back, vl);
+        vfloat32m1_t wr = __riscv_vle32_v_f32m1(tw_real + k, vl);
+        vfloat32m1_t wi = __riscv_vle32_v_f32m1(tw_imag + k, vl);
+
+        // E = (a + conj b) / 2, D = (a - conj b) / 2, O = D * conj(W)
+        vfloat32m1_t er = __riscv_vfmul_vf_f32m1(__riscv_vfadd_vv_f32m1(ar, br, vl), 0.5f, vl);
+        vfloat32m1_t ei = __riscv_vfmul_vf_f32m1(__riscv_vfsub_vv_f32m1(ai, bi, vl), 0.5f, vl);
+        vfloat32m1_t dr = __riscv_vfmul_vf_f32m1(__riscv_vfsub_vv_f32m1(ar, br, vl), 0.5f, vl);
+        vfloat32m1_t di = __riscv_vfmul_vf_f32m1(__riscv_vfadd_vv_f32m1(ai, bi, vl), 0.5f, vl);
+        vfloat32m1_t or_ = __riscv_vfmul_vv_f32m1(dr, wr, vl);
+        or_ = __riscv_vfmacc_vv_f32m1(or_, di, wi, vl);
+        vfloat32m1_t oi = __riscv_vfmul_vv_f32m1(di, wr, vl);
+        oi = __riscv_vfnmsac_vv_f32m1(oi, dr, wi, vl);
+
+        // Z[k] = E + iO, Z[m-k] = conj(E) + i conj(O)
+        __riscv_vse32_v_f32m1(z_re + k, __riscv_vfsub_vv_f32m1(er, oi, vl), vl);
+        __riscv_vse32_v_f32m1(z_im + k, __riscv_vfadd_vv_f32m1(ei, or_, vl), vl);
+        __riscv_vsse32_v_f32m1(z_re + m - k, back, __riscv_vfadd_vv_f32m1(er, oi, vl), vl);
+        __riscv_vsse32_v_f32m1(z_im + m - k, back, __riscv_vfsub_vv_f32m1(or_, ei, vl), vl);
+    }
+}
+
+#else
+
+static void deinterleave(const float *x, float *even, float *odd, int m) {
+    for (int k = 0; k < m; ++k) {
+        even[k] = x[2 * k];
+        odd[k] = x[2 * k + 1];
+    }
+}
+
+static void interleave(const float *even, const float *odd, float *x, int m) {
+    for (int k = 0; k < m; ++k) {
+        x[2 * k] = even[k];
+        x[2 * k + 1] = odd[k];
+    }
+}
+
+static void r2c_split(float *re, float *im, const float *tw_real, const float *tw_imag, int m) {
+    for (int k = 1; k <= m / 2; ++k) {
+        float ar = re[k], ai = im[k];
+        float br = re[m - k], bi = im[m - k];
+        float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        float or_ = 0.5f * (ai + bi), oi = 0.5f * (br - ar);
+        float tr = or_ * tw_real[k] - oi * tw_imag[k];
+        float ti = or_ * tw_imag[k] + oi * tw_real[k];
+        re[k] = er + tr;
+        im[k] = ei + ti;
+        re[m - k] = er - tr;
+        im[m - k] = ti - ei;
+    }
+}
 
-        if (!col_input_real || !col_input_imag) {
-            perror("malloc for col FFT");
-            // Free previously allocated memory and return
-            free(temp_real_rows); free(temp_imag_rows);
+static void c2r_merge(const float *in_re, const float *in_im, float *z_re, float *z_im,
+                      const float *tw_real, const float *tw_imag, int m) {
+    for (int k = 1; k <= m / 2; ++k) {
+        float ar = in_re[k], ai = in_im[k];
+        float br = in_re[m - k], bi = in_im[m - k];
+        float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        float dr = 0.5f * (ar - br), di = 0.5f * (ai + bi);
+        float or_ = dr * tw_real[k] + di * tw_imag[k];
+        float oi = di * tw_real[k] - dr * tw_imag[k];
+        z_re[k] = er - oi;
+        z_im[k] = ei + or_;
+        z_re[m - k] = er + oi;
+        z_im[m - k] = or_ - ei;
+    }
+}
+
+#endif
+
+fft_real_plan *fft_real_plan_create(int n) {
+    if (n < 1) {
+        fprintf(stderr, "fft_real_plan_create: invalid size N=%d\n", n);
+        return NULL;
+    }
+
+    fft_real_plan *plan = (fft_real_plan*)calloc(1, sizeof(fft_real_plan));
+    if (!plan) {
+        perror("calloc for real FFT plan");
+        return NULL;
+    }
+    __atomic_add_fetch(&stat_plans_created, 1, __ATOMIC_RELAXED);
+    plan->n = n;
+    if (n % 2 != 0) {
+        // Odd lengths cannot be packed into a half-length complex FFT;
+        // run the full complex transform and keep the non-redundant bins.
+        plan->full_forward = fft_plan_get(n, FFT_FORWARD);
+        plan->full_inverse = fft_plan_get(n, FFT_INVERSE);
+        if (!plan->full_forward || !plan->full_inverse) {
+            fft_real_plan_destroy(plan);
+            return NULL;
+        }
+        return plan;
+    }
+
+    int m = n / 2;
+    plan->half_forward = fft_plan_get(m, FFT_FORWARD);
+    plan->half_inverse = fft_plan_get(m, FFT_INVERSE);
+    plan->tw_real = (float*)malloc(m * sizeof(float));
+    plan->tw_imag = (float*)malloc(m * sizeof(float));
+    if (!plan->half_forward || !plan->half_inverse || !plan->tw_real || !plan->tw_imag) {
+        perror("malloc for real FFT tables");
+        fft_real_plan_destroy(plan);
+        return NULL;
+    }
+    for (int k = 0; k < m; ++k) {
+        double angle = -2.0 * M_PI * (double)k / (double)n;
+        plan->tw_real[k] = (float)cos(angle);
+        plan->tw_imag[k] = (float)sin(angle);
+    }
+    return plan;
+}
+
+void fft_real_plan_destroy(fft_real_plan *plan) {
+    if (!plan) return;
+    free(plan->tw_real);
+    free(plan->tw_imag);
+    free(plan);
+}
+
+static const fft_real_plan *real_plan_cache_find(int n) {
+    for (fft_real_plan *p = real_plan_cache; p; p = p->next) {
+        if (p->n == n) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+const fft_real_plan *fft_real_plan_get(int n) {
+    pthread_mutex_lock(&plan_cache_lock);
+    const fft_real_plan *found = real_plan_cache_find(n);
+    pthread_mutex_unlock(&plan_cache_lock);
+    if (found) return found;
+
+    fft_real_plan *plan = fft_real_plan_create(n);
+    if (!plan) return NULL;
+
+    pthread_mutex_lock(&plan_cache_lock);
+    found = real_plan_cache_find(n);
+    if (!found) {
+        plan->next = real_plan_cache;
+        real_plan_cache = plan;
+        found = plan;
+        plan = NULL;
+    }
+    pthread_mutex_unlock(&plan_cache_lock);
+    fft_real_plan_destroy(plan);
+    return found;
+}
+
+static int r2c_odd(const fft_real_plan *plan, const float *input, float *output_real, float *output_imag) {
+    int n = plan->n;
+    float *work = fft_thread_scratch(FFT_SCRATCH_REAL, 3 * (size_t)n);
+    if (!work) return -1;
+    float *zero = work, *full_re = work + n, *full_im = work + 2 * n;
+    memset(zero, 0, n * sizeof(float));
+    if (fft_plan_execute(plan->full_forward, input, zero, full_re, full_im) != 0) return -1;
+    memcpy(output_real, full_re, (n / 2 + 1) * sizeof(float));
+    memcpy(output_imag, full_im, (n / 2 + 1) * sizeof(float));
+    return 0;
+}
+
+static int c2r_odd(const fft_real_plan *plan, const float *input_real, const float *input_imag, float *output) {
+    int n = plan->n, bins = n / 2 + 1;
+    float *work = fft_thread_scratch(FFT_SCRATCH_REAL, 4 * (size_t)n);
+    if (!work) return -1;
+    float *full_re = work, *full_im = work + n;
+    // Rebuild the full spectrum from X[n-k] = conj(X[k]).
+    for (int k = 0; k < bins; ++k) {
+        full_re[k] = input_real[k];
+        full_im[k] = input_imag[k];
+    }
+    full_im[0] = 0.0f;
+    for (int k = bins; k < n; ++k) {
+        full_re[k] = input_real[n - k];
+        full_im[k] = -input_imag[n - k];
+    }
+    if (fft_plan_execute(plan->full_inverse, full_re, full_im, work + 2 * n, work + 3 * n) != 0) return -1;
+    memcpy(output, work + 2 * n, n * sizeof(float));
+    return 0;
+}
+
+// fft_execute_r2c with only the bins k <= window guaranteed. Bin k needs
+// Z[k] and Z[m-k], which is the same window of the half-length FFT.
+static int execute_r2c(const fft_real_plan *plan, const float *input, float *output_real, float *output_imag,
+                       float *scratch, int window) {
+    if (plan->n % 2 != 0) {
+        return r2c_odd(plan, input, output_real, output_imag);
+    }
+    int m = plan->n / 2;
+
+    // Transform the packed half-length signal straight into the output,
+    // then split it into the n/2 + 1 bins of the real spectrum.
+    deinterleave(input, scratch, scratch + m, m);
+    if (execute_pruned(plan->half_forward, scratch, scratch + m, output_real, output_imag, window) != 0) return -1;
+
+    float z0r = output_real[0], z0i = output_imag[0];
+    output_real[0] = z0r + z0i;
+    output_imag[0] = 0.0f;
+    output_real[m] = z0r - z0i;
+    output_imag[m] = 0.0f;
+    r2c_split(output_real, output_imag, plan->tw_real, plan->tw_imag, m);
+    return 0;
+}
+
+int fft_execute_r2c(const fft_real_plan *plan, const float *input, float *output_real, float *output_imag,
+                    float *scratch) {
+    return execute_r2c(plan, input, output_real, output_imag, scratch, plan->n);
+}
+
+int fft_execute_c2r(const fft_real_plan *plan, const float *input_real, const float *input_imag, float *output,
+                    float *scratch) {
+    if (plan->n % 2 != 0) {
+        return c2r_odd(plan, input_real, input_imag, output);
+    }
+    int m = plan->n / 2;
+
+    // Build Z in the two halves of the output, inverse-transform it into
+    // the scratch buffer, then interleave back as even/odd samples.
+    float *z_re = output, *z_im = output + m;
+    z_re[0] = 0.5f * (input_real[0] + input_real[m]);
+    z_im[0] = 0.5f * (input_real[0] - input_real[m]);
+    c2r_merge(input_real, input_imag, z_re, z_im, plan->tw_real, plan->tw_imag, m);
+
+    if (fft_plan_execute(plan->half_inverse, z_re, z_im, scratch, scratch + m) != 0) return -1;
+    interleave(scratch, scratch + m, output, m);
+    return 0;
+}
+
+// --- 2D FFT: row FFTs followed by column FFTs ---
+// Each transform is a pool task: workers take a band of rows, meet at a
+// barrier, then take a band of columns (whole COLUMN_STRIP strips, so the
+// batched column kernel keeps full-width vectors). A worker whose scratch
+// buffer cannot be allocated skips its share, still meets the others at
+// every barrier, and sets the task's failed flag for the caller to return.
+
+typedef struct {
+    const fft_plan *row_plan;
+    const fft_real_plan *real_row_plan;
+    const fft_plan *col_plan;
+    const float *input;
+    const float *input_real;
+    const float *input_imag;
+    float *output;
+    float *output_real;
+    float *output_imag;
+    float *temp_real; // c2r: column pass results
+    float *temp_imag;
+    int width;
+    int height;
+    int spectrum_width;
+    int row_begin; // Row-only tasks: rows [row_begin, row_end)
+    int row_end;
+    const int *mask; // Pruned r2c: bins kept per row, NULL for all
+    int mask_bins;   // Widest row of the mask
+    int failed;      // Set by any worker that could not do its share
+} two_d_task;
+
+static void task_fail(int *failed) {
+    __atomic_store_n(failed, 1, __ATOMIC_RELAXED);
+}
+
+static void column_range(int cols, int worker, int workers, int *begin, int *end) {
+    int strips = (cols + COLUMN_STRIP - 1) / COLUMN_STRIP;
+    int s0, s1;
+    fft_parallel_range(strips, worker, workers, &s0, &s1);
+    *begin = s0 * COLUMN_STRIP;
+    *end = s1 * COLUMN_STRIP < cols ? s1 * COLUMN_STRIP : cols;
+}
+
+static void two_d_fft_task(void *arg, int worker, int workers) {
+    two_d_task *t = (two_d_task*)arg;
+    int width = t->width;
+    int r0, r1, c0, c1;
+
+    // Imaginary part is 0 for the initial real image
+    float *zero_imag = fft_thread_scratch(FFT_SCRATCH_ROW, width);
+    if (zero_imag) {
+        memset(zero_imag, 0, width * sizeof(float));
+        // Perform 1D FFT on each row, straight into the output planes
+        fft_parallel_range(t->height, worker, workers, &r0, &r1);
+        for (int r = r0; r < r1; ++r) {
+            if (fft_plan_execute(t->row_plan, t->input + (size_t)r * width, zero_imag,
+                                 t->output_real + (size_t)r * width, t->output_imag + (size_t)r * width) != 0) {
+                task_fail(&t->failed);
+                break;
+            }
+        }
+    } else {
+        task_fail(&t->failed);
+    }
+    fft_parallel_barrier(workers);
+
+    // Perform 1D FFT on the columns of the row-wise FFT results, many
+    // columns per vector, in place
+    column_range(width, worker, workers, &c0, &c1);
+    if (c1 > c0 && fft_plan_execute_columns(t->col_plan, t->output_real + c0, t->output_imag + c0,
+                                            t->output_real + c0, t->output_imag + c0, width, c1 - c0) != 0) {
+        task_fail(&t->failed);
+    }
+}
+
+int two_d_fft(float *input_pixels, float *output_real, float *output_imag, int width, int height) {
+    two_d_task task = {0};
+    // Plans are cached, so steady-state calls do no trig or table setup.
+    task.row_plan = fft_plan_get(width, FFT_FORWARD);
+    task.col_plan = fft_plan_get(height, FFT_FORWARD);
+    if (!task.row_plan || !task.col_plan) {
+        return -1;
+    }
+    task.input = input_pixels;
+    task.output_real = output_real;
+    task.output_imag = output_imag;
+    task.width = width;
+    task.height = height;
+    fft_parallel_run(two_d_fft_task, &task, (size_t)width * height);
+    return task.failed ? -1 : 0;
+}
+
+static void r2c_rows(two_d_task *t, int r0, int r1) {
+    int sw = t->spectrum_width;
+    // With a mask the columns read only bins [0, mask_bins) of each row.
+    int window = t->mask ? t->mask_bins - 1 : t->width;
+    if (window < 0 || r1 <= r0) return;
+    // Row scratch (width floats)
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_ROW, t->width);
+    if (!scratch) {
+        task_fail(&t->failed);
+        return;
+    }
+    for (int r = r0; r < r1; ++r) {
+        if (execute_r2c(t->real_row_plan, t->input + (size_t)r * t->width, t->output_real + (size_t)r * sw,
+                        t->output_imag + (size_t)r * sw, scratch, window) != 0) {
+            task_fail(&t->failed);
             return;
         }
+    }
+}
 
-        for (int r = 0; r < height; ++r) {
-            col_input_real[r] = temp_real_rows[r * width + c];
-            col_input_imag[r] = temp_imag_rows[r * width + c];
+// Largest |vertical frequency| kept in column c of the mask. Rows keep a
+// prefix of their bins, so this also covers every column after c.
+static int mask_column_window(const two_d_task *t, int c) {
+    int window = -1;
+    for (int r = 0; r < t->height; ++r) {
+        int f = r <= t->height / 2 ? r : t->height - r;
+        if (t->mask[r] > c && f > window) window = f;
+    }
+    return window;
+}
+
+static void r2c_columns(two_d_task *t, int worker, int workers) {
+    int sw = t->spectrum_width;
+    int c0, c1;
+    if (!t->mask) {
+        // Only the W/2+1 non-redundant columns go through the column pass.
+        column_range(sw, worker, workers, &c0, &c1);
+        if (c1 > c0 && fft_plan_execute_columns(t->col_plan, t->output_real + c0, t->output_imag + c0,
+                                                t->output_real + c0, t->output_imag + c0, sw, c1 - c0) != 0) {
+            task_fail(&t->failed);
+        }
+        return;
+    }
+
+    // Masked: only the columns of the widest row, each strip pruned to the
+    // rows its first column keeps.
+    column_range(t->mask_bins, worker, workers, &c0, &c1);
+    for (int c = c0; c < c1; c += COLUMN_STRIP) {
+        int cols = c1 - c < COLUMN_STRIP ? c1 - c : COLUMN_STRIP;
+        int window = mask_column_window(t, c);
+        if (window < 0) continue;
+        if (execute_columns(t->col_plan, t->output_real + c, t->output_imag + c, t->output_real + c,
+                            t->output_imag + c, sw, cols, window) != 0) {
+            task_fail(&t->failed);
+            return;
         }
+    }
+}
+
+// Clears every bin outside the mask, including what the pruned passes
+// left half computed.
+static void mask_zero(const two_d_task *t, int worker, int workers) {
+    int sw = t->spectrum_width;
+    int r0, r1;
+    fft_parallel_range(t->height, worker, workers, &r0, &r1);
+    for (int r = r0; r < r1; ++r) {
+        size_t keep = (size_t)t->mask[r];
+        memset(t->output_real + (size_t)r * sw + keep, 0, (sw - keep) * sizeof(float));
+        memset(t->output_imag + (size_t)r * sw + keep, 0, (sw - keep) * sizeof(float));
+    }
+}
+
+static void two_d_r2c_task(void *arg, int worker, int workers) {
+    two_d_task *t = (two_d_task*)arg;
+    int r0, r1;
+    fft_parallel_range(t->height, worker, workers, &r0, &r1);
+    r2c_rows(t, r0, r1);
+    fft_parallel_barrier(workers);
+    r2c_columns(t, worker, workers);
+    if (t->mask) {
+        fft_parallel_barrier(workers);
+        mask_zero(t, worker, workers);
+    }
+}
+
+static void two_d_r2c_rows_task(void *arg, int worker, int workers) {
+    two_d_task *t = (two_d_task*)arg;
+    int r0, r1;
+    fft_parallel_range(t->row_end - t->row_begin, worker, workers, &r0, &r1);
+    r2c_rows(t, t->row_begin + r0, t->row_begin + r1);
+}
+
+static void two_d_r2c_columns_task(void *arg, int worker, int workers) {
+    two_d_task *t = (two_d_task*)arg;
+    r2c_columns(t, worker, workers);
+    if (t->mask) {
+        fft_parallel_barrier(workers);
+        mask_zero(t, worker, workers);
+    }
+}
 
-        // Call the 1D FFT (using RVV for acceleration)
-        _1d_fft_rvv(col_input_real, col_input_imag, output_real + c, output_imag + c, height);
-        // Note: Store results in column-major order to `output_real` and `output_imag`
-        // so that `output_real[r*width + c]` gives (r,c) element.
-        // This requires careful indexing:
+static int r2c_task_init(two_d_task *task, const float *input_pixels, float *output_real, float *output_imag,
+                         int width, int height, const int *mask) {
+    memset(task, 0, sizeof(*task));
+    task->real_row_plan = fft_real_plan_get(width);
+    task->col_plan = fft_plan_get(height, FFT_FORWARD);
+    if (!task->real_row_plan || !task->col_plan) {
+        return 0;
+    }
+    task->input = input_pixels;
+    task->output_real = output_real;
+    task->output_imag = output_imag;
+    task->width = width;
+    task->height = height;
+    task->spectrum_width = width / 2 + 1;
+    task->mask = mask;
+    if (mask) {
         for (int r = 0; r < height; ++r) {
-            output_real[r * width + c] = output_real[c + r * width]; // Correct indexing logic for col output
-            output_imag[r * width + c] = output_imag[c + r * width];
+            if (mask[r] > task->mask_bins) task->mask_bins = mask[r];
+        }
+    }
+    return 1;
+}
+
+int two_d_fft_r2c(const float *input_pixels, float *output_real, float *output_imag, int width, int height) {
+    return two_d_fft_r2c_pruned(input_pixels, output_real, output_imag, width, height, NULL);
+}
+
+int two_d_fft_r2c_rows(const float *input_pixels, float *output_real, float *output_imag, int width, int height,
+                       int row_begin, int row_end) {
+    return two_d_fft_r2c_rows_pruned(input_pixels, output_real, output_imag, width, height, row_begin, row_end,
+                                     NULL);
+}
+
+int two_d_fft_r2c_columns(float *output_real, float *output_imag, int width, int height) {
+    return two_d_fft_r2c_columns_pruned(output_real, output_imag, width, height, NULL);
+}
+
+// --- Pruned transforms ---
+
+int fft_mask_lowpass(int *mask, int width, int height, int shape, float cutoff) {
+    if (width < 1 || height < 1 || !(cutoff > 0.0f && cutoff <= 1.0f) ||
+        (shape != FFT_MASK_RECTANGLE && shape != FFT_MASK_ELLIPSE)) {
+        return -1;
+    }
+    int sw = width / 2 + 1;
+    double rx = cutoff * (width / 2.0), ry = cutoff * (height / 2.0);
+    for (int r = 0; r < height; ++r) {
+        int f = r <= height / 2 ? r : height - r;
+        double kx = -1.0;
+        if (f <= ry) {
+            kx = shape == FFT_MASK_RECTANGLE || f == 0 ? rx : rx * sqrt(1.0 - (f / ry) * (f / ry));
+        }
+        int bins = (int)floor(kx) + 1;
+        mask[r] = bins < sw ? bins : sw;
+    }
+    return 0;
+}
+
+size_t fft_mask_count(const int *mask, int height) {
+    size_t count = 0;
+    for (int r = 0; r < height; ++r) {
+        count += (size_t)mask[r];
+    }
+    return count;
+}
+
+int two_d_fft_r2c_pruned(const float *input_pixels, float *output_real, float *output_imag, int width, int height,
+                         const int *mask) {
+    two_d_task task;
+    if (!r2c_task_init(&task, input_pixels, output_real, output_imag, width, height, mask)) {
+        return -1;
+    }
+    fft_parallel_run(two_d_r2c_task, &task, (size_t)width * height);
+    return task.failed ? -1 : 0;
+}
+
+int two_d_fft_r2c_rows_pruned(const float *input_pixels, float *output_real, float *output_imag, int width,
+                              int height, int row_begin, int row_end, const int *mask) {
+    if (row_end <= row_begin) return 0;
+    two_d_task task;
+    if (!r2c_task_init(&task, input_pixels, output_real, output_imag, width, height, mask)) {
+        return -1;
+    }
+    task.row_begin = row_begin;
+    task.row_end = row_end;
+    fft_parallel_run(two_d_r2c_rows_task, &task, (size_t)width * (row_end - row_begin));
+    return task.failed ? -1 : 0;
+}
+
+int two_d_fft_r2c_columns_pruned(float *output_real, float *output_imag, int width, int height, const int *mask) {
+    two_d_task task;
+    if (!r2c_task_init(&task, NULL, output_real, output_imag, width, height, mask)) {
+        return -1;
+    }
+    fft_parallel_run(two_d_r2c_columns_task, &task, (size_t)width * height);
+    return task.failed ? -1 : 0;
+}
+
+static void two_d_c2r_task(void *arg, int worker, int workers) {
+    two_d_task *t = (two_d_task*)arg;
+    int sw = t->spectrum_width;
+    int r0, r1, c0, c1;
+
+    column_range(sw, worker, workers, &c0, &c1);
+    if (c1 > c0 && fft_plan_execute_columns(t->col_plan, t->input_real + c0, t->input_imag + c0,
+                                            t->temp_real + c0, t->temp_imag + c0, sw, c1 - c0) != 0) {
+        task_fail(&t->failed);
+    }
+    fft_parallel_barrier(workers);
+
+    fft_parallel_range(t->height, worker, workers, &r0, &r1);
+    if (r1 <= r0) return;
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_ROW, t->width);
+    if (!scratch) {
+        task_fail(&t->failed);
+        return;
+    }
+    for (int r = r0; r < r1; ++r) {
+        if (fft_execute_c2r(t->real_row_plan, t->temp_real + (size_t)r * sw, t->temp_imag + (size_t)r * sw,
+                            t->output + (size_t)r * t->width, scratch) != 0) {
+            task_fail(&t->failed);
+            return;
         }
+    }
+}
+
+int two_d_ifft_c2r(const float *input_real, const float *input_imag, float *output_pixels, int width, int height) {
+    two_d_task task = {0};
+    task.real_row_plan = fft_real_plan_get(width);
+    task.col_plan = fft_plan_get(height, FFT_INVERSE);
+    if (!task.real_row_plan || !task.col_plan) {
+        return -1;
+    }
+    task.spectrum_width = width / 2 + 1;
 
-        free(col_input_real);
-        free(col_input_imag);
+    // Inverse column results (height x spectrum_width complex), in the
+    // calling thread's scratch; the pool workers only borrow it.
+    size_t plane = (size_t)height * task.spectrum_width;
+    float *temp = fft_thread_scratch(FFT_SCRATCH_PLANE, 2 * plane);
+    if (!temp) {
+        return -1;
     }
+    task.input_real = input_real;
+    task.input_imag = input_imag;
+    task.output = output_pixels;
+    task.temp_real = temp;
+    task.temp_imag = temp + plane;
+    task.width = width;
+    task.height = height;
+    fft_parallel_run(two_d_c2r_task, &task, (size_t)width * height);
+    return task.failed ? -1 : 0;
+}
+
+// --- Batched planes ---
+// One pool task for every plane: workers split the rows of all planes as
+// one list, meet at a barrier, then split the column strips of all planes
+// the same way, so small chroma planes do not each pay for a pool start
+// and a barrier of their own.
 
-    free(temp_real_rows);
-    free(temp_imag_rows);
-}
\ No newline at end of file
+typedef struct {
+    const fft_plane *planes;
+    int count;
+    const fft_real_plan *row_plans[FFT_MAX_PLANES];
+    const fft_plan *col_plans[FFT_MAX_PLANES];
+    float *temp[FFT_MAX_PLANES]; // c2r: column pass results, real then imaginary
+    int max_width;
+    int total_rows;
+    int total_strips;
+    int failed; // As in two_d_task
+} planes_task;
+
+static int plane_strips(const fft_plane *p) {
+    return (p->width / 2 + 1 + COLUMN_STRIP - 1) / COLUMN_STRIP;
+}
+
+static int planes_task_init(planes_task *task, const fft_plane *planes, int count, int direction) {
+    memset(task, 0, sizeof(*task));
+    if (count < 1 || count > FFT_MAX_PLANES) {
+        return 0;
+    }
+    task->planes = planes;
+    task->count = count;
+    for (int i = 0; i < count; ++i) {
+        task->row_plans[i] = fft_real_plan_get(planes[i].width);
+        task->col_plans[i] = fft_plan_get(planes[i].height, direction);
+        if (!task->row_plans[i] || !task->col_plans[i]) {
+            return 0;
+        }
+        if (planes[i].width > task->max_width) task->max_width = planes[i].width;
+        task->total_rows += planes[i].height;
+        task->total_strips += plane_strips(&planes[i]);
+    }
+    return 1;
+}
+
+static size_t planes_points(const fft_plane *planes, int count) {
+    size_t points = 0;
+    for (int i = 0; i < count; ++i) {
+        points += (size_t)planes[i].width * planes[i].height;
+    }
+    return points;
+}
+
+// This worker's share of the rows of every plane: plane i gets rows
+// [*begin, *end) of its own.
+static void planes_row_range(const planes_task *t, int worker, int workers, int i, int *begin, int *end) {
+    int g0, g1, offset = 0;
+    fft_parallel_range(t->total_rows, worker, workers, &g0, &g1);
+    for (int j = 0; j < i; ++j) {
+        offset += t->planes[j].height;
+    }
+    int h = t->planes[i].height;
+    *begin = g0 - offset < 0 ? 0 : g0 - offset > h ? h : g0 - offset;
+    *end = g1 - offset < 0 ? 0 : g1 - offset > h ? h : g1 - offset;
+}
+
+// The same for the spectrum columns, in whole strips.
+static void planes_column_range(const planes_task *t, int worker, int workers, int i, int *begin, int *end) {
+    int s0, s1, offset = 0;
+    fft_parallel_range(t->total_strips, worker, workers, &s0, &s1);
+    for (int j = 0; j < i; ++j) {
+        offset += plane_strips(&t->planes[j]);
+    }
+    int strips = plane_strips(&t->planes[i]), sw = t->planes[i].width / 2 + 1;
+    s0 = s0 - offset < 0 ? 0 : s0 - offset > strips ? strips : s0 - offset;
+    s1 = s1 - offset < 0 ? 0 : s1 - offset > strips ? strips : s1 - offset;
+    *begin = s0 * COLUMN_STRIP;
+    *end = s1 * COLUMN_STRIP < sw ? s1 * COLUMN_STRIP : sw;
+}
+
+static void planes_r2c_task(void *arg, int worker, int workers) {
+    planes_task *t = (planes_task*)arg;
+    int r0, r1, c0, c1;
+
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_ROW, t->max_width);
+    if (!scratch) task_fail(&t->failed);
+    for (int i = 0; i < t->count && scratch; ++i) {
+        const fft_plane *p = &t->planes[i];
+        int sw = p->width / 2 + 1;
+        planes_row_range(t, worker, workers, i, &r0, &r1);
+        for (int r = r0; r < r1; ++r) {
+            if (fft_execute_r2c(t->row_plans[i], p->pixels + (size_t)r * p->width, p->real + (size_t)r * sw,
+                                p->imag + (size_t)r * sw, scratch) != 0) {
+                task_fail(&t->failed);
+                break;
+            }
+        }
+    }
+    fft_parallel_barrier(workers);
+
+    for (int i = 0; i < t->count; ++i) {
+        const fft_plane *p = &t->planes[i];
+        int sw = p->width / 2 + 1;
+        planes_column_range(t, worker, workers, i, &c0, &c1);
+        if (c1 > c0 && fft_plan_execute_columns(t->col_plans[i], p->real + c0, p->imag + c0, p->real + c0,
+                                                p->imag + c0, sw, c1 - c0) != 0) {
+            task_fail(&t->failed);
+        }
+    }
+}
+
+int two_d_fft_r2c_planes(const fft_plane *planes, int count) {
+    planes_task task;
+    if (!planes_task_init(&task, planes, count, FFT_FORWARD)) {
+        return -1;
+    }
+    fft_parallel_run(planes_r2c_task, &task, planes_points(planes, count));
+    return task.failed ? -1 : 0;
+}
+
+static void planes_c2r_task(void *arg, int worker, int workers) {
+    planes_task *t = (planes_task*)arg;
+    int r0, r1, c0, c1;
+
+    for (int i = 0; i < t->count; ++i) {
+        const fft_plane *p = &t->planes[i];
+        int sw = p->width / 2 + 1;
+        size_t plane = (size_t)p->height * sw;
+        planes_column_range(t, worker, workers, i, &c0, &c1);
+        if (c1 > c0 && fft_plan_execute_columns(t->col_plans[i], p->real + c0, p->imag + c0, t->temp[i] + c0,
+                                                t->temp[i] + plane + c0, sw, c1 - c0) != 0) {
+            task_fail(&t->failed);
+        }
+    }
+    fft_parallel_barrier(workers);
+
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_ROW, t->max_width);
+    if (!scratch) task_fail(&t->failed);
+    for (int i = 0; i < t->count && scratch; ++i) {
+        const fft_plane *p = &t->planes[i];
+        int sw = p->width / 2 + 1;
+        size_t plane = (size_t)p->height * sw;
+        planes_row_range(t, worker, workers, i, &r0, &r1);
+        for (int r = r0; r < r1; ++r) {
+            if (fft_execute_c2r(t->row_plans[i], t->temp[i] + (size_t)r * sw, t->temp[i] + plane + (size_t)r * sw,
+                                p->pixels + (size_t)r * p->width, scratch) != 0) {
+                task_fail(&t->failed);
+                break;
+            }
+        }
+    }
+}
+
+int two_d_ifft_c2r_planes(const fft_plane *planes, int count) {
+    planes_task task;
+    if (!planes_task_init(&task, planes, count, FFT_INVERSE)) {
+        return -1;
+    }
+    // Column results of every plane, in the calling thread's scratch.
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += 2 * (size_t)planes[i].height * (planes[i].width / 2 + 1);
+    }
+    float *temp = fft_thread_scratch(FFT_SCRATCH_PLANE, total);
+    if (!temp) {
+        return -1;
+    }
+    for (int i = 0; i < count; ++i) {
+        task.temp[i] = temp;
+        temp += 2 * (size_t)planes[i].height * (planes[i].width / 2 + 1);
+    }
+    fft_parallel_run(planes_c2r_task, &task, planes_points(planes, count));
+    return task.failed ? -1 : 0;
+}
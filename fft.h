@@ -1,6 +1,176 @@
 #ifndef FFT_H
 #define FFT_H
 
-void two_d_fft(float *input_pixels, float *output_real, float *output_imag, int width, int height);
+#include <stddef.h> // For size_t
 
-#endif // FFT_H
\ No newline at end of file
+#define FFT_FORWARD 0
+#define FFT_INVERSE 1 // Normalized by 1/N, like version-2's fft_1d
+
+// --- FFT plans ---
+// A plan precomputes the twiddle and index tables for one size and
+// direction. Transforms are complex, on split real/imaginary arrays, for any
+// N >= 1: powers of two use the radix-2 kernels, sizes of the form
+// 2^a 3^b 5^c 7^d use mixed-radix stages and other sizes use Bluestein's
+// algorithm. Input and output may be the same arrays (in-place transform)
+// but must not otherwise overlap. Non-power-of-two plans use per-thread
+// scratch buffers that are kept for reuse. Every function that executes a
+// transform returns 0, or -1 if a scratch buffer could not be allocated
+// (or, for the functions that look up their own plans, a plan could not be
+// created); the output is then incomplete.
+typedef struct fft_plan fft_plan;
+
+fft_plan *fft_plan_create(int n, int direction);
+int fft_plan_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                      float *output_real, float *output_imag);
+void fft_plan_destroy(fft_plan *plan);
+
+// Transforms `cols` adjacent columns (each plan->n long) of a row-major
+// matrix with a row stride of `stride` floats, many columns per vector.
+// In place when input and output are the same arrays.
+int fft_plan_execute_columns(const fft_plan *plan, const float *input_real, const float *input_imag,
+                             float *output_real, float *output_imag, int stride, int cols);
+
+// Shared plan for (n, direction), created on first use and kept for the
+// lifetime of the process. Do not destroy the returned plan.
+const fft_plan *fft_plan_get(int n, int direction);
+// Destroys every cached plan, complex and real.
+void fft_plan_cache_clear(void);
+
+// --- Real-input plans ---
+// n-point real <-> complex transforms, any n >= 1. The complex side holds
+// only the n/2 + 1 non-redundant bins; the rest follow from Hermitian
+// symmetry X[n-k] = conj(X[k]). Even n runs an n/2-point complex FFT; odd n
+// falls back to a full n-point one.
+typedef struct fft_real_plan fft_real_plan;
+
+fft_real_plan *fft_real_plan_create(int n);
+void fft_real_plan_destroy(fft_real_plan *plan);
+// Shared real plan for n, kept for the lifetime of the process.
+const fft_real_plan *fft_real_plan_get(int n);
+
+// Forward, unnormalized. scratch must hold n floats.
+int fft_execute_r2c(const fft_real_plan *plan, const float *input, float *output_real, float *output_imag,
+                    float *scratch);
+// Inverse of fft_execute_r2c (normalized by 1/n). scratch must hold n floats.
+int fft_execute_c2r(const fft_real_plan *plan, const float *input_real, const float *input_imag, float *output,
+                    float *scratch);
+
+// --- Threads ---
+// The 2D transforms split their row and column passes across a persistent
+// worker pool. The default thread count is $FFT_THREADS, or the number of
+// online CPUs; small images always run on the calling thread. Plans and
+// the plan caches are safe to use from several threads at once.
+// Returns 0 on success, -1 if threads is out of range.
+int fft_set_threads(int threads);
+int fft_get_threads(void);
+
+// --- Allocation counters ---
+// Every heap allocation the library makes after warm-up is a plan being
+// built or a per-thread scratch buffer growing; a steady workload should
+// leave these counts unchanged.
+typedef struct {
+    unsigned long plans_created;       // Complex and real plans, cached or not
+    unsigned long scratch_allocations; // Scratch buffer (re)allocations, all threads
+    unsigned long scratch_bytes;       // Scratch currently held, all threads
+} fft_alloc_stats;
+
+void fft_get_alloc_stats(fft_alloc_stats *stats);
+
+// Complex 1D FFT (forward, unnormalized) using the cached plan for N.
+// Uses RVV intrinsics when built with the V extension, scalar code otherwise.
+int _1d_fft_rvv(const float *input_real, const float *input_imag, float *output_real, float *output_imag, int N);
+
+int two_d_fft(float *input_pixels, float *output_real, float *output_imag, int width, int height);
+
+// Real-input 2D FFT. Output planes are height x (width/2 + 1), row-major.
+int two_d_fft_r2c(const float *input_pixels, float *output_real, float *output_imag, int width, int height);
+// two_d_fft_r2c in two steps, for input that arrives a row at a time:
+// transform rows [row_begin, row_end) once they are in place (any order,
+// each row once), then run the column pass when every row is done.
+int two_d_fft_r2c_rows(const float *input_pixels, float *output_real, float *output_imag, int width, int height,
+                       int row_begin, int row_end);
+int two_d_fft_r2c_columns(float *output_real, float *output_imag, int width, int height);
+// Inverse of two_d_fft_r2c: height x (width/2 + 1) spectrum -> width x height pixels.
+int two_d_ifft_c2r(const float *input_real, const float *input_imag, float *output_pixels, int width, int height);
+
+// --- Batched planes ---
+// The real-input 2D transforms of up to FFT_MAX_PLANES planes (the
+// channels of one image, possibly of different sizes) in one pool run:
+// the row passes of all planes split across the workers, then the column
+// passes, with every plan shared by the planes of its size.
+#define FFT_MAX_PLANES 4
+
+typedef struct {
+    int width;
+    int height;
+    float *pixels; // width x height: input of r2c (not modified), output of c2r
+    float *real;   // height x (width/2 + 1) spectrum: output of r2c, input of c2r
+    float *imag;
+} fft_plane;
+
+// two_d_fft_r2c on every plane.
+int two_d_fft_r2c_planes(const fft_plane *planes, int count);
+// two_d_ifft_c2r on every plane; the spectra are not modified.
+int two_d_ifft_c2r_planes(const fft_plane *planes, int count);
+
+// --- Pruned transforms ---
+// A mask keeps part of the height x (width/2 + 1) half spectrum of
+// two_d_fft_r2c: mask[ky], in [0, width/2 + 1], is the number of bins kept
+// in row ky, always the lowest ones (kx < mask[ky]). Row ky holds vertical
+// frequency ky, or ky - height past height/2. Low-pass shapes all keep a
+// prefix of every row, and the prefix lets the column pass drop whole
+// columns.
+#define FFT_MASK_RECTANGLE 0 // |fx| <= cutoff * width/2 and |fy| <= cutoff * height/2
+#define FFT_MASK_ELLIPSE 1   // Inside the ellipse with those semi-axes
+
+// Fills mask (height entries) with a low-pass shape, cutoff in (0, 1].
+// Returns 0, or -1 for a bad size, shape or cutoff.
+int fft_mask_lowpass(int *mask, int width, int height, int shape, float cutoff);
+// Number of bins the mask keeps.
+size_t fft_mask_count(const int *mask, int height);
+
+// two_d_fft_r2c computing only the bins of mask; the rest come out 0. The
+// column pass stops at the widest row of the mask, and on power-of-two
+// sizes the butterflies that feed only dropped bins are skipped: each row
+// computes just the bins the columns read, each column strip just the
+// rows it keeps. A NULL mask keeps everything. The _rows/_columns pair
+// splits it like two_d_fft_r2c_rows/_columns, with the same mask for both.
+int two_d_fft_r2c_pruned(const float *input_pixels, float *output_real, float *output_imag, int width, int height,
+                         const int *mask);
+int two_d_fft_r2c_rows_pruned(const float *input_pixels, float *output_real, float *output_imag, int width,
+                              int height, int row_begin, int row_end, const int *mask);
+int two_d_fft_r2c_columns_pruned(float *output_real, float *output_imag, int width, int height, const int *mask);
+
+// --- Frame sessions ---
+// two_d_fft_r2c over a sequence of same-size frames, for video where most
+// rows repeat from one frame to the next. The session keeps the last frame,
+// the row pass of every row and the last spectrum, compares each row of a
+// new frame with the last one and redoes the row pass only for rows whose
+// bytes differ. When few rows changed, the spectrum is updated by
+// linearity: the column DFT of the row deltas is added directly, with no
+// column pass. Otherwise the column pass reruns over the stored rows. A
+// session is not thread-safe, but each call still uses the worker pool.
+typedef struct fft_session fft_session;
+
+// NULL if width or height is below 1 or allocation failed.
+fft_session *fft_session_create(int width, int height);
+// Bytes a session of that size allocates, for memory budgets; 0 if width
+// or height is below 1.
+size_t fft_session_size(int width, int height);
+void fft_session_destroy(fft_session *session);
+// Transforms the next width x height frame of 8-bit pixels. *real and
+// *imag point to the session's height x (width/2 + 1) spectrum, valid
+// until the next call. Returns the number of rows recomputed (all of them
+// on the first frame; 0 if the spectrum did not change), or -1 if the
+// transform failed, in which case the next frame is transformed in full.
+int fft_session_frame(fft_session *session, const unsigned char *pixels, const float **real, const float **imag);
+
+// --- Tile transforms ---
+// Complex 2D FFT of one size x size tile (size 8, 16 or 32), split
+// real/imaginary, row-major, in place. Each size has its own fully
+// unrolled kernel: no plans, no scratch, no allocation. FFT_INVERSE is
+// normalized by 1/size^2. Returns 0, or -1 for an unsupported size.
+#define FFT_TILE_MAX 32
+int fft_tile_2d(float *re, float *im, int size, int direction);
+
+#endif // FFT_H
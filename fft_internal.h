@@ -0,0 +1,107 @@
+#ifndef FFT_INTERNAL_H
+#define FFT_INTERNAL_H
+
+// Plan layout shared by fft.c and fft_mixed.c. Not part of the public API.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fft.h"
+
+#define FFT_MAX_STAGES 32
+
+// How a plan computes its transform, chosen from n at plan creation.
+enum {
+    FFT_KIND_RADIX2,    // n = 2^k: bit reversal + radix-2 butterflies (RVV)
+    FFT_KIND_MIXED,     // n = 2^a 3^b 5^c 7^d: Stockham stages of radix 2/3/4/5/7
+    FFT_KIND_BLUESTEIN  // any other n: chirp-z convolution via power-of-two FFTs
+};
+
+struct fft_plan {
+    int n;
+    int direction;
+    int kind;
+    int log2n;
+    // Twiddles. Radix-2: the stage with butterfly span h uses W_{2h}^j
+    // (conjugated for inverse plans), j < h, stored at offset h - 1.
+    // Mixed radix: see fft_mixed.c. Both layouts need n - 1 entries.
+    float *tw_real;
+    float *tw_imag;
+    // Bit-reversed index table (byte offsets on RVV for vluxei32).
+    uint32_t *bitrev;
+    // Index pairs (i, rev(i)) with i < rev(i), for in-place execution.
+    uint32_t *swap_a;
+    uint32_t *swap_b;
+    int swap_count;
+    // Mixed radix: radix of each Stockham stage, first stage first.
+    int num_stages;
+    int radices[FFT_MAX_STAGES];
+    // Bluestein: n-point chirp, and the FFT of the conjugate chirp
+    // wrapped to the power-of-two convolution length conv_n.
+    int conv_n;
+    const fft_plan *conv_forward; // cached conv_n-point plans
+    const fft_plan *conv_inverse;
+    float *chirp_real;
+    float *chirp_imag;
+    float *kernel_real;
+    float *kernel_imag;
+    struct fft_plan *next; // plan cache chain
+};
+
+// Real-input plan: see "Real-input transforms" in fft.c.
+struct fft_real_plan {
+    int n;
+    const fft_plan *half_forward; // cached n/2-point plans (even n)
+    const fft_plan *half_inverse;
+    const fft_plan *full_forward; // cached n-point plans (odd n)
+    const fft_plan *full_inverse;
+    float *tw_real;               // W_n^k = exp(-2*pi*i*k/n), k < n/2
+    float *tw_imag;
+    struct fft_real_plan *next;   // plan cache chain
+};
+
+// Per-thread scratch buffers, grown on demand and reused across calls.
+// Each nesting level of the transforms uses its own slot.
+enum {
+    FFT_SCRATCH_PLAN,   // mixed-radix ping-pong and Bluestein convolution
+    FFT_SCRATCH_COLUMN, // Bluestein column gather
+    FFT_SCRATCH_REAL,   // odd-length real transforms
+    FFT_SCRATCH_ROW,    // 2D row pass: zero imaginary row, r2c/c2r scratch
+    FFT_SCRATCH_PLANE,  // c2r: column pass results, shared by the pool task
+    FFT_SCRATCH_SLOTS
+};
+float *fft_thread_scratch(int slot, size_t floats);
+// Frees the calling thread's scratch buffers (pool threads call this on exit).
+void fft_thread_scratch_release(void);
+
+// --- Worker pool (fft_threads.c) ---
+// Transforms smaller than this many points run on the calling thread.
+#define FFT_PARALLEL_MIN_POINTS (128 * 128)
+
+// A task runs once on each of `workers` threads, `worker` in [0, workers).
+typedef void (*fft_task_fn)(void *arg, int worker, int workers);
+// Runs fn on the pool and returns when every worker has finished.
+void fft_parallel_run(fft_task_fn fn, void *arg, size_t points);
+// Waits until every worker of the running task reaches the barrier.
+void fft_parallel_barrier(int workers);
+// This worker's share [begin, end) of total items.
+void fft_parallel_range(int total, int worker, int workers, int *begin, int *end);
+
+// Returns 1 if n factors into 2, 3, 5 and 7 only.
+int fft_mixed_supported(int n);
+// Fill in the kind-specific tables; return 0 on failure.
+int fft_mixed_init(fft_plan *plan);
+int fft_bluestein_init(fft_plan *plan);
+
+// Mixed radix on elements that are `lanes` floats wide, element k of the
+// input at offset k * in_stride and of the output at k * out_stride.
+// 1D transforms use lanes = 1 and unit strides. Returns 0, or -1 if the
+// scratch buffer could not be allocated.
+int fft_mixed_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                      float *output_real, float *output_imag, size_t in_stride, size_t out_stride, int lanes);
+// Contiguous 1D Bluestein transform; input may equal output. Returns 0,
+// or -1 if the scratch buffer could not be allocated.
+int fft_bluestein_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                          float *output_real, float *output_imag);
+
+#endif // FFT_INTERNAL_H
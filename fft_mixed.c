@@ -0,0 +1,335 @@
+#include "fft_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// --- Mixed-radix FFT (Stockham autosort) ---
+// n is split into radix 4, 2, 3, 5 and 7 stages. Stage t sees sub-length
+// n_t = n / (r_0 * ... * r_{t-1}) and stride s_t = n / n_t, and with
+// m = n_t / r computes, for p < m and q < s_t,
+//     a_k = x[q + s*(p + k*m)],  k < r
+//     y[q + s*(r*p + j)] = DFT_r(a)_j * w_p^j,  w_p = exp(-+2*pi*i*p/n_t)
+// ping-ponging between two buffers. The output comes out in natural order,
+// so there is no digit-reversal pass and the twiddles for stage t live at
+// a running offset as tw[p*(r-1) + j-1]; they total n - 1 entries.
+
+// cos / sin of 2*pi*t/r for the odd radices.
+static const float cos5[5] = { 1.0f, 0.309016994374947f, -0.809016994374947f, -0.809016994374947f, 0.309016994374947f };
+static const float sin5[5] = { 0.0f, 0.951056516295154f, 0.587785252292473f, -0.587785252292473f, -0.951056516295154f };
+static const float cos7[7] = { 1.0f, 0.623489801858734f, -0.222520933956314f, -0.900968867902419f,
+                               -0.900968867902419f, -0.222520933956314f, 0.623489801858734f };
+static const float sin7[7] = { 0.0f, 0.781831482468030f, 0.974927912181824f, 0.433883739117558f,
+                               -0.433883739117558f, -0.974927912181824f, -0.781831482468030f };
+
+int fft_mixed_supported(int n) {
+    if (n < 1) return 0;
+    static const int primes[] = { 2, 3, 5, 7 };
+    for (int i = 0; i < 4; ++i) {
+        while (n % primes[i] == 0) {
+            n /= primes[i];
+        }
+    }
+    return n == 1;
+}
+
+int fft_mixed_init(fft_plan *plan) {
+    int n = plan->n;
+    double sign = plan->direction == FFT_INVERSE ? 1.0 : -1.0;
+
+    // Radix 4 first (fewest stages and trivial internal twiddles), then
+    // whatever is left.
+    static const int radix_order[] = { 4, 2, 3, 5, 7 };
+    int rest = n;
+    plan->num_stages = 0;
+    for (int i = 0; i < 5; ++i) {
+        while (rest % radix_order[i] == 0 && plan->num_stages < FFT_MAX_STAGES) {
+            plan->radices[plan->num_stages++] = radix_order[i];
+            rest /= radix_order[i];
+        }
+    }
+    if (rest != 1) return 0;
+
+    float *wr = plan->tw_real, *wi = plan->tw_imag;
+    int n_cur = n;
+    for (int t = 0; t < plan->num_stages; ++t) {
+        int r = plan->radices[t];
+        int m = n_cur / r;
+        for (int p = 0; p < m; ++p) {
+            for (int j = 1; j < r; ++j) {
+                double angle = sign * 2.0 * M_PI * (double)p * (double)j / (double)n_cur;
+                *wr++ = (float)cos(angle);
+                *wi++ = (float)sin(angle);
+            }
+        }
+        n_cur = m;
+    }
+    return 1;
+}
+
+// --- Small DFT kernels: b = DFT_r(a); sign is -1 forward, +1 inverse ---
+
+static inline void dft2(const float *ar, const float *ai, float *br, float *bi, float sign) {
+    (void)sign;
+    br[0] = ar[0] + ar[1]; bi[0] = ai[0] + ai[1];
+    br[1] = ar[0] - ar[1]; bi[1] = ai[0] - ai[1];
+}
+
+static inline void dft3(const float *ar, const float *ai, float *br, float *bi, float sign) {
+    const float s3 = 0.866025403784439f; // sin(2*pi/3)
+    float tr = ar[1] + ar[2], ti = ai[1] + ai[2];
+    float mr = ar[0] - 0.5f * tr, mi = ai[0] - 0.5f * ti;
+    // i * sign * sin(2*pi/3) * (a1 - a2)
+    float dr = -sign * s3 * (ai[1] - ai[2]);
+    float di = sign * s3 * (ar[1] - ar[2]);
+    br[0] = ar[0] + tr; bi[0] = ai[0] + ti;
+    br[1] = mr + dr;    bi[1] = mi + di;
+    br[2] = mr - dr;    bi[2] = mi - di;
+}
+
+static inline void dft4(const float *ar, const float *ai, float *br, float *bi, float sign) {
+    float s0r = ar[0] + ar[2], s0i = ai[0] + ai[2];
+    float d0r = ar[0] - ar[2], d0i = ai[0] - ai[2];
+    float s1r = ar[1] + ar[3], s1i = ai[1] + ai[3];
+    float d1r = ar[1] - ar[3], d1i = ai[1] - ai[3];
+    // w4 * d1 with w4 = sign * i
+    float er = -sign * d1i, ei = sign * d1r;
+    br[0] = s0r + s1r; bi[0] = s0i + s1i;
+    br[1] = d0r + er;  bi[1] = d0i + ei;
+    br[2] = s0r - s1r; bi[2] = s0i - s1i;
+    br[3] = d0r - er;  bi[3] = d0i - ei;
+}
+
+// Odd radix r: pairs a_k, a_{r-k} share the cosine and mirror the sine term.
+static inline void dft_odd(const float *ar, const float *ai, float *br, float *bi, float sign,
+                           int r, const float *ct, const float *st) {
+    float sum_r = ar[0], sum_i = ai[0];
+    for (int k = 1; k < r; ++k) {
+        sum_r += ar[k];
+        sum_i += ai[k];
+    }
+    br[0] = sum_r;
+    bi[0] = sum_i;
+
+    for (int j = 1; j <= r / 2; ++j) {
+        float cr = ar[0], ci = ai[0], sr = 0.0f, si = 0.0f;
+        for (int k = 1; k <= r / 2; ++k) {
+            int t = (j * k) % r;
+            cr += ct[t] * (ar[k] + ar[r - k]);
+            ci += ct[t] * (ai[k] + ai[r - k]);
+            sr += st[t] * (ar[k] - ar[r - k]);
+            si += st[t] * (ai[k] - ai[r - k]);
+        }
+        // b_j = c + i*sign*s, b_{r-j} = c - i*sign*s
+        br[j] = cr - sign * si;     bi[j] = ci + sign * sr;
+        br[r - j] = cr + sign * si; bi[r - j] = ci - sign * sr;
+    }
+}
+
+static inline void dft5(const float *ar, const float *ai, float *br, float *bi, float sign) {
+    dft_odd(ar, ai, br, bi, sign, 5, cos5, sin5);
+}
+
+static inline void dft7(const float *ar, const float *ai, float *br, float *bi, float sign) {
+    dft_odd(ar, ai, br, bi, sign, 7, cos7, sin7);
+}
+
+// One Stockham stage, instantiated per radix so the small DFT inlines.
+#define STOCKHAM_STAGE(R, KERNEL)                                                           \
+    for (int p = 0; p < m; ++p) {                                                           \
+        const float *wr = tw_real + p * (R - 1), *wi = tw_imag + p * (R - 1);               \
+        for (int q = 0; q < s; ++q) {                                                       \
+            for (int l = 0; l < lanes; ++l) {                                               \
+                float ar[R], ai[R], br[R], bi[R];                                           \
+                for (int k = 0; k < R; ++k) {                                               \
+                    size_t idx = (size_t)(q + s * (p + k * m)) * xs + l;                    \
+                    ar[k] = xr[idx];                                                        \
+                    ai[k] = xi[idx];                                                        \
+                }                                                                           \
+                KERNEL(ar, ai, br, bi, sign);                                               \
+                size_t out0 = (size_t)(q + s * R * p) * ys + l;                             \
+                yr[out0] = br[0];                                                           \
+                yi[out0] = bi[0];                                                           \
+                for (int j = 1; j < R; ++j) {                                               \
+                    size_t idx = (size_t)(q + s * (R * p + j)) * ys + l;                    \
+                    yr[idx] = br[j] * wr[j - 1] - bi[j] * wi[j - 1];                        \
+                    yi[idx] = br[j] * wi[j - 1] + bi[j] * wr[j - 1];                        \
+                }                                                                           \
+            }                                                                               \
+        }                                                                                   \
+    }
+
+static void stockham_stage(const float *xr, const float *xi, size_t xs, float *yr, float *yi, size_t ys,
+                           int n_cur, int s, int r, const float *tw_real, const float *tw_imag,
+                           float sign, int lanes) {
+    int m = n_cur / r;
+    switch (r) {
+    case 2: STOCKHAM_STAGE(2, dft2) break;
+    case 3: STOCKHAM_STAGE(3, dft3) break;
+    case 4: STOCKHAM_STAGE(4, dft4) break;
+    case 5: STOCKHAM_STAGE(5, dft5) break;
+    case 7: STOCKHAM_STAGE(7, dft7) break;
+    }
+}
+
+static void copy_elements(const float *src_real, const float *src_imag, size_t src_stride,
+                          float *dst_real, float *dst_imag, size_t dst_stride, int n, int lanes) {
+    for (int k = 0; k < n; ++k) {
+        memcpy(dst_real + k * dst_stride, src_real + k * src_stride, lanes * sizeof(float));
+        memcpy(dst_imag + k * dst_stride, src_imag + k * src_stride, lanes * sizeof(float));
+    }
+}
+
+int fft_mixed_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                      float *output_real, float *output_imag, size_t in_stride, size_t out_stride, int lanes) {
+    int n = plan->n;
+    int stages = plan->num_stages;
+    float sign = plan->direction == FFT_INVERSE ? 1.0f : -1.0f;
+
+    if (stages == 0) {
+        copy_elements(input_real, input_imag, in_stride, output_real, output_imag, out_stride, n, lanes);
+        return 0;
+    }
+
+    // Two compact ping-pong buffers (element stride = lanes).
+    size_t plane = (size_t)n * lanes;
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_PLAN, 4 * plane);
+    if (!scratch) return -1;
+    float *a_real = scratch, *a_imag = scratch + plane;
+    float *b_real = scratch + 2 * plane, *b_imag = scratch + 3 * plane;
+
+    const float *xr = input_real, *xi = input_imag;
+    size_t xs = in_stride;
+    // Only the last stage writes the output; the others alternate between
+    // the two buffers. A single-stage in-place transform would read and
+    // write the output at once, so it starts from a copy of the input.
+    if (stages == 1 && input_real == output_real && input_imag == output_imag) {
+        copy_elements(input_real, input_imag, in_stride, b_real, b_imag, lanes, n, lanes);
+        xr = b_real;
+        xi = b_imag;
+        xs = lanes;
+    }
+
+    const float *tw_real = plan->tw_real, *tw_imag = plan->tw_imag;
+    int n_cur = n, s = 1;
+    for (int t = 0; t < stages; ++t) {
+        int r = plan->radices[t];
+        float *yr, *yi;
+        size_t ys;
+        if (t == stages - 1) {
+            yr = output_real; yi = output_imag; ys = out_stride;
+        } else {
+            yr = (xr == a_real) ? b_real : a_real;
+            yi = (xr == a_real) ? b_imag : a_imag;
+            ys = lanes;
+        }
+
+        stockham_stage(xr, xi, xs, yr, yi, ys, n_cur, s, r, tw_real, tw_imag, sign, lanes);
+
+        tw_real += (n_cur / r) * (r - 1);
+        tw_imag += (n_cur / r) * (r - 1);
+        n_cur /= r;
+        s *= r;
+        xr = yr; xi = yi; xs = ys;
+    }
+
+    if (plan->direction == FFT_INVERSE) {
+        float factor = 1.0f / (float)n;
+        for (int k = 0; k < n; ++k) {
+            for (int l = 0; l < lanes; ++l) {
+                output_real[k * out_stride + l] *= factor;
+                output_imag[k * out_stride + l] *= factor;
+            }
+        }
+    }
+    return 0;
+}
+
+// --- Bluestein (chirp-z) FFT for sizes with a large prime factor ---
+// With c_k = exp(-+i*pi*k^2/n), nk = (n^2 + k^2 - (k-n)^2) / 2 turns the DFT
+// into X_k = c_k * sum_j (x_j c_j) conj(c_{k-j}), a convolution evaluated
+// with power-of-two FFTs of length conv_n >= 2n - 1.
+
+int fft_bluestein_init(fft_plan *plan) {
+    int n = plan->n;
+    int m = 1;
+    while (m < 2 * n - 1) {
+        m <<= 1;
+    }
+    plan->conv_n = m;
+    plan->conv_forward = fft_plan_get(m, FFT_FORWARD);
+    plan->conv_inverse = fft_plan_get(m, FFT_INVERSE);
+    plan->chirp_real = (float*)malloc(n * sizeof(float));
+    plan->chirp_imag = (float*)malloc(n * sizeof(float));
+    plan->kernel_real = (float*)calloc(m, sizeof(float));
+    plan->kernel_imag = (float*)calloc(m, sizeof(float));
+    if (!plan->conv_forward || !plan->conv_inverse || !plan->chirp_real || !plan->chirp_imag ||
+        !plan->kernel_real || !plan->kernel_imag) {
+        return 0;
+    }
+
+    double sign = plan->direction == FFT_INVERSE ? 1.0 : -1.0;
+    for (int k = 0; k < n; ++k) {
+        // k^2 mod 2n keeps the angle small and exact for large k.
+        uint64_t k2 = ((uint64_t)k * (uint64_t)k) % (uint64_t)(2 * n);
+        double angle = sign * M_PI * (double)k2 / (double)n;
+        plan->chirp_real[k] = (float)cos(angle);
+        plan->chirp_imag[k] = (float)sin(angle);
+    }
+
+    // Conjugate chirp wrapped around: b[j] = b[m-j] = conj(c_j).
+    float *b_real = (float*)calloc(m, sizeof(float));
+    float *b_imag = (float*)calloc(m, sizeof(float));
+    if (!b_real || !b_imag) {
+        free(b_real); free(b_imag);
+        return 0;
+    }
+    for (int j = 0; j < n; ++j) {
+        b_real[j] = plan->chirp_real[j];
+        b_imag[j] = -plan->chirp_imag[j];
+        if (j > 0) {
+            b_real[m - j] = b_real[j];
+            b_imag[m - j] = b_imag[j];
+        }
+    }
+    fft_plan_execute(plan->conv_forward, b_real, b_imag, plan->kernel_real, plan->kernel_imag);
+    free(b_real);
+    free(b_imag);
+    return 1;
+}
+
+int fft_bluestein_execute(const fft_plan *plan, const float *input_real, const float *input_imag,
+                          float *output_real, float *output_imag) {
+    int n = plan->n, m = plan->conv_n;
+    float *scratch = fft_thread_scratch(FFT_SCRATCH_PLAN, 4 * (size_t)m);
+    if (!scratch) return -1;
+    float *a_real = scratch, *a_imag = scratch + m;
+    float *f_real = scratch + 2 * m, *f_imag = scratch + 3 * m;
+
+    const float *cr = plan->chirp_real, *ci = plan->chirp_imag;
+    for (int k = 0; k < n; ++k) {
+        a_real[k] = input_real[k] * cr[k] - input_imag[k] * ci[k];
+        a_imag[k] = input_real[k] * ci[k] + input_imag[k] * cr[k];
+    }
+    memset(a_real + n, 0, (m - n) * sizeof(float));
+    memset(a_imag + n, 0, (m - n) * sizeof(float));
+
+    fft_plan_execute(plan->conv_forward, a_real, a_imag, f_real, f_imag);
+    const float *kr = plan->kernel_real, *ki = plan->kernel_imag;
+    for (int k = 0; k < m; ++k) {
+        float re = f_real[k] * kr[k] - f_imag[k] * ki[k];
+        float im = f_real[k] * ki[k] + f_imag[k] * kr[k];
+        f_real[k] = re;
+        f_imag[k] = im;
+    }
+    fft_plan_execute(plan->conv_inverse, f_real, f_imag, a_real, a_imag);
+
+    float factor = plan->direction == FFT_INVERSE ? 1.0f / (float)n : 1.0f;
+    for (int k = 0; k < n; ++k) {
+        float re = a_real[k] * cr[k] - a_imag[k] * ci[k];
+        float im = a_real[k] * ci[k] + a_imag[k] * cr[k];
+        output_real[k] = re * factor;
+        output_imag[k] = im * factor;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "fft_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// --- Persistent worker pool for the 2D transforms ---
+// Helper threads are started on the first parallel call and then sleep on
+// a condition variable between jobs, so a transform costs one broadcast
+// and one join instead of thread creation. The calling thread takes part
+// as worker 0. One job runs at a time; a caller that finds the pool busy
+// (e.g. another server thread) runs its job on its own thread instead of
+// queueing behind it.
+
+#define FFT_MAX_THREADS 64
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;  // held for a whole job
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER; // guards the fields below
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_barrier_t pool_barrier;
+
+static int requested_threads = 0; // 0 until configured
+static int pool_size = 1;         // workers, including the caller
+static pthread_t pool_threads[FFT_MAX_THREADS];
+static unsigned long pool_generation = 0;
+static int pool_shutdown = 0;
+static int pool_pending = 0;
+static fft_task_fn pool_fn = NULL;
+static void *pool_arg = NULL;
+
+static int default_threads(void) {
+    const char *env = getenv("FFT_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > FFT_MAX_THREADS) n = FFT_MAX_THREADS;
+    return (int)n;
+}
+
+static void *pool_main(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_generation == seen && !pool_shutdown) {
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        }
+        if (pool_shutdown) break;
+        seen = pool_generation;
+        fft_task_fn fn = pool_fn;
+        void *fn_arg = pool_arg;
+        int workers = pool_size;
+        pthread_mutex_unlock(&pool_lock);
+
+        fn(fn_arg, worker, workers);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_pending == 0) {
+            pthread_cond_signal(&pool_done);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    fft_thread_scratch_release();
+    return NULL;
+}
+
+// Both called with job_lock held, so no job is in flight.
+static void pool_stop(void) {
+    if (pool_size <= 1) return;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_shutdown = 1;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+    for (int i = 1; i < pool_size; ++i) {
+        pthread_join(pool_threads[i], NULL);
+    }
+    pthread_barrier_destroy(&pool_barrier);
+    pool_shutdown = 0;
+    pool_generation = 0;
+    pool_size = 1;
+}
+
+static void pool_start(int threads) {
+    int started = 1;
+    while (started < threads) {
+        if (pthread_create(&pool_threads[started], NULL, pool_main, (void*)(intptr_t)started) != 0) {
+            perror("pthread_create for FFT pool");
+            break;
+        }
+        started++;
+    }
+    pool_size = started;
+    if (pool_size > 1) {
+        pthread_barrier_init(&pool_barrier, NULL, pool_size);
+    }
+}
+
+int fft_set_threads(int threads) {
+    if (threads < 1 || threads > FFT_MAX_THREADS) {
+        fprintf(stderr, "fft_set_threads: thread count %d out of range 1..%d\n", threads, FFT_MAX_THREADS);
+        return -1;
+    }
+    pthread_mutex_lock(&job_lock);
+    if (threads != requested_threads) {
+        pool_stop();
+        requested_threads = threads;
+    }
+    pthread_mutex_unlock(&job_lock);
+    return 0;
+}
+
+int fft_get_threads(void) {
+    pthread_mutex_lock(&job_lock);
+    if (requested_threads == 0) {
+        requested_threads = default_threads();
+    }
+    int threads = requested_threads;
+    pthread_mutex_unlock(&job_lock);
+    return threads;
+}
+
+void fft_parallel_run(fft_task_fn fn, void *arg, size_t points) {
+    if (points < FFT_PARALLEL_MIN_POINTS || pthread_mutex_trylock(&job_lock) != 0) {
+        fn(arg, 0, 1);
+        return;
+    }
+    if (requested_threads == 0) {
+        requested_threads = default_threads();
+    }
+    if (pool_size == 1 && requested_threads > 1) {
+        pool_start(requested_threads);
+    }
+    if (pool_size == 1) {
+        pthread_mutex_unlock(&job_lock);
+        fn(arg, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_fn = fn;
+    pool_arg = arg;
+    pool_pending = pool_size - 1;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    fn(arg, 0, pool_size);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_pending > 0) {
+        pthread_cond_wait(&pool_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_unlock(&job_lock);
+}
+
+void fft_parallel_barrier(int workers) {
+    if (workers > 1) {
+        pthread_barrier_wait(&pool_barrier);
+    }
+}
+
+void fft_parallel_range(int total, int worker, int workers, int *begin, int *end) {
+    *begin = (int)((long)total * worker / workers);
+    *end = (int)((long)total * (worker + 1) / workers);
+}
@@ -0,0 +1,180 @@
+#include "fft.h"
+
+#if defined(__riscv_vector)
+#include <riscv_vector.h>
+#endif
+
+// --- Fixed-size tile transforms ---
+// A tile is small enough to live in registers and L1, so the 2D FFT skips
+// plans altogether: each 1D pass runs along the row index with every
+// butterfly applied to whole rows at once (one vector operation across
+// the columns), then the tile is transposed and the pass repeated. The
+// kernel below is written once and force-inlined into one function per
+// size, where the constant size lets the compiler unroll every stage and
+// butterfly and fold in the twiddle constants.
+
+#define TILE_INLINE static inline __attribute__((always_inline))
+
+// W_32^k = exp(-2 pi i k / 32), k = 0..15. W_n^j is W_32^(j * 32 / n).
+static const float w32_real[16] = {
+    1.000000000f, 0.980785280f, 0.923879533f, 0.831469612f, 0.707106781f, 0.555570233f, 0.382683432f, 0.195090322f,
+    0.000000000f, -0.195090322f, -0.382683432f, -0.555570233f, -0.707106781f, -0.831469612f, -0.923879533f, -0.980785280f,
+};
+static const float w32_imag[16] = {
+    -0.000000000f, -0.195090322f, -0.382683432f, -0.555570233f, -0.707106781f, -0.831469612f, -0.923879533f, -0.980785280f,
+    -1.000000000f, -0.980785280f, -0.923879533f, -0.831469612f, -0.707106781f, -0.555570233f, -0.382683432f, -0.195090322f,
+};
+
+#if defined(__riscv_vector)
+
+// (a, b) <- (a + w*b, a - w*b) over n lanes. A 32-float row is a single
+// m4 register group from VLEN = 256 up.
+TILE_INLINE void tile_butterfly(float *a_re, float *a_im, float *b_re, float *b_im, float wr, float wi, int n) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)n; c += vl) {
+        vl = __riscv_vsetvl_e32m4(n - c);
+        vfloat32m4_t ar = __riscv_vle32_v_f32m4(a_re + c, vl);
+        vfloat32m4_t ai = __riscv_vle32_v_f32m4(a_im + c, vl);
+        vfloat32m4_t br = __riscv_vle32_v_f32m4(b_re + c, vl);
+        vfloat32m4_t bi = __riscv_vle32_v_f32m4(b_im + c, vl);
+
+        vfloat32m4_t tr = __riscv_vfmul_vf_f32m4(br, wr, vl);
+        tr = __riscv_vfnmsac_vf_f32m4(tr, wi, bi, vl);
+        vfloat32m4_t ti = __riscv_vfmul_vf_f32m4(br, wi, vl);
+        ti = __riscv_vfmacc_vf_f32m4(ti, wr, bi, vl);
+
+        __riscv_vse32_v_f32m4(a_re + c, __riscv_vfadd_vv_f32m4(ar, tr, vl), vl);
+        __riscv_vse32_v_f32m4(a_im + c, __riscv_vfadd_vv_f32m4(ai, ti, vl), vl);
+        __riscv_vse32_v_f32m4(b_re + c, __riscv_vfsub_vv_f32m4(ar, tr, vl), vl);
+        __riscv_vse32_v_f32m4(b_im + c, __riscv_vfsub_vv_f32m4(ai, ti, vl), vl);
+    }
+}
+
+TILE_INLINE void tile_row_swap(float *a, float *b, int n) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)n; c += vl) {
+        vl = __riscv_vsetvl_e32m4(n - c);
+        vfloat32m4_t va = __riscv_vle32_v_f32m4(a + c, vl);
+        vfloat32m4_t vb = __riscv_vle32_v_f32m4(b + c, vl);
+        __riscv_vse32_v_f32m4(a + c, vb, vl);
+        __riscv_vse32_v_f32m4(b + c, va, vl);
+    }
+}
+
+TILE_INLINE void tile_scale(float *x, int count, float factor) {
+    size_t vl;
+    for (size_t i = 0; i < (size_t)count; i += vl) {
+        vl = __riscv_vsetvl_e32m8(count - i);
+        __riscv_vse32_v_f32m8(x + i, __riscv_vfmul_vf_f32m8(__riscv_vle32_v_f32m8(x + i, vl), factor, vl), vl);
+    }
+}
+
+#else
+
+TILE_INLINE void tile_butterfly(float *a_re, float *a_im, float *b_re, float *b_im, float wr, float wi, int n) {
+    for (int c = 0; c < n; ++c) {
+        float tr = b_re[c] * wr - b_im[c] * wi;
+        float ti = b_re[c] * wi + b_im[c] * wr;
+        b_re[c] = a_re[c] - tr;
+        b_im[c] = a_im[c] - ti;
+        a_re[c] += tr;
+        a_im[c] += ti;
+    }
+}
+
+TILE_INLINE void tile_row_swap(float *a, float *b, int n) {
+    for (int c = 0; c < n; ++c) {
+        float t = a[c];
+        a[c] = b[c];
+        b[c] = t;
+    }
+}
+
+TILE_INLINE void tile_scale(float *x, int count, float factor) {
+    for (int i = 0; i < count; ++i) {
+        x[i] *= factor;
+    }
+}
+
+#endif
+
+// Radix-2 DIT along the row index: every column of the tile at once.
+// sign is 1 for the forward transform and -1 for the inverse.
+TILE_INLINE void tile_pass(float *re, float *im, int n, int log2n, float sign) {
+#pragma GCC unroll 32
+    for (int i = 0; i < n; ++i) {
+        int r = 0;
+        for (int b = 0; b < log2n; ++b) {
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        }
+        if (r > i) {
+            tile_row_swap(re + i * n, re + r * n, n);
+            tile_row_swap(im + i * n, im + r * n, n);
+        }
+    }
+#pragma GCC unroll 8
+    for (int half = 1; half < n; half <<= 1) {
+#pragma GCC unroll 16
+        for (int i = 0; i < n; i += 2 * half) {
+#pragma GCC unroll 16
+            for (int j = 0; j < half; ++j) {
+                int k = j * (16 / half); // W_{2 half}^j
+                int a = (i + j) * n, b = a + half * n;
+                tile_butterfly(re + a, im + a, re + b, im + b, w32_real[k], sign * w32_imag[k], n);
+            }
+        }
+    }
+}
+
+TILE_INLINE void tile_transpose(float *x, int n) {
+#pragma GCC unroll 32
+    for (int r = 1; r < n; ++r) {
+        for (int c = 0; c < r; ++c) {
+            float t = x[r * n + c];
+            x[r * n + c] = x[c * n + r];
+            x[c * n + r] = t;
+        }
+    }
+}
+
+TILE_INLINE void tile_2d(float *re, float *im, int n, int log2n, int direction) {
+    float sign = direction == FFT_INVERSE ? -1.0f : 1.0f;
+    tile_pass(re, im, n, log2n, sign);
+    tile_transpose(re, n);
+    tile_transpose(im, n);
+    tile_pass(re, im, n, log2n, sign);
+    tile_transpose(re, n);
+    tile_transpose(im, n);
+    if (direction == FFT_INVERSE) {
+        tile_scale(re, n * n, 1.0f / (float)(n * n));
+        tile_scale(im, n * n, 1.0f / (float)(n * n));
+    }
+}
+
+static void tile_2d_8(float *re, float *im, int direction) {
+    tile_2d(re, im, 8, 3, direction);
+}
+
+static void tile_2d_16(float *re, float *im, int direction) {
+    tile_2d(re, im, 16, 4, direction);
+}
+
+static void tile_2d_32(float *re, float *im, int direction) {
+    tile_2d(re, im, 32, 5, direction);
+}
+
+int fft_tile_2d(float *re, float *im, int size, int direction) {
+    switch (size) {
+    case 8:
+        tile_2d_8(re, im, direction);
+        return 0;
+    case 16:
+        tile_2d_16(re, im, direction);
+        return 0;
+    case 32:
+        tile_2d_32(re, im, direction);
+        return 0;
+    default:
+        return -1;
+    }
+}
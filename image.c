@@ -0,0 +1,56 @@
+#include "image.h"
+
+static inline uint8_t clamp_byte(float v) {
+    v += 0.5f;
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (uint8_t)v;
+}
+
+void image_rgb_to_ycbcr(const uint8_t *rgb, int width, int height, int color, float *y, float *cb, float *cr) {
+    if (color == IMAGE_COLOR_YCBCR444) {
+        for (size_t i = 0; i < (size_t)width * height; ++i) {
+            float r = rgb[3 * i], g = rgb[3 * i + 1], b = rgb[3 * i + 2];
+            y[i] = 0.299f * r + 0.587f * g + 0.114f * b;
+            cb[i] = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+            cr[i] = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+        }
+        return;
+    }
+
+    // 4:2:0: full-resolution luma, then chroma averaged over each 2x2
+    // block (the last row or column repeats at odd sizes).
+    int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    for (size_t i = 0; i < (size_t)width * height; ++i) {
+        y[i] = 0.299f * rgb[3 * i] + 0.587f * rgb[3 * i + 1] + 0.114f * rgb[3 * i + 2];
+    }
+    for (int cy = 0; cy < ch; ++cy) {
+        int y0 = 2 * cy, y1 = 2 * cy + 1 < height ? 2 * cy + 1 : 2 * cy;
+        for (int cx = 0; cx < cw; ++cx) {
+            int x0 = 2 * cx, x1 = 2 * cx + 1 < width ? 2 * cx + 1 : 2 * cx;
+            const uint8_t *p[4] = { rgb + 3 * ((size_t)y0 * width + x0), rgb + 3 * ((size_t)y0 * width + x1),
+                                    rgb + 3 * ((size_t)y1 * width + x0), rgb + 3 * ((size_t)y1 * width + x1) };
+            float r = 0.25f * (p[0][0] + p[1][0] + p[2][0] + p[3][0]);
+            float g = 0.25f * (p[0][1] + p[1][1] + p[2][1] + p[3][1]);
+            float b = 0.25f * (p[0][2] + p[1][2] + p[2][2] + p[3][2]);
+            cb[(size_t)cy * cw + cx] = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+            cr[(size_t)cy * cw + cx] = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+        }
+    }
+}
+
+void image_ycbcr_to_rgb(const float *y, const float *cb, const float *cr, int width, int height, int color,
+                        uint8_t *rgb) {
+    int subsampled = color == IMAGE_COLOR_YCBCR420;
+    int cw = subsampled ? (width + 1) / 2 : width;
+    for (int row = 0; row < height; ++row) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t)row * width + x;
+            size_t c = subsampled ? (size_t)(row / 2) * cw + x / 2 : i;
+            float luma = y[i], u = cb[c] - 128.0f, v = cr[c] - 128.0f;
+            rgb[3 * i] = clamp_byte(luma + 1.402f * v);
+            rgb[3 * i + 1] = clamp_byte(luma - 0.344136f * u - 0.714136f * v);
+            rgb[3 * i + 2] = clamp_byte(luma + 1.772f * u);
+        }
+    }
+}
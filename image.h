@@ -6,8 +6,6 @@
 
 // --- Image Data Structure ---
 // This structure will hold the raw pixel data and its dimensions.
-// For simplicity in this project, we're assuming grayscale 8-bit images.
-// You could extend this for RGB, different bit depths, etc.
 typedef struct {
     int width;
     int height;
@@ -16,21 +14,27 @@ typedef struct {
     uint8_t *pixels;
 } ImageData;
 
-// --- Function Prototypes (Optional, for more complex image handling) ---
-// In this minimal server, we're handling raw pixels directly in server.c.
-// If you wanted to abstract image loading/saving, you'd put prototypes here.
-
-// Example: Function to allocate memory for image data
-// ImageData* create_image_data(int width, int height);
-
-// Example: Function to free image data
-// void free_image_data(ImageData *img);
-
-// Example: Basic image loading (e.g., from a raw binary file)
-// ImageData* load_raw_grayscale_image(const char *filepath, int width, int height);
-
-// Example: Basic image saving (e.g., to a raw binary file)
-// int save_raw_grayscale_image(const char *filepath, const ImageData *img);
-
-
-#endif // IMAGE_H
\ No newline at end of file
+// Interleaved 8-bit values per pixel of the images the server takes.
+#define IMAGE_CHANNELS_GRAY 1
+#define IMAGE_CHANNELS_RGB 3
+
+// Plane layouts. The values are stored in compressed streams
+// (COMPRESSION_COLOR_* in compression.h), so they must not change.
+#define IMAGE_COLOR_GRAY 0     // One plane
+#define IMAGE_COLOR_YCBCR444 1 // Y, Cb, Cr at full resolution
+#define IMAGE_COLOR_YCBCR420 2 // Cb, Cr at half resolution both ways, rounded up
+
+// --- Color conversion ---
+// RGB <-> YCbCr as in JPEG (BT.601, full range, chroma offset by 128), on
+// the planes of an IMAGE_COLOR_YCBCR444 or _YCBCR420 layout. For 4:2:0
+// each chroma sample is the mean of a 2x2 block, clamped at the right and
+// bottom edges, and is replicated back over the block on the way out.
+
+// Interleaved RGB -> Y, Cb and Cr float planes, ready for the FFT.
+void image_rgb_to_ycbcr(const uint8_t *rgb, int width, int height, int color, float *y, float *cb, float *cr);
+// Reconstructed Y, Cb and Cr planes -> interleaved RGB, rounded and
+// clamped to [0, 255].
+void image_ycbcr_to_rgb(const float *y, const float *cb, const float *cr, int width, int height, int color,
+                        uint8_t *rgb);
+
+#endif // IMAGE_H
@@ -0,0 +1,177 @@
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// One thread's metrics. Only the owning thread writes a shard; readers
+// may see a count a moment ahead of its sum, which Prometheus tolerates.
+typedef struct metrics_shard {
+    uint64_t buckets[METRIC_STAGE_COUNT][METRICS_BUCKETS];
+    uint64_t sum_ns[METRIC_STAGE_COUNT];
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    struct metrics_shard *next;
+} __attribute__((aligned(64))) metrics_shard;
+
+// Every shard ever created, newest first. Shards are never freed: a thread
+// that exits leaves its totals behind.
+static metrics_shard *shards;
+static __thread metrics_shard *local_shard;
+
+static const char *const stage_names[METRIC_STAGE_COUNT] = {
+    "parse", "queue", "receive", "convert", "fft", "quantize", "entropy", "tiled_encode", "entropy_decode", "ifft",
+    "tiled_decode", "send", "request",
+};
+
+static const struct {
+    const char *name;
+    const char *label; // Optional {label} distinguishing series of one metric
+    const char *help;
+    int gauge;         // 1 for a level (TYPE gauge), 0 for a count
+} counter_info[METRIC_COUNTER_COUNT] = {
+    { "requests_total", "endpoint=\"compress\"", "Requests served, by endpoint.", 0 },
+    { "requests_total", "endpoint=\"decompress\"", NULL, 0 },
+    { "requests_total", "endpoint=\"other\"", NULL, 0 },
+    { "responses_total", "code=\"2xx\"", "Responses sent, by status class.", 0 },
+    { "responses_total", "code=\"4xx\"", NULL, 0 },
+    { "responses_total", "code=\"5xx\"", NULL, 0 },
+    { "received_bytes_total", NULL, "Request bytes read, headers and bodies.", 0 },
+    { "sent_bytes_total", NULL, "Response bytes written, headers and bodies.", 0 },
+    { "compressed_pixels_total", NULL, "Pixels of the images compressed.", 0 },
+    { "decompressed_pixels_total", NULL, "Pixels of the images (or regions) decompressed.", 0 },
+    { "connections_total", NULL, "Connections accepted.", 0 },
+    { "connection_buffer_grows_total", NULL, "Connection receive buffer allocations.", 0 },
+    { "workspace_grows_total", NULL, "Worker workspace (re)allocations.", 0 },
+    { "workspace_bytes", NULL, "Memory held by worker workspaces.", 1 },
+    { "compress_input_bytes_total", NULL, "Raw pixel bytes compressed.", 0 },
+    { "compress_output_bytes_total", NULL, "Compressed stream bytes produced.", 0 },
+    { "encode_nanoseconds_total", NULL, "Time spent quantizing and entropy coding.", 0 },
+    { "decompress_input_bytes_total", NULL, "Compressed stream bytes decoded.", 0 },
+    { "decompress_output_bytes_total", NULL, "Raw pixel bytes produced by decompression.", 0 },
+    { "decode_nanoseconds_total", NULL, "Time spent entropy decoding and dequantizing.", 0 },
+    { "frame_bytes", NULL, "Memory held by video frame state.", 1 },
+    { "frame_evictions_total", NULL, "Idle video frame states freed to stay in budget or after idling.", 0 },
+    { "body_bytes", NULL, "Memory held for request bodies still arriving.", 1 },
+    { "streamed_rows_total", NULL, "Image rows transformed while their request body was arriving.", 0 },
+    { "stalled_requests_total", NULL, "Partial requests dropped for sending nothing for the stall timeout.", 0 },
+};
+
+uint64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// The calling thread's shard, created and published on first use. NULL
+// only if that allocation failed; the sample is then dropped.
+static metrics_shard *shard_get(void) {
+    metrics_shard *shard = local_shard;
+    if (shard) return shard;
+    shard = (metrics_shard*)aligned_alloc(64, sizeof(metrics_shard));
+    if (!shard) return NULL;
+    *shard = (metrics_shard){0};
+    shard->next = __atomic_load_n(&shards, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&shards, &shard->next, shard, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    local_shard = shard;
+    return shard;
+}
+
+// Single writer: a plain read-modify-write, stored atomically so that
+// readers never see a torn value.
+static inline void shard_add(uint64_t *p, uint64_t value) {
+    __atomic_store_n(p, *p + value, __ATOMIC_RELAXED);
+}
+
+static int bucket_index(uint64_t ns) {
+    if (ns <= (1ull << METRICS_MIN_LOG2)) return 0;
+    int index = 64 - __builtin_clzll(ns - 1) - METRICS_MIN_LOG2; // ceil(log2 ns) - min
+    return index < METRICS_BUCKETS - 1 ? index : METRICS_BUCKETS - 1;
+}
+
+void metrics_record(int stage, uint64_t ns) {
+    metrics_shard *shard = shard_get();
+    if (!shard) return;
+    shard_add(&shard->buckets[stage][bucket_index(ns)], 1);
+    shard_add(&shard->sum_ns[stage], ns);
+}
+
+void metrics_add(int counter, uint64_t value) {
+    metrics_shard *shard = shard_get();
+    if (!shard) return;
+    shard_add(&shard->counters[counter], value);
+}
+
+uint64_t metrics_counter(int counter) {
+    uint64_t total = 0;
+    for (metrics_shard *s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next) {
+        total += __atomic_load_n(&s->counters[counter], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+// snprintf that appends at *len and keeps counting past the end of out.
+static void append(char *out, size_t size, size_t *len, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(*len < size ? out + *len : NULL, *len < size ? size - *len : 0, fmt, ap);
+    va_end(ap);
+    if (n > 0) *len += (size_t)n;
+}
+
+size_t metrics_format(char *out, size_t size) {
+    uint64_t merged_buckets[METRIC_STAGE_COUNT][METRICS_BUCKETS] = {{0}};
+    uint64_t merged_sum[METRIC_STAGE_COUNT] = {0};
+    uint64_t merged_counters[METRIC_COUNTER_COUNT] = {0};
+    for (metrics_shard *s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next) {
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; ++stage) {
+            for (int b = 0; b < METRICS_BUCKETS; ++b) {
+                merged_buckets[stage][b] += __atomic_load_n(&s->buckets[stage][b], __ATOMIC_RELAXED);
+            }
+            merged_sum[stage] += __atomic_load_n(&s->sum_ns[stage], __ATOMIC_RELAXED);
+        }
+        for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+            merged_counters[c] += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        }
+    }
+
+    size_t len = 0;
+    append(out, size, &len,
+           "# HELP image_compress_stage_seconds Time spent in each request stage.\n"
+           "# TYPE image_compress_stage_seconds histogram\n");
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; ++stage) {
+        uint64_t count = 0;
+        for (int b = 0; b < METRICS_BUCKETS; ++b) {
+            count += merged_buckets[stage][b];
+            if (b < METRICS_BUCKETS - 1) {
+                append(out, size, &len, "image_compress_stage_seconds_bucket{stage=\"%s\",le=\"%.10g\"} %llu\n",
+                       stage_names[stage], (double)(1ull << (METRICS_MIN_LOG2 + b)) * 1e-9,
+                       (unsigned long long)count);
+            } else {
+                append(out, size, &len, "image_compress_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                       stage_names[stage], (unsigned long long)count);
+            }
+        }
+        append(out, size, &len, "image_compress_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage_names[stage],
+               (double)merged_sum[stage] * 1e-9);
+        append(out, size, &len, "image_compress_stage_seconds_count{stage=\"%s\"} %llu\n", stage_names[stage],
+               (unsigned long long)count);
+    }
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+        if (counter_info[c].help) {
+            append(out, size, &len, "# HELP image_compress_%s %s\n# TYPE image_compress_%s %s\n",
+                   counter_info[c].name, counter_info[c].help, counter_info[c].name,
+                   counter_info[c].gauge ? "gauge" : "counter");
+        }
+        if (counter_info[c].label) {
+            append(out, size, &len, "image_compress_%s{%s} %llu\n", counter_info[c].name, counter_info[c].label,
+                   (unsigned long long)merged_counters[c]);
+        } else {
+            append(out, size, &len, "image_compress_%s %llu\n", counter_info[c].name,
+                   (unsigned long long)merged_counters[c]);
+        }
+    }
+    return len;
+}
@@ -0,0 +1,84 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h> // For size_t
+#include <stdint.h>
+
+// --- Request metrics ---
+// Per-stage latency histograms and counters for GET /metrics. Every thread
+// records into its own shard (created on its first record), so the hot
+// path is a clock read and a few relaxed single-writer stores: no locks,
+// no shared cache lines. metrics_format() merges the shards on read.
+//
+// Histogram buckets are powers of two in nanoseconds: bucket i counts
+// durations up to 2^(METRICS_MIN_LOG2 + i) ns, the last one everything
+// longer.
+
+#define METRICS_MIN_LOG2 10 // First bucket: <= 1.024 us
+#define METRICS_BUCKETS 27  // Up to 2^35 ns (34 s), then +Inf
+// Enough for the text of every stage and counter.
+#define METRICS_TEXT_MAX 65536
+
+enum {
+    METRIC_STAGE_PARSE,          // Finding and parsing the request headers
+    METRIC_STAGE_QUEUE,          // Waiting for a compute worker
+    METRIC_STAGE_RECEIVE,        // Buffering the request body on the event loop
+    METRIC_STAGE_CONVERT,        // Widening pixels to floats
+    METRIC_STAGE_FFT,            // Forward 2D FFT, row and column passes
+    METRIC_STAGE_QUANTIZE,       // Quantizing the spectrum
+    METRIC_STAGE_ENTROPY,        // Huffman coding the quantized spectrum
+    METRIC_STAGE_TILED_ENCODE,   // Tiled mode: tile FFTs, quantization and coding
+    METRIC_STAGE_ENTROPY_DECODE, // Huffman decoding and dequantization
+    METRIC_STAGE_IFFT,           // Inverse 2D FFT and rounding to pixels
+    METRIC_STAGE_TILED_DECODE,   // Tiled mode: decoding, tile IFFTs and rounding
+    METRIC_STAGE_SEND,           // Writing the response
+    METRIC_STAGE_REQUEST,        // Whole request, from headers parsed to response sent
+    METRIC_STAGE_COUNT
+};
+
+enum {
+    METRIC_REQUESTS_COMPRESS,
+    METRIC_REQUESTS_DECOMPRESS,
+    METRIC_REQUESTS_OTHER,          // /stats, /metrics, 404s and malformed requests
+    METRIC_RESPONSES_2XX,
+    METRIC_RESPONSES_4XX,
+    METRIC_RESPONSES_5XX,
+    METRIC_BYTES_RECEIVED,          // Request headers and bodies
+    METRIC_BYTES_SENT,              // Response headers and bodies
+    METRIC_PIXELS_COMPRESSED,
+    METRIC_PIXELS_DECOMPRESSED,
+    METRIC_CONNECTIONS,             // Accepted
+    METRIC_BUFFER_GROWS,            // Connection receive buffer (re)allocations
+    METRIC_WORKSPACE_GROWS,         // Worker workspace (re)allocations
+    METRIC_WORKSPACE_BYTES,         // Bytes added to worker workspaces (exported as a gauge)
+    METRIC_COMPRESS_INPUT_BYTES,    // Raw 8-bit pixels compressed
+    METRIC_COMPRESS_OUTPUT_BYTES,   // Compressed stream bytes produced
+    METRIC_ENCODE_NS,               // Quantization and entropy coding
+    METRIC_DECOMPRESS_INPUT_BYTES,  // Compressed stream bytes decoded
+    METRIC_DECOMPRESS_OUTPUT_BYTES, // Raw 8-bit pixels produced
+    METRIC_DECODE_NS,               // Entropy decoding and dequantization
+    METRIC_FRAME_BYTES,             // Held by video frame state (a gauge; frees add -bytes)
+    METRIC_FRAME_EVICTIONS,         // Frame state freed for the budget or for idling
+    METRIC_BODY_BYTES,              // Held for request bodies still arriving (a gauge)
+    METRIC_ROWS_STREAMED,           // Row FFTs run by row jobs, ahead of their request
+    METRIC_REQUESTS_STALLED,        // Partial requests dropped after the stall timeout
+    METRIC_COUNTER_COUNT
+};
+
+// Monotonic clock in nanoseconds.
+uint64_t metrics_now(void);
+// Adds one duration to a stage histogram of the calling thread.
+void metrics_record(int stage, uint64_t ns);
+// Adds value to a counter of the calling thread. A gauge goes down by
+// adding the two's complement; the sum over threads wraps back exactly.
+void metrics_add(int counter, uint64_t value);
+
+// Sum of a counter over every thread, for GET /stats.
+uint64_t metrics_counter(int counter);
+
+// Writes the merged histograms and counters in the Prometheus text format.
+// Returns the length of the full text, like snprintf: the output was
+// truncated if that is >= size.
+size_t metrics_format(char *out, size_t size);
+
+#endif // METRICS_H
@@ -1,4 +1,8 @@
-riscv64-unknown-linux-gcc -march=rv64gc -mabi=lp64d -O3 -Wall -Wextra \
+riscv64-unknown-linux-gcc -march=rv64gcv -mabi=lp64d -O3 -Wall -Wextra -pthread \
     -I. \
     -o image_compress_server \
-    server.c fft.c compression.c -lm
\ No newline at end of file
+    server.c fft.c fft_mixed.c fft_threads.c fft_tile.c fft_session.c compression.c workspace.c metrics.c image.c -lm
+riscv64-unknown-linux-gcc -march=rv64gcv -mabi=lp64d -O3 -Wall -Wextra -pthread \
+    -I. \
+    -o image_compress_batch \
+    batch.c fft.c fft_mixed.c fft_threads.c fft_tile.c compression.c workspace.c -lm
@@ -1,37 +1,1019 @@
+#define _GNU_SOURCE // accept4
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
+#include "common.h"
 #include "fft.h"
 #include "image.h"
 #include "compression.h"
+#include "workspace.h"
+#include "metrics.h"
 
 #define PORT 8080
-#define BUFFER_SIZE 8192 // For HTTP request/response
+#define DEFAULT_BACKLOG 128
+#define MAX_HEADER_SIZE 8192 // Requests whose headers do not fit are rejected
+#define READ_CHUNK 65536
+#define MAX_EVENTS 64
+#define SEND_TIMEOUT_MS 10000
+#define DEFAULT_IMAGE_DIM 256 // When X-Image-Width/Height are not sent
+#define MAX_FRAME_DIM 2048 // POST /frame and /decompress-frame, about 71 MB of encoder state
+#define DEFAULT_FRAME_BUDGET_MB 512 // -m: frame state of all connections together
+#define FRAME_IDLE_SECONDS 30       // Frame state unused this long is freed
+#define DEFAULT_BODY_BUDGET_MB 1024 // -r: request bodies still arriving, all connections together
+#define DEFAULT_STALL_SECONDS 10    // -s: longest a partial request may go without new bytes
+#define SWEEP_MS 1000               // How often the event loop looks for idle frame state and stalls
+#define STREAM_BATCH_PIXELS 65536   // Rows of a streamed body widened before a row job is queued
+#define RESPONSE_CHUNK 65536 // Encoder output staged per send on streamed responses
+
+// --- Server structure ---
+// The main thread runs an epoll loop over non-blocking sockets: it accepts
+// clients and reads until a whole request is in, then queues the
+// connection for a fixed pool of compute workers. A worker never waits on
+// the network for input, so a slow upload holds only its own memory, not
+// a worker. Bodies are buffered on the connection, except for whole-image
+// gray POST /compress: the loop widens those a row at a time into the
+// request's FFT input plane, and queues the rows as row FFT jobs for the
+// workers, so the row pass overlaps the upload (see request_ingest).
+// Bodies still arriving count against a server-wide budget, with 503 past
+// it, and a request that stops sending for the stall timeout is dropped.
+// Sockets are registered EPOLLONESHOT, so exactly one thread owns a
+// connection at a time: the loop while reading, a worker while it
+// computes and sends the response. Keep-alive connections are re-armed by
+// the worker and go back to the loop.
+
+typedef struct {
+    char method[16];
+    char uri[256];
+    int content_length;
+    int width;
+    int height;
+    int tile_size; // X-Tile-Size; 0 for a whole-image FFT
+    float low_pass;     // X-Low-Pass cutoff in (0, 1]; 0 keeps the whole spectrum
+    int low_pass_shape; // FFT_MASK_*
+    int rgb;    // X-Image-Format: rgb, 3 interleaved bytes per pixel
+    int chroma; // X-Chroma: 444 or 420 (the default) for rgb
+    int region[4]; // X-Region: x, y, width, height
+    int has_region;
+    int key_frame; // X-Key-Frame: 1
+    int keep_alive;
+    size_t header_len; // Bytes up to and including the blank line
+    int malformed;
+    int over_budget; // The body did not fit in the body budget; answered 503
+    size_t consumed; // Bytes of the connection buffer used by this request
+} http_request;
+
+// A whole-image gray POST /compress body streamed into the FFT input
+// plane. The thread reading the connection widens each complete row into
+// plane, drops it from the connection buffer and publishes it in
+// rows_ready; row jobs on the compute workers transform the published
+// rows while the rest arrives, and the worker serving the request does
+// whatever rows are left, then the column pass. Shared by the connection
+// and its queued row job; the last reference frees it and gives its bytes
+// back to the body budget.
+typedef struct request_ingest {
+    pthread_mutex_t lock;
+    pthread_cond_t idle; // Broadcast when busy clears
+    int width;
+    int height;
+    float *plane;        // width x height; also the coder's scratch
+    float *real;         // height x (width/2 + 1) spectrum
+    float *imag;
+    int *mask;           // X-Low-Pass, or NULL
+    size_t bytes;        // Charged to the body budget
+    uint64_t convert_ns; // Widening; only the reading thread touches it
+    // Guarded by lock
+    int refs;
+    int rows_ready; // Rows widened and published
+    int rows_done;  // Rows whose row FFT ran
+    int busy;       // A thread is transforming rows
+    int queued;     // A row job is queued or running
+    int failed;     // A row FFT failed
+    uint64_t fft_ns;
+    struct request_ingest *next; // Row job queue link
+} request_ingest;
+
+// POST /frame and /decompress-frame state: the coder's reference values
+// for frames of one size and, for the encoder, the FFT session holding the
+// row and column passes of the last frame. The buffers count against the
+// frame budget (see frame_acquire) and can be evicted while no worker uses
+// them; the shell stays with its connection.
+typedef struct frame_state {
+    fft_session *session; // Encoder only
+    int32_t *reference;   // NULL until allocated and after eviction
+    int width;
+    int height;
+    int primed;           // Decoder: reference holds a decoded frame
+    // Guarded by frame_lock
+    size_t bytes;         // Charged to the budget while the buffers exist
+    int busy;             // A worker is using the buffers
+    uint64_t last_used_ns;
+    struct frame_state *prev, *next; // Budget list, least recently used first
+} frame_state;
+
+typedef struct connection {
+    int fd;
+    char *buf; // Bytes received but not yet consumed
+    size_t len;
+    size_t cap;
+    size_t need;         // Bytes of buf the pending request takes, once its headers are in
+    uint64_t receive_ns; // metrics_now() when its body started arriving
+    uint64_t progress_ns; // metrics_now() at the last bytes received
+    size_t body_charge;  // Buffered body bytes charged to the body budget
+    size_t body_dropped; // Body bytes already widened into ingest and dropped from buf
+    request_ingest *ingest; // Streamed body of the pending request, or NULL
+    http_request req;
+    frame_state *frame;   // Set by the first POST /frame
+    frame_state *decoder; // Set by the first POST /decompress-frame
+    uint64_t queued_ns; // metrics_now() when queued for a worker
+    struct connection *next; // Work queue link
+    int parked;              // In the epoll set, waiting for bytes (guarded by park_lock)
+    struct connection *park_prev, *park_next;
+} connection;
 
 // Function prototypes
-void handle_client(int client_sock);
-int parse_http_request(char *request, char *method, char *uri, char **body_start, int *content_length);
+int parse_http_request(const char *request, size_t header_len, http_request *req);
+static int request_ready(connection *conn);
+static void handle_request(connection *conn, workspace *ws);
+static void handle_decompress(connection *conn, workspace *ws);
+static void handle_compress_tiled(connection *conn, workspace *ws);
+static void handle_compress_color(connection *conn, workspace *ws);
+static void handle_frame(connection *conn, workspace *ws);
+static void handle_decompress_frame(connection *conn, workspace *ws);
+static void handle_metrics(connection *conn, workspace *ws);
+
+static int epoll_fd = -1;
+
+// Connections with a complete request, and row jobs of streamed bodies,
+// waiting for a compute worker
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static connection *queue_head = NULL;
+static connection *queue_tail = NULL;
+static request_ingest *rows_head = NULL;
+static request_ingest *rows_tail = NULL;
+
+// Connections parked in the epoll set, for the stall sweep. Linked by the
+// thread that arms the socket, unlinked by the event loop when it takes
+// the connection back.
+static pthread_mutex_t park_lock = PTHREAD_MUTEX_INITIALIZER;
+static connection *park_head = NULL;
+static uint64_t stall_ns = (uint64_t)DEFAULT_STALL_SECONDS * 1000000000u;
+
+// Memory held for request bodies still arriving (METRIC_BODY_BYTES
+// follows body_bytes)
+static pthread_mutex_t body_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t body_bytes;
+static size_t body_budget = (size_t)DEFAULT_BODY_BUDGET_MB << 20;
+
+// -v: print every request and its compression results
+static int verbose;
+
+// Frame states whose buffers exist, least recently used first, and the
+// bytes charged for them (METRIC_FRAME_BYTES follows frame_bytes).
+static pthread_mutex_t frame_lock = PTHREAD_MUTEX_INITIALIZER;
+static frame_state *frame_head = NULL;
+static frame_state *frame_tail = NULL;
+static size_t frame_bytes;
+static size_t frame_budget = (size_t)DEFAULT_FRAME_BUDGET_MB << 20;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-b backlog] [-w workers] [-t fft_threads] [-m MB] [-r MB] [-s seconds] [-v]\n"
+            "  -p  TCP port (default %d)\n"
+            "  -b  listen backlog (default %d)\n"
+            "  -w  compute worker threads (default: online CPUs)\n"
+            "  -t  threads per 2D FFT (default: $FFT_THREADS or online CPUs)\n"
+            "  -m  memory for video frame state, all connections together, in MB\n"
+            "      (default %d)\n"
+            "  -r  memory for request bodies still arriving, all connections together,\n"
+            "      in MB (default %d)\n"
+            "  -s  seconds a partial request may go without new bytes (default %d)\n"
+            "  -v  log every request and its compression ratio and speed\n",
+            prog, PORT, DEFAULT_BACKLOG, DEFAULT_FRAME_BUDGET_MB, DEFAULT_BODY_BUDGET_MB, DEFAULT_STALL_SECONDS);
+}
+
+static void frame_unlink(frame_state *frame) {
+    if (frame->prev) {
+        frame->prev->next = frame->next;
+    } else {
+        frame_head = frame->next;
+    }
+    if (frame->next) {
+        frame->next->prev = frame->prev;
+    } else {
+        frame_tail = frame->prev;
+    }
+    frame->prev = frame->next = NULL;
+}
+
+static void frame_append(frame_state *frame) {
+    frame->prev = frame_tail;
+    frame->next = NULL;
+    if (frame_tail) {
+        frame_tail->next = frame;
+    } else {
+        frame_head = frame;
+    }
+    frame_tail = frame;
+}
+
+// Frees the buffers of a listed frame state. Called with frame_lock held.
+static void frame_drop(frame_state *frame) {
+    frame_unlink(frame);
+    frame_bytes -= frame->bytes;
+    metrics_add(METRIC_FRAME_BYTES, -(uint64_t)frame->bytes);
+    frame->bytes = 0;
+    fft_session_destroy(frame->session);
+    free(frame->reference);
+    frame->session = NULL;
+    frame->reference = NULL;
+}
+
+// Makes *slot hold buffers for width x height frames, with an FFT session
+// if encoder is set, and marks it busy until frame_release. Buffers of
+// another size are dropped. New buffers must fit in frame_budget; idle
+// states of other connections are evicted for them, least recently used
+// first. Returns 1 if the buffers are new (the last frame is gone), 0 if
+// they were kept, -1 if they would not fit even with every idle state
+// evicted (nothing is evicted then), -2 if allocation failed.
+static int frame_acquire(frame_state **slot, int width, int height, int encoder) {
+    frame_state *frame = *slot;
+    if (!frame) {
+        frame = (frame_state*)calloc(1, sizeof(frame_state));
+        if (!frame) return -2;
+        *slot = frame;
+    }
+    size_t reference_bytes = simple_compress_reference_size(width, height);
+    size_t bytes = reference_bytes + (encoder ? fft_session_size(width, height) : 0);
+
+    pthread_mutex_lock(&frame_lock);
+    if (frame->reference && frame->width == width && frame->height == height) {
+        frame->busy = 1;
+        pthread_mutex_unlock(&frame_lock);
+        return 0;
+    }
+    if (frame->reference) frame_drop(frame);
+    size_t idle_bytes = 0;
+    for (frame_state *victim = frame_head; victim; victim = victim->next) {
+        if (!victim->busy) idle_bytes += victim->bytes;
+    }
+    if (frame_bytes - idle_bytes + bytes > frame_budget) {
+        pthread_mutex_unlock(&frame_lock);
+        return -1; // Evicting the idle states would not make room
+    }
+    for (frame_state *victim = frame_head; victim && frame_bytes + bytes > frame_budget;) {
+        frame_state *next = victim->next;
+        if (!victim->busy) {
+            frame_drop(victim);
+            metrics_add(METRIC_FRAME_EVICTIONS, 1);
+        }
+        victim = next;
+    }
+    frame_bytes += bytes; // Reserved; the state is listed once allocated
+    frame->bytes = bytes;
+    frame->busy = 1;
+    pthread_mutex_unlock(&frame_lock);
+
+    frame->width = width;
+    frame->height = height;
+    frame->primed = 0;
+    frame->reference = (int32_t*)malloc(reference_bytes);
+    frame->session = encoder ? fft_session_create(width, height) : NULL;
+    int failed = !frame->reference || (encoder && !frame->session);
+    if (failed) {
+        fft_session_destroy(frame->session);
+        free(frame->reference);
+        frame->session = NULL;
+        frame->reference = NULL;
+    }
+    pthread_mutex_lock(&frame_lock);
+    if (failed) {
+        frame_bytes -= bytes;
+        frame->bytes = 0;
+        frame->busy = 0;
+    } else {
+        frame_append(frame);
+        metrics_add(METRIC_FRAME_BYTES, bytes);
+    }
+    pthread_mutex_unlock(&frame_lock);
+    return failed ? -2 : 1;
+}
+
+// Ends a frame_acquire: the state becomes the most recently used, and
+// evictable again.
+static void frame_release(frame_state *frame) {
+    pthread_mutex_lock(&frame_lock);
+    frame->busy = 0;
+    frame->last_used_ns = metrics_now();
+    if (frame->reference) {
+        frame_unlink(frame);
+        frame_append(frame);
+    }
+    pthread_mutex_unlock(&frame_lock);
+}
+
+static void frame_state_free(frame_state *frame) {
+    if (!frame) return;
+    pthread_mutex_lock(&frame_lock);
+    if (frame->reference) frame_drop(frame);
+    pthread_mutex_unlock(&frame_lock);
+    free(frame);
+}
+
+// Evicts the frame states no request has used for FRAME_IDLE_SECONDS. The
+// list is in order of last use, so the walk stops at the first recent one.
+static void frame_sweep(void) {
+    uint64_t cutoff = metrics_now() - (uint64_t)FRAME_IDLE_SECONDS * 1000000000u;
+    pthread_mutex_lock(&frame_lock);
+    for (frame_state *frame = frame_head; frame && frame->last_used_ns < cutoff;) {
+        frame_state *next = frame->next;
+        if (!frame->busy) {
+            frame_drop(frame);
+            metrics_add(METRIC_FRAME_EVICTIONS, 1);
+        }
+        frame = next;
+    }
+    pthread_mutex_unlock(&frame_lock);
+}
+
+// Charges bytes to the body budget. Returns 0, or -1 (and charges
+// nothing) if they do not fit.
+static int body_reserve(size_t bytes) {
+    pthread_mutex_lock(&body_lock);
+    int fits = body_bytes + bytes <= body_budget;
+    if (fits) body_bytes += bytes;
+    pthread_mutex_unlock(&body_lock);
+    if (!fits) return -1;
+    metrics_add(METRIC_BODY_BYTES, bytes);
+    return 0;
+}
+
+static void body_release(size_t bytes) {
+    if (bytes == 0) return;
+    pthread_mutex_lock(&body_lock);
+    body_bytes -= bytes;
+    pthread_mutex_unlock(&body_lock);
+    metrics_add(METRIC_BODY_BYTES, -(uint64_t)bytes);
+}
+
+// The plane, spectrum and mask of a streamed body, in one block charged
+// to the body budget. NULL if it does not fit or allocation failed.
+static request_ingest *ingest_create(const http_request *req) {
+    int width = req->width, height = req->height;
+    size_t plane_bytes = (size_t)width * height * sizeof(float);
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    if (plane_bytes < scratch_bytes) plane_bytes = scratch_bytes;
+    size_t spectrum_bytes = (size_t)(width / 2 + 1) * height * sizeof(float);
+    size_t mask_bytes = req->low_pass != 0.0f ? (size_t)height * sizeof(int) : 0;
+    size_t bytes = workspace_block_size(plane_bytes) + 2 * workspace_block_size(spectrum_bytes) +
+                   workspace_block_size(mask_bytes);
+    if (body_reserve(bytes) != 0) return NULL;
+    request_ingest *in = (request_ingest*)calloc(1, sizeof(request_ingest));
+    unsigned char *block = in ? (unsigned char*)aligned_alloc(WORKSPACE_ALIGN, bytes) : NULL;
+    if (!block) {
+        free(in);
+        body_release(bytes);
+        return NULL;
+    }
+    in->plane = (float*)block;
+    in->real = (float*)(block + workspace_block_size(plane_bytes));
+    in->imag = (float*)(block + workspace_block_size(plane_bytes) + workspace_block_size(spectrum_bytes));
+    if (mask_bytes != 0) {
+        in->mask = (int*)(block + bytes - workspace_block_size(mask_bytes));
+        fft_mask_lowpass(in->mask, width, height, req->low_pass_shape, req->low_pass);
+    }
+    pthread_mutex_init(&in->lock, NULL);
+    pthread_cond_init(&in->idle, NULL);
+    in->width = width;
+    in->height = height;
+    in->bytes = bytes;
+    in->refs = 1;
+    return in;
+}
+
+static void ingest_release(request_ingest *in) {
+    pthread_mutex_lock(&in->lock);
+    int last = --in->refs == 0;
+    pthread_mutex_unlock(&in->lock);
+    if (!last) return;
+    body_release(in->bytes);
+    pthread_mutex_destroy(&in->lock);
+    pthread_cond_destroy(&in->idle);
+    free(in->plane);
+    free(in);
+}
+
+// Runs the row FFTs of the rows published but not yet done. Called, and
+// returns, with in->lock held; drops it while transforming.
+static void ingest_rows(request_ingest *in) {
+    int begin = in->rows_done, end = in->rows_ready;
+    in->busy = 1;
+    pthread_mutex_unlock(&in->lock);
+    uint64_t start = metrics_now();
+    int status = two_d_fft_r2c_rows_pruned(in->plane, in->real, in->imag, in->width, in->height, begin, end,
+                                           in->mask);
+    uint64_t ns = metrics_now() - start;
+    pthread_mutex_lock(&in->lock);
+    in->fft_ns += ns;
+    if (status != 0) in->failed = 1;
+    in->rows_done = end;
+    in->busy = 0;
+    pthread_cond_broadcast(&in->idle);
+}
+
+// A row job, run by a compute worker: transforms published rows while
+// whole batches of them wait, then drops the job's reference.
+static void ingest_job(request_ingest *in) {
+    int rows = 0;
+    pthread_mutex_lock(&in->lock);
+    while (!in->busy && !in->failed &&
+           (size_t)(in->rows_ready - in->rows_done) * in->width >= STREAM_BATCH_PIXELS) {
+        rows += in->rows_ready - in->rows_done;
+        ingest_rows(in);
+    }
+    in->queued = 0;
+    pthread_mutex_unlock(&in->lock);
+    metrics_add(METRIC_ROWS_STREAMED, rows);
+    ingest_release(in);
+}
+
+// Called by the worker serving the request, once every row is published:
+// waits for a row job in progress and transforms the rows left. Returns
+// 0, or -1 if a row FFT failed.
+static int ingest_finish(request_ingest *in) {
+    pthread_mutex_lock(&in->lock);
+    for (;;) {
+        if (in->busy) {
+            pthread_cond_wait(&in->idle, &in->lock);
+        } else if (in->failed || in->rows_done == in->rows_ready) {
+            break;
+        } else {
+            ingest_rows(in);
+        }
+    }
+    int failed = in->failed;
+    pthread_mutex_unlock(&in->lock);
+    return failed ? -1 : 0;
+}
+
+static void rows_push(request_ingest *in) {
+    in->next = NULL;
+    pthread_mutex_lock(&queue_lock);
+    if (rows_tail) {
+        rows_tail->next = in;
+    } else {
+        rows_head = in;
+    }
+    rows_tail = in;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Widens the complete rows of the body buffered so far into the plane and
+// drops them from conn->buf. While more of the body is to come, a row job
+// is queued once STREAM_BATCH_PIXELS of published rows wait for one.
+static void ingest_feed(connection *conn) {
+    request_ingest *in = conn->ingest;
+    size_t width = (size_t)in->width;
+    unsigned char *body = (unsigned char*)conn->buf + conn->req.header_len;
+    size_t buffered = conn->len - conn->req.header_len;
+    size_t body_left = (size_t)conn->req.content_length - conn->body_dropped;
+    size_t used = (buffered < body_left ? buffered : body_left) / width * width;
+    if (used == 0) return;
+
+    uint64_t start = metrics_now();
+    float *row = in->plane + conn->body_dropped; // The rows so far, body_dropped pixels
+    for (size_t i = 0; i < used; ++i) {
+        row[i] = (float)body[i];
+    }
+    memmove(body, body + used, buffered - used);
+    conn->len -= used;
+    conn->need -= used;
+    conn->body_dropped += used;
+    in->convert_ns += metrics_now() - start;
+
+    int more = conn->body_dropped < (size_t)conn->req.content_length;
+    pthread_mutex_lock(&in->lock);
+    in->rows_ready += (int)(used / width);
+    int queue = more && !in->queued && (size_t)(in->rows_ready - in->rows_done) * width >= STREAM_BATCH_PIXELS;
+    if (queue) {
+        in->queued = 1;
+        in->refs++;
+    }
+    pthread_mutex_unlock(&in->lock);
+    if (queue) rows_push(in);
+}
+
+static void connection_close(connection *conn) {
+    close(conn->fd); // Also removes it from the epoll set
+    free(conn->buf);
+    if (conn->ingest) ingest_release(conn->ingest);
+    body_release(conn->body_charge);
+    frame_state_free(conn->frame);
+    frame_state_free(conn->decoder);
+    free(conn);
+}
+
+static void park_unlink(connection *conn) {
+    if (!conn->parked) return;
+    if (conn->park_prev) {
+        conn->park_prev->park_next = conn->park_next;
+    } else {
+        park_head = conn->park_next;
+    }
+    if (conn->park_next) conn->park_next->park_prev = conn->park_prev;
+    conn->park_prev = conn->park_next = NULL;
+    conn->parked = 0;
+}
+
+// Registers (op EPOLL_CTL_ADD) or re-arms (EPOLL_CTL_MOD) the socket and
+// parks the connection. Returns 0, or -1 if epoll_ctl failed.
+static int connection_park(connection *conn, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    pthread_mutex_lock(&park_lock);
+    conn->park_prev = NULL;
+    conn->park_next = park_head;
+    if (park_head) park_head->park_prev = conn;
+    park_head = conn;
+    conn->parked = 1;
+    // Under the lock, so that the stall sweep cannot close the connection
+    // before this thread is done with it
+    int status = epoll_ctl(epoll_fd, op, conn->fd, &ev);
+    if (status == -1) park_unlink(conn);
+    pthread_mutex_unlock(&park_lock);
+    return status;
+}
+
+// Called by the event loop for each connection it gets an event for.
+static void connection_unpark(connection *conn) {
+    pthread_mutex_lock(&park_lock);
+    park_unlink(conn);
+    pthread_mutex_unlock(&park_lock);
+}
+
+// Hands the connection back to the event loop for its next request.
+static void connection_rearm(connection *conn) {
+    if (connection_park(conn, EPOLL_CTL_MOD) == -1) {
+        perror("epoll_ctl rearm");
+        connection_close(conn);
+    }
+}
+
+// Closes the parked connections whose partial request (headers or body)
+// has had no new bytes for stall_ns. Runs on the event loop between
+// batches of events, so none of them can be in use.
+static void stall_sweep(void) {
+    uint64_t now = metrics_now();
+    connection *stalled = NULL;
+    pthread_mutex_lock(&park_lock);
+    for (connection *conn = park_head; conn;) {
+        connection *next = conn->park_next;
+        if ((conn->len > 0 || conn->need > 0) && now - conn->progress_ns > stall_ns) {
+            park_unlink(conn);
+            conn->park_next = stalled;
+            stalled = conn;
+        }
+        conn = next;
+    }
+    pthread_mutex_unlock(&park_lock);
+    while (stalled) {
+        connection *next = stalled->park_next;
+        metrics_add(METRIC_REQUESTS_STALLED, 1);
+        connection_close(stalled);
+        stalled = next;
+    }
+}
+
+// Shrinks a buffer grown for a large body, which the small requests that
+// usually follow on the connection do not need.
+static void connection_trim(connection *conn) {
+    if (conn->cap <= 4 * READ_CHUNK || conn->len > READ_CHUNK) return;
+    char *shrunk = (char*)realloc(conn->buf, 2 * READ_CHUNK);
+    if (shrunk) {
+        conn->buf = shrunk;
+        conn->cap = 2 * READ_CHUNK;
+    }
+}
+
+static void queue_push(connection *conn) {
+    conn->next = NULL;
+    conn->queued_ns = metrics_now();
+    pthread_mutex_lock(&queue_lock);
+    if (queue_tail) {
+        queue_tail->next = conn;
+    } else {
+        queue_head = conn;
+    }
+    queue_tail = conn;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Next unit of work: a row job (in *rows, returning NULL) or a connection.
+// Row jobs go first, since requests still arriving wait on them.
+static connection *queue_pop(request_ingest **rows) {
+    pthread_mutex_lock(&queue_lock);
+    while (!queue_head && !rows_head) {
+        pthread_cond_wait(&queue_cond, &queue_lock);
+    }
+    *rows = rows_head;
+    if (rows_head) {
+        rows_head = rows_head->next;
+        if (!rows_head) rows_tail = NULL;
+        pthread_mutex_unlock(&queue_lock);
+        return NULL;
+    }
+    connection *conn = queue_head;
+    queue_head = conn->next;
+    if (!queue_head) queue_tail = NULL;
+    pthread_mutex_unlock(&queue_lock);
+    return conn;
+}
+
+// Drops a served request from the connection buffer and gives back what
+// it held.
+static void request_done(connection *conn) {
+    if (conn->ingest) {
+        ingest_release(conn->ingest);
+        conn->ingest = NULL;
+    }
+    body_release(conn->body_charge);
+    conn->body_charge = 0;
+    size_t used = conn->req.consumed;
+    memmove(conn->buf, conn->buf + used, conn->len - used);
+    conn->len -= used;
+    conn->need = 0;
+    conn->body_dropped = 0;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    // Request buffers come from this worker's workspace, which stays sized
+    // for the largest image seen so far.
+    workspace ws;
+    workspace_init(&ws);
+    for (;;) {
+        request_ingest *rows;
+        connection *conn = queue_pop(&rows);
+        if (!conn) {
+            ingest_job(rows);
+            continue;
+        }
+        metrics_record(METRIC_STAGE_QUEUE, metrics_now() - conn->queued_ns);
+        // Serve every complete request already buffered (pipelining),
+        // then give the socket back to the event loop.
+        for (;;) {
+            unsigned long grows = ws.grows;
+            size_t capacity = ws.capacity;
+            uint64_t start = metrics_now();
+            handle_request(conn, &ws);
+            metrics_record(METRIC_STAGE_REQUEST, metrics_now() - start);
+            metrics_add(METRIC_BYTES_RECEIVED, conn->req.header_len + (size_t)conn->req.content_length);
+            if (ws.grows != grows) {
+                metrics_add(METRIC_WORKSPACE_GROWS, ws.grows - grows);
+                metrics_add(METRIC_WORKSPACE_BYTES, ws.capacity - capacity);
+            }
+            if (!conn->req.keep_alive) {
+                connection_close(conn);
+                break;
+            }
+            request_done(conn);
+            connection_trim(conn);
+            if (!request_ready(conn)) {
+                conn->progress_ns = metrics_now();
+                connection_rearm(conn);
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Sends every byte of iov (modified) on a non-blocking socket with one
+// sendmsg per attempt, waiting for space as needed. flags may add
+// MSG_MORE when more data follows shortly. Returns 0 on success, -1 if
+// the peer is gone or too slow.
+static int send_iov(int fd, struct iovec *iov, int count, int flags) {
+    while (count > 0 && iov->iov_len == 0) {
+        iov++;
+        count--;
+    }
+    while (count > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)count };
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | flags);
+        if (n > 0) {
+            while (count > 0 && (size_t)n >= iov->iov_len) {
+                n -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0) {
+                iov->iov_base = (char*)iov->iov_base + n;
+                iov->iov_len -= n;
+            }
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, SEND_TIMEOUT_MS) <= 0) return -1;
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int response_header(connection *conn, char *out, size_t size, const char *status, const char *content_type,
+                           const char *extra_headers, size_t body_len) {
+    return snprintf(out, size, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s%s\r\n", status,
+                    content_type, body_len, extra_headers ? extra_headers : "",
+                    conn->req.keep_alive ? "" : "Connection: close\r\n");
+}
+
+static void count_response(const char *status) {
+    metrics_add(status[0] == '2' ? METRIC_RESPONSES_2XX : status[0] == '4' ? METRIC_RESPONSES_4XX
+                                                                           : METRIC_RESPONSES_5XX,
+                1);
+}
+
+// extra_headers, if not NULL, is a run of complete CRLF-terminated lines.
+// The header and body leave in one sendmsg when the socket has room.
+static void send_response(connection *conn, const char *status, const char *content_type,
+                          const char *extra_headers, const void *body, size_t body_len) {
+    char http_header[384];
+    int header_len = response_header(conn, http_header, sizeof(http_header), status, content_type, extra_headers,
+                                     body_len);
+    struct iovec iov[2] = { { http_header, (size_t)header_len }, { (void*)body, body_len } };
+    uint64_t start = metrics_now();
+    if (send_iov(conn->fd, iov, 2, 0) != 0) {
+        conn->req.keep_alive = 0; // Drop the connection on a failed send
+    }
+    metrics_record(METRIC_STAGE_SEND, metrics_now() - start);
+    metrics_add(METRIC_BYTES_SENT, (size_t)header_len + body_len);
+    count_response(status);
+}
+
+// A 200 response whose body comes from simple_compress_stream, a chunk at
+// a time: the first chunk goes out behind the header, and every chunk but
+// the last is sent with MSG_MORE so the kernel can fill whole segments.
+// The stream size is known up front, so the response keeps a plain
+// Content-Length.
+typedef struct {
+    connection *conn;
+    size_t sent;      // Body bytes so far
+    uint64_t send_ns; // Time blocked in sendmsg
+} response_stream;
+
+static int response_sink(void *ctx, const unsigned char *data, size_t size, size_t stream_size) {
+    response_stream *rs = (response_stream*)ctx;
+    char http_header[384];
+    int header_len = 0;
+    if (rs->sent == 0) {
+        header_len = response_header(rs->conn, http_header, sizeof(http_header), "200 OK",
+                                     "application/octet-stream", NULL, stream_size);
+    }
+    struct iovec iov[2] = { { http_header, (size_t)header_len }, { (void*)data, size } };
+    rs->sent += size;
+    uint64_t start = metrics_now();
+    int status = send_iov(rs->conn->fd, iov, 2, rs->sent < stream_size ? MSG_MORE : 0);
+    rs->send_ns += metrics_now() - start;
+    metrics_add(METRIC_BYTES_SENT, (size_t)header_len + size);
+    return status;
+}
+
+static void send_error(connection *conn, const char *status, const char *message) {
+    send_response(conn, status, "text/plain", NULL, message, strlen(message));
+}
+
+// Checks the headers of a POST /compress against its body size. Returns
+// the message of the 400 answer, or NULL if the request can be served.
+static const char *compress_error(const http_request *req) {
+    // The body is raw 8-bit grayscale, or interleaved RGB with
+    // X-Image-Format: rgb, width x height as given by the X-Image-Width /
+    // X-Image-Height headers. Any size is accepted; the FFT handles
+    // non-power-of-two dimensions.
+    int width = req->width, height = req->height;
+    if (req->content_length == 0) return "Missing image data.\n";
+    if (width < 1 || height < 1 || width > MAX_IMAGE_DIM || height > MAX_IMAGE_DIM ||
+        req->content_length != (req->rgb ? IMAGE_CHANNELS_RGB : IMAGE_CHANNELS_GRAY) * width * height ||
+        (req->tile_size != 0 && simple_compress_tiled_bound(width, height, req->tile_size) == 0)) {
+        return "Bad image dimensions.\n";
+    }
+    // The low-pass filter prunes the whole-image FFT; tiles have none.
+    if (req->low_pass != 0.0f && (req->tile_size != 0 || !(req->low_pass > 0.0f && req->low_pass <= 1.0f))) {
+        return "Bad X-Low-Pass.\n";
+    }
+    // Color images take the whole-image path only.
+    if (req->rgb && (req->tile_size != 0 || req->low_pass != 0.0f)) {
+        return "X-Image-Format: rgb takes no X-Tile-Size or X-Low-Pass.\n";
+    }
+    return NULL;
+}
+
+// Whole-image gray compression reads its body row by row, so the body
+// can stream into the FFT input plane (request_ingest).
+static int request_streams(const http_request *req) {
+    return strcmp(req->method, "POST") == 0 && strcmp(req->uri, "/compress") == 0 && !req->rgb &&
+           req->tile_size == 0 && compress_error(req) == NULL;
+}
+
+// Returns 1 once conn->buf holds a whole request, or a request that can be
+// rejected without reading further (conn->req.malformed or over_budget is
+// then set). Once the headers are in and the body is not, conn->need is
+// the size of the request still to be buffered, and the body is charged
+// to the body budget: in full if buffered, as its plane and spectrum if
+// streamed (see ingest_feed, which keeps conn->need current).
+static int request_scan(connection *conn) {
+    // Headers parsed already: only the body is awaited.
+    if (conn->need) return conn->len >= conn->need;
+    memset(&conn->req, 0, sizeof(conn->req));
+    conn->req.width = DEFAULT_IMAGE_DIM;
+    conn->req.height = DEFAULT_IMAGE_DIM;
+    conn->req.chroma = 420;
+
+    size_t search = conn->len < MAX_HEADER_SIZE ? conn->len : MAX_HEADER_SIZE;
+    const char *end = NULL;
+    for (size_t i = 0; i + 4 <= search; ++i) {
+        if (memcmp(conn->buf + i, "\r\n\r\n", 4) == 0) {
+            end = conn->buf + i;
+            break;
+        }
+    }
+    if (!end) {
+        if (conn->len < MAX_HEADER_SIZE) return 0;
+        conn->req.malformed = 1;
+        return 1;
+    }
+
+    conn->req.header_len = (size_t)(end - conn->buf) + 4;
+    if (parse_http_request(conn->buf, conn->req.header_len, &conn->req) != 0) {
+        conn->req.malformed = 1;
+        return 1;
+    }
+    // A body we would reject anyway is not worth reading.
+    if (conn->req.content_length < 0 || conn->req.content_length > IMAGE_CHANNELS_RGB * MAX_IMAGE_DIM * MAX_IMAGE_DIM) {
+        conn->req.malformed = 1;
+        return 1;
+    }
+    size_t total = conn->req.header_len + (size_t)conn->req.content_length;
+    if (conn->len >= total) return 1;
+    if (request_streams(&conn->req)) {
+        conn->ingest = ingest_create(&conn->req);
+    } else if (body_reserve((size_t)conn->req.content_length) == 0) {
+        conn->body_charge = (size_t)conn->req.content_length;
+    }
+    if (!conn->ingest && !conn->body_charge) {
+        conn->req.over_budget = 1;
+        return 1;
+    }
+    conn->need = total;
+    if (conn->ingest) ingest_feed(conn);
+    return 0;
+}
+
+// request_scan, timed once it finds a request. The receive stage runs
+// from the first read that left the body incomplete to the last one.
+static int request_ready(connection *conn) {
+    uint64_t start = metrics_now();
+    if (!request_scan(conn)) {
+        if (conn->need && !conn->receive_ns) conn->receive_ns = start;
+        return 0;
+    }
+    metrics_record(METRIC_STAGE_PARSE, metrics_now() - start);
+    metrics_record(METRIC_STAGE_RECEIVE, conn->receive_ns ? start - conn->receive_ns : 0);
+    conn->receive_ns = 0;
+    return 1;
+}
+
+// The body of the current request, all of it buffered.
+static const unsigned char *request_body(const connection *conn) {
+    return (const unsigned char*)conn->buf + conn->req.header_len;
+}
+
+// Reads until the next request is buffered. Returns 1 once it is (see
+// request_ready), 0 if the socket runs dry first, -1 once the peer has
+// closed it or on error.
+static int connection_read(connection *conn) {
+    for (;;) {
+        if (conn->cap - conn->len < READ_CHUNK) {
+            // The buffer doubles as bytes arrive, so headers alone never
+            // reserve a large body, but it stops at the pending request
+            // plus one read.
+            size_t cap = conn->cap ? conn->cap * 2 : READ_CHUNK;
+            while (cap - conn->len < READ_CHUNK) cap *= 2;
+            if (conn->need && cap > conn->need + READ_CHUNK) cap = conn->need + READ_CHUNK;
+            char *grown = (char*)realloc(conn->buf, cap);
+            if (!grown) {
+                perror("realloc");
+                return -1;
+            }
+            conn->buf = grown;
+            conn->cap = cap;
+            metrics_add(METRIC_BUFFER_GROWS, 1);
+        }
+        ssize_t n = recv(conn->fd, conn->buf + conn->len, conn->cap - conn->len, 0);
+        if (n > 0) {
+            conn->len += n;
+            conn->progress_ns = metrics_now();
+            if (conn->ingest) ingest_feed(conn);
+            // The headers need no new scan until the body is complete.
+            if (conn->len < conn->need) continue;
+            if (request_ready(conn)) return 1;
+        } else if (n == 0) {
+            return -1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            perror("recv");
+            return -1;
+        }
+    }
+}
+
+static void accept_clients(int server_sock) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_addr_size = sizeof(client_addr);
+        int client_sock = accept4(server_sock, (struct sockaddr*)&client_addr, &client_addr_size, SOCK_NONBLOCK);
+        if (client_sock == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept");
+            }
+            return;
+        }
+
+        connection *conn = (connection*)calloc(1, sizeof(connection));
+        if (!conn) {
+            perror("calloc");
+            close(client_sock);
+            continue;
+        }
+        conn->fd = client_sock;
+        conn->progress_ns = metrics_now();
+        metrics_add(METRIC_CONNECTIONS, 1);
+        if (connection_park(conn, EPOLL_CTL_ADD) == -1) {
+            perror("epoll_ctl add");
+            connection_close(conn);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int port = PORT, backlog = DEFAULT_BACKLOG, workers = 0;
+    int server_sock;
+    struct sockaddr_in server_addr;
 
-int main() {
-    int server_sock, client_sock;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_addr_size;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:w:t:m:r:s:vh")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'b': backlog = atoi(optarg); break;
+        case 'w': workers = atoi(optarg); break;
+        case 'v': verbose = 1; break;
+        case 'm': frame_budget = (size_t)strtoul(optarg, NULL, 10) << 20; break;
+        case 'r': body_budget = (size_t)strtoul(optarg, NULL, 10) << 20; break;
+        case 's': stall_ns = (uint64_t)strtoul(optarg, NULL, 10) * 1000000000u; break;
+        case 't':
+            if (fft_set_threads(atoi(optarg)) != 0) exit(EXIT_FAILURE);
+            break;
+        default:
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (workers < 1) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
 
     // 1. Create socket
-    server_sock = socket(AF_INET, SOCK_STREAM, 0);
+    server_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (server_sock == -1) {
         perror("socket");
         exit(EXIT_FAILURE);
     }
+    int reuse = 1;
+    setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
     // Set up server address
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY; // Listen on all interfaces
-    server_addr.sin_port = htons(PORT);
+    server_addr.sin_port = htons(port);
 
     // 2. Bind socket
     if (bind(server_sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
@@ -41,171 +1023,842 @@ int main() {
     }
 
     // 3. Listen for incoming connections
-    if (listen(server_sock, 5) == -1) { // 5 pending connections
+    if (listen(server_sock, backlog) == -1) {
         perror("listen");
         close(server_sock);
         exit(EXIT_FAILURE);
     }
 
-    printf("Server listening on port %d...\n", PORT);
+    // 4. Register the listening socket and start the compute workers
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        perror("epoll_create1");
+        close(server_sock);
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL marks the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_sock, &ev) == -1) {
+        perror("epoll_ctl");
+        close(server_sock);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < workers; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(thread);
+    }
+
+    printf("Server listening on port %d (backlog %d, %d workers, %d FFT threads)...\n",
+           port, backlog, workers, fft_get_threads());
 
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t last_sweep = metrics_now();
     while (1) {
-        client_addr_size = sizeof(client_addr);
-        // 4. Accept a client connection
-        client_sock = accept(server_sock, (struct sockaddr*)&client_addr, &client_addr_size);
-        if (client_sock == -1) {
-            perror("accept");
-            continue; // Keep listening
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, SWEEP_MS);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            connection *conn = (connection*)events[i].data.ptr;
+            if (!conn) {
+                accept_clients(server_sock);
+                continue;
+            }
+            connection_unpark(conn);
+            int status = connection_read(conn);
+            if (status == 1) {
+                queue_push(conn);
+            } else if (status == 0 && !(events[i].events & (EPOLLHUP | EPOLLERR))) {
+                connection_rearm(conn);
+            } else {
+                connection_close(conn);
+            }
+        }
+        // After the batch, whose events may name connections the sweep
+        // closes
+        uint64_t now = metrics_now();
+        if (now - last_sweep >= (uint64_t)SWEEP_MS * 1000000u) {
+            frame_sweep();
+            stall_sweep();
+            last_sweep = now;
         }
-        printf("Accepted connection from %s:%d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-
-        handle_client(client_sock);
-        close(client_sock); // Close client socket after handling
     }
 
-    close(server_sock); // Never reached in this infinite loop
+    close(epoll_fd);
+    close(server_sock);
     return 0;
 }
 
-void handle_client(int client_sock) {
-    char request_buffer[BUFFER_SIZE];
-    char method[16], uri[256];
-    char *body_start = NULL;
-    int content_length = 0;
-    ssize_t bytes_received;
+// Plain-text counters showing where memory goes. In steady state only
+// "requests" moves: workspace_grows and fft_scratch_allocations stay put
+// once every worker has seen the largest image size in use.
+static void handle_stats(connection *conn) {
+    fft_alloc_stats fft_stats;
+    fft_get_alloc_stats(&fft_stats);
+    unsigned long long requests = metrics_counter(METRIC_REQUESTS_COMPRESS) +
+                                  metrics_counter(METRIC_REQUESTS_DECOMPRESS) +
+                                  metrics_counter(METRIC_REQUESTS_OTHER);
+    char body[768];
+    int len = snprintf(body, sizeof(body),
+                       "requests %llu\n"
+                       "workspace_grows %llu\n"
+                       "workspace_bytes %llu\n"
+                       "fft_plans_created %lu\n"
+                       "fft_scratch_allocations %lu\n"
+                       "fft_scratch_bytes %lu\n"
+                       "compress_input_bytes %llu\n"
+                       "compress_output_bytes %llu\n"
+                       "encode_ns %llu\n"
+                       "decompress_input_bytes %llu\n"
+                       "decompress_output_bytes %llu\n"
+                       "decode_ns %llu\n"
+                       "frame_bytes %llu\n"
+                       "frame_evictions %llu\n"
+                       "body_bytes %llu\n"
+                       "streamed_rows %llu\n"
+                       "stalled_requests %llu\n",
+                       requests, (unsigned long long)metrics_counter(METRIC_WORKSPACE_GROWS),
+                       (unsigned long long)metrics_counter(METRIC_WORKSPACE_BYTES), fft_stats.plans_created,
+                       fft_stats.scratch_allocations, fft_stats.scratch_bytes,
+                       (unsigned long long)metrics_counter(METRIC_COMPRESS_INPUT_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_COMPRESS_OUTPUT_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_ENCODE_NS),
+                       (unsigned long long)metrics_counter(METRIC_DECOMPRESS_INPUT_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_DECOMPRESS_OUTPUT_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_DECODE_NS),
+                       (unsigned long long)metrics_counter(METRIC_FRAME_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_FRAME_EVICTIONS),
+                       (unsigned long long)metrics_counter(METRIC_BODY_BYTES),
+                       (unsigned long long)metrics_counter(METRIC_ROWS_STREAMED),
+                       (unsigned long long)metrics_counter(METRIC_REQUESTS_STALLED));
+    send_response(conn, "200 OK", "text/plain", NULL, body, len);
+}
 
-    bytes_received = recv(client_sock, request_buffer, BUFFER_SIZE - 1, 0);
-    if (bytes_received <= 0) {
-        perror("recv");
+// Per-stage latency histograms and counters in the Prometheus text format
+// (see metrics.h), followed by the FFT allocation counts of GET /stats.
+static void handle_metrics(connection *conn, workspace *ws) {
+    if (workspace_begin(ws, workspace_block_size(METRICS_TEXT_MAX)) != 0) {
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    char *body = (char*)workspace_alloc(ws, METRICS_TEXT_MAX);
+    size_t len = metrics_format(body, METRICS_TEXT_MAX);
+    fft_alloc_stats fft_stats;
+    fft_get_alloc_stats(&fft_stats);
+    if (len < METRICS_TEXT_MAX) {
+        len += snprintf(body + len, METRICS_TEXT_MAX - len,
+                        "# HELP image_compress_fft_plans_created_total FFT plans built.\n"
+                        "# TYPE image_compress_fft_plans_created_total counter\n"
+                        "image_compress_fft_plans_created_total %lu\n"
+                        "# HELP image_compress_fft_scratch_allocations_total FFT scratch (re)allocations.\n"
+                        "# TYPE image_compress_fft_scratch_allocations_total counter\n"
+                        "image_compress_fft_scratch_allocations_total %lu\n"
+                        "# HELP image_compress_fft_scratch_bytes Memory held by FFT scratch buffers.\n"
+                        "# TYPE image_compress_fft_scratch_bytes gauge\n"
+                        "image_compress_fft_scratch_bytes %lu\n",
+                        fft_stats.plans_created, fft_stats.scratch_allocations, fft_stats.scratch_bytes);
+    }
+    if (len >= METRICS_TEXT_MAX) {
+        send_error(conn, "500 Internal Server Error", "Metrics do not fit.\n");
         return;
     }
-    request_buffer[bytes_received] = '\0'; // Null-terminate
+    send_response(conn, "200 OK", "text/plain; version=0.0.4", NULL, body, len);
+}
+
+// Ratio against the raw 8-bit image; throughput over the coefficients the
+// coder quantizes.
+static void log_compress(const compression_stats *cstats, int width, int height, int channels, int tiled) {
+    size_t pixels = (size_t)width * height;
+    size_t input_bytes = pixels * channels;
+    uint64_t encode_ns = (uint64_t)(cstats->encode_seconds * 1e9);
+    if (tiled) {
+        metrics_record(METRIC_STAGE_TILED_ENCODE, encode_ns);
+    } else {
+        uint64_t quantize_ns = (uint64_t)(cstats->quantize_seconds * 1e9);
+        metrics_record(METRIC_STAGE_QUANTIZE, quantize_ns);
+        metrics_record(METRIC_STAGE_ENTROPY, encode_ns - quantize_ns);
+    }
+    metrics_add(METRIC_PIXELS_COMPRESSED, pixels);
+    metrics_add(METRIC_COMPRESS_INPUT_BYTES, input_bytes);
+    metrics_add(METRIC_COMPRESS_OUTPUT_BYTES, cstats->output_bytes);
+    metrics_add(METRIC_ENCODE_NS, encode_ns);
+    if (!verbose) return;
+    printf("Compressed %dx%d: %zu -> %zu bytes (ratio %.2f), %zu/%zu zero coefficients, encode %.1f MB/s\n",
+           width, height, input_bytes, cstats->output_bytes, (double)input_bytes / cstats->output_bytes,
+           cstats->zero_coefficients, cstats->coefficients,
+           cstats->coefficients * sizeof(float) / 1e6 / cstats->encode_seconds);
+}
 
-    // Basic HTTP request parsing
-    if (parse_http_request(request_buffer, method, uri, &body_start, &content_length) != 0) {
-        // Simple error response
-        const char *response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 15\r\n\r\nBad Request!\n";
-        send(client_sock, response, strlen(response), 0);
+// POST /compress with X-Tile-Size: the tiles are transformed straight from
+// the 8-bit pixels in the request body, so there is no float plane.
+static void handle_compress_tiled(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    int width = req->width, height = req->height;
+    size_t bound = simple_compress_tiled_bound(width, height, req->tile_size);
+    size_t scratch_bytes = simple_compress_tiled_scratch_size(width, height, req->tile_size);
+    size_t needed = workspace_block_size(scratch_bytes) + workspace_block_size(bound);
+    if (workspace_begin(ws, needed) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
         return;
     }
+    void *scratch = workspace_alloc(ws, scratch_bytes);
+    unsigned char *compressed_data = (unsigned char*)workspace_alloc(ws, bound);
 
-    printf("Method: %s, URI: %s, Content-Length: %d\n", method, uri, content_length);
+    compression_stats cstats;
+    size_t compressed_size = simple_compress_tiled(request_body(conn), width, height, req->tile_size,
+                                                   COMPRESSION_DEFAULT_QUANTIZATION, compressed_data, scratch,
+                                                   &cstats);
+    if (compressed_size == 0) {
+        send_error(conn, "500 Internal Server Error", "Compression failed.\n");
+        return;
+    }
+    log_compress(&cstats, width, height, IMAGE_CHANNELS_GRAY, 1);
+    send_response(conn, "200 OK", "application/octet-stream", NULL, compressed_data, compressed_size);
+}
 
-    // Only handle POST to /compress
-    if (strcmp(method, "POST") == 0 && strcmp(uri, "/compress") == 0) {
-        if (body_start == NULL || content_length == 0) {
-            const char *response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 22\r\n\r\nMissing image data.\n";
-            send(client_sock, response, strlen(response), 0);
-            return;
-        }
+// POST /compress with X-Image-Format: rgb: the pixels are converted to Y,
+// Cb and Cr planes, and the three FFTs run as one batch on the pool.
+static void handle_compress_color(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    int width = req->width, height = req->height;
+    int color = req->chroma == 444 ? COMPRESSION_COLOR_YCBCR444 : COMPRESSION_COLOR_YCBCR420;
+    size_t bound = simple_compress_color_bound(width, height, color);
 
-        // --- Image Processing Workflow ---
-        // For simplicity, let's assume raw grayscale image data (e.g., 256x256 uint8_t)
-        // You'd need to define your image format (e.g., width, height, pixel format)
-        int width = 256; // Example
-        int height = 256; // Example
-
-        // This assumes the body directly contains the raw pixel data.
-        // In a real scenario, you'd need to deserialize image data
-        // (e.g., read width/height from the header, or a custom format).
-        float *image_pixels_float = (float*)malloc(width * height * sizeof(float));
-        if (!image_pixels_float) {
-            perror("malloc");
-            const char *response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 26\r\n\r\nMemory allocation failed.\n";
-            send(client_sock, response, strlen(response), 0);
-            return;
-        }
+    // As in handle_compress, the Y plane doubles as the coder's scratch.
+    fft_plane planes[COMPRESSION_MAX_PLANES];
+    size_t plane_bytes[COMPRESSION_MAX_PLANES], spectrum_bytes[COMPRESSION_MAX_PLANES];
+    size_t needed = workspace_block_size(bound);
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        compression_plane_size(color, p, width, height, &planes[p].width, &planes[p].height);
+        plane_bytes[p] = (size_t)planes[p].width * planes[p].height * sizeof(float);
+        spectrum_bytes[p] = (size_t)(planes[p].width / 2 + 1) * planes[p].height * sizeof(float);
+        needed += workspace_block_size(plane_bytes[p]) + 2 * workspace_block_size(spectrum_bytes[p]);
+    }
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    if (plane_bytes[0] < scratch_bytes) {
+        needed += workspace_block_size(scratch_bytes) - workspace_block_size(plane_bytes[0]);
+        plane_bytes[0] = scratch_bytes;
+    }
+    if (workspace_begin(ws, needed) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    unsigned char *compressed_data = (unsigned char*)workspace_alloc(ws, bound);
+    const float *fft_real[COMPRESSION_MAX_PLANES], *fft_imag[COMPRESSION_MAX_PLANES];
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        planes[p].pixels = (float*)workspace_alloc(ws, plane_bytes[p]);
+        planes[p].real = (float*)workspace_alloc(ws, spectrum_bytes[p]);
+        planes[p].imag = (float*)workspace_alloc(ws, spectrum_bytes[p]);
+        fft_real[p] = planes[p].real;
+        fft_imag[p] = planes[p].imag;
+    }
 
-        // Convert received byte data to float for FFT
-        for (int i = 0; i < width * height; ++i) {
-            // Assuming 8-bit grayscale for simplicity, scale to [0, 1] or [0, 255]
-            image_pixels_float[i] = (float)((unsigned char)body_start[i]);
+    uint64_t t1 = metrics_now();
+    image_rgb_to_ycbcr(request_body(conn), width, height, color, planes[0].pixels, planes[1].pixels, planes[2].pixels);
+    uint64_t t2 = metrics_now();
+    if (two_d_fft_r2c_planes(planes, COMPRESSION_MAX_PLANES) != 0) {
+        send_error(conn, "500 Internal Server Error", "Transform failed.\n");
+        return;
+    }
+    uint64_t t3 = metrics_now();
+    metrics_record(METRIC_STAGE_CONVERT, t2 - t1);
+    metrics_record(METRIC_STAGE_FFT, t3 - t2);
+
+    compression_stats cstats;
+    size_t compressed_size = simple_compress_color(fft_real, fft_imag, width, height, color,
+                                                   COMPRESSION_DEFAULT_QUANTIZATION, compressed_data,
+                                                   planes[0].pixels, &cstats);
+    if (compressed_size == 0) {
+        send_error(conn, "500 Internal Server Error", "Compression failed.\n");
+        return;
+    }
+    log_compress(&cstats, width, height, IMAGE_CHANNELS_RGB, 0);
+    send_response(conn, "200 OK", "application/octet-stream", NULL, compressed_data, compressed_size);
+}
+
+// Answers a request frame_acquire refused.
+static void frame_refused(connection *conn, int status) {
+    if (status == -1) {
+        send_error(conn, "503 Service Unavailable", "Frame state over the server's budget; retry later.\n");
+    } else {
+        conn->req.keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+    }
+}
+
+// POST /frame: one gray frame of a video sequence sent over one
+// connection. Only the rows whose bytes changed since the connection's
+// last frame are transformed again (fft_session_frame), and the spectrum
+// is coded as its difference from the last frame's (simple_compress_frame),
+// so a still scene costs a few bytes. The first frame, a frame of a new
+// size, and any frame sent with X-Key-Frame: 1 are coded as key frames,
+// which decode on their own; so is the first frame after the connection's
+// state was evicted (see frame_acquire). X-Frame: key|delta says which was
+// sent and X-Changed-Rows how many rows were transformed. 503 if the
+// state does not fit in the frame budget.
+static void handle_frame(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    int width = req->width, height = req->height;
+    if (width < 1 || height < 1 || width > MAX_FRAME_DIM || height > MAX_FRAME_DIM ||
+        req->content_length != width * height) {
+        send_error(conn, "400 Bad Request", "Bad frame dimensions.\n");
+        return;
+    }
+    if (req->rgb || req->tile_size != 0 || req->low_pass != 0.0f) {
+        send_error(conn, "400 Bad Request", "Frames are gray, without X-Tile-Size or X-Low-Pass.\n");
+        return;
+    }
+
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    size_t bound = simple_compress_bound(width, height);
+    int key = req->key_frame;
+    int fresh = frame_acquire(&conn->frame, width, height, 1);
+    if (fresh < 0) {
+        frame_refused(conn, fresh);
+        return;
+    }
+    frame_state *frame = conn->frame;
+    if (fresh) key = 1;
+    size_t needed = workspace_block_size(scratch_bytes) + workspace_block_size(bound);
+    if (workspace_begin(ws, needed) != 0) {
+        frame_release(frame);
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    void *scratch = workspace_alloc(ws, scratch_bytes);
+    unsigned char *compressed_data = (unsigned char*)workspace_alloc(ws, bound);
+
+    uint64_t t1 = metrics_now();
+    const float *fft_real, *fft_imag;
+    int changed_rows = fft_session_frame(frame->session, request_body(conn), &fft_real, &fft_imag);
+    if (changed_rows < 0) {
+        frame_release(frame);
+        send_error(conn, "500 Internal Server Error", "Transform failed.\n");
+        return;
+    }
+    metrics_record(METRIC_STAGE_FFT, metrics_now() - t1);
+
+    compression_stats cstats;
+    size_t compressed_size = simple_compress_frame(fft_real, fft_imag, width, height,
+                                                   COMPRESSION_DEFAULT_QUANTIZATION, frame->reference, &key,
+                                                   compressed_data, scratch, &cstats);
+    frame_release(frame);
+    if (compressed_size == 0) {
+        send_error(conn, "500 Internal Server Error", "Compression failed.\n");
+        return;
+    }
+    log_compress(&cstats, width, height, IMAGE_CHANNELS_GRAY, 0);
+    char headers[64];
+    snprintf(headers, sizeof(headers), "X-Frame: %s\r\nX-Changed-Rows: %d\r\n", key ? "key" : "delta",
+             changed_rows);
+    send_response(conn, "200 OK", "application/octet-stream", headers, compressed_data, compressed_size);
+}
+
+static void handle_request(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    // The event loop buffered the whole body, whether or not it is used,
+    // less the rows of a streamed body, widened and dropped as they came.
+    req->consumed = req->header_len + (size_t)req->content_length - conn->body_dropped;
+
+    if (req->malformed) {
+        req->keep_alive = 0;
+        metrics_add(METRIC_REQUESTS_OTHER, 1);
+        send_error(conn, "400 Bad Request", "Bad Request!\n");
+        return;
+    }
+    // The body was never read, so the connection cannot go on.
+    if (req->over_budget) {
+        req->keep_alive = 0;
+        metrics_add(METRIC_REQUESTS_OTHER, 1);
+        send_error(conn, "503 Service Unavailable", "Request body over the server's budget; retry later.\n");
+        return;
+    }
+
+    if (verbose) printf("Method: %s, URI: %s, Content-Length: %d\n", req->method, req->uri, req->content_length);
+
+    if (strcmp(req->method, "GET") == 0 &&
+        (strcmp(req->uri, "/stats") == 0 || strcmp(req->uri, "/metrics") == 0)) {
+        metrics_add(METRIC_REQUESTS_OTHER, 1);
+        if (strcmp(req->uri, "/stats") == 0) {
+            handle_stats(conn);
+        } else {
+            handle_metrics(conn, ws);
         }
+        return;
+    }
+
+    if (strcmp(req->method, "POST") == 0 && strcmp(req->uri, "/decompress") == 0) {
+        metrics_add(METRIC_REQUESTS_DECOMPRESS, 1);
+        handle_decompress(conn, ws);
+        return;
+    }
+
+    if (strcmp(req->method, "POST") == 0 && strcmp(req->uri, "/frame") == 0) {
+        metrics_add(METRIC_REQUESTS_COMPRESS, 1);
+        handle_frame(conn, ws);
+        return;
+    }
+
+    if (strcmp(req->method, "POST") == 0 && strcmp(req->uri, "/decompress-frame") == 0) {
+        metrics_add(METRIC_REQUESTS_DECOMPRESS, 1);
+        handle_decompress_frame(conn, ws);
+        return;
+    }
 
+    // Otherwise only handle POST to /compress
+    if (strcmp(req->method, "POST") != 0 || strcmp(req->uri, "/compress") != 0) {
+        // Not found or unsupported method
+        metrics_add(METRIC_REQUESTS_OTHER, 1);
+        send_error(conn, "404 Not Found", "Not Found!\n");
+        return;
+    }
+    metrics_add(METRIC_REQUESTS_COMPRESS, 1);
+    const char *error = compress_error(req);
+    if (error) {
+        send_error(conn, "400 Bad Request", error);
+        return;
+    }
+    if (req->tile_size != 0) {
+        handle_compress_tiled(conn, ws);
+        return;
+    }
+    if (req->rgb) {
+        handle_compress_color(conn, ws);
+        return;
+    }
+    int width = req->width, height = req->height;
+    size_t pixels = (size_t)width * height;
+    int spectrum_width = width / 2 + 1;
+    size_t spectrum_bytes = (size_t)spectrum_width * height * sizeof(float);
+
+    // Every buffer of the request comes out of the worker's workspace,
+    // unless the body streamed into the buffers of its request_ingest. The
+    // input plane is dead after the FFT and doubles as the coder's scratch.
+    // The response needs only one RESPONSE_CHUNK, whatever the image size.
+    request_ingest *in = conn->ingest;
+    size_t plane_bytes = pixels * sizeof(float);
+    size_t scratch_bytes = simple_compress_scratch_size(width, height);
+    if (plane_bytes < scratch_bytes) plane_bytes = scratch_bytes;
+    size_t mask_bytes = req->low_pass != 0.0f ? (size_t)height * sizeof(int) : 0;
+    size_t needed = workspace_block_size(RESPONSE_CHUNK);
+    if (!in) {
+        needed += workspace_block_size(plane_bytes) + 2 * workspace_block_size(spectrum_bytes) +
+                  workspace_block_size(mask_bytes);
+    }
+    if (workspace_begin(ws, needed) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    unsigned char *chunk = (unsigned char*)workspace_alloc(ws, RESPONSE_CHUNK);
+    float *image_pixels_float, *fft_real, *fft_imag;
 
-        // 1. Perform 2D FFT
-        // Output will be complex numbers (real and imaginary parts)
-        float *fft_real = (float*)malloc(width * height * sizeof(float));
-        float *fft_imag = (float*)malloc(width * height * sizeof(float));
-        if (!fft_real || !fft_imag) {
-            perror("malloc");
-            const char *response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 26\r\n\r\nMemory allocation failed.\n";
-            send(client_sock, response, strlen(response), 0);
-            free(image_pixels_float); free(fft_real); free(fft_imag); // Free what's allocated
+    // 1. Widen the pixels and perform the 2D FFT. The input is real, so
+    // only the width/2 + 1 non-redundant columns of the spectrum are
+    // computed and stored (Hermitian symmetry). With X-Low-Pass the FFT
+    // computes only the bins the mask keeps; the others are coded as
+    // zeros, so the stream format does not change.
+    if (in) {
+        // Streamed: the rows are widened and most of them transformed
+        // already; finish the row pass and run the column pass.
+        image_pixels_float = in->plane;
+        fft_real = in->real;
+        fft_imag = in->imag;
+        uint64_t t1 = metrics_now();
+        if (ingest_finish(in) != 0 || two_d_fft_r2c_columns_pruned(fft_real, fft_imag, width, height, in->mask) != 0) {
+            send_error(conn, "500 Internal Server Error", "Transform failed.\n");
             return;
         }
-
-        // Call the 2D FFT function (defined in fft.c)
-        // This is a placeholder; a real FFT takes real input and produces complex output.
-        // You'd need to handle input/output complex arrays.
-        two_d_fft(image_pixels_float, fft_real, fft_imag, width, height);
-
-        // 2. Apply Compression (Quantization + Simple Encoding)
-        // This will be a very basic quantization for demonstration
-        unsigned char *compressed_data = NULL;
-        size_t compressed_size = 0;
-        
-        // This function will take fft_real and fft_imag, quantize, and encode.
-        // Returns dynamically allocated compressed_data and its size.
-        simple_compress(fft_real, fft_imag, width, height, &compressed_data, &compressed_size);
-
-        if (!compressed_data || compressed_size == 0) {
-            const char *response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 26\r\n\r\nCompression failed.\n";
-            send(client_sock, response, strlen(response), 0);
-            free(image_pixels_float); free(fft_real); free(fft_imag);
+        metrics_record(METRIC_STAGE_CONVERT, in->convert_ns);
+        metrics_record(METRIC_STAGE_FFT, in->fft_ns + (metrics_now() - t1));
+    } else {
+        image_pixels_float = (float*)workspace_alloc(ws, plane_bytes);
+        fft_real = (float*)workspace_alloc(ws, spectrum_bytes);
+        fft_imag = (float*)workspace_alloc(ws, spectrum_bytes);
+        int *mask = NULL;
+        if (mask_bytes != 0) {
+            mask = (int*)workspace_alloc(ws, mask_bytes);
+            fft_mask_lowpass(mask, width, height, req->low_pass_shape, req->low_pass);
+        }
+        uint64_t t0 = metrics_now();
+        const unsigned char *raw = request_body(conn);
+        for (size_t i = 0; i < pixels; ++i) {
+            image_pixels_float[i] = (float)raw[i];
+        }
+        uint64_t t1 = metrics_now();
+        if (two_d_fft_r2c_pruned(image_pixels_float, fft_real, fft_imag, width, height, mask) != 0) {
+            send_error(conn, "500 Internal Server Error", "Transform failed.\n");
             return;
         }
+        metrics_record(METRIC_STAGE_CONVERT, t1 - t0);
+        metrics_record(METRIC_STAGE_FFT, metrics_now() - t1);
+    }
 
-        // --- Prepare HTTP Response ---
-        char http_header[256];
-        snprintf(http_header, sizeof(http_header),
-                 "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\n\r\n",
-                 compressed_size);
+    // 2. Apply Compression (Quantization + Entropy Coding), sending each
+    // chunk of the stream as soon as it is coded
+    compression_stats cstats;
+    response_stream rs = { conn, 0, 0 };
+    size_t compressed_size = simple_compress_stream(fft_real, fft_imag, width, height,
+                                                    COMPRESSION_DEFAULT_QUANTIZATION, chunk, RESPONSE_CHUNK,
+                                                    image_pixels_float, response_sink, &rs, &cstats);
+    metrics_record(METRIC_STAGE_SEND, rs.send_ns);
+    if (compressed_size == 0) {
+        if (rs.sent == 0) {
+            send_error(conn, "500 Internal Server Error", "Compression failed.\n");
+        } else {
+            req->keep_alive = 0; // Failed mid-body: the response cannot be finished
+        }
+        return;
+    }
+    metrics_add(METRIC_RESPONSES_2XX, 1);
+    // The coder's time, without the sends it waited on
+    cstats.encode_seconds -= rs.send_ns * 1e-9;
+    log_compress(&cstats, width, height, IMAGE_CHANNELS_GRAY, 0);
+}
 
-        // Send header
-        send(client_sock, http_header, strlen(http_header), 0);
-        // Send compressed data
-        send(client_sock, compressed_data, compressed_size, 0);
+static void log_decompress(const compression_stats *cstats, int width, int height, int channels,
+                           size_t stream_bytes, int tiled) {
+    size_t pixels = (size_t)width * height;
+    size_t output_bytes = pixels * channels;
+    metrics_record(tiled ? METRIC_STAGE_TILED_DECODE : METRIC_STAGE_ENTROPY_DECODE,
+                   (uint64_t)(cstats->decode_seconds * 1e9));
+    metrics_add(METRIC_PIXELS_DECOMPRESSED, pixels);
+    metrics_add(METRIC_DECOMPRESS_INPUT_BYTES, stream_bytes);
+    metrics_add(METRIC_DECOMPRESS_OUTPUT_BYTES, output_bytes);
+    metrics_add(METRIC_DECODE_NS, (uint64_t)(cstats->decode_seconds * 1e9));
+    if (!verbose) return;
+    printf("Decompressed %dx%d: %zu -> %zu bytes, decode %.1f MB/s\n", width, height, stream_bytes, output_bytes,
+           cstats->coefficients * sizeof(float) / 1e6 / cstats->decode_seconds);
+}
 
-        // Clean up
-        free(image_pixels_float);
-        free(fft_real);
-        free(fft_imag);
-        free(compressed_data);
+static void send_pixels(connection *conn, const unsigned char *pixels, int width, int height, int channels) {
+    char dims[128];
+    snprintf(dims, sizeof(dims), "X-Image-Width: %d\r\nX-Image-Height: %d\r\n%s", width, height,
+             channels == IMAGE_CHANNELS_RGB ? "X-Image-Format: rgb\r\n" : "");
+    send_response(conn, "200 OK", "application/octet-stream", dims, pixels, (size_t)width * height * channels);
+}
 
-    } else {
-        // Not found or unsupported method
-        const char *response = "HTTP/1.1 404 Not Found\r\nContent-Length: 14\r\n\r\nNot Found!\n";
-        send(client_sock, response, strlen(response), 0);
+// Tiled streams decode tile by tile straight to 8-bit pixels, so only the
+// output needs a buffer. With X-Region only that part of the image is
+// decoded and returned.
+static void decompress_tiled(connection *conn, workspace *ws, const compression_info *info) {
+    http_request *req = &conn->req;
+    size_t stream_bytes = (size_t)req->content_length;
+    int x = 0, y = 0, width = info->width, height = info->height;
+    if (req->has_region) {
+        x = req->region[0];
+        y = req->region[1];
+        width = req->region[2];
+        height = req->region[3];
+    }
+    if (x < 0 || y < 0 || width < 1 || height < 1 || x > info->width - width || y > info->height - height) {
+        send_error(conn, "400 Bad Request", "Bad region.\n");
+        return;
+    }
+    size_t pixels = (size_t)width * height;
+    if (workspace_begin(ws, workspace_block_size(pixels)) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    unsigned char *image_pixels = (unsigned char*)workspace_alloc(ws, pixels);
+
+    compression_stats cstats;
+    if (simple_decompress_region(request_body(conn), stream_bytes, x, y, width, height, image_pixels, &cstats) != 0) {
+        send_error(conn, "400 Bad Request", "Bad compressed stream.\n");
+        return;
     }
+    log_decompress(&cstats, width, height, IMAGE_CHANNELS_GRAY, stream_bytes, 1);
+    send_pixels(conn, image_pixels, width, height, IMAGE_CHANNELS_GRAY);
 }
 
-// Very basic HTTP request parsing (only extracts method, URI, and Content-Length)
-int parse_http_request(char *request, char *method, char *uri, char **body_start, int *content_length) {
-    char *line = strtok(request, "\r\n");
-    if (!line) return -1; // No request line
+// Color streams: the planes are decoded, inverse transformed as one batch
+// and converted back to interleaved RGB.
+static void decompress_color(connection *conn, workspace *ws, const compression_info *info) {
+    http_request *req = &conn->req;
+    size_t stream_bytes = (size_t)req->content_length;
+    int width = info->width, height = info->height;
+    size_t rgb_bytes = (size_t)width * height * IMAGE_CHANNELS_RGB;
 
-    // Parse request line (e.g., "POST /compress HTTP/1.1")
-    if (sscanf(line, "%15s %255s HTTP/1.1", method, uri) != 2) {
-        return -1; // Malformed request line
+    fft_plane planes[COMPRESSION_MAX_PLANES];
+    size_t plane_bytes[COMPRESSION_MAX_PLANES], spectrum_bytes[COMPRESSION_MAX_PLANES];
+    size_t needed = workspace_block_size(rgb_bytes);
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        compression_plane_size(info->color, p, width, height, &planes[p].width, &planes[p].height);
+        plane_bytes[p] = (size_t)planes[p].width * planes[p].height * sizeof(float);
+        spectrum_bytes[p] = (size_t)(planes[p].width / 2 + 1) * planes[p].height * sizeof(float);
+        needed += workspace_block_size(plane_bytes[p]) + 2 * workspace_block_size(spectrum_bytes[p]);
+    }
+    if (workspace_begin(ws, needed) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    unsigned char *rgb = (unsigned char*)workspace_alloc(ws, rgb_bytes);
+    float *fft_real[COMPRESSION_MAX_PLANES], *fft_imag[COMPRESSION_MAX_PLANES];
+    for (int p = 0; p < COMPRESSION_MAX_PLANES; ++p) {
+        planes[p].pixels = (float*)workspace_alloc(ws, plane_bytes[p]);
+        planes[p].real = (float*)workspace_alloc(ws, spectrum_bytes[p]);
+        planes[p].imag = (float*)workspace_alloc(ws, spectrum_bytes[p]);
+        fft_real[p] = planes[p].real;
+        fft_imag[p] = planes[p].imag;
     }
 
-    *content_length = 0;
-    *body_start = NULL;
+    compression_stats cstats;
+    if (simple_decompress_color(request_body(conn), stream_bytes, fft_real, fft_imag, &cstats) != 0) {
+        send_error(conn, "400 Bad Request", "Bad compressed stream.\n");
+        return;
+    }
 
-    // Parse headers
-    while ((line = strtok(NULL, "\r\n")) != NULL && strlen(line) > 0) {
-        if (strncmp(line, "Content-Length:", 15) == 0) {
-            *content_length = atoi(line + 15);
-        }
+    uint64_t start = metrics_now();
+    if (two_d_ifft_c2r_planes(planes, COMPRESSION_MAX_PLANES) != 0) {
+        send_error(conn, "500 Internal Server Error", "Transform failed.\n");
+        return;
     }
+    image_ycbcr_to_rgb(planes[0].pixels, planes[1].pixels, planes[2].pixels, width, height, info->color, rgb);
+    metrics_record(METRIC_STAGE_IFFT, metrics_now() - start);
+
+    log_decompress(&cstats, width, height, IMAGE_CHANNELS_RGB, stream_bytes, 0);
+    send_pixels(conn, rgb, width, height, IMAGE_CHANNELS_RGB);
+}
 
-    // The body starts after the double CRLF following the headers
-    // This is a simplification; a robust parser would find the actual "\r\n\r\n" sequence.
-    char *header_end = strstr(request, "\r\n\r\n");
-    if (header_end) {
-        *body_start = header_end + 4; // Move past "\r\n\r\n"
+// POST /decompress: the body is a stream from /compress; the response is
+// the reconstructed raw 8-bit image, with its size in the X-Image-Width /
+// X-Image-Height headers and, for color streams, X-Image-Format: rgb.
+static void handle_decompress(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    const unsigned char *stream = request_body(conn);
+    size_t stream_bytes = (size_t)req->content_length;
+    compression_info info;
+
+    // The header gives the image size, and with it every buffer size.
+    if (simple_decompress_info(stream, stream_bytes, &info) != 0 || info.width > MAX_IMAGE_DIM ||
+        info.height > MAX_IMAGE_DIM || (req->has_region && info.mode != COMPRESSION_MODE_TILED)) {
+        send_error(conn, "400 Bad Request", "Bad compressed stream.\n");
+        return;
+    }
+    if (info.mode == COMPRESSION_MODE_TILED) {
+        decompress_tiled(conn, ws, &info);
+        return;
+    }
+    if (info.color != COMPRESSION_COLOR_GRAY) {
+        decompress_color(conn, ws, &info);
+        return;
+    }
+    int width = info.width, height = info.height;
+    size_t pixels = (size_t)width * height;
+    size_t spectrum_bytes = (size_t)(width / 2 + 1) * height * sizeof(float);
+    size_t plane_bytes = pixels * sizeof(float);
+    size_t needed = 2 * workspace_block_size(spectrum_bytes) + workspace_block_size(plane_bytes);
+    if (workspace_begin(ws, needed) != 0) {
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    float *fft_real = (float*)workspace_alloc(ws, spectrum_bytes);
+    float *fft_imag = (float*)workspace_alloc(ws, spectrum_bytes);
+    float *image_pixels_float = (float*)workspace_alloc(ws, plane_bytes);
+
+    // 1. Entropy decoding and dequantization
+    compression_stats cstats;
+    if (simple_decompress(stream, stream_bytes, fft_real, fft_imag, &cstats) != 0) {
+        send_error(conn, "400 Bad Request", "Bad compressed stream.\n");
+        return;
+    }
+
+    // 2. Inverse 2D FFT, then round to 8 bits in place (the bytes end up
+    // at the front of the float plane)
+    uint64_t start = metrics_now();
+    if (two_d_ifft_c2r(fft_real, fft_imag, image_pixels_float, width, height) != 0) {
+        send_error(conn, "500 Internal Server Error", "Transform failed.\n");
+        return;
+    }
+    unsigned char *image_pixels = (unsigned char*)image_pixels_float;
+    simple_decompress_pixels(image_pixels_float, image_pixels, pixels);
+    metrics_record(METRIC_STAGE_IFFT, metrics_now() - start);
+
+    log_decompress(&cstats, width, height, IMAGE_CHANNELS_GRAY, stream_bytes, 0);
+    send_pixels(conn, image_pixels, width, height, IMAGE_CHANNELS_GRAY);
+}
+
+// POST /decompress-frame: the inverse of POST /frame. The streams /frame
+// returned, sent in order over one connection, come back as pixels; each
+// delta frame is decoded against the frame before it on this connection.
+// A delta frame with no frame before it (the first request, a new size,
+// a failed decode or evicted state) gets 409: the client must resend from
+// a key frame.
+static void handle_decompress_frame(connection *conn, workspace *ws) {
+    http_request *req = &conn->req;
+    const unsigned char *stream = request_body(conn);
+    size_t stream_bytes = (size_t)req->content_length;
+    compression_info info;
+    if (simple_decompress_info(stream, stream_bytes, &info) != 0 ||
+        (info.mode != COMPRESSION_MODE_FULL && info.mode != COMPRESSION_MODE_DELTA) ||
+        info.color != COMPRESSION_COLOR_GRAY || info.width > MAX_FRAME_DIM || info.height > MAX_FRAME_DIM) {
+        send_error(conn, "400 Bad Request", "Bad frame stream.\n");
+        return;
+    }
+    int width = info.width, height = info.height;
+    int fresh = frame_acquire(&conn->decoder, width, height, 0);
+    if (fresh < 0) {
+        frame_refused(conn, fresh);
+        return;
     }
+    frame_state *frame = conn->decoder;
+    if (info.mode == COMPRESSION_MODE_DELTA && !frame->primed) {
+        frame_release(frame);
+        send_error(conn, "409 Conflict", "No frame to apply the delta to; send a key frame.\n");
+        return;
+    }
+
+    size_t pixels = (size_t)width * height;
+    size_t spectrum_bytes = (size_t)(width / 2 + 1) * height * sizeof(float);
+    size_t plane_bytes = pixels * sizeof(float);
+    size_t needed = 2 * workspace_block_size(spectrum_bytes) + workspace_block_size(plane_bytes);
+    if (workspace_begin(ws, needed) != 0) {
+        frame_release(frame);
+        req->keep_alive = 0;
+        send_error(conn, "500 Internal Server Error", "Memory allocation failed.\n");
+        return;
+    }
+    float *fft_real = (float*)workspace_alloc(ws, spectrum_bytes);
+    float *fft_imag = (float*)workspace_alloc(ws, spectrum_bytes);
+    float *image_pixels_float = (float*)workspace_alloc(ws, plane_bytes);
+
+    compression_stats cstats;
+    frame->primed = simple_decompress_frame(stream, stream_bytes, width, height, frame->reference, fft_real,
+                                            fft_imag, &cstats) == 0;
+    int primed = frame->primed;
+    frame_release(frame);
+    if (!primed) {
+        send_error(conn, "400 Bad Request", "Bad frame stream.\n");
+        return;
+    }
+
+    uint64_t start = metrics_now();
+    if (two_d_ifft_c2r(fft_real, fft_imag, image_pixels_float, width, height) != 0) {
+        send_error(conn, "500 Internal Server Error", "Transform failed.\n");
+        return;
+    }
+    unsigned char *image_pixels = (unsigned char*)image_pixels_float;
+    simple_decompress_pixels(image_pixels_float, image_pixels, pixels);
+    metrics_record(METRIC_STAGE_IFFT, metrics_now() - start);
 
+    log_decompress(&cstats, width, height, IMAGE_CHANNELS_GRAY, stream_bytes, 0);
+    send_pixels(conn, image_pixels, width, height, IMAGE_CHANNELS_GRAY);
+}
+
+// Very basic HTTP request parsing: the request line, Content-Length,
+// Connection, the image dimension and format headers, the tiling options
+// and the low-pass filter.
+// header_len covers the request up to and including the blank line; the
+// buffer is not modified.
+int parse_http_request(const char *request, size_t header_len, http_request *req) {
+    const char *line = request;
+    const char *end = request + header_len;
+    char request_line[320], version[16];
+
+    // Parse request line (e.g., "POST /compress HTTP/1.1"), copied out
+    // since the buffer is not NUL-terminated
+    const char *eol = memchr(line, '\r', end - line);
+    if (!eol || (size_t)(eol - line) >= sizeof(request_line)) return -1;
+    memcpy(request_line, line, eol - line);
+    request_line[eol - line] = '\0';
+    if (sscanf(request_line, "%15s %255s %15s", req->method, req->uri, version) != 3 ||
+        strncmp(version, "HTTP/1.", 7) != 0) {
+        return -1; // Malformed request line
+    }
+    // HTTP/1.1 connections persist unless the client says otherwise.
+    req->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+    req->content_length = 0;
+
+    // Parse headers, one CRLF-terminated line at a time
+    for (;;) {
+        eol = memchr(line, '\r', end - line);
+        if (!eol || eol + 1 >= end || eol[1] != '\n') return -1;
+        line = eol + 2;
+        if (line + 2 >= end) break; // The blank line
+
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            // Digits only, up to INT_MAX; the header block ends in CRLF,
+            // so strtoull stops inside the buffer
+            const char *value = line + 15;
+            char *value_end;
+            while (*value == ' ' || *value == '\t') value++;
+            if (*value < '0' || *value > '9') return -1;
+            errno = 0;
+            unsigned long long length = strtoull(value, &value_end, 10);
+            while (*value_end == ' ' || *value_end == '\t') value_end++;
+            if (errno == ERANGE || *value_end != '\r' || length > INT_MAX) return -1;
+            req->content_length = (int)length;
+        } else if (strncasecmp(line, "X-Image-Width:", 14) == 0) {
+            req->width = atoi(line + 14);
+        } else if (strncasecmp(line, "X-Image-Height:", 15) == 0) {
+            req->height = atoi(line + 15);
+        } else if (strncasecmp(line, "X-Image-Format:", 15) == 0) {
+            const char *value = line + 15;
+            while (*value == ' ') value++;
+            if (strncasecmp(value, "gray\r", 5) == 0) {
+                req->rgb = 0;
+            } else if (strncasecmp(value, "rgb\r", 4) == 0) {
+                req->rgb = 1;
+            } else {
+                return -1;
+            }
+        } else if (strncasecmp(line, "X-Chroma:", 9) == 0) {
+            req->chroma = atoi(line + 9);
+            if (req->chroma != 444 && req->chroma != 420) return -1;
+        } else if (strncasecmp(line, "X-Tile-Size:", 12) == 0) {
+            req->tile_size = atoi(line + 12);
+        } else if (strncasecmp(line, "X-Low-Pass:", 11) == 0) {
+            // cutoff[, rectangle|ellipse]; the cutoff range is checked
+            // with the image dimensions
+            char value[64], shape[16] = "rectangle";
+            eol = memchr(line, '\r', end - line);
+            if (!eol || (size_t)(eol - line - 11) >= sizeof(value)) return -1;
+            memcpy(value, line + 11, eol - line - 11);
+            value[eol - line - 11] = '\0';
+            if (sscanf(value, "%f , %15s", &req->low_pass, shape) < 1) return -1;
+            if (strcasecmp(shape, "rectangle") == 0) {
+                req->low_pass_shape = FFT_MASK_RECTANGLE;
+            } else if (strcasecmp(shape, "ellipse") == 0) {
+                req->low_pass_shape = FFT_MASK_ELLIPSE;
+            } else {
+                return -1;
+            }
+        } else if (strncasecmp(line, "X-Region:", 9) == 0) {
+            // x,y,width,height, copied out to stop sscanf at the line end
+            char value[64];
+            eol = memchr(line, '\r', end - line);
+            if (!eol || (size_t)(eol - line - 9) >= sizeof(value)) return -1;
+            memcpy(value, line + 9, eol - line - 9);
+            value[eol - line - 9] = '\0';
+            if (sscanf(value, "%d , %d , %d , %d", &req->region[0], &req->region[1], &req->region[2],
+                       &req->region[3]) != 4) {
+                return -1;
+            }
+            req->has_region = 1;
+        } else if (strncasecmp(line, "X-Key-Frame:", 12) == 0) {
+            req->key_frame = atoi(line + 12) != 0;
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            const char *value = line + 11;
+            while (*value == ' ') value++;
+            if (strncasecmp(value, "close", 5) == 0) {
+                req->keep_alive = 0;
+            } else if (strncasecmp(value, "keep-alive", 10) == 0) {
+                req->keep_alive = 1;
+            }
+        }
+    }
     return 0;
-}
\ No newline at end of file
+}
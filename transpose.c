@@ -0,0 +1,86 @@
+#include "transpose.h"
+#include <stddef.h>
+
+#if defined(__riscv_vector)
+#include <riscv_vector.h>
+#endif
+
+#if defined(__riscv_vector)
+
+// Each tile row is a unit-stride load from src and a strided store into
+// the matching dst column.
+void transpose_tiled(const float *src, float *dst, int rows, int cols) {
+    ptrdiff_t dst_stride = (ptrdiff_t)rows * (ptrdiff_t)sizeof(float);
+    for (int r0 = 0; r0 < rows; r0 += TRANSPOSE_TILE) {
+        int r1 = r0 + TRANSPOSE_TILE < rows ? r0 + TRANSPOSE_TILE : rows;
+        for (int c0 = 0; c0 < cols; c0 += TRANSPOSE_TILE) {
+            int c1 = c0 + TRANSPOSE_TILE < cols ? c0 + TRANSPOSE_TILE : cols;
+            for (int r = r0; r < r1; ++r) {
+                size_t vl;
+                for (size_t c = c0; c < (size_t)c1; c += vl) {
+                    vl = __riscv_vsetvl_e32m1(c1 - c);
+                    vfloat32m1_t v = __riscv_vle32_v_f32m1(src + (size_t)r * cols + c, vl);
+                    __riscv_vsse32_v_f32m1(dst + c * rows + r, dst_stride, v, vl);
+                }
+            }
+        }
+    }
+}
+
+// Swaps row segment data[r][c0..c1) with column segment data[c0..c1)[r].
+static void swap_row_with_column(float *data, int n, int r, int c0, int c1) {
+    ptrdiff_t stride = (ptrdiff_t)n * (ptrdiff_t)sizeof(float);
+    size_t vl;
+    for (size_t c = c0; c < (size_t)c1; c += vl) {
+        vl = __riscv_vsetvl_e32m1(c1 - c);
+        float *row = data + (size_t)r * n + c;
+        float *col = data + c * n + r;
+        vfloat32m1_t vr = __riscv_vle32_v_f32m1(row, vl);
+        vfloat32m1_t vc = __riscv_vlse32_v_f32m1(col, stride, vl);
+        __riscv_vse32_v_f32m1(row, vc, vl);
+        __riscv_vsse32_v_f32m1(col, stride, vr, vl);
+    }
+}
+
+#else
+
+void transpose_tiled(const float *src, float *dst, int rows, int cols) {
+    for (int r0 = 0; r0 < rows; r0 += TRANSPOSE_TILE) {
+        int r1 = r0 + TRANSPOSE_TILE < rows ? r0 + TRANSPOSE_TILE : rows;
+        for (int c0 = 0; c0 < cols; c0 += TRANSPOSE_TILE) {
+            int c1 = c0 + TRANSPOSE_TILE < cols ? c0 + TRANSPOSE_TILE : cols;
+            for (int r = r0; r < r1; ++r) {
+                for (int c = c0; c < c1; ++c) {
+                    dst[(size_t)c * rows + r] = src[(size_t)r * cols + c];
+                }
+            }
+        }
+    }
+}
+
+static void swap_row_with_column(float *data, int n, int r, int c0, int c1) {
+    for (int c = c0; c < c1; ++c) {
+        float t = data[(size_t)r * n + c];
+        data[(size_t)r * n + c] = data[(size_t)c * n + r];
+        data[(size_t)c * n + r] = t;
+    }
+}
+
+#endif
+
+void transpose_square_inplace(float *data, int n) {
+    for (int r0 = 0; r0 < n; r0 += TRANSPOSE_TILE) {
+        int r1 = r0 + TRANSPOSE_TILE < n ? r0 + TRANSPOSE_TILE : n;
+        // Diagonal tile: swap its strict upper triangle with the lower one.
+        for (int r = r0; r < r1; ++r) {
+            swap_row_with_column(data, n, r, r + 1, r1);
+        }
+        // Off-diagonal tiles to the right, each swapped with its mirror below.
+        for (int c0 = r1; c0 < n; c0 += TRANSPOSE_TILE) {
+            int c1 = c0 + TRANSPOSE_TILE < n ? c0 + TRANSPOSE_TILE : n;
+            for (int r = r0; r < r1; ++r) {
+                swap_row_with_column(data, n, r, c0, c1);
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+// Edge length of the square tiles the transposes work on. An 8x8 float tile
+// touches only 8 cache lines on each side, so source and destination stay
+// in L1 even at power-of-two strides where larger tiles alias in the cache
+// sets (see bench/bench_transpose.c).
+#define TRANSPOSE_TILE 8
+
+// dst (cols x rows) = src (rows x cols)^T, row-major, one tile at a time.
+// src and dst must not overlap.
+void transpose_tiled(const float *src, float *dst, int rows, int cols);
+
+// In-place transpose of a square n x n matrix: tiles on the diagonal are
+// transposed in place, off-diagonal tile pairs are swapped.
+void transpose_square_inplace(float *data, int n);
+
+#endif // TRANSPOSE_H
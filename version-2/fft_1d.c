@@ -1,49 +1,486 @@
 #include "fft_1d.h"
 #include "uart.h"
+#include "profile.h"
 #include <math.h>
 
-static void bit_reverse_permutation(int N, cplx_double *data) {
-    int i, j, k;
-    for (i = 0, j = 0; i < N; ++i) {
+static unsigned int pool_clock;
+static int algorithm = FFT_1D_ALGORITHM_AUTO;
+static fft_1d_plan plan_pool[FFT_1D_PLAN_POOL_SIZE];
+
+// Stockham ping-pong buffer and Bluestein convolution buffer. Bare metal
+// is single-threaded, so one static buffer serves every plan.
+static cplx_double work_buffer[FFT_1D_MAX_N];
+
+static int is_power_of_two(int n) {
+    return (n & (n - 1)) == 0;
+}
+
+void fft_1d_set_algorithm(int a) {
+    algorithm = a;
+}
+
+// Engine for a power-of-two N under the current algorithm setting.
+static int pow2_kind(void) {
+    switch (algorithm) {
+    case FFT_1D_ALGORITHM_COOLEY_TUKEY:
+        return FFT_1D_RADIX2;
+    case FFT_1D_ALGORITHM_STOCKHAM:
+        return FFT_1D_STOCKHAM;
+    default:
+        return FFT_1D_RADIX2;
+    }
+}
+
+// Splits N into radix 4, 2, 3, 5 and 7 stages. Returns 0 if another prime
+// factor remains.
+static int factorize(fft_1d_plan *plan, int N) {
+    static const int radices[] = {4, 2, 3, 5, 7};
+    plan->num_stages = 0;
+    for (int i = 0; i < 5; ++i) {
+        while (N % radices[i] == 0 && plan->num_stages < FFT_1D_MAX_STAGES) {
+            plan->radices[plan->num_stages++] = radices[i];
+            N /= radices[i];
+        }
+    }
+    return N == 1;
+}
+
+static int reverse_bits(int x, int bits) {
+    int r = 0;
+    for (int b = 0; b < bits; ++b) {
+        r |= ((x >> b) & 1) << (bits - 1 - b);
+    }
+    return r;
+}
+
+static void radix2_init(fft_1d_plan *plan, int N, int inverse) {
+    // Twiddles are computed directly per index; no w *= wlen recurrence.
+    for (int len = 2; len <= N; len <<= 1) {
+        double angle = -2 * M_PI / len;
+        if (inverse) angle = -angle;
+
+        cplx_double *w = &plan->twiddles[len / 2 - 1];
+        for (int j = 0; j < len / 2; ++j) {
+            w[j] = cos(angle * j) + I * sin(angle * j);
+        }
+    }
+
+    int log2n = 0;
+    while ((1 << log2n) < N) log2n++;
+    for (int i = 0; i < N; ++i) {
+        plan->bitrev[i] = (uint16_t)reverse_bits(i, log2n);
+    }
+
+    // Fuse the log2(N) radix-2 stages into as many radix-8 passes as fit.
+    // A leftover pair becomes one radix-4 pass; a single leftover stage
+    // turns one radix-8 into two radix-4 passes, which is cheaper than a
+    // radix-2 pass plus a radix-8. Small radices go first: the first pass
+    // needs no twiddles.
+    int eights = log2n / 3, fours = log2n % 3 / 2, twos = log2n % 3 % 2;
+    if (twos && eights) {
+        eights--;
+        fours += 2;
+        twos = 0;
+    }
+    plan->num_stages = 0;
+    while (twos--) plan->radices[plan->num_stages++] = 2;
+    while (fours--) plan->radices[plan->num_stages++] = 4;
+    while (eights--) plan->radices[plan->num_stages++] = 8;
+
+    // A pass of radix R over sub-transforms of length h finds its inputs
+    // at j + q*h (j < h, q < R), sub-transform bitrev(q) of the R, and
+    // scales input q by W_(R*h)^(bitrev(q)*j). Those R-1 factors per j are
+    // stored back to back, pass after pass; they sum to N-1 entries.
+    cplx_double *w = plan->pass_twiddles;
+    int h = 1;
+    for (int t = 0; t < plan->num_stages; ++t) {
+        int R = plan->radices[t];
+        int log2r = R == 8 ? 3 : R == 4 ? 2 : 1;
+        if (h > 1) {
+            double angle = (inverse ? 2 : -2) * M_PI / (R * h);
+            for (int j = 0; j < h; ++j) {
+                for (int q = 1; q < R; ++q) {
+                    int e = reverse_bits(q, log2r) * j;
+                    *w++ = cos(angle * e) + I * sin(angle * e);
+                }
+            }
+        }
+        h *= R;
+    }
+}
+
+static void mixed_init(fft_1d_plan *plan, int N, int inverse) {
+    // Every stage twiddle and every small-DFT root is a power of W_N.
+    double angle = (inverse ? 2 : -2) * M_PI / N;
+    for (int k = 0; k < N; ++k) {
+        plan->twiddles[k] = cos(angle * k) + I * sin(angle * k);
+    }
+}
+
+static int bluestein_init(fft_1d_plan *plan, int N, int inverse) {
+    int M = 1;
+    while (M < 2 * N - 1) M <<= 1;
+
+    plan->conv = fft_1d_plan_create(M, 0);
+    if (!plan->conv) return 0;
+
+    // k*k is reduced mod 2N so the angle stays small and exact.
+    double angle = (inverse ? 1 : -1) * M_PI / N;
+    for (int k = 0; k < N; ++k) {
+        long k2 = ((long)k * k) % (2L * N);
+        plan->twiddles[k] = cos(angle * k2) + I * sin(angle * k2);
+    }
+
+    for (int k = 0; k < M; ++k) {
+        plan->kernel[k] = 0;
+    }
+    plan->kernel[0] = conj(plan->twiddles[0]);
+    for (int k = 1; k < N; ++k) {
+        plan->kernel[k] = conj(plan->twiddles[k]);
+        plan->kernel[M - k] = conj(plan->twiddles[k]);
+    }
+    fft_1d_execute(plan->conv, plan->kernel);
+    return 1;
+}
+
+fft_1d_plan *fft_1d_plan_create(int N, int inverse) {
+    if (N < 1 || N > FFT_1D_MAX_N) {
+        uart_puts("Error: unsupported FFT size!\n");
+        return 0;
+    }
+
+    int pow2 = is_power_of_two(N);
+    int kind = pow2 ? pow2_kind() : -1;
+    fft_1d_plan *reusable = 0;
+    for (int i = 0; i < FFT_1D_PLAN_POOL_SIZE; ++i) {
+        fft_1d_plan *p = &plan_pool[i];
+        if (p->n == N && p->inverse == inverse && (!pow2 || p->kind == kind)) {
+            p->refs++;
+            p->last_use = ++pool_clock;
+            return p;
+        }
+        // Prefer never-used slots, then the least recently used tables.
+        if (p->refs == 0 && (!reusable || (reusable->n != 0 && (p->n == 0 || p->last_use < reusable->last_use)))) {
+            reusable = p;
+        }
+    }
+    if (!reusable) {
+        uart_puts("Error: FFT plan pool exhausted!\n");
+        return 0;
+    }
+
+    // An evicted Bluestein plan unpins its convolution plan.
+    if (reusable->conv) {
+        fft_1d_plan_destroy(reusable->conv);
+        reusable->conv = 0;
+    }
+    reusable->n = N;
+    reusable->inverse = inverse;
+    // Hold the slot while a Bluestein plan fetches its convolution plan.
+    reusable->refs = 1;
+    reusable->last_use = ++pool_clock;
+
+    if (pow2) {
+        // Both engines share the twiddle layout; Stockham ignores bitrev.
+        reusable->kind = kind;
+        radix2_init(reusable, N, inverse);
+    } else if (factorize(reusable, N)) {
+        reusable->kind = FFT_1D_MIXED;
+        mixed_init(reusable, N, inverse);
+    } else {
+        reusable->kind = FFT_1D_BLUESTEIN;
+        if (2 * N > FFT_1D_MAX_N || !bluestein_init(reusable, N, inverse)) {
+            uart_puts("Error: unsupported FFT size!\n");
+            reusable->n = 0;
+            reusable->refs = 0;
+            return 0;
+        }
+    }
+    return reusable;
+}
+
+void fft_1d_plan_destroy(fft_1d_plan *plan) {
+    if (plan && plan->refs > 0) {
+        plan->refs--;
+    }
+}
+
+// z * (s*i) for s = +-1: the W_4 rotation, -i forward and +i inverse.
+static inline cplx_double rotate4(cplx_double z, double s) {
+    return -s * cimag(z) + I * (s * creal(z));
+}
+
+// z * W_8 = z * (1 + s*i) / sqrt(2): two multiplies instead of four.
+static inline cplx_double rotate8(cplx_double z, double s) {
+    double re = creal(z), im = cimag(z);
+    return M_SQRT1_2 * (re - s * im) + I * (M_SQRT1_2 * (im + s * re));
+}
+
+// The fused passes. Each reads R inputs at stride h, scales them by the
+// pass twiddles (w is 0 for the first pass, where all of them are 1),
+// and runs log2(R) radix-2 DIT stages in registers. Inside those stages
+// every twiddle is a power of W_8, so only rotations remain.
+static void pass2(cplx_double *data, int N, int h, const cplx_double *w) {
+    for (int i = 0; i < N; i += 2 * h) {
+        for (int j = 0; j < h; ++j) {
+            cplx_double a = data[i + j], b = data[i + j + h];
+            if (w) b *= w[j];
+            data[i + j] = a + b;
+            data[i + j + h] = a - b;
+        }
+    }
+}
+
+static void pass4(cplx_double *data, int N, int h, const cplx_double *w, double s) {
+    for (int i = 0; i < N; i += 4 * h) {
+        for (int j = 0; j < h; ++j) {
+            cplx_double *x = &data[i + j];
+            cplx_double c0 = x[0], c1 = x[h], c2 = x[2 * h], c3 = x[3 * h];
+            if (w) {
+                c1 *= w[3 * j];
+                c2 *= w[3 * j + 1];
+                c3 *= w[3 * j + 2];
+            }
+            cplx_double t0 = c0 + c1, t1 = c0 - c1;
+            cplx_double t2 = c2 + c3, t3 = rotate4(c2 - c3, s);
+            x[0] = t0 + t2;
+            x[h] = t1 + t3;
+            x[2 * h] = t0 - t2;
+            x[3 * h] = t1 - t3;
+        }
+    }
+}
+
+static void pass8(cplx_double *data, int N, int h, const cplx_double *w, double s) {
+    for (int i = 0; i < N; i += 8 * h) {
+        for (int j = 0; j < h; ++j) {
+            cplx_double *x = &data[i + j];
+            cplx_double c[8];
+            c[0] = x[0];
+            for (int q = 1; q < 8; ++q) {
+                c[q] = w ? x[q * h] * w[7 * j + q - 1] : x[q * h];
+            }
+            // Two radix-4 halves, then the W_8 stage across them.
+            for (int q = 0; q < 8; q += 4) {
+                cplx_double t0 = c[q] + c[q + 1], t1 = c[q] - c[q + 1];
+                cplx_double t2 = c[q + 2] + c[q + 3], t3 = rotate4(c[q + 2] - c[q + 3], s);
+                c[q] = t0 + t2;
+                c[q + 1] = t1 + t3;
+                c[q + 2] = t0 - t2;
+                c[q + 3] = t1 - t3;
+            }
+            cplx_double u5 = rotate8(c[5], s), u6 = rotate4(c[6], s), u7 = rotate4(rotate8(c[7], s), s);
+            x[0] = c[0] + c[4];
+            x[4 * h] = c[0] - c[4];
+            x[h] = c[1] + u5;
+            x[5 * h] = c[1] - u5;
+            x[2 * h] = c[2] + u6;
+            x[6 * h] = c[2] - u6;
+            x[3 * h] = c[3] + u7;
+            x[7 * h] = c[3] - u7;
+        }
+    }
+}
+
+static void radix2_execute(const fft_1d_plan *plan, cplx_double *data) {
+    int N = plan->n;
+
+    PROF_BEGIN(bitrev);
+    for (int i = 0; i < N; ++i) {
+        int j = plan->bitrev[i];
         if (j > i) {
             cplx_double temp = data[i];
             data[i] = data[j];
             data[j] = temp;
         }
-        k = N >> 1;
-        while (k <= j) {
-            j -= k;
-            k >>= 1;
+    }
+    PROF_END(PROF_FFT_1D_BITREV, bitrev, N);
+
+    PROF_BEGIN(butterflies);
+    double s = plan->inverse ? 1 : -1;
+    const cplx_double *w = plan->pass_twiddles;
+    int log2n = 0;
+    for (int t = 0, h = 1; t < plan->num_stages; ++t) {
+        int R = plan->radices[t];
+        const cplx_double *pw = h > 1 ? w : 0;
+        if (R == 8) {
+            pass8(data, N, h, pw, s);
+            log2n += 3;
+        } else if (R == 4) {
+            pass4(data, N, h, pw, s);
+            log2n += 2;
+        } else {
+            pass2(data, N, h, pw);
+            log2n += 1;
         }
-        j += k;
+        if (h > 1) w += (R - 1) * h;
+        h *= R;
     }
+    // Items stay radix-2 butterflies, comparable across radix choices.
+    PROF_END(PROF_FFT_1D_BUTTERFLY, butterflies, (uint64_t)(N / 2) * log2n);
 }
 
-void fft_1d(int N, cplx_double *data, int inverse) {
-    if (N <= 1) return;
+// Radix-2 decimation in frequency, self-sorting. The stage of length
+// len = 2m with stride s = N / len maps
+//   dst[q + s*2p]     = src[q + s*p] + src[q + s*(p + m)]
+//   dst[q + s*(2p+1)] = (src[q + s*p] - src[q + s*(p + m)]) * W_len^p
+// ping-ponging between data and work_buffer. The inner loop runs over the
+// longer of p and q so early stages are not stuck with two-element loops.
+static void stockham_execute(const fft_1d_plan *plan, cplx_double *data) {
+    int N = plan->n;
+    cplx_double *src = data, *dst = work_buffer;
+    PROF_BEGIN(stages);
+    int log2n = 0;
 
-    bit_reverse_permutation(N, data);
+    for (int len = N, s = 1; len > 1; len >>= 1, s <<= 1) {
+        int m = len / 2;
+        const cplx_double *w = &plan->twiddles[m - 1];
+        if (s >= m) {
+            for (int p = 0; p < m; ++p) {
+                const cplx_double *a = &src[s * p];
+                const cplx_double *b = &src[s * (p + m)];
+                cplx_double *y0 = &dst[2 * s * p];
+                cplx_double *y1 = y0 + s;
+                for (int q = 0; q < s; ++q) {
+                    cplx_double u = a[q], v = b[q];
+                    y0[q] = u + v;
+                    y1[q] = (u - v) * w[p];
+                }
+            }
+        } else {
+            for (int q = 0; q < s; ++q) {
+                for (int p = 0; p < m; ++p) {
+                    cplx_double u = src[q + s * p], v = src[q + s * (p + m)];
+                    dst[q + 2 * s * p] = u + v;
+                    dst[q + 2 * s * p + s] = (u - v) * w[p];
+                }
+            }
+        }
+        cplx_double *temp = src;
+        src = dst;
+        dst = temp;
+        log2n++;
+    }
 
-    for (int len = 2; len <= N; len <<= 1) {
-        double angle = 2 * M_PI / len;
-        if (inverse) angle = -angle;
+    if (src != data) {
+        for (int i = 0; i < N; ++i) {
+            data[i] = src[i];
+        }
+    }
+    PROF_END(PROF_FFT_1D_STOCKHAM, stages, (uint64_t)(N / 2) * log2n);
+}
 
-        cplx_double wlen = cos(angle) + I * sin(angle);
+// Self-sorting (Stockham) stages: each one reads src and writes dst, so no
+// bit reversal is needed. With sub-transform length len = r * m and stride
+// s = N / len, stage output k of butterfly (p, q) is
+//   dst[q + s*(r*p + k)] = W_len^(p*k) * sum_j src[q + s*(p + j*m)] * W_r^(j*k)
+static void mixed_execute(const fft_1d_plan *plan, cplx_double *data) {
+    int N = plan->n;
+    const cplx_double *w = plan->twiddles;
+    cplx_double *src = data, *dst = work_buffer;
+    int s = 1;
+    PROF_BEGIN(stages);
+    uint64_t butterflies = 0;
 
-        for (int i = 0; i < N; i += len) {
-            cplx_double w = 1.0 + 0.0 * I;
-            for (int j = 0; j < len / 2; ++j) {
-                cplx_double t = w * data[i + j + len / 2];
-                data[i + j + len / 2] = data[i + j] - t;
-                data[i + j] = data[i + j] + t;
-                w *= wlen;
+    for (int t = 0; t < plan->num_stages; ++t) {
+        int r = plan->radices[t];
+        int m = N / (s * r);
+        int root_step = N / r; // W_r = W_N^(N/r)
+        for (int p = 0; p < m; ++p) {
+            for (int q = 0; q < s; ++q) {
+                cplx_double a[7];
+                for (int j = 0; j < r; ++j) {
+                    a[j] = src[q + s * (p + j * m)];
+                }
+                for (int k = 0; k < r; ++k) {
+                    cplx_double sum = a[0];
+                    for (int j = 1; j < r; ++j) {
+                        sum += a[j] * w[((j * k) % r) * root_step];
+                    }
+                    dst[q + s * (r * p + k)] = sum * w[p * k * s];
+                }
             }
         }
+        cplx_double *temp = src;
+        src = dst;
+        dst = temp;
+        s *= r;
+        butterflies += N / r;
+    }
+
+    if (src != data) {
+        for (int i = 0; i < N; ++i) {
+            data[i] = src[i];
+        }
+    }
+    PROF_END(PROF_FFT_1D_MIXED, stages, butterflies);
+}
+
+// X[k] = c[k] * sum_j (x[j] c[j]) conj(c[k-j]) with chirp c, computed as a
+// circular convolution of power-of-two length M. The inverse convolution
+// FFT reuses the forward plan: ifft(x) = conj(fft(conj(x))) / M. The
+// convolution runs in work_buffer, so it always takes the in-place
+// Cooley-Tukey path, whichever engine the conv plan was built for.
+static void bluestein_execute(const fft_1d_plan *plan, cplx_double *data) {
+    int N = plan->n;
+    int M = plan->conv->n;
+    const cplx_double *chirp = plan->twiddles;
+    PROF_BEGIN(bluestein);
+
+    for (int k = 0; k < N; ++k) {
+        work_buffer[k] = data[k] * chirp[k];
+    }
+    for (int k = N; k < M; ++k) {
+        work_buffer[k] = 0;
+    }
+    PROF_PAUSE(bluestein);
+    radix2_execute(plan->conv, work_buffer);
+    PROF_RESUME(bluestein);
+    for (int k = 0; k < M; ++k) {
+        work_buffer[k] = conj(work_buffer[k] * plan->kernel[k]);
+    }
+    PROF_PAUSE(bluestein);
+    radix2_execute(plan->conv, work_buffer);
+    PROF_RESUME(bluestein);
+    for (int k = 0; k < N; ++k) {
+        data[k] = conj(work_buffer[k]) * chirp[k] / M;
+    }
+    PROF_END(PROF_FFT_1D_BLUESTEIN, bluestein, N);
+}
+
+void fft_1d_execute(const fft_1d_plan *plan, cplx_double *data) {
+    int N = plan->n;
+    if (N <= 1) return;
+
+    switch (plan->kind) {
+    case FFT_1D_RADIX2:
+        radix2_execute(plan, data);
+        break;
+    case FFT_1D_STOCKHAM:
+        stockham_execute(plan, data);
+        break;
+    case FFT_1D_MIXED:
+        mixed_execute(plan, data);
+        break;
+    case FFT_1D_BLUESTEIN:
+        bluestein_execute(plan, data);
+        break;
     }
 
-    if (inverse) {
+    if (plan->inverse) {
+        PROF_BEGIN(scale);
         for (int i = 0; i < N; ++i) {
             data[i] /= N;
         }
+        PROF_END(PROF_FFT_1D_SCALE, scale, N);
     }
 }
+
+void fft_1d(int N, cplx_double *data, int inverse) {
+    if (N <= 1) return;
+
+    fft_1d_plan *plan = fft_1d_plan_create(N, inverse);
+    if (!plan) return;
+    fft_1d_execute(plan, data);
+    fft_1d_plan_destroy(plan);
+}
@@ -6,6 +6,70 @@
 
 typedef double complex cplx_double;
 
+// Largest transform a plan can hold, and how many plans stay cached.
+// Plans live in a static pool (no heap on bare metal). Sizes that are not
+// of the form 2^a 3^b 5^c 7^d go through Bluestein's algorithm, whose
+// power-of-two convolution must also fit, so they are limited to
+// FFT_1D_MAX_N / 2.
+#define FFT_1D_MAX_N 1024
+#define FFT_1D_PLAN_POOL_SIZE 8
+#define FFT_1D_MAX_STAGES 16
+
+enum {
+    FFT_1D_RADIX2,    // N = 2^k: in-place bit reversal + fused radix-2/4/8 passes
+    FFT_1D_STOCKHAM,  // N = 2^k: self-sorting radix-2 stages, no bit reversal
+    FFT_1D_MIXED,     // N = 2^a 3^b 5^c 7^d: Stockham stages of radix 4/2/3/5/7
+    FFT_1D_BLUESTEIN  // any other N: chirp-z convolution of power-of-two length
+};
+
+// Engine for power-of-two sizes. Cooley-Tukey works in place, a bit
+// reversal followed by fused radix-4/8 passes; Stockham ping-pongs radix-2
+// stages through a work buffer with unit or constant stride everywhere.
+enum {
+    FFT_1D_ALGORITHM_AUTO,        // Cooley-Tukey: fewer passes, ~1.4x faster in bench_fft
+    FFT_1D_ALGORITHM_COOLEY_TUKEY,
+    FFT_1D_ALGORITHM_STOCKHAM
+};
+
+// Precomputed tables for one (N, inverse) pair.
+typedef struct fft_1d_plan {
+    int n;
+    int inverse;
+    int refs;
+    unsigned int last_use; // Pool clock at the last create, for LRU eviction
+    int kind;
+    // Stockham: per-stage twiddles, the stage of length len uses
+    // twiddles[len/2 - 1 + j] = exp(-+2*pi*i*j/len), j < len/2.
+    // Mixed radix: twiddles[k] = exp(-+2*pi*i*k/N), k < N.
+    // Bluestein: the chirp, twiddles[k] = exp(-+pi*i*k*k/N), k < N.
+    cplx_double twiddles[FFT_1D_MAX_N];
+    uint16_t bitrev[FFT_1D_MAX_N];
+    // Mixed radix: the stage radices. Radix 2: the radices of the fused
+    // passes, each 2, 4 or 8 (one, two or three radix-2 stages).
+    int num_stages;
+    int radices[FFT_1D_MAX_STAGES];
+    union {
+        // Bluestein: forward FFT of the wrapped conjugate chirp.
+        cplx_double kernel[FFT_1D_MAX_N];
+        // Radix 2: the input twiddles of the fused passes, see radix2_init.
+        cplx_double pass_twiddles[FFT_1D_MAX_N];
+    };
+    // Bluestein: the (pinned) power-of-two plan used for the convolution.
+    struct fft_1d_plan *conv;
+} fft_1d_plan;
+
+// Returns a plan for (N, inverse), reusing cached tables when present.
+// Returns 0 if N is out of range or the pool is full.
+fft_1d_plan *fft_1d_plan_create(int N, int inverse);
+void fft_1d_execute(const fft_1d_plan *plan, cplx_double *data);
+// Releases the caller's reference. The tables stay cached until the slot
+// is needed for another size.
+void fft_1d_plan_destroy(fft_1d_plan *plan);
+
 void fft_1d(int N, cplx_double *data, int inverse);
 
+// Selects the power-of-two engine (FFT_1D_ALGORITHM_*) for plans created
+// from now on; cached plans of the other engine are not reused.
+void fft_1d_set_algorithm(int algorithm);
+
 #endif // FFT_1D_H
@@ -1,44 +1,100 @@
 #include "fft_2d.h"
 #include "fft_1d.h"
 #include "uart.h"
+#include "profile.h"
 
 #define MAX_FFT_DIM 16
+// Transpose tile edge: two 8x8 tiles of complex doubles fill 2 KB.
+#define TRANSPOSE_TILE 8
 
 static cplx_double temp_transpose_buffer[MAX_FFT_DIM * MAX_FFT_DIM];
 
+// dst (cols x rows) = src (rows x cols)^T, one tile at a time.
+static void transpose_tiled(const cplx_double *src, cplx_double *dst, int rows, int cols) {
+    for (int r0 = 0; r0 < rows; r0 += TRANSPOSE_TILE) {
+        int r1 = r0 + TRANSPOSE_TILE < rows ? r0 + TRANSPOSE_TILE : rows;
+        for (int c0 = 0; c0 < cols; c0 += TRANSPOSE_TILE) {
+            int c1 = c0 + TRANSPOSE_TILE < cols ? c0 + TRANSPOSE_TILE : cols;
+            for (int r = r0; r < r1; ++r) {
+                for (int c = c0; c < c1; ++c) {
+                    dst[c * rows + r] = src[r * cols + c];
+                }
+            }
+        }
+    }
+}
+
+// In-place transpose of an n x n matrix: diagonal tiles are transposed in
+// place, off-diagonal tiles are swapped with their mirror.
+static void transpose_square_inplace(cplx_double *data, int n) {
+    for (int r0 = 0; r0 < n; r0 += TRANSPOSE_TILE) {
+        int r1 = r0 + TRANSPOSE_TILE < n ? r0 + TRANSPOSE_TILE : n;
+        for (int c0 = r0; c0 < n; c0 += TRANSPOSE_TILE) {
+            int c1 = c0 + TRANSPOSE_TILE < n ? c0 + TRANSPOSE_TILE : n;
+            for (int r = r0; r < r1; ++r) {
+                for (int c = (c0 == r0 ? r + 1 : c0); c < c1; ++c) {
+                    cplx_double temp = data[r * n + c];
+                    data[r * n + c] = data[c * n + r];
+                    data[c * n + r] = temp;
+                }
+            }
+        }
+    }
+}
+
 void fft_2d(int rows, int cols, cplx_double *data, int inverse) {
     if (rows > MAX_FFT_DIM || cols > MAX_FFT_DIM) {
         uart_puts("Error: FFT dims too large!\n");
         while (1);
     }
 
+    // Row and column plans are fetched once per call; their tables stay
+    // cached in the plan pool across calls.
+    fft_1d_plan *row_plan = fft_1d_plan_create(cols, inverse);
+    fft_1d_plan *col_plan = fft_1d_plan_create(rows, inverse);
+    if (!row_plan || !col_plan) {
+        uart_puts("Error: FFT plan creation failed!\n");
+        while (1);
+    }
+
+    int points = rows * cols;
+
     // FFT rows
+    PROF_BEGIN(row_pass);
     for (int r = 0; r < rows; ++r) {
-        fft_1d(cols, &data[r * cols], inverse);
+        fft_1d_execute(row_plan, &data[r * cols]);
     }
+    PROF_END(PROF_FFT_2D_ROWS, row_pass, points);
 
-    // Transpose
-    for (int r = 0; r < rows; ++r) {
+    if (rows == cols) {
+        // Square: transpose in place, FFT cols (now rows), transpose back.
+        PROF_BEGIN(transpose_in);
+        transpose_square_inplace(data, rows);
+        PROF_END(PROF_FFT_2D_TRANSPOSE, transpose_in, points);
+        PROF_BEGIN(column_pass);
         for (int c = 0; c < cols; ++c) {
-            temp_transpose_buffer[c * rows + r] = data[r * cols + c];
+            fft_1d_execute(col_plan, &data[c * rows]);
         }
-    }
-    for (int i = 0; i < rows * cols; ++i) {
-        data[i] = temp_transpose_buffer[i];
-    }
-
-    // FFT cols (now rows of transposed)
-    for (int c = 0; c < cols; ++c) {
-        fft_1d(rows, &data[c * rows], inverse);
-    }
-
-    // Transpose back
-    for (int r = 0; r < cols; ++r) {
-        for (int c = 0; c < rows; ++c) {
-            temp_transpose_buffer[c * cols + r] = data[r * rows + c];
+        PROF_END(PROF_FFT_2D_COLUMNS, column_pass, points);
+        PROF_BEGIN(transpose_out);
+        transpose_square_inplace(data, rows);
+        PROF_END(PROF_FFT_2D_TRANSPOSE, transpose_out, points);
+    } else {
+        // Transpose into the temp buffer and FFT the columns there, then
+        // transpose straight back into data (no copy-back passes).
+        PROF_BEGIN(transpose_in);
+        transpose_tiled(data, temp_transpose_buffer, rows, cols);
+        PROF_END(PROF_FFT_2D_TRANSPOSE, transpose_in, points);
+        PROF_BEGIN(column_pass);
+        for (int c = 0; c < cols; ++c) {
+            fft_1d_execute(col_plan, &temp_transpose_buffer[c * rows]);
         }
+        PROF_END(PROF_FFT_2D_COLUMNS, column_pass, points);
+        PROF_BEGIN(transpose_out);
+        transpose_tiled(temp_transpose_buffer, data, cols, rows);
+        PROF_END(PROF_FFT_2D_TRANSPOSE, transpose_out, points);
     }
-    for (int i = 0; i < rows * cols; ++i) {
-        data[i] = temp_transpose_buffer[i];
-    }
+
+    fft_1d_plan_destroy(row_plan);
+    fft_1d_plan_destroy(col_plan);
 }
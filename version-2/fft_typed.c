@@ -0,0 +1,291 @@
+#include "fft_typed.h"
+#include "uart.h"
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__riscv_vector)
+#include <riscv_vector.h>
+#endif
+
+static unsigned int pool_clock;
+static fft_typed_plan plan_pool[FFT_TYPED_PLAN_POOL_SIZE];
+
+// --- fp64 ---
+#define FT_T double
+#define FT_NAME(name) name##_f64
+#define FT_TYPE FFT_TYPE_F64
+#define FT_TW tw.f64
+#define FT_SCALED 0
+#define FT_FROM_DOUBLE(x) (x)
+#define FT_CMUL(tr, ti, br, bi, wr, wi) ((tr) = (br) * (wr) - (bi) * (wi), (ti) = (br) * (wi) + (bi) * (wr))
+#define FT_BADD(a, t) ((a) + (t))
+#define FT_BSUB(a, t) ((a) - (t))
+#if defined(__riscv_vector)
+#define FT_VECTOR 1
+#define FT_V vfloat64m2_t
+#define FT_VSETVL(n) __riscv_vsetvl_e64m2(n)
+#define FT_VLE(p, vl) __riscv_vle64_v_f64m2(p, vl)
+#define FT_VSE(p, v, vl) __riscv_vse64_v_f64m2(p, v, vl)
+#define FT_VLSE(p, stride, vl) __riscv_vlse64_v_f64m2(p, stride, vl)
+#define FT_VSSE(p, stride, v, vl) __riscv_vsse64_v_f64m2(p, stride, v, vl)
+#define FT_VMV(s, vl) __riscv_vfmv_v_f_f64m2(s, vl)
+#define FT_VCMUL(tr, ti, br, bi, wr, wi, vl)                                                                  \
+    ((tr) = __riscv_vfnmsac_vv_f64m2(__riscv_vfmul_vv_f64m2(br, wr, vl), bi, wi, vl),                        \
+     (ti) = __riscv_vfmacc_vv_f64m2(__riscv_vfmul_vv_f64m2(br, wi, vl), bi, wr, vl))
+#define FT_VBADD(a, t, vl) __riscv_vfadd_vv_f64m2(a, t, vl)
+#define FT_VBSUB(a, t, vl) __riscv_vfsub_vv_f64m2(a, t, vl)
+#define FT_VSCALE(v, s, vl) __riscv_vfmul_vf_f64m2(v, s, vl)
+#else
+#define FT_VECTOR 0
+#endif
+#include "fft_typed_kernel.h"
+
+// --- fp32 ---
+#define FT_T float
+#define FT_NAME(name) name##_f32
+#define FT_TYPE FFT_TYPE_F32
+#define FT_TW tw.f32
+#define FT_SCALED 0
+#define FT_FROM_DOUBLE(x) ((float)(x))
+#define FT_CMUL(tr, ti, br, bi, wr, wi) ((tr) = (br) * (wr) - (bi) * (wi), (ti) = (br) * (wi) + (bi) * (wr))
+#define FT_BADD(a, t) ((a) + (t))
+#define FT_BSUB(a, t) ((a) - (t))
+#if defined(__riscv_vector)
+#define FT_VECTOR 1
+#define FT_V vfloat32m2_t
+#define FT_VSETVL(n) __riscv_vsetvl_e32m2(n)
+#define FT_VLE(p, vl) __riscv_vle32_v_f32m2(p, vl)
+#define FT_VSE(p, v, vl) __riscv_vse32_v_f32m2(p, v, vl)
+#define FT_VLSE(p, stride, vl) __riscv_vlse32_v_f32m2(p, stride, vl)
+#define FT_VSSE(p, stride, v, vl) __riscv_vsse32_v_f32m2(p, stride, v, vl)
+#define FT_VMV(s, vl) __riscv_vfmv_v_f_f32m2(s, vl)
+#define FT_VCMUL(tr, ti, br, bi, wr, wi, vl)                                                                  \
+    ((tr) = __riscv_vfnmsac_vv_f32m2(__riscv_vfmul_vv_f32m2(br, wr, vl), bi, wi, vl),                        \
+     (ti) = __riscv_vfmacc_vv_f32m2(__riscv_vfmul_vv_f32m2(br, wi, vl), bi, wr, vl))
+#define FT_VBADD(a, t, vl) __riscv_vfadd_vv_f32m2(a, t, vl)
+#define FT_VBSUB(a, t, vl) __riscv_vfsub_vv_f32m2(a, t, vl)
+#define FT_VSCALE(v, s, vl) __riscv_vfmul_vf_f32m2(v, s, vl)
+#else
+#define FT_VECTOR 0
+#endif
+#include "fft_typed_kernel.h"
+
+// --- fp16 ---
+#if FFT_TYPED_HAVE_F16
+#define FT_T fft_f16
+#define FT_NAME(name) name##_f16
+#define FT_TYPE FFT_TYPE_F16
+#define FT_TW tw.f16
+#define FT_SCALED 0
+#define FT_FROM_DOUBLE(x) ((fft_f16)(x))
+#define FT_CMUL(tr, ti, br, bi, wr, wi) ((tr) = (br) * (wr) - (bi) * (wi), (ti) = (br) * (wi) + (bi) * (wr))
+#define FT_BADD(a, t) ((a) + (t))
+#define FT_BSUB(a, t) ((a) - (t))
+#if defined(__riscv_vector) && defined(__riscv_zvfh)
+#define FT_VECTOR 1
+#define FT_V vfloat16m2_t
+#define FT_VSETVL(n) __riscv_vsetvl_e16m2(n)
+#define FT_VLE(p, vl) __riscv_vle16_v_f16m2(p, vl)
+#define FT_VSE(p, v, vl) __riscv_vse16_v_f16m2(p, v, vl)
+#define FT_VLSE(p, stride, vl) __riscv_vlse16_v_f16m2(p, stride, vl)
+#define FT_VSSE(p, stride, v, vl) __riscv_vsse16_v_f16m2(p, stride, v, vl)
+#define FT_VMV(s, vl) __riscv_vfmv_v_f_f16m2(s, vl)
+#define FT_VCMUL(tr, ti, br, bi, wr, wi, vl)                                                                  \
+    ((tr) = __riscv_vfnmsac_vv_f16m2(__riscv_vfmul_vv_f16m2(br, wr, vl), bi, wi, vl),                        \
+     (ti) = __riscv_vfmacc_vv_f16m2(__riscv_vfmul_vv_f16m2(br, wi, vl), bi, wr, vl))
+#define FT_VBADD(a, t, vl) __riscv_vfadd_vv_f16m2(a, t, vl)
+#define FT_VBSUB(a, t, vl) __riscv_vfsub_vv_f16m2(a, t, vl)
+#define FT_VSCALE(v, s, vl) __riscv_vfmul_vf_f16m2(v, s, vl)
+#else
+#define FT_VECTOR 0
+#endif
+#include "fft_typed_kernel.h"
+#endif
+
+// --- Q15 ---
+// The scalar helpers round and saturate exactly like vsmul, vssub/vsadd
+// and vaadd/vasub with vxrm = round-to-nearest-up, so both builds produce
+// bit-identical results.
+static inline int16_t q15_saturate(int32_t x) {
+    return (int16_t)(x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x);
+}
+
+static inline int16_t q15_mul(int16_t a, int16_t b) {
+    return q15_saturate(((int32_t)a * b + (1 << 14)) >> 15);
+}
+
+static inline int16_t q15_from_double(double x) {
+    return q15_saturate((int32_t)lround(x * 32768.0));
+}
+
+#define FT_T int16_t
+#define FT_NAME(name) name##_q15
+#define FT_TYPE FFT_TYPE_Q15
+#define FT_TW tw.q15
+#define FT_SCALED 1
+#define FT_FROM_DOUBLE(x) q15_from_double(x)
+#define FT_CMUL(tr, ti, br, bi, wr, wi)                                                                       \
+    ((tr) = q15_saturate(q15_mul(br, wr) - q15_mul(bi, wi)), (ti) = q15_saturate(q15_mul(br, wi) + q15_mul(bi, wr)))
+#define FT_BADD(a, t) ((int16_t)(((int32_t)(a) + (t) + 1) >> 1))
+#define FT_BSUB(a, t) ((int16_t)(((int32_t)(a) - (t) + 1) >> 1))
+#if defined(__riscv_vector)
+#define FT_VECTOR 1
+#define FT_V vint16m2_t
+#define FT_VSETVL(n) __riscv_vsetvl_e16m2(n)
+#define FT_VLE(p, vl) __riscv_vle16_v_i16m2(p, vl)
+#define FT_VSE(p, v, vl) __riscv_vse16_v_i16m2(p, v, vl)
+#define FT_VLSE(p, stride, vl) __riscv_vlse16_v_i16m2(p, stride, vl)
+#define FT_VSSE(p, stride, v, vl) __riscv_vsse16_v_i16m2(p, stride, v, vl)
+#define FT_VMV(s, vl) __riscv_vmv_v_x_i16m2(s, vl)
+#define FT_VCMUL(tr, ti, br, bi, wr, wi, vl)                                                                  \
+    ((tr) = __riscv_vssub_vv_i16m2(__riscv_vsmul_vv_i16m2(br, wr, __RISCV_VXRM_RNU, vl),                      \
+                                   __riscv_vsmul_vv_i16m2(bi, wi, __RISCV_VXRM_RNU, vl), vl),                 \
+     (ti) = __riscv_vsadd_vv_i16m2(__riscv_vsmul_vv_i16m2(br, wi, __RISCV_VXRM_RNU, vl),                      \
+                                   __riscv_vsmul_vv_i16m2(bi, wr, __RISCV_VXRM_RNU, vl), vl))
+#define FT_VBADD(a, t, vl) __riscv_vaadd_vv_i16m2(a, t, __RISCV_VXRM_RNU, vl)
+#define FT_VBSUB(a, t, vl) __riscv_vasub_vv_i16m2(a, t, __RISCV_VXRM_RNU, vl)
+#else
+#define FT_VECTOR 0
+#endif
+#include "fft_typed_kernel.h"
+
+int fft_typed_supported(int type) {
+    switch (type) {
+    case FFT_TYPE_F64:
+    case FFT_TYPE_F32:
+    case FFT_TYPE_Q15:
+        return 1;
+    case FFT_TYPE_F16:
+        return FFT_TYPED_HAVE_F16;
+    default:
+        return 0;
+    }
+}
+
+int fft_typed_element_size(int type) {
+    switch (type) {
+    case FFT_TYPE_F64:
+        return 8;
+    case FFT_TYPE_F32:
+        return 4;
+    case FFT_TYPE_F16:
+    case FFT_TYPE_Q15:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static void init_tables(fft_typed_plan *plan) {
+    int N = plan->n;
+    int log2n = 0;
+    while ((1 << log2n) < N) log2n++;
+    for (int i = 0; i < N; ++i) {
+        int r = 0;
+        for (int b = 0; b < log2n; ++b) {
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        }
+        plan->bitrev[i] = (uint16_t)r;
+    }
+
+    switch (plan->type) {
+    case FFT_TYPE_F64:
+        init_twiddles_f64(plan);
+        break;
+    case FFT_TYPE_F32:
+        init_twiddles_f32(plan);
+        break;
+#if FFT_TYPED_HAVE_F16
+    case FFT_TYPE_F16:
+        init_twiddles_f16(plan);
+        break;
+#endif
+    case FFT_TYPE_Q15:
+        init_twiddles_q15(plan);
+        break;
+    }
+}
+
+fft_typed_plan *fft_typed_plan_create(int N, int inverse, int type) {
+    if (N < 1 || N > FFT_TYPED_MAX_N || (N & (N - 1)) != 0) {
+        uart_puts("Error: unsupported FFT size!\n");
+        return 0;
+    }
+    if (!fft_typed_supported(type)) {
+        uart_puts("Error: unsupported FFT element type!\n");
+        return 0;
+    }
+
+    fft_typed_plan *reusable = 0;
+    for (int i = 0; i < FFT_TYPED_PLAN_POOL_SIZE; ++i) {
+        fft_typed_plan *p = &plan_pool[i];
+        if (p->n == N && p->inverse == inverse && p->type == type) {
+            p->refs++;
+            p->last_use = ++pool_clock;
+            return p;
+        }
+        // Prefer never-used slots, then the least recently used tables.
+        if (p->refs == 0 && (!reusable || (reusable->n != 0 && (p->n == 0 || p->last_use < reusable->last_use)))) {
+            reusable = p;
+        }
+    }
+    if (!reusable) {
+        uart_puts("Error: FFT plan pool exhausted!\n");
+        return 0;
+    }
+
+    reusable->n = N;
+    reusable->inverse = inverse;
+    reusable->type = type;
+    reusable->refs = 1;
+    reusable->last_use = ++pool_clock;
+    init_tables(reusable);
+    return reusable;
+}
+
+void fft_typed_plan_destroy(fft_typed_plan *plan) {
+    if (plan && plan->refs > 0) {
+        plan->refs--;
+    }
+}
+
+void fft_typed_execute(const fft_typed_plan *plan, void *re, void *im) {
+    switch (plan->type) {
+    case FFT_TYPE_F64:
+        fft_typed_execute_f64(plan, (double*)re, (double*)im);
+        break;
+    case FFT_TYPE_F32:
+        fft_typed_execute_f32(plan, (float*)re, (float*)im);
+        break;
+#if FFT_TYPED_HAVE_F16
+    case FFT_TYPE_F16:
+        fft_typed_execute_f16(plan, (fft_f16*)re, (fft_f16*)im);
+        break;
+#endif
+    case FFT_TYPE_Q15:
+        fft_typed_execute_q15(plan, (int16_t*)re, (int16_t*)im);
+        break;
+    }
+}
+
+void fft_typed_2d(int rows, int cols, int type, void *re, void *im, int inverse) {
+    switch (type) {
+    case FFT_TYPE_F64:
+        fft_typed_2d_f64(rows, cols, (double*)re, (double*)im, inverse);
+        break;
+    case FFT_TYPE_F32:
+        fft_typed_2d_f32(rows, cols, (float*)re, (float*)im, inverse);
+        break;
+#if FFT_TYPED_HAVE_F16
+    case FFT_TYPE_F16:
+        fft_typed_2d_f16(rows, cols, (fft_f16*)re, (fft_f16*)im, inverse);
+        break;
+#endif
+    case FFT_TYPE_Q15:
+        fft_typed_2d_q15(rows, cols, (int16_t*)re, (int16_t*)im, inverse);
+        break;
+    default:
+        uart_puts("Error: unsupported FFT element type!\n");
+        while (1);
+    }
+}
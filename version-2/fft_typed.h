@@ -0,0 +1,101 @@
+#ifndef FFT_TYPED_H
+#define FFT_TYPED_H
+
+#include <stdint.h>
+
+// --- Precision-specialized FFTs ---
+// A separate engine from fft_1d/fft_2d, for power-of-two sizes only: plain
+// in-place radix-2 (bit reversal, then log2(N) stages), generated from one
+// source (fft_typed_kernel.h) for each element type, on split real and
+// imaginary arrays of that type. It shares no code or plans with fft_1d,
+// which keeps its own cplx_double radix-2/4/8, Stockham, mixed-radix and
+// Bluestein paths; fft_1d and fft_2d do not call into it. Narrower types
+// fit more lanes per vector register: at a fixed LMUL, fp32 has 2x and
+// fp16/Q15 4x the lanes of fp64.
+//
+//   FFT_TYPE_F64  double
+//   FFT_TYPE_F32  float
+//   FFT_TYPE_F16  _Float16; vectorized with Zvfh, emulated in scalar code
+//                 otherwise. Only when the compiler has _Float16.
+//   FFT_TYPE_Q15  int16_t fixed point, value / 32768. Every stage halves
+//                 its outputs (vaadd/vasub), so the transform is scaled by
+//                 1/N in both directions and cannot overflow as long as
+//                 every input has magnitude |x| < 1.
+//
+// Sizes are powers of two up to FFT_TYPED_MAX_N; plan creation fails for
+// anything else, and callers with other sizes must use the cplx_double
+// fft_1d/fft_2d API. FFT_TYPE_F64/F32/F16 follow the fft_1d conventions:
+// forward unnormalized, inverse normalized by 1/N.
+//
+// A type is picked at compile time by calling the suffixed functions
+// (fft_typed_execute_f32, fft_typed_2d_q15, ...) or at plan creation, by
+// passing the type to fft_typed_plan_create and running the plan through
+// fft_typed_execute.
+
+#if defined(__FLT16_MAX__)
+#define FFT_TYPED_HAVE_F16 1
+typedef _Float16 fft_f16;
+#else
+#define FFT_TYPED_HAVE_F16 0
+#endif
+
+#define FFT_TYPED_MAX_N 1024
+#define FFT_TYPED_PLAN_POOL_SIZE 8
+
+enum {
+    FFT_TYPE_F64,
+    FFT_TYPE_F32,
+    FFT_TYPE_F16,
+    FFT_TYPE_Q15,
+    FFT_TYPE_COUNT
+};
+
+// Precomputed tables for one (N, inverse, type). The stage of length len
+// uses twiddles re/im[len/2 - 1 + j] = exp(-+2*pi*i*j/len), j < len/2,
+// stored in the plan's element type.
+typedef struct fft_typed_plan {
+    int n;
+    int inverse;
+    int type;
+    int refs;
+    unsigned int last_use; // Pool clock at the last create, for LRU eviction
+    uint16_t bitrev[FFT_TYPED_MAX_N];
+    union {
+        struct { double re[FFT_TYPED_MAX_N], im[FFT_TYPED_MAX_N]; } f64;
+        struct { float re[FFT_TYPED_MAX_N], im[FFT_TYPED_MAX_N]; } f32;
+#if FFT_TYPED_HAVE_F16
+        struct { fft_f16 re[FFT_TYPED_MAX_N], im[FFT_TYPED_MAX_N]; } f16;
+#endif
+        struct { int16_t re[FFT_TYPED_MAX_N], im[FFT_TYPED_MAX_N]; } q15;
+    } tw;
+} fft_typed_plan;
+
+// Returns 1 if this build supports the element type.
+int fft_typed_supported(int type);
+// Bytes per real or imaginary element of the type.
+int fft_typed_element_size(int type);
+
+// Returns a plan for (N, inverse, type), reusing cached tables when
+// present. Returns 0 if N is not a power of two in range, the type is not
+// supported or the pool is full.
+fft_typed_plan *fft_typed_plan_create(int N, int inverse, int type);
+void fft_typed_plan_destroy(fft_typed_plan *plan);
+
+// In-place 1D transform; re and im are arrays of the plan's element type.
+void fft_typed_execute(const fft_typed_plan *plan, void *re, void *im);
+// In-place rows x cols 2D transform, row-major. rows and cols must both
+// be powers of two; like fft_2d, it halts with an error otherwise.
+void fft_typed_2d(int rows, int cols, int type, void *re, void *im, int inverse);
+
+void fft_typed_execute_f64(const fft_typed_plan *plan, double *re, double *im);
+void fft_typed_execute_f32(const fft_typed_plan *plan, float *re, float *im);
+void fft_typed_execute_q15(const fft_typed_plan *plan, int16_t *re, int16_t *im);
+void fft_typed_2d_f64(int rows, int cols, double *re, double *im, int inverse);
+void fft_typed_2d_f32(int rows, int cols, float *re, float *im, int inverse);
+void fft_typed_2d_q15(int rows, int cols, int16_t *re, int16_t *im, int inverse);
+#if FFT_TYPED_HAVE_F16
+void fft_typed_execute_f16(const fft_typed_plan *plan, fft_f16 *re, fft_f16 *im);
+void fft_typed_2d_f16(int rows, int cols, fft_f16 *re, fft_f16 *im, int inverse);
+#endif
+
+#endif // FFT_TYPED_H
@@ -0,0 +1,253 @@
+// Radix-2 FFT kernels of the fft_typed engine (not used by fft_1d) for
+// one element type. There is no include guard:
+// fft_typed.c includes this file once per type, after defining
+//
+//   FT_T                element type
+//   FT_NAME(name)       name with the type suffix appended
+//   FT_TYPE             FFT_TYPE_* constant
+//   FT_TW               plan twiddle member (FT_TW.re, FT_TW.im)
+//   FT_SCALED           1 if every stage halves its outputs (fixed point),
+//                       0 if the inverse is normalized by 1/N at the end
+//   FT_FROM_DOUBLE(x)   converts a twiddle component
+//   FT_CMUL(tr, ti, br, bi, wr, wi)   t = w * b
+//   FT_BADD(a, t), FT_BSUB(a, t)      butterfly outputs a + t, a - t
+//   FT_VECTOR           1 to use the RVV versions below
+//
+// and, when FT_VECTOR is 1,
+//
+//   FT_V, FT_VSETVL(n), FT_VLE(p, vl), FT_VSE(p, v, vl),
+//   FT_VLSE(p, stride, vl), FT_VSSE(p, stride, v, vl), FT_VMV(s, vl),
+//   FT_VCMUL(tr, ti, br, bi, wr, wi, vl), FT_VBADD(a, t, vl),
+//   FT_VBSUB(a, t, vl), FT_VSCALE(v, s, vl)
+//
+// Every one of them is undefined again at the end of this file.
+
+static void FT_NAME(init_twiddles)(fft_typed_plan *plan) {
+    int N = plan->n;
+    for (int len = 2; len <= N; len <<= 1) {
+        double angle = (plan->inverse ? 2 : -2) * M_PI / len;
+        for (int j = 0; j < len / 2; ++j) {
+            plan->FT_TW.re[len / 2 - 1 + j] = FT_FROM_DOUBLE(cos(angle * j));
+            plan->FT_TW.im[len / 2 - 1 + j] = FT_FROM_DOUBLE(sin(angle * j));
+        }
+    }
+}
+
+#if FT_VECTOR
+
+// (a, b) <- (a + w*b, a - w*b) over n contiguous lanes, one twiddle.
+static void FT_NAME(butterfly_span)(FT_T *a_re, FT_T *a_im, FT_T *b_re, FT_T *b_im, FT_T wr, FT_T wi, int n) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)n; c += vl) {
+        vl = FT_VSETVL(n - c);
+        FT_V ar = FT_VLE(a_re + c, vl), ai = FT_VLE(a_im + c, vl);
+        FT_V br = FT_VLE(b_re + c, vl), bi = FT_VLE(b_im + c, vl);
+        FT_V tr, ti;
+        FT_VCMUL(tr, ti, br, bi, FT_VMV(wr, vl), FT_VMV(wi, vl), vl);
+        FT_VSE(a_re + c, FT_VBADD(ar, tr, vl), vl);
+        FT_VSE(a_im + c, FT_VBADD(ai, ti, vl), vl);
+        FT_VSE(b_re + c, FT_VBSUB(ar, tr, vl), vl);
+        FT_VSE(b_im + c, FT_VBSUB(ai, ti, vl), vl);
+    }
+}
+
+static void FT_NAME(swap_span)(FT_T *a, FT_T *b, int n) {
+    size_t vl;
+    for (size_t c = 0; c < (size_t)n; c += vl) {
+        vl = FT_VSETVL(n - c);
+        FT_V va = FT_VLE(a + c, vl), vb = FT_VLE(b + c, vl);
+        FT_VSE(a + c, vb, vl);
+        FT_VSE(b + c, va, vl);
+    }
+}
+
+#if !FT_SCALED
+static void FT_NAME(scale)(FT_T *x, int count, FT_T factor) {
+    size_t vl;
+    for (size_t i = 0; i < (size_t)count; i += vl) {
+        vl = FT_VSETVL(count - i);
+        FT_VSE(x + i, FT_VSCALE(FT_VLE(x + i, vl), factor, vl), vl);
+    }
+}
+#endif
+
+// One radix-2 stage over a whole transform. Long sub-transforms are
+// vectorized along j within each block; short ones (the first stages)
+// across the blocks, with strided accesses and one twiddle per j.
+static void FT_NAME(stage)(FT_T *re, FT_T *im, int N, int half, const FT_T *w_re, const FT_T *w_im) {
+    size_t vl;
+    if (2 * half * half >= N) {
+        for (int i = 0; i < N; i += 2 * half) {
+            for (int j = 0; j < half; j += vl) {
+                vl = FT_VSETVL(half - j);
+                FT_T *a_re = re + i + j, *a_im = im + i + j;
+                FT_V ar = FT_VLE(a_re, vl), ai = FT_VLE(a_im, vl);
+                FT_V br = FT_VLE(a_re + half, vl), bi = FT_VLE(a_im + half, vl);
+                FT_V tr, ti;
+                FT_VCMUL(tr, ti, br, bi, FT_VLE(w_re + j, vl), FT_VLE(w_im + j, vl), vl);
+                FT_VSE(a_re, FT_VBADD(ar, tr, vl), vl);
+                FT_VSE(a_im, FT_VBADD(ai, ti, vl), vl);
+                FT_VSE(a_re + half, FT_VBSUB(ar, tr, vl), vl);
+                FT_VSE(a_im + half, FT_VBSUB(ai, ti, vl), vl);
+            }
+        }
+    } else {
+        int blocks = N / (2 * half);
+        ptrdiff_t stride = (ptrdiff_t)(2 * half) * sizeof(FT_T);
+        for (int j = 0; j < half; ++j) {
+            FT_V wr = FT_VMV(w_re[j], FT_VSETVL(blocks)), wi = FT_VMV(w_im[j], FT_VSETVL(blocks));
+            for (int b = 0; b < blocks; b += vl) {
+                vl = FT_VSETVL(blocks - b);
+                FT_T *a_re = re + b * 2 * half + j, *a_im = im + b * 2 * half + j;
+                FT_V ar = FT_VLSE(a_re, stride, vl), ai = FT_VLSE(a_im, stride, vl);
+                FT_V br = FT_VLSE(a_re + half, stride, vl), bi = FT_VLSE(a_im + half, stride, vl);
+                FT_V tr, ti;
+                FT_VCMUL(tr, ti, br, bi, wr, wi, vl);
+                FT_VSSE(a_re, stride, FT_VBADD(ar, tr, vl), vl);
+                FT_VSSE(a_im, stride, FT_VBADD(ai, ti, vl), vl);
+                FT_VSSE(a_re + half, stride, FT_VBSUB(ar, tr, vl), vl);
+                FT_VSSE(a_im + half, stride, FT_VBSUB(ai, ti, vl), vl);
+            }
+        }
+    }
+}
+
+#else
+
+static void FT_NAME(butterfly_span)(FT_T *a_re, FT_T *a_im, FT_T *b_re, FT_T *b_im, FT_T wr, FT_T wi, int n) {
+    for (int c = 0; c < n; ++c) {
+        FT_T tr, ti;
+        FT_CMUL(tr, ti, b_re[c], b_im[c], wr, wi);
+        b_re[c] = FT_BSUB(a_re[c], tr);
+        b_im[c] = FT_BSUB(a_im[c], ti);
+        a_re[c] = FT_BADD(a_re[c], tr);
+        a_im[c] = FT_BADD(a_im[c], ti);
+    }
+}
+
+static void FT_NAME(swap_span)(FT_T *a, FT_T *b, int n) {
+    for (int c = 0; c < n; ++c) {
+        FT_T t = a[c];
+        a[c] = b[c];
+        b[c] = t;
+    }
+}
+
+#if !FT_SCALED
+static void FT_NAME(scale)(FT_T *x, int count, FT_T factor) {
+    for (int i = 0; i < count; ++i) {
+        x[i] *= factor;
+    }
+}
+#endif
+
+static void FT_NAME(stage)(FT_T *re, FT_T *im, int N, int half, const FT_T *w_re, const FT_T *w_im) {
+    for (int i = 0; i < N; i += 2 * half) {
+        for (int j = 0; j < half; ++j) {
+            FT_T tr, ti;
+            FT_CMUL(tr, ti, re[i + j + half], im[i + j + half], w_re[j], w_im[j]);
+            re[i + j + half] = FT_BSUB(re[i + j], tr);
+            im[i + j + half] = FT_BSUB(im[i + j], ti);
+            re[i + j] = FT_BADD(re[i + j], tr);
+            im[i + j] = FT_BADD(im[i + j], ti);
+        }
+    }
+}
+
+#endif
+
+void FT_NAME(fft_typed_execute)(const fft_typed_plan *plan, FT_T *re, FT_T *im) {
+    int N = plan->n;
+    if (N <= 1) return;
+
+    for (int i = 0; i < N; ++i) {
+        int j = plan->bitrev[i];
+        if (j > i) {
+            FT_T t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (int half = 1; half < N; half <<= 1) {
+        FT_NAME(stage)(re, im, N, half, &plan->FT_TW.re[half - 1], &plan->FT_TW.im[half - 1]);
+    }
+#if !FT_SCALED
+    if (plan->inverse) {
+        FT_NAME(scale)(re, N, (FT_T)(1.0 / N));
+        FT_NAME(scale)(im, N, (FT_T)(1.0 / N));
+    }
+#endif
+}
+
+// Transforms all cols columns of a row-major rows x cols matrix at once:
+// rows are swapped and butterflied whole, one vector operation across the
+// columns, so the column pass needs no transpose or temp buffer.
+static void FT_NAME(execute_columns)(const fft_typed_plan *plan, FT_T *re, FT_T *im, int cols) {
+    int N = plan->n;
+    if (N <= 1) return;
+
+    for (int i = 0; i < N; ++i) {
+        int j = plan->bitrev[i];
+        if (j > i) {
+            FT_NAME(swap_span)(re + i * cols, re + j * cols, cols);
+            FT_NAME(swap_span)(im + i * cols, im + j * cols, cols);
+        }
+    }
+    for (int half = 1; half < N; half <<= 1) {
+        const FT_T *w_re = &plan->FT_TW.re[half - 1], *w_im = &plan->FT_TW.im[half - 1];
+        for (int i = 0; i < N; i += 2 * half) {
+            for (int j = 0; j < half; ++j) {
+                int a = (i + j) * cols, b = a + half * cols;
+                FT_NAME(butterfly_span)(re + a, im + a, re + b, im + b, w_re[j], w_im[j], cols);
+            }
+        }
+    }
+#if !FT_SCALED
+    if (plan->inverse) {
+        FT_NAME(scale)(re, N * cols, (FT_T)(1.0 / N));
+        FT_NAME(scale)(im, N * cols, (FT_T)(1.0 / N));
+    }
+#endif
+}
+
+void FT_NAME(fft_typed_2d)(int rows, int cols, FT_T *re, FT_T *im, int inverse) {
+    fft_typed_plan *row_plan = fft_typed_plan_create(cols, inverse, FT_TYPE);
+    fft_typed_plan *col_plan = fft_typed_plan_create(rows, inverse, FT_TYPE);
+    if (!row_plan || !col_plan) {
+        uart_puts("Error: FFT plan creation failed!\n");
+        while (1);
+    }
+
+    for (int r = 0; r < rows; ++r) {
+        FT_NAME(fft_typed_execute)(row_plan, re + r * cols, im + r * cols);
+    }
+    FT_NAME(execute_columns)(col_plan, re, im, cols);
+
+    fft_typed_plan_destroy(row_plan);
+    fft_typed_plan_destroy(col_plan);
+}
+
+#undef FT_T
+#undef FT_NAME
+#undef FT_TYPE
+#undef FT_TW
+#undef FT_SCALED
+#undef FT_FROM_DOUBLE
+#undef FT_CMUL
+#undef FT_BADD
+#undef FT_BSUB
+#undef FT_VECTOR
+#undef FT_V
+#undef FT_VSETVL
+#undef FT_VLE
+#undef FT_VSE
+#undef FT_VLSE
+#undef FT_VSSE
+#undef FT_VMV
+#undef FT_VCMUL
+#undef FT_VBADD
+#undef FT_VBSUB
+#undef FT_VSCALE
@@ -1,5 +1,7 @@
 #include "uart.h"
 #include "fft_2d.h"
+#include "fft_1d.h"
+#include "profile.h"
 
 int main(void) {
     uart_init();
@@ -32,6 +34,25 @@ int main(void) {
         uart_puts("i\n");
     }
 
+#if defined(FFT_PROFILE)
+    // A workload big enough to profile: 16x16 2D transforms both ways and
+    // one 1D size per kernel (radix 2, mixed radix, Bluestein).
+    static cplx_double work[FFT_1D_MAX_N];
+    static const int sizes_1d[] = { 1024, 1000, 509 };
+    for (int i = 0; i < FFT_1D_MAX_N; ++i) {
+        work[i] = (double)(i % 17) - 8.0;
+    }
+    for (int rep = 0; rep < 8; ++rep) {
+        fft_2d(16, 16, work, 0);
+        fft_2d(16, 16, work, 1);
+        for (int s = 0; s < 3; ++s) {
+            fft_1d(sizes_1d[s], work, 0);
+            fft_1d(sizes_1d[s], work, 1);
+        }
+    }
+#endif
+    prof_dump();
+
     uart_puts("Done.\n");
     while (1);
 
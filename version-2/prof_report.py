@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Turns a profile.h UART dump into a per-stage report.
+
+Usage: prof_report.py [dump.txt]   (reads stdin without an argument)
+
+Reads the last PROF BEGIN ... PROF END block in the input (other console
+output is ignored) and prints, per stage: calls, cycles, retired
+instructions, IPC, cycles per call and cycles per item, where an item is
+the unit printed in the dump (a butterfly for the butterfly stages). The
+share column splits fft_2d time between its row pass, transposes and
+column pass.
+"""
+
+import sys
+
+
+def parse(lines):
+    stages = None
+    for line in lines:
+        line = line.strip()
+        if line == "PROF BEGIN":
+            stages = []
+        elif line == "PROF END":
+            if stages is not None:
+                yield stages
+            stages = None
+        elif line.startswith("PROF ") and stages is not None:
+            fields = line.split()
+            entry = {"stage": fields[1]}
+            for field in fields[2:]:
+                key, _, value = field.partition("=")
+                entry[key] = value if key == "unit" else int(value, 0)
+            stages.append(entry)
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    dumps = list(parse(source))
+    if not dumps:
+        sys.exit("no PROF BEGIN/END block in the input")
+    stages = dumps[-1]
+
+    total_2d = sum(s["cycles"] for s in stages if s["stage"].startswith("fft_2d."))
+    print(f"{'stage':<18} {'calls':>8} {'cycles':>14} {'instret':>14} {'IPC':>6} "
+          f"{'cyc/call':>12} {'cyc/item':>10} {'unit':<10} {'share':>6}")
+    for s in stages:
+        calls, cycles, instret, items = s["calls"], s["cycles"], s["instret"], s["items"]
+        ipc = f"{instret / cycles:.2f}" if cycles and instret else "-"
+        per_call = f"{cycles / calls:.0f}" if calls else "-"
+        per_item = f"{cycles / items:.2f}" if items else "-"
+        share = "-"
+        if s["stage"].startswith("fft_2d.") and total_2d:
+            share = f"{100.0 * cycles / total_2d:.1f}%"
+        print(f"{s['stage']:<18} {calls:>8} {cycles:>14} {instret:>14} {ipc:>6} "
+              f"{per_call:>12} {per_item:>10} {s['unit']:<10} {share:>6}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,64 @@
+#include "profile.h"
+
+#if defined(FFT_PROFILE)
+
+#include "uart.h"
+
+prof_counter prof_table[PROF_STAGE_COUNT];
+
+static const char *const stage_names[PROF_STAGE_COUNT] = {
+    "fft_2d.rows",
+    "fft_2d.transpose",
+    "fft_2d.columns",
+    "fft_1d.bitrev",
+    "fft_1d.butterfly",
+    "fft_1d.stockham",
+    "fft_1d.mixed",
+    "fft_1d.bluestein",
+    "fft_1d.scale",
+};
+
+// What one item is, for the cycles-per-item column of the report.
+static const char *const stage_units[PROF_STAGE_COUNT] = {
+    "point",
+    "element",
+    "point",
+    "point",
+    "butterfly",
+    "butterfly",
+    "butterfly",
+    "point",
+    "point",
+};
+
+void prof_reset(void) {
+    for (int i = 0; i < PROF_STAGE_COUNT; ++i) {
+        prof_table[i].calls = 0;
+        prof_table[i].cycles = 0;
+        prof_table[i].instret = 0;
+        prof_table[i].items = 0;
+    }
+}
+
+void prof_dump(void) {
+    uart_puts("PROF BEGIN\n");
+    for (int i = 0; i < PROF_STAGE_COUNT; ++i) {
+        const prof_counter *c = &prof_table[i];
+        uart_puts("PROF ");
+        uart_puts(stage_names[i]);
+        uart_puts(" unit=");
+        uart_puts(stage_units[i]);
+        uart_puts(" calls=");
+        uart_puthex(c->calls);
+        uart_puts(" cycles=");
+        uart_puthex(c->cycles);
+        uart_puts(" instret=");
+        uart_puthex(c->instret);
+        uart_puts(" items=");
+        uart_puthex(c->items);
+        uart_putc('\n');
+    }
+    uart_puts("PROF END\n");
+}
+
+#endif
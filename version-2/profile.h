@@ -0,0 +1,126 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// --- Per-stage cycle profiler ---
+// Built with -DFFT_PROFILE (make PROFILE=1), every instrumented stage adds
+// its rdcycle/rdinstret deltas, call count and work items to a static
+// table, and prof_dump() prints the table over the UART:
+//
+//   PROF BEGIN
+//   PROF <stage> unit=<item unit> calls=<hex> cycles=<hex> instret=<hex> items=<hex>
+//   ...
+//   PROF END
+//
+// prof_report.py turns a dump into IPC and cycles per item. Stages nest:
+// fft_2d.rows includes the fft_1d.* stages of the row transforms. Without
+// FFT_PROFILE the macros compile away and prof_dump() is empty.
+
+enum {
+    PROF_FFT_2D_ROWS,       // fft_2d row transforms
+    PROF_FFT_2D_TRANSPOSE,  // fft_2d transposes, both directions
+    PROF_FFT_2D_COLUMNS,    // fft_2d column transforms
+    PROF_FFT_1D_BITREV,     // radix-2 bit-reversal permutation
+    PROF_FFT_1D_BUTTERFLY,  // fused radix-2/4/8 passes, in radix-2 butterflies
+    PROF_FFT_1D_STOCKHAM,   // radix-2 Stockham stages, including the copy back
+    PROF_FFT_1D_MIXED,      // mixed-radix Stockham stages
+    PROF_FFT_1D_BLUESTEIN,  // Bluestein chirp multiplies (its FFTs count as radix-2)
+    PROF_FFT_1D_SCALE,      // 1/N normalization of inverse transforms
+    PROF_STAGE_COUNT
+};
+
+#if defined(FFT_PROFILE)
+
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t instret;
+    uint64_t items;
+} prof_counter;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t instret;
+} prof_mark;
+
+extern prof_counter prof_table[PROF_STAGE_COUNT];
+
+static inline uint64_t prof_read_cycles(void) {
+#if defined(__riscv)
+    uint64_t value;
+    __asm__ volatile("rdcycle %0" : "=r"(value));
+    return value;
+#elif defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t prof_read_instret(void) {
+#if defined(__riscv)
+    uint64_t value;
+    __asm__ volatile("rdinstret %0" : "=r"(value));
+    return value;
+#else
+    return 0;
+#endif
+}
+
+static inline prof_mark prof_now(void) {
+    prof_mark m;
+    m.instret = prof_read_instret();
+    m.cycles = prof_read_cycles();
+    return m;
+}
+
+static inline void prof_record(int stage, prof_mark start, uint64_t items) {
+    uint64_t cycles = prof_read_cycles();
+    uint64_t instret = prof_read_instret();
+    prof_counter *c = &prof_table[stage];
+    c->calls++;
+    c->cycles += cycles - start.cycles;
+    c->instret += instret - start.instret;
+    c->items += items;
+}
+
+// Between PROF_PAUSE and PROF_RESUME the mark holds the counts so far
+// instead of the start, so the region in between is left out of the
+// stage. Used around sub-transforms recorded under their own stage.
+static inline void prof_pause(prof_mark *m) {
+    prof_mark now = prof_now();
+    m->cycles = now.cycles - m->cycles;
+    m->instret = now.instret - m->instret;
+}
+
+static inline void prof_resume(prof_mark *m) {
+    prof_mark now = prof_now();
+    m->cycles = now.cycles - m->cycles;
+    m->instret = now.instret - m->instret;
+}
+
+#define PROF_BEGIN(mark) prof_mark mark = prof_now()
+#define PROF_PAUSE(mark) prof_pause(&mark)
+#define PROF_RESUME(mark) prof_resume(&mark)
+#define PROF_END(stage, mark, items) prof_record(stage, mark, items)
+
+void prof_reset(void);
+void prof_dump(void);
+
+#else
+
+#define PROF_BEGIN(mark) ((void)0)
+#define PROF_PAUSE(mark) ((void)0)
+#define PROF_RESUME(mark) ((void)0)
+#define PROF_END(stage, mark, items) ((void)(items))
+
+static inline void prof_reset(void) {
+}
+
+static inline void prof_dump(void) {
+}
+
+#endif
+
+#endif // PROFILE_H
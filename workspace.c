@@ -0,0 +1,51 @@
+#include "workspace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void workspace_init(workspace *ws) {
+    ws->base = NULL;
+    ws->capacity = 0;
+    ws->used = 0;
+    ws->grows = 0;
+}
+
+void workspace_free(workspace *ws) {
+    free(ws->base);
+    workspace_init(ws);
+}
+
+size_t workspace_block_size(size_t bytes) {
+    return (bytes + WORKSPACE_ALIGN - 1) & ~(size_t)(WORKSPACE_ALIGN - 1);
+}
+
+int workspace_begin(workspace *ws, size_t bytes) {
+    ws->used = 0;
+    if (bytes <= ws->capacity) {
+        return 0;
+    }
+
+    // Old contents are dead, so free and allocate rather than realloc
+    // (which would copy them).
+    free(ws->base);
+    ws->base = NULL;
+    ws->capacity = 0;
+    void *base = NULL;
+    if (posix_memalign(&base, WORKSPACE_ALIGN, bytes) != 0) {
+        perror("posix_memalign for workspace");
+        return -1;
+    }
+    ws->base = (unsigned char*)base;
+    ws->capacity = bytes;
+    ws->grows++;
+    return 0;
+}
+
+void *workspace_alloc(workspace *ws, size_t bytes) {
+    size_t size = workspace_block_size(bytes);
+    if (size > ws->capacity - ws->used) {
+        return NULL;
+    }
+    void *block = ws->base + ws->used;
+    ws->used += size;
+    return block;
+}
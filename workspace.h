@@ -0,0 +1,35 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h> // For size_t
+
+// Alignment of every workspace block: a cache line, which also covers
+// any vector register width in use.
+#define WORKSPACE_ALIGN 64
+
+// --- Workspace (bump arena) ---
+// One contiguous, aligned buffer that a worker carves per-request buffers
+// out of. workspace_begin() sizes it for the coming request and releases
+// the previous request's blocks; the memory is only reallocated when a
+// request needs more than any request before it, so steady-state requests
+// do no heap allocation. Not thread-safe: one workspace per thread.
+typedef struct {
+    unsigned char *base;
+    size_t capacity;
+    size_t used;
+    unsigned long grows; // Times the buffer had to be (re)allocated
+} workspace;
+
+void workspace_init(workspace *ws);
+void workspace_free(workspace *ws);
+
+// Rounds a block size up to WORKSPACE_ALIGN, for summing request sizes.
+size_t workspace_block_size(size_t bytes);
+// Makes room for `bytes` (a sum of workspace_block_size values) and
+// empties the workspace. Returns 0 on success, -1 if allocation failed.
+int workspace_begin(workspace *ws, size_t bytes);
+// Next aligned block, or NULL if it does not fit what workspace_begin
+// reserved.
+void *workspace_alloc(workspace *ws, size_t bytes);
+
+#endif // WORKSPACE_H